@@ -0,0 +1,112 @@
+// Compares the reader's per-trade path (TryPop -> AddTrade) with the batched
+// one (TryPopBatch -> AddBatch):
+//
+//   cqg_bench_add_batch [--count=N] [--symbols=N] [--batch=N] [--rounds=N]
+//
+// Trades are synthetic, a random walk per symbol at 1000 trades per
+// one-second window. Each round pushes a burst of --batch trades into the
+// queue and drains it, single-threaded, so the numbers are the reader's cost
+// per trade without contention.
+#include "aggregator.hpp"
+#include "trade.hpp"
+#include "trade_block.hpp"
+#include "trade_queue.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<STrade> GenerateTrades(size_t count, size_t symbols) {
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int> step(-3, 3);
+    std::uniform_real_distribution<double> qty(0.001, 0.5);
+    std::vector<std::string> names;
+    std::vector<double> prices;
+    for (size_t s = 0; s < symbols; ++s) {
+        names.push_back("SYM" + std::to_string(s) + "USDT");
+        prices.push_back(100.0 + static_cast<double>(s) * 50.0);
+    }
+    std::vector<STrade> trades;
+    trades.reserve(count);
+    const uint64_t start_ms = 1700000000000;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t s = rng() % symbols;
+        prices[s] += step(rng) * 0.01;
+        trades.push_back({names[s], prices[s], qty(rng), start_ms + i / 1000 * 1000, (rng() & 1) != 0});
+    }
+    return trades;
+}
+
+template <typename TDrain>
+double Run(const std::vector<STrade>& trades, size_t batch, int rounds, TDrain&& drain) {
+    SAppConfig cfg;
+    double seconds = 0.0;
+    for (int round = 0; round < rounds; ++round) {
+        CTradeAggregator aggregator(cfg);
+        CTradeQueue queue;
+        for (size_t begin = 0; begin < trades.size(); begin += batch) {
+            const size_t end = std::min(trades.size(), begin + batch);
+            for (size_t i = begin; i < end; ++i) {
+                queue.Push(trades[i]);
+            }
+            // Only the consumer side is timed.
+            const auto start = std::chrono::steady_clock::now();
+            drain(queue, aggregator);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        aggregator.FlushStatistics();
+    }
+    return seconds / rounds;
+}
+
+void Report(const char* name, size_t trades, double seconds) {
+    std::printf("%-10s %8.1f ns/trade %12.0f trades/s\n", name, seconds * 1e9 / static_cast<double>(trades),
+                static_cast<double>(trades) / seconds);
+}
+}
+
+int main(int argc, char** argv) {
+    size_t count = 2000000;
+    size_t symbols = 8;
+    size_t batch = 1024;
+    int rounds = 5;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--count=", 0) == 0) {
+            count = std::stoull(arg.substr(8));
+        } else if (arg.rfind("--symbols=", 0) == 0) {
+            symbols = std::max<size_t>(1, std::stoull(arg.substr(10)));
+        } else if (arg.rfind("--batch=", 0) == 0) {
+            batch = std::max<size_t>(1, std::stoull(arg.substr(8)));
+        } else if (arg.rfind("--rounds=", 0) == 0) {
+            rounds = std::max(1, std::stoi(arg.substr(9)));
+        } else {
+            std::fprintf(stderr, "usage: %s [--count=N] [--symbols=N] [--batch=N] [--rounds=N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const auto trades = GenerateTrades(count, symbols);
+    const double single = Run(trades, batch, rounds, [](CTradeQueue& queue, CTradeAggregator& aggregator) {
+        STrade trade;
+        while (queue.TryPop(trade)) {
+            aggregator.AddTrade(trade);
+        }
+    });
+    STradeBlock block;
+    block.Reserve(batch);
+    const double batched = Run(trades, batch, rounds, [&](CTradeQueue& queue, CTradeAggregator& aggregator) {
+        while (queue.TryPopBatch(block, batch)) {
+            aggregator.AddBatch(block);
+        }
+    });
+    Report("per-trade", trades.size(), single);
+    Report("batched", trades.size(), batched);
+    std::printf("speedup    %.2fx (batch=%zu, symbols=%zu, avx2=%s)\n", single / batched, batch, symbols,
+                ReduceTradesUsesAvx2() ? "yes" : "no");
+    return 0;
+}
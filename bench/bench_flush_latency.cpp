@@ -0,0 +1,158 @@
+// AddTrade latency while the writer flushes:
+//
+//   cqg_bench_flush_latency [--seconds=N] [--symbols=N] [--period-ms=N] [--write-period-ms=N]
+//
+// One thread adds trades with wall-clock timestamps as fast as it can, over
+// --symbols symbols, into --period-ms windows; another calls FlushStatistics
+// every --write-period-ms (default: the window period) and
+// destroys the returned windows, as the writer does. Every AddTrade call is
+// timed; calls that overlap a FlushStatistics call are reported separately.
+#include "aggregator.hpp"
+#include "trade.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+uint64_t NowMs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// Exact below kExactNs, raw samples above: the tail is what matters here.
+class CLatencyHistogram {
+public:
+    static constexpr uint32_t kExactNs = 1u << 17;
+
+    CLatencyHistogram() : m_counts(kExactNs, 0) {}
+    void Add(uint32_t ns) {
+        ++m_total;
+        if (ns < kExactNs) {
+            ++m_counts[ns];
+        } else {
+            m_slow.push_back(ns);
+        }
+    }
+    void Merge(const CLatencyHistogram& other) {
+        for (uint32_t ns = 0; ns < kExactNs; ++ns) {
+            m_counts[ns] += other.m_counts[ns];
+        }
+        m_slow.insert(m_slow.end(), other.m_slow.begin(), other.m_slow.end());
+        m_total += other.m_total;
+    }
+    uint32_t Percentile(double p) {
+        std::sort(m_slow.begin(), m_slow.end());
+        const uint64_t rank = std::min<uint64_t>(m_total - 1, static_cast<uint64_t>(p * static_cast<double>(m_total)));
+        uint64_t seen = 0;
+        for (uint32_t ns = 0; ns < kExactNs; ++ns) {
+            seen += m_counts[ns];
+            if (seen > rank) {
+                return ns;
+            }
+        }
+        return m_slow[rank - seen];
+    }
+    uint64_t Total() const { return m_total; }
+
+private:
+    std::vector<uint64_t> m_counts;
+    std::vector<uint32_t> m_slow;
+    uint64_t m_total = 0;
+};
+
+void Report(const char* name, CLatencyHistogram& h) {
+    if (h.Total() == 0) {
+        std::printf("%-14s no samples\n", name);
+        return;
+    }
+    std::printf("%-14s %10llu calls  p50 %6u ns  p99 %6u ns  p99.9 %7u ns  p99.99 %8u ns  max %8u ns\n", name,
+                static_cast<unsigned long long>(h.Total()), h.Percentile(0.5), h.Percentile(0.99),
+                h.Percentile(0.999), h.Percentile(0.9999), h.Percentile(1.0));
+}
+}
+
+int main(int argc, char** argv) {
+    int seconds = 5;
+    size_t symbols = 2000;
+    uint64_t period_ms = 100;
+    uint64_t write_period_ms = 0;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--seconds=", 0) == 0) {
+            seconds = std::max(1, std::stoi(arg.substr(10)));
+        } else if (arg.rfind("--symbols=", 0) == 0) {
+            symbols = std::max<size_t>(1, std::stoull(arg.substr(10)));
+        } else if (arg.rfind("--period-ms=", 0) == 0) {
+            period_ms = std::max<uint64_t>(1, std::stoull(arg.substr(12)));
+        } else if (arg.rfind("--write-period-ms=", 0) == 0) {
+            write_period_ms = std::stoull(arg.substr(18));
+        } else {
+            std::fprintf(stderr, "usage: %s [--seconds=N] [--symbols=N] [--period-ms=N] [--write-period-ms=N]\n",
+                         argv[0]);
+            return 1;
+        }
+    }
+
+    if (write_period_ms == 0) {
+        write_period_ms = period_ms;
+    }
+    SAppConfig cfg;
+    cfg.agg.period_ms = period_ms;
+    CTradeAggregator aggregator(cfg);
+    std::vector<std::string> names;
+    for (size_t s = 0; s < symbols; ++s) {
+        names.push_back("SYM" + std::to_string(s) + "USDT");
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<bool> flushing{false};
+    uint64_t windows = 0;
+    std::thread writer([&]() {
+        while (!stop.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(write_period_ms));
+            flushing.store(true);
+            auto flushed = aggregator.FlushStatistics();
+            windows += flushed.size();
+            flushed.clear();  // arenas go back to the pool here, as in the writer
+            flushing.store(false);
+        }
+    });
+
+    CLatencyHistogram quiet;
+    CLatencyHistogram during_flush;
+    std::mt19937_64 rng(42);
+    const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    uint64_t ts = NowMs();
+    for (uint64_t i = 0;; ++i) {
+        if ((i & 1023) == 0) {
+            ts = NowMs();
+            if (std::chrono::steady_clock::now() >= end) {
+                break;
+            }
+        }
+        const STrade trade{names[rng() % symbols], 100.0 + static_cast<double>(i % 100) * 0.01, 0.5, ts, (i & 1) != 0};
+        const bool overlaps = flushing.load(std::memory_order_relaxed);
+        const auto start = std::chrono::steady_clock::now();
+        aggregator.AddTrade(trade);
+        const auto ns = static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        (overlaps || flushing.load(std::memory_order_relaxed) ? during_flush : quiet).Add(ns);
+    }
+    stop.store(true);
+    writer.join();
+
+    std::printf("symbols=%zu period=%llu ms write period=%llu ms windows flushed=%llu\n", symbols,
+                static_cast<unsigned long long>(period_ms), static_cast<unsigned long long>(write_period_ms),
+                static_cast<unsigned long long>(windows));
+    Report("outside flush", quiet);
+    Report("during flush", during_flush);
+    quiet.Merge(during_flush);
+    Report("all", quiet);
+    return 0;
+}
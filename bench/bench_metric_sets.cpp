@@ -0,0 +1,112 @@
+// Compares the AddTrade cost of the minimal and the full metric set
+// (see metrics.hpp), both instantiated in the same binary:
+//
+//   cqg_bench_metric_sets [--count=N] [--symbols=N] [--rounds=N]
+//
+// Trades are synthetic: a random walk per symbol, 1000 trades per one-second
+// window spread over the symbols.
+#include "aggregator.hpp"
+#include "trade.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<STrade> GenerateTrades(size_t count, size_t symbols) {
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int> step(-3, 3);
+    std::uniform_real_distribution<double> qty(0.001, 0.5);
+    std::vector<std::string> names;
+    std::vector<double> prices;
+    for (size_t s = 0; s < symbols; ++s) {
+        names.push_back("SYM" + std::to_string(s) + "USDT");
+        prices.push_back(100.0 + static_cast<double>(s) * 50.0);
+    }
+    std::vector<STrade> trades;
+    trades.reserve(count);
+    const uint64_t start_ms = 1700000000000;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t s = rng() % symbols;
+        prices[s] += step(rng) * 0.01;
+        const uint64_t ts = start_ms + i / 1000 * 1000;  // 1000 trades per one-second window
+        trades.push_back({names[s], prices[s], qty(rng), ts, (rng() & 1) != 0});
+    }
+    return trades;
+}
+
+struct SRunResult {
+    double seconds = 0.0;
+    size_t output_bytes = 0;
+    size_t stats_bytes = 0;
+};
+
+template <typename TMetrics>
+SRunResult Run(const std::vector<STrade>& trades, int rounds) {
+    using Aggregator = CBasicTradeAggregator<TMetrics>;
+    SAppConfig cfg;
+    SRunResult result;
+    result.stats_bytes = sizeof(typename Aggregator::SSymbolStats);
+    for (int round = 0; round < rounds; ++round) {
+        Aggregator aggregator(cfg);
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto& trade : trades) {
+            aggregator.AddTrade(trade);
+        }
+        const auto windows = aggregator.FlushStatistics();
+        result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (round == 0) {
+            // Only the metric columns; the core fields are printed by both builds.
+            std::ostringstream os;
+            os << std::fixed;
+            for (const auto& window : windows) {
+                for (const auto& entry : window.second) {
+                    entry.second.metrics.Print(os, entry.second);
+                }
+            }
+            result.output_bytes = os.str().size();
+        }
+    }
+    result.seconds /= rounds;
+    return result;
+}
+
+void Report(const char* name, size_t trades, const SRunResult& r) {
+    std::printf("%-8s %8.1f ns/trade %12.0f trades/s  SSymbolStats=%zu bytes  metric output=%zu bytes\n", name,
+                r.seconds * 1e9 / static_cast<double>(trades), static_cast<double>(trades) / r.seconds,
+                r.stats_bytes, r.output_bytes);
+}
+}
+
+int main(int argc, char** argv) {
+    size_t count = 2000000;
+    size_t symbols = 8;
+    int rounds = 5;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--count=", 0) == 0) {
+            count = std::stoull(arg.substr(8));
+        } else if (arg.rfind("--symbols=", 0) == 0) {
+            symbols = std::max<size_t>(1, std::stoull(arg.substr(10)));
+        } else if (arg.rfind("--rounds=", 0) == 0) {
+            rounds = std::max(1, std::stoi(arg.substr(9)));
+        } else {
+            std::fprintf(stderr, "usage: %s [--count=N] [--symbols=N] [--rounds=N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const auto trades = GenerateTrades(count, symbols);
+    // Warm-up round: page faults and the first arena blocks are not counted.
+    Run<CMinimalMetrics>(trades, 1);
+    const auto minimal = Run<CMinimalMetrics>(trades, rounds);
+    const auto full = Run<CFullMetrics>(trades, rounds);
+    Report("minimal", trades.size(), minimal);
+    Report("full", trades.size(), full);
+    std::printf("full/minimal %.2fx\n", full.seconds / minimal.seconds);
+    return 0;
+}
@@ -0,0 +1,234 @@
+// Heap allocations and time per message of the websocket read loop:
+//
+//   cqg_bench_read_loop [--messages=N] [--rounds=N] [--timer-us=N]
+//
+// A server thread streams N trade frames over TLS on loopback. The client
+// reads them through the stream stack CWebSocketClient uses, with two loops:
+// - shared: each read gets a new lambda holding shared_ptr copies of the
+//   client and the connection, and Asio's default handler memory (the loop
+//   CWebSocketClient used before it got a CHandlerMemory);
+// - recycled: the handler moves its references on to the next read and
+//   allocates from the connection's CHandlerMemory, as CWebSocketClient does.
+// operator new is counted on the client thread, after a warm-up of 1000
+// messages. --timer-us adds a timer on the client thread, re-armed every N us.
+#include "handler_memory.hpp"
+#include "self_signed_cert.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+
+namespace beast = boost::beast;
+namespace net = boost::asio;
+namespace ssl = net::ssl;
+namespace websocket = beast::websocket;
+using tcp = net::ip::tcp;
+
+namespace {
+thread_local uint64_t t_allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+    ++t_allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+constexpr uint64_t kWarmupMessages = 1000;
+const char* const kFrame =
+    R"({"stream":"btcusdt@trade","data":{"e":"trade","E":1700000000123,"s":"BTCUSDT","t":4242424242,)"
+    R"("p":"37012.45000000","q":"0.01234000","T":1700000000122,"m":true,"M":true}})";
+
+using Stream = websocket::stream<beast::ssl_stream<beast::tcp_stream>>;
+
+void Serve(tcp::acceptor& acceptor, ssl::context& ctx, uint64_t messages) {
+    tcp::socket socket(acceptor.get_executor());
+    acceptor.accept(socket);
+    websocket::stream<ssl::stream<tcp::socket>> ws(std::move(socket), ctx);
+    ws.next_layer().handshake(ssl::stream_base::server);
+    ws.accept();
+    ws.text(true);
+    const std::string frame(kFrame);
+    for (uint64_t i = 0; i < messages; ++i) {
+        ws.write(net::buffer(frame));
+    }
+    beast::error_code ec;
+    ws.close(websocket::close_code::normal, ec);
+}
+
+struct SConnection {
+    SConnection(net::io_context& ioc, ssl::context& ctx) : ws(ioc, ctx) {}
+    Stream ws;
+    beast::flat_buffer buffer;
+    CHandlerMemory read_memory;
+};
+using ConnectionPtr = std::shared_ptr<SConnection>;
+
+struct SResult {
+    uint64_t messages = 0;
+    uint64_t allocations = 0;
+    double seconds = 0.0;
+    uint64_t handler_blocks = 0;  // CHandlerMemory's own operator new calls over the whole run
+};
+
+// Stands in for the client object the read handler keeps alive.
+class CLoop : public std::enable_shared_from_this<CLoop> {
+public:
+    explicit CLoop(uint64_t messages) : m_messages(messages) {}
+
+    void StartShared(const ConnectionPtr& conn) {
+        conn->ws.async_read(conn->buffer, [self = shared_from_this(), conn](beast::error_code ec, std::size_t) {
+            if (self->OnMessage(*conn, ec)) {
+                self->StartShared(conn);
+            }
+        });
+    }
+
+    struct SReadHandler {
+        std::shared_ptr<CLoop> self;
+        ConnectionPtr conn;
+        CHandlerMemory* memory;
+
+        using allocator_type = THandlerAllocator<SReadHandler>;
+        allocator_type get_allocator() const noexcept { return allocator_type(*memory); }
+
+        void operator()(beast::error_code ec, std::size_t) {
+            CLoop& loop = *self;
+            if (loop.OnMessage(*conn, ec)) {
+                loop.StartRecycled(std::move(*this));
+            }
+        }
+    };
+
+    void StartRecycled(SReadHandler handler) {
+        Stream& ws = handler.conn->ws;
+        beast::flat_buffer& buffer = handler.conn->buffer;
+        ws.async_read(buffer, std::move(handler));
+    }
+
+    bool OnMessage(SConnection& conn, beast::error_code ec) {
+        if (ec) {
+            return false;
+        }
+        conn.buffer.consume(conn.buffer.size());
+        ++m_read;
+        if (m_read == kWarmupMessages) {
+            m_started = std::chrono::steady_clock::now();
+            m_allocations_at_start = t_allocations;
+        }
+        if (m_read == m_messages) {
+            m_result.messages = m_read - kWarmupMessages;
+            m_result.allocations = t_allocations - m_allocations_at_start;
+            m_result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_started).count();
+        }
+        return true;
+    }
+
+    bool Done() const { return m_read >= m_messages; }
+    const SResult& Result() const { return m_result; }
+
+private:
+    const uint64_t m_messages;
+    uint64_t m_read = 0;
+    uint64_t m_allocations_at_start = 0;
+    std::chrono::steady_clock::time_point m_started;
+    SResult m_result;
+};
+
+// Re-armed every timer_us on the client thread until the loop is done, like
+// the client's own timers, competing with the reads for Asio's per-thread
+// handler memory.
+void Tick(net::steady_timer& timer, const CLoop& loop, int timer_us) {
+    if (loop.Done()) {
+        return;
+    }
+    timer.expires_after(std::chrono::microseconds(timer_us));
+    timer.async_wait([&timer, &loop, timer_us](beast::error_code ec) {
+        if (!ec) {
+            Tick(timer, loop, timer_us);
+        }
+    });
+}
+
+SResult Run(bool recycled, uint64_t messages, int timer_us) {
+    ssl::context server_ctx(ssl::context::tls_server);
+    if (!UseSelfSignedCertificate(server_ctx)) {
+        std::fprintf(stderr, "certificate generation failed\n");
+        std::exit(1);
+    }
+    net::io_context server_ioc;
+    tcp::acceptor acceptor(server_ioc, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+    std::thread server([&] { Serve(acceptor, server_ctx, messages); });
+
+    net::io_context ioc;
+    ssl::context ctx(ssl::context::tls_client);
+    ctx.set_verify_mode(ssl::verify_none);
+    auto conn = std::make_shared<SConnection>(ioc, ctx);
+    beast::get_lowest_layer(conn->ws).connect(acceptor.local_endpoint());
+    conn->ws.next_layer().handshake(ssl::stream_base::client);
+    conn->ws.handshake("localhost", "/");
+
+    auto loop = std::make_shared<CLoop>(messages);
+    if (recycled) {
+        loop->StartRecycled(CLoop::SReadHandler{loop, conn, &conn->read_memory});
+    } else {
+        loop->StartShared(conn);
+    }
+    net::steady_timer timer(ioc);
+    if (timer_us > 0) {
+        Tick(timer, *loop, timer_us);
+    }
+    ioc.run();
+    server.join();
+    SResult result = loop->Result();
+    result.handler_blocks = conn->read_memory.Allocations();
+    return result;
+}
+}
+
+int main(int argc, char** argv) {
+    uint64_t messages = 200000;
+    int rounds = 3;
+    int timer_us = 0;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--messages=", 0) == 0) {
+            messages = std::max<uint64_t>(kWarmupMessages + 1, std::stoull(arg.substr(11)));
+        } else if (arg.rfind("--timer-us=", 0) == 0) {
+            timer_us = std::stoi(arg.substr(11));
+        } else if (arg.rfind("--rounds=", 0) == 0) {
+            rounds = std::max(1, std::stoi(arg.substr(9)));
+        } else {
+            std::fprintf(stderr, "usage: %s [--messages=N] [--rounds=N] [--timer-us=N]\n", argv[0]);
+            return 1;
+        }
+    }
+    for (int round = 0; round < rounds; ++round) {
+        for (const bool recycled : {false, true}) {
+            const SResult result = Run(recycled, messages, timer_us);
+            std::printf("%-9s messages=%llu handler_blocks=%llu allocations/msg=%.3f ns/msg=%.0f\n",
+                        recycled ? "recycled" : "shared", static_cast<unsigned long long>(result.messages),
+                        static_cast<unsigned long long>(result.handler_blocks),
+                        result.messages ? static_cast<double>(result.allocations) / static_cast<double>(result.messages) : 0.0,
+                        result.messages ? result.seconds * 1e9 / static_cast<double>(result.messages) : 0.0);
+        }
+    }
+    return 0;
+}
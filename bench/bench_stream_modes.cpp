@@ -0,0 +1,220 @@
+// Compares the per-message cost of the @trade and @aggTrade stream modes:
+// parse -> CTradeQueue::Push -> Pop -> CTradeAggregator::AddTrade, once with
+// STrade::FromJson (JSON DOM) and once with the Binance feed adapter's parser.
+//
+//   cqg_bench_stream_modes [--trades=recorded.jsonl] [--agg-trades=recorded.jsonl]
+//                          [--count=N] [--rounds=N]
+//
+// Input files hold one combined-stream frame per line, as received from the
+// socket. Without --trades a bursty synthetic @trade feed is generated. Without
+// --agg-trades the @aggTrade feed is derived from the @trade one by merging
+// consecutive fills with the same symbol, price, side and timestamp, which is
+// how the exchange groups them per taker order.
+#include "aggregator.hpp"
+#include "feed_adapter.hpp"
+#include "trade.hpp"
+#include "trade_queue.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<std::string> ReadLines(const std::string& path) {
+    std::vector<std::string> lines;
+    std::ifstream in(path);
+    for (std::string line; std::getline(in, line);) {
+        if (!line.empty()) {
+            lines.push_back(std::move(line));
+        }
+    }
+    return lines;
+}
+
+std::string FormatTradeFrame(const STrade& t, uint64_t id) {
+    std::ostringstream oss;
+    oss.precision(10);
+    std::string stream = t.symbol;
+    for (auto& c : stream) {
+        c = static_cast<char>(::tolower(c));
+    }
+    oss << R"({"stream":")" << stream << R"(@trade","data":{"e":"trade","E":)" << t.timestamp + 1
+        << R"(,"s":")" << t.symbol << R"(","t":)" << id << R"(,"p":")" << t.price << R"(","q":")" << t.quantity
+        << R"(","T":)" << t.timestamp << R"(,"m":)" << (t.buyer_initiated ? "true" : "false")
+        << R"(,"M":true}})";
+    return oss.str();
+}
+
+std::string FormatAggTradeFrame(const STrade& t, uint64_t agg_id) {
+    std::ostringstream oss;
+    oss.precision(10);
+    std::string stream = t.symbol;
+    for (auto& c : stream) {
+        c = static_cast<char>(::tolower(c));
+    }
+    oss << R"({"stream":")" << stream << R"(@aggTrade","data":{"e":"aggTrade","E":)" << t.timestamp + 1
+        << R"(,"s":")" << t.symbol << R"(","a":)" << agg_id << R"(,"p":")" << t.price << R"(","q":")"
+        << t.quantity << R"(","f":)" << t.first_trade_id << R"(,"l":)" << t.last_trade_id
+        << R"(,"T":)" << t.timestamp << R"(,"m":)" << (t.buyer_initiated ? "true" : "false")
+        << R"(,"M":true}})";
+    return oss.str();
+}
+
+// Market orders sweeping a few levels: each burst fills several makers at the
+// same price in the same millisecond.
+std::vector<std::string> GenerateTrades(size_t count) {
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int> burst(1, 12);
+    std::uniform_int_distribution<int> levels(1, 3);
+    std::uniform_real_distribution<double> qty(0.001, 0.5);
+    const char* symbols[] = {"BTCUSDT", "ETHUSDT"};
+    double mid[] = {65000.0, 3200.0};
+
+    std::vector<std::string> frames;
+    frames.reserve(count);
+    uint64_t ts = 1700000000000;
+    uint64_t id = 1;
+    while (frames.size() < count) {
+        const size_t s = rng() % 2;
+        const bool buyer_maker = rng() % 2;
+        ts += rng() % 3;
+        double price = mid[s];
+        for (int level = levels(rng); level > 0 && frames.size() < count; --level) {
+            for (int fill = burst(rng); fill > 0 && frames.size() < count; --fill) {
+                STrade t{symbols[s], price, qty(rng), ts, buyer_maker};
+                frames.push_back(FormatTradeFrame(t, id++));
+            }
+            price += buyer_maker ? -0.01 : 0.01;
+        }
+        mid[s] = price;
+    }
+    return frames;
+}
+
+std::vector<std::string> DeriveAggTrades(const std::vector<std::string>& trade_frames) {
+    std::vector<std::string> frames;
+    STrade pending{};
+    bool has_pending = false;
+    uint64_t agg_id = 1;
+    for (const auto& frame : trade_frames) {
+        const STrade t = STrade::FromJson(frame);
+        if (has_pending && t.symbol == pending.symbol && t.price == pending.price &&
+            t.buyer_initiated == pending.buyer_initiated && t.timestamp == pending.timestamp) {
+            pending.quantity += t.quantity;
+            pending.last_trade_id = t.last_trade_id;
+            continue;
+        }
+        if (has_pending) {
+            frames.push_back(FormatAggTradeFrame(pending, agg_id++));
+        }
+        pending = t;
+        has_pending = true;
+    }
+    if (has_pending) {
+        frames.push_back(FormatAggTradeFrame(pending, agg_id++));
+    }
+    return frames;
+}
+
+struct SRunResult {
+    double seconds = 0.0;
+    uint64_t trades = 0;
+    double volume = 0.0;
+};
+
+template <typename FParse>
+SRunResult Run(const std::vector<std::string>& frames, int rounds, FParse parse) {
+    SAppConfig cfg;
+    SRunResult result;
+    for (int round = 0; round < rounds; ++round) {
+        CTradeAggregator aggregator(cfg);
+        CTradeQueue queue;
+        STrade trade;
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto& frame : frames) {
+            queue.Push(parse(frame));
+            queue.Pop(trade);
+            aggregator.AddTrade(trade);
+        }
+        const auto stats = aggregator.FlushStatistics();
+        result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (round == 0) {
+            for (const auto& window : stats) {
+                for (const auto& entry : window.second) {
+                    result.trades += entry.second.trades_count;
+                    result.volume += entry.second.total_volume;
+                }
+            }
+        }
+    }
+    result.seconds /= rounds;
+    return result;
+}
+
+void Report(const char* mode, size_t messages, const SRunResult& r) {
+    std::printf("%-16s messages=%-9zu trades=%-9llu %8.1f ns/message %8.1f ns/trade %10.0f trades/s\n",
+                mode, messages, static_cast<unsigned long long>(r.trades),
+                r.seconds * 1e9 / static_cast<double>(messages),
+                r.seconds * 1e9 / static_cast<double>(r.trades),
+                static_cast<double>(r.trades) / r.seconds);
+}
+}
+
+int main(int argc, char** argv) {
+    std::string trades_path;
+    std::string agg_trades_path;
+    size_t count = 200000;
+    int rounds = 5;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--trades=", 0) == 0) {
+            trades_path = arg.substr(9);
+        } else if (arg.rfind("--agg-trades=", 0) == 0) {
+            agg_trades_path = arg.substr(13);
+        } else if (arg.rfind("--count=", 0) == 0) {
+            count = std::stoull(arg.substr(8));
+        } else if (arg.rfind("--rounds=", 0) == 0) {
+            rounds = std::max(1, std::stoi(arg.substr(9)));
+        } else {
+            std::fprintf(stderr, "usage: %s [--trades=file] [--agg-trades=file] [--count=N] [--rounds=N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const auto trade_frames = trades_path.empty() ? GenerateTrades(count) : ReadLines(trades_path);
+    const auto agg_frames = agg_trades_path.empty() ? DeriveAggTrades(trade_frames) : ReadLines(agg_trades_path);
+    if (trade_frames.empty() || agg_frames.empty()) {
+        std::fprintf(stderr, "no input frames\n");
+        return 1;
+    }
+
+    auto dom = [](const std::string& frame) { return STrade::FromJson(frame); };
+    auto adapter = [](const std::string& frame) {
+        STrade trade{};
+        CBinanceFeed::ParseTrade(frame, trade);
+        return trade;
+    };
+    const auto raw = Run(trade_frames, rounds, dom);
+    const auto agg = Run(agg_frames, rounds, dom);
+    const auto raw_adapter = Run(trade_frames, rounds, adapter);
+    const auto agg_adapter = Run(agg_frames, rounds, adapter);
+    Report("trade", trade_frames.size(), raw);
+    Report("aggTrade", agg_frames.size(), agg);
+    Report("trade/adapter", trade_frames.size(), raw_adapter);
+    Report("aggTrade/adapter", agg_frames.size(), agg_adapter);
+    std::printf("speedup   %.2fx (%.2f trades per aggTrade message)\n", raw.seconds / agg.seconds,
+                static_cast<double>(agg.trades) / static_cast<double>(agg_frames.size()));
+    std::printf("adapter   %.2fx on trade, %.2fx on aggTrade over the JSON DOM\n", raw.seconds / raw_adapter.seconds,
+                agg.seconds / agg_adapter.seconds);
+    if (raw.trades != agg.trades) {
+        std::printf("note: trade counts differ (%llu vs %llu); recordings cover different intervals?\n",
+                    static_cast<unsigned long long>(raw.trades), static_cast<unsigned long long>(agg.trades));
+    }
+    return 0;
+}
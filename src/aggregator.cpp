@@ -1,63 +1,326 @@
 
 #include "aggregator.hpp"
+#include "logger.hpp"
 #include <algorithm>
 #include <chrono>
 
-CTradeAggregator::CTradeAggregator(const SAppConfig& cfg)
-    : m_cfg(cfg) {}
+template <typename TMetrics>
+CBasicTradeAggregator<TMetrics>::CBasicTradeAggregator(const SAppConfig& cfg)
+    : m_cfg(cfg),
+      m_arena_pool(std::make_shared<CArenaPool>(cfg.agg.arena_kb * 1024, cfg.agg.arena_hugepages)) {}
 
-void CTradeAggregator::AddTrade(const STrade& trade) {
+template <typename TMetrics>
+typename CBasicTradeAggregator<TMetrics>::WindowStats& CBasicTradeAggregator<TMetrics>::Window(uint64_t window_start) {
+    auto it = m_statistics.find(window_start);
+    if (it == m_statistics.end()) {
+        const size_t sketch_slots = m_cfg.agg.top_k > 0 ? m_cfg.agg.sketch_slots : 0;
+        it = m_statistics.emplace(window_start, WindowStats(std::make_unique<CWindowArena>(m_arena_pool), sketch_slots,
+                                                            m_cfg.agg.top_k)).first;
+        const uint64_t deadline = window_start + m_cfg.agg.period_ms + m_cfg.output.write_delay_ms;
+        if (deadline < m_next_deadline_ms.load(std::memory_order_relaxed)) {
+            // Due before whatever the writer sleeps towards: wake it. This
+            // happens once per idle spell, not once per window.
+            m_next_deadline_ms.store(deadline, std::memory_order_release);
+            { std::lock_guard<std::mutex> wait_lock(m_deadline_mutex); }
+            m_deadline_cond.notify_one();
+        }
+    }
+    return it->second;
+}
+
+template <typename TMetrics>
+void CBasicTradeAggregator<TMetrics>::StoreDeadlineLocked() {
+    m_next_deadline_ms.store(m_statistics.empty() ? kNoDeadline
+                                                  : m_statistics.begin()->first + m_cfg.agg.period_ms +
+                                                        m_cfg.output.write_delay_ms,
+                             std::memory_order_release);
+}
+
+template <typename TMetrics>
+bool CBasicTradeAggregator<TMetrics>::WaitForFlushDue(std::chrono::milliseconds max_wait) {
+    using Clock = std::chrono::system_clock;
+    const auto give_up = Clock::now() + max_wait;
+    std::unique_lock<std::mutex> wait_lock(m_deadline_mutex);
+    for (;;) {
+        if (m_wait_interrupted) {
+            m_wait_interrupted = false;
+            return false;
+        }
+        const uint64_t deadline = m_next_deadline_ms.load(std::memory_order_acquire);
+        const auto due = deadline == kNoDeadline ? Clock::time_point::max()
+                                                 : Clock::time_point(std::chrono::milliseconds(deadline));
+        const auto now = Clock::now();
+        if (now >= due) {
+            return true;
+        }
+        if (now >= give_up) {
+            return false;
+        }
+        m_deadline_cond.wait_until(wait_lock, std::min(due, give_up));
+    }
+}
+
+template <typename TMetrics>
+void CBasicTradeAggregator<TMetrics>::InterruptFlushWait() {
+    {
+        std::lock_guard<std::mutex> wait_lock(m_deadline_mutex);
+        m_wait_interrupted = true;
+    }
+    m_deadline_cond.notify_all();
+}
+
+template <typename TMetrics>
+void CBasicTradeAggregator<TMetrics>::AddTrade(const STrade& trade) {
     if (!trade.IsValid()) {
         return;
     }
     std::lock_guard<std::mutex> lock(m_mutex);
     const uint64_t window_start = (trade.timestamp / m_cfg.agg.period_ms) * m_cfg.agg.period_ms;
-    auto& stats = m_statistics[window_start][trade.symbol];
-    stats.trades_count++;
+    auto& stats = Window(window_start).Track(trade.symbol);
+    const uint64_t count = trade.TradeCount();
+    stats.trades_count += count;
     stats.total_quantity += trade.quantity;
     stats.total_volume += (trade.price * trade.quantity);
     stats.min_price = std::min(stats.min_price, trade.price);
     stats.max_price = std::max(stats.max_price, trade.price);
     if (trade.buyer_initiated) {
-        stats.sell_count++;
+        stats.sell_count += count;
     } else {
-        stats.buy_count++;
+        stats.buy_count += count;
+    }
+    stats.metrics.Add(trade.price, trade.quantity);
+    ServeFlushLocked();
+}
+
+template <typename TMetrics>
+void CBasicTradeAggregator<TMetrics>::AddBatch(const STradeBlock& block) {
+    const size_t n = block.Size();
+    if (n == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& b = m_batch;
+    b.groups.clear();
+    b.group_of.resize(n);
+    // Each symbol remembers its latest group; a block rarely spans more than
+    // one window per symbol, so the fallback scan is the exception.
+    b.group_by_symbol.assign(block.symbols.size(), kNoGroup);
+    for (size_t i = 0; i < n; ++i) {
+        const uint32_t symbol_index = block.symbol_index[i];
+        const uint64_t window_start = (block.timestamp[i] / m_cfg.agg.period_ms) * m_cfg.agg.period_ms;
+        uint32_t group = b.group_by_symbol[symbol_index];
+        if (group == kNoGroup || b.groups[group].window_start != window_start) {
+            group = 0;
+            while (group < b.groups.size() &&
+                   (b.groups[group].symbol_index != symbol_index || b.groups[group].window_start != window_start)) {
+                ++group;
+            }
+            if (group == b.groups.size()) {
+                b.groups.push_back({symbol_index, window_start, 0, 0, 0});
+            }
+            b.group_by_symbol[symbol_index] = group;
+        }
+        b.group_of[i] = group;
+        ++b.groups[group].size;
+    }
+
+    const bool single_group = b.groups.size() == 1;
+    if (!single_group) {
+        size_t offset = 0;
+        for (auto& g : b.groups) {
+            g.offset = offset;
+            g.cursor = offset;
+            offset += g.size;
+        }
+        b.price.resize(n);
+        b.quantity.resize(n);
+        b.trade_count.resize(n);
+        b.buyer_initiated.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            const size_t to = b.groups[b.group_of[i]].cursor++;
+            b.price[to] = block.price[i];
+            b.quantity[to] = block.quantity[i];
+            b.trade_count[to] = block.trade_count[i];
+            b.buyer_initiated[to] = block.buyer_initiated[i];
+        }
+    }
+    // A single group is reduced straight from the block's columns.
+    const double* price = single_group ? block.price.data() : b.price.data();
+    const double* quantity = single_group ? block.quantity.data() : b.quantity.data();
+    const uint64_t* trade_count = single_group ? block.trade_count.data() : b.trade_count.data();
+    const uint8_t* buyer_initiated = single_group ? block.buyer_initiated.data() : b.buyer_initiated.data();
+
+    for (const auto& g : b.groups) {
+        auto& stats = Window(g.window_start).Track(block.symbols[g.symbol_index]);
+        const STradeReduction r = ReduceTrades(price + g.offset, quantity + g.offset, trade_count + g.offset,
+                                               buyer_initiated + g.offset, g.size);
+        stats.trades_count += r.trades_count;
+        stats.total_quantity += r.total_quantity;
+        stats.total_volume += r.total_volume;
+        stats.min_price = std::min(stats.min_price, r.min_price);
+        stats.max_price = std::max(stats.max_price, r.max_price);
+        stats.sell_count += r.buyer_initiated_count;
+        stats.buy_count += r.trades_count - r.buyer_initiated_count;
+        if constexpr (TMetrics::kSize > 0) {
+            for (size_t i = g.offset; i < g.offset + g.size; ++i) {
+                stats.metrics.Add(price[i], quantity[i]);
+            }
+        }
     }
+    ServeFlushLocked();
+}
 
+template <typename TMetrics>
+void CBasicTradeAggregator<TMetrics>::AddCoalesced(const SCoalescedTrades& partial) {
+    if (partial.trades_count == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint64_t window_start = (partial.window_start / m_cfg.agg.period_ms) * m_cfg.agg.period_ms;
+    auto& stats = Window(window_start).Track(partial.symbol);
+    stats.trades_count += partial.trades_count;
+    stats.total_quantity += partial.total_quantity;
+    stats.total_volume += partial.total_volume;
+    stats.min_price = std::min(stats.min_price, partial.min_price);
+    stats.max_price = std::max(stats.max_price, partial.max_price);
+    stats.buy_count += partial.buy_count;
+    stats.sell_count += partial.sell_count;
+    ServeFlushLocked();
 }
 
-CTradeAggregator::AllWindowsStats CTradeAggregator::FlushStatistics() {
+template <typename TMetrics>
+void CBasicTradeAggregator<TMetrics>::AddBookSample(const std::string& symbol, uint64_t timestamp_ms, const SBookSample& sample) {
+    if (timestamp_ms == 0) {
+        return;
+    }
     std::lock_guard<std::mutex> lock(m_mutex);
-    AllWindowsStats flushed;
-    const uint64_t now_ms = static_cast<uint64_t>(
-        std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::system_clock::now().time_since_epoch()).count());
+    const uint64_t window_start = (timestamp_ms / m_cfg.agg.period_ms) * m_cfg.agg.period_ms;
+    SSymbolStats* stats = Window(window_start).TrackSample(symbol);
+    if (!stats) {
+        ServeFlushLocked();
+        return;
+    }
+    auto& book = stats->book;
+    book.samples++;
+    book.spread_sum += sample.best_ask - sample.best_bid;
+    book.best_bid = sample.best_bid;
+    book.best_ask = sample.best_ask;
+    book.bid_depth = sample.bid_depth;
+    book.ask_depth = sample.ask_depth;
+    ServeFlushLocked();
+}
+
+template <typename TMetrics>
+void CBasicTradeAggregator<TMetrics>::DetachClosedLocked(uint64_t now_ms) {
+    // We do not flush the window immediately after it ends,
+    // we wait for delay_ms milliseconds. This allows for possible trade arrival delays,
+    // so that late trades with timestamps falling into an already finished window are still aggregated correctly.
+    // If agregate_using_timestamp=false, no delay is used and windows are flushed immediately
+    const uint64_t delay_ms = m_cfg.output.write_delay_ms;
+    AllWindowsStats closed;
+    // Windows are ordered by start, so the closed ones are a prefix.
     for (auto it = m_statistics.begin(); it != m_statistics.end();) {
-        const uint64_t window_start = it->first;
-        const uint64_t window_end = window_start + m_cfg.agg.period_ms;
-        const uint64_t delay_ms = m_cfg.output.write_delay_ms;
-        // We do not flush the window immediately after it ends,
-        // we wait for delay_ms milliseconds. This allows for possible trade arrival delays,
-        // so that late trades with timestamps falling into an already finished window are still aggregated correctly.
-        // If agregate_using_timestamp=false, no delay is used and windows are flushed immediately
-        if (window_end + delay_ms > now_ms) {
-            ++it;
-            continue;
-        }
-        flushed.emplace(window_start, std::move(it->second));
-        it = m_statistics.erase(it);
-    }
-    
+        if (it->first + m_cfg.agg.period_ms + delay_ms > now_ms) {
+            break;
+        }
+        closed.insert(m_statistics.extract(it++));
+    }
+    StoreDeadlineLocked();
+    m_flush_served_ms = now_ms;
+    {
+        std::lock_guard<std::mutex> handoff(m_handoff_mutex);
+        m_detached.merge(closed);
+        m_detached_as_of_ms = std::max(m_detached_as_of_ms, now_ms);
+    }
+    m_handoff_cond.notify_one();
+}
+
+template <typename TMetrics>
+typename CBasicTradeAggregator<TMetrics>::AllWindowsStats CBasicTradeAggregator<TMetrics>::FlushStatistics() {
+    // Requests are strictly increasing so that each one is served, even two
+    // within the same millisecond.
+    const uint64_t now_ms = std::max<uint64_t>(
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count()),
+        m_flush_requested_ms.load(std::memory_order_relaxed) + 1);
+    m_flush_requested_ms.store(now_ms, std::memory_order_release);
+    bool served = false;
+    {
+        std::unique_lock<std::mutex> handoff(m_handoff_mutex);
+        served = m_handoff_cond.wait_for(handoff, kFlushHandoffTimeout, [&]() {
+            return m_detached_as_of_ms >= now_ms;
+        });
+    }
+    if (!served) {
+        // Nobody is adding: the lock is free, so taking it stalls no one.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_flush_served_ms != now_ms) {
+            DetachClosedLocked(now_ms);
+        }
+    }
+    AllWindowsStats flushed;
+    {
+        std::lock_guard<std::mutex> handoff(m_handoff_mutex);
+        flushed.swap(m_detached);
+    }
+    // The top-K cut is the writer's work, off the producers' lock.
+    for (auto& window : flushed) {
+        window.second.KeepTopK();
+    }
     return flushed;
 }
 
-void CTradeAggregator::UpdateConfig(const SAppConfig& cfg) {
+template <typename TMetrics>
+void CBasicTradeAggregator<TMetrics>::UpdateConfig(const SAppConfig& cfg) {
     std::lock_guard<std::mutex> lock(m_mutex);
     const bool statistics_affected =
         (cfg.agg.period_ms != m_cfg.agg.period_ms) ||
         (cfg.output.write_delay_ms != m_cfg.output.write_delay_ms);
+    if (cfg.agg.arena_kb != m_cfg.agg.arena_kb || cfg.agg.arena_hugepages != m_cfg.agg.arena_hugepages) {
+        // Windows already handed out keep the old pool alive until they are gone.
+        m_arena_pool = std::make_shared<CArenaPool>(cfg.agg.arena_kb * 1024, cfg.agg.arena_hugepages);
+    }
     m_cfg = cfg;
     if (statistics_affected) {
         m_statistics.clear();
     }
+    StoreDeadlineLocked();
+    // The new deadline can be earlier than the one the writer sleeps towards.
+    { std::lock_guard<std::mutex> wait_lock(m_deadline_mutex); }
+    m_deadline_cond.notify_one();
 }
+
+template <typename TMetrics>
+void CBasicTradeAggregator<TMetrics>::WriteWindow(std::ostream& os, uint64_t window_start_ms, const WindowStats& stats_map) {
+    os << "timestamp=" << FormatIsoUtc(window_start_ms) << "\n";
+    for (const auto& entry : stats_map) {
+        const auto& symbol = entry.first;
+        const auto& stats = entry.second;
+        // A window can hold book samples for a symbol that had no trades.
+        const bool has_trades = stats.trades_count > 0;
+        os << "symbol=" << symbol
+           << " trades=" << stats.trades_count
+           << " volume=" << std::fixed << std::setprecision(5) << stats.total_volume
+           << " quantity=" << std::fixed << std::setprecision(5) << stats.total_quantity
+           << " min=" << std::setprecision(2) << (has_trades ? stats.min_price : 0.0)
+           << " max=" << std::setprecision(2) << (has_trades ? stats.max_price : 0.0)
+           << " buy=" << stats.buy_count
+           << " sell=" << stats.sell_count;
+        if (has_trades) {
+            stats.metrics.Print(os, stats);
+        }
+        const auto& book = stats.book;
+        if (book.samples > 0) {
+            os << " bid=" << std::setprecision(2) << book.best_bid
+               << " ask=" << std::setprecision(2) << book.best_ask
+               << " mid=" << std::setprecision(3) << (book.best_bid + book.best_ask) / 2.0
+               << " spread=" << std::setprecision(5) << book.spread_sum / static_cast<double>(book.samples)
+               << " bid_depth=" << std::setprecision(5) << book.bid_depth
+               << " ask_depth=" << std::setprecision(5) << book.ask_depth;
+        }
+        os << "\n";
+    }
+}
+
+template class CBasicTradeAggregator<CMinimalMetrics>;
+template class CBasicTradeAggregator<CFullMetrics>;
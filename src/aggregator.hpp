@@ -1,19 +1,46 @@
 #pragma once
 #include "config.hpp"
+#include "metrics.hpp"
+#include "order_book.hpp"
 #include "trade.hpp"
+#include "trade_block.hpp"
+#include "trade_queue.hpp"
+#include "window_arena.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
 #include <iomanip>
 #include <iostream>
 #include <limits>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
-
-class CTradeAggregator {
+// Per-window, per-symbol trade statistics. TMetrics (a CMetricSet, see
+// metrics.hpp) adds optional metrics on top of the core fields; the
+// instantiations live in aggregator.cpp and the rest of the service uses
+// CTradeAggregator, the set selected at build time.
+template <typename TMetrics>
+class CBasicTradeAggregator {
 public:
+    // Order book metrics of a window; samples == 0 when no book is kept for the symbol.
+    struct SBookStats {
+        uint64_t samples = 0;
+        double spread_sum = 0.0;
+        double best_bid = 0.0;   // as of the last update in the window
+        double best_ask = 0.0;
+        double bid_depth = 0.0;  // summed over book.levels levels
+        double ask_depth = 0.0;
+    };
+
     struct SSymbolStats {
         uint64_t trades_count = 0;
         double total_quantity = 0.0;
@@ -22,19 +49,272 @@ public:
         double max_price = std::numeric_limits<double>::lowest();
         uint64_t buy_count = 0;
         uint64_t sell_count = 0;
+        SBookStats book;
+        TMetrics metrics;  // not updated from coalesced partials
+    };
+
+    // Per-symbol statistics of one window. Hash nodes, buckets and symbol keys
+    // are allocated from the window's own arena, which is returned to the pool
+    // in one piece when the window is destroyed by whoever flushed it.
+    //
+    // With sketch_slots > 0 (agg.top_k mode) the window tracks at most that
+    // many symbols, as a Space-Saving heavy-hitter sketch ranked by volume:
+    // a symbol that is not tracked takes over the slot of the one with the
+    // least estimated volume, whose statistics go to the "others" rollup, and
+    // inherits that volume as its error. Any symbol with more than
+    // 1/sketch_slots of the window's volume is still tracked when the window
+    // closes; its statistics are exact from the moment it was last taken in.
+    class CWindowStats {
+    public:
+        using Map = std::pmr::unordered_map<std::pmr::string, SSymbolStats>;
+        static constexpr std::string_view kOthersSymbol{"others"};
+
+        CWindowStats() : CWindowStats(std::make_unique<CWindowArena>()) {}
+        explicit CWindowStats(std::unique_ptr<CWindowArena> arena, size_t sketch_slots = 0, size_t top_k = 0)
+            : m_arena(std::move(arena)), m_map(m_arena->Resource()), m_slots(m_arena->Resource()),
+              m_sketch_slots(sketch_slots), m_top_k(top_k) {
+            if (m_sketch_slots > 0) {
+                m_map.reserve(m_sketch_slots + 1);
+                m_slots.reserve(m_sketch_slots);
+            }
+        }
+        CWindowStats(CWindowStats&&) = default;
+        // The map's nodes belong to the arena; assigning would mix arenas.
+        CWindowStats& operator=(CWindowStats&&) = delete;
+
+        SSymbolStats& operator[](std::string_view symbol) {
+            // The lookup key stays in SSO; only a new symbol is copied into the arena.
+            const typename Map::key_type key(symbol);
+            auto it = m_map.find(key);
+            if (it == m_map.end()) {
+                it = m_map.emplace(key, SSymbolStats{}).first;
+            }
+            return it->second;
+        }
+        // The statistics that a trade of symbol goes to; without a sketch, same as operator[].
+        SSymbolStats& Track(std::string_view symbol) {
+            if (m_sketch_slots == 0) {
+                return (*this)[symbol];
+            }
+            const typename Map::key_type key(symbol);
+            auto it = m_map.find(key);
+            if (it != m_map.end()) {
+                return it->second;  // its slot's count goes stale, see FreshestMinSlot
+            }
+            if (m_slots.size() < m_sketch_slots) {
+                it = m_map.emplace(key, SSymbolStats{}).first;
+                m_slots.push_back({0.0, 0.0, &*it});
+                SiftUp(m_slots.size() - 1);
+                return it->second;
+            }
+            // Reuse the evicted symbol's node, so churn in the long tail
+            // allocates nothing from the arena.
+            SSlot& slot = FreshestMinSlot();
+            Fold(m_others, slot.entry->second);
+            auto node = m_map.extract(m_map.find(slot.entry->first));
+            node.key() = symbol;
+            node.mapped() = SSymbolStats{};
+            it = m_map.insert(std::move(node)).position;
+            // Its count stays the minimum: the slot stays at the top.
+            slot.error = slot.count;
+            slot.entry = &*it;
+            return it->second;
+        }
+        // For book samples, which carry no volume to rank by: with a sketch,
+        // null unless the symbol is tracked already.
+        SSymbolStats* TrackSample(std::string_view symbol) {
+            if (m_sketch_slots == 0) {
+                return &(*this)[symbol];
+            }
+            auto it = m_map.find(typename Map::key_type(symbol));
+            return it == m_map.end() ? nullptr : &it->second;
+        }
+        // Called once the window is closed: keeps the top_k tracked symbols by
+        // the volume they were tracked with (the estimate's guaranteed part; a
+        // newcomer's inherited error does not rank it) and folds the rest,
+        // with everything evicted so far, into the kOthersSymbol entry. No-op
+        // without a sketch.
+        void KeepTopK() {
+            if (m_sketch_slots == 0) {
+                return;
+            }
+            if (m_slots.size() > m_top_k) {
+                const auto by_volume = [](const SSlot& a, const SSlot& b) {
+                    return a.entry->second.total_volume > b.entry->second.total_volume;
+                };
+                std::nth_element(m_slots.begin(), m_slots.begin() + static_cast<std::ptrdiff_t>(m_top_k), m_slots.end(),
+                                 by_volume);
+                for (size_t i = m_top_k; i < m_slots.size(); ++i) {
+                    Fold(m_others, m_slots[i].entry->second);
+                    m_map.erase(m_slots[i].entry->first);
+                }
+            }
+            m_slots.clear();
+            if (m_others.trades_count > 0) {
+                m_map.emplace(typename Map::key_type(kOthersSymbol), m_others);
+            }
+        }
+        const SSymbolStats& at(std::string_view symbol) const { return m_map.at(typename Map::key_type(symbol)); }
+        typename Map::const_iterator find(std::string_view symbol) const { return m_map.find(typename Map::key_type(symbol)); }
+        typename Map::const_iterator begin() const { return m_map.begin(); }
+        typename Map::const_iterator end() const { return m_map.end(); }
+        size_t size() const { return m_map.size(); }
+        bool empty() const { return m_map.empty(); }
+
+    private:
+        // A min-heap on count. Tracking a symbol does not touch the heap:
+        // count is the estimate when the slot was last sifted, never above
+        // the current one, and is only brought up to date when the slot
+        // reaches the top.
+        struct SSlot {
+            double count;
+            double error;  // volume inherited from the symbol it was taken from
+            typename Map::value_type* entry;
+        };
+
+        static double Estimate(const SSlot& slot) { return slot.entry->second.total_volume + slot.error; }
+        // Core fields only: metrics and book samples are not kept for others.
+        static void Fold(SSymbolStats& into, const SSymbolStats& from) {
+            into.trades_count += from.trades_count;
+            into.total_quantity += from.total_quantity;
+            into.total_volume += from.total_volume;
+            into.min_price = std::min(into.min_price, from.min_price);
+            into.max_price = std::max(into.max_price, from.max_price);
+            into.buy_count += from.buy_count;
+            into.sell_count += from.sell_count;
+        }
+        SSlot& FreshestMinSlot() {
+            // Counts only grow, so once the top is up to date it is the minimum.
+            while (Estimate(m_slots[0]) > m_slots[0].count) {
+                m_slots[0].count = Estimate(m_slots[0]);
+                SiftDown(0);
+            }
+            return m_slots[0];
+        }
+        void SiftUp(size_t i) {
+            while (i > 0 && m_slots[i].count < m_slots[(i - 1) / 2].count) {
+                std::swap(m_slots[i], m_slots[(i - 1) / 2]);
+                i = (i - 1) / 2;
+            }
+        }
+        void SiftDown(size_t i) {
+            for (;;) {
+                size_t least = i;
+                for (size_t child = 2 * i + 1; child <= 2 * i + 2 && child < m_slots.size(); ++child) {
+                    if (m_slots[child].count < m_slots[least].count) {
+                        least = child;
+                    }
+                }
+                if (least == i) {
+                    return;
+                }
+                std::swap(m_slots[i], m_slots[least]);
+                i = least;
+            }
+        }
+
+        // Declared first so it outlives the map.
+        std::unique_ptr<CWindowArena> m_arena;
+        Map m_map;
+        std::pmr::vector<SSlot> m_slots;
+        size_t m_sketch_slots;
+        size_t m_top_k;
+        SSymbolStats m_others;
     };
 
-    using WindowStats = std::unordered_map<std::string, SSymbolStats>;
+    using WindowStats = CWindowStats;
     using AllWindowsStats = std::map<uint64_t, WindowStats>;
 
-    explicit CTradeAggregator(const SAppConfig& cfg);
+    explicit CBasicTradeAggregator(const SAppConfig& cfg);
 
     void AddTrade(const STrade& trade);
+    // Same result as AddTrade over every trade of the block, under one lock:
+    // trades are grouped by symbol and window, and each group's columns are
+    // reduced at once (see ReduceTrades).
+    void AddBatch(const STradeBlock& block);
+    // Merges a partial aggregate built by the queue's coalesce overflow policy.
+    void AddCoalesced(const SCoalescedTrades& partial);
+    void AddBookSample(const std::string& symbol, uint64_t timestamp_ms, const SBookSample& sample);
+    // Returns the windows closed as of now (window end + write_delay_ms).
+    // The writer does not take the lock of the Add* calls: it posts the
+    // current time, and the next Add* call detaches the closed windows (node
+    // splices, no allocation) into a handoff map that only the two of them
+    // share. If no Add* call comes within kFlushHandoffTimeout, the
+    // producers are idle and the writer detaches the windows itself.
     AllWindowsStats FlushStatistics();
     void UpdateConfig(const SAppConfig& cfg);
+    // A flushed window as the writer reports it: a "timestamp=" line, then
+    // one "symbol=" line per symbol with the core fields, the metric set and
+    // the book fields when the window has book samples.
+    static void WriteWindow(std::ostream& os, uint64_t window_start_ms, const WindowStats& stats_map);
+
+    static constexpr uint64_t kNoDeadline = std::numeric_limits<uint64_t>::max();
+    // Epoch ms at which the earliest open window is due (window end +
+    // write_delay_ms), kNoDeadline when there is none.
+    uint64_t NextFlushDeadlineMs() const { return m_next_deadline_ms.load(std::memory_order_acquire); }
+    // Sleeps until the earliest open window is due and returns true. Opening
+    // a window that is due earlier (the first one after an idle spell, or a
+    // late trade for a flushed window) wakes the sleeper. Returns false after
+    // max_wait or after InterruptFlushWait().
+    bool WaitForFlushDue(std::chrono::milliseconds max_wait);
+    void InterruptFlushWait();
 private:
+    // Reused by AddBatch: the block's columns regrouped so that each
+    // (symbol, window) group is contiguous, in arrival order.
+    static constexpr uint32_t kNoGroup = std::numeric_limits<uint32_t>::max();
+    struct SBatchScratch {
+        struct SGroup {
+            uint32_t symbol_index = 0;
+            uint64_t window_start = 0;
+            size_t offset = 0;
+            size_t size = 0;
+            size_t cursor = 0;  // next free slot while scattering
+        };
+        std::vector<SGroup> groups;
+        std::vector<uint32_t> group_of;         // per trade
+        std::vector<uint32_t> group_by_symbol;  // latest group per interned symbol
+        std::vector<double> price;
+        std::vector<double> quantity;
+        std::vector<uint64_t> trade_count;
+        std::vector<uint8_t> buyer_initiated;
+    };
+
+    static constexpr std::chrono::milliseconds kFlushHandoffTimeout{2};
+
+    WindowStats& Window(uint64_t window_start);
+    // Called with m_mutex held at the end of every Add*: serves a pending flush request.
+    void ServeFlushLocked() {
+        const uint64_t requested = m_flush_requested_ms.load(std::memory_order_acquire);
+        if (requested != m_flush_served_ms) {
+            DetachClosedLocked(requested);
+        }
+    }
+    void DetachClosedLocked(uint64_t now_ms);
+    // Recomputes m_next_deadline_ms from the earliest window.
+    void StoreDeadlineLocked();
 
     SAppConfig m_cfg;
+    std::shared_ptr<CArenaPool> m_arena_pool;
     AllWindowsStats m_statistics;
+    SBatchScratch m_batch;
+    uint64_t m_flush_served_ms = 0;  // guarded by m_mutex
     std::mutex m_mutex;
-};
\ No newline at end of file
+
+    // Flush handoff between the Add* calls and the writer.
+    std::atomic<uint64_t> m_flush_requested_ms{0};
+    std::mutex m_handoff_mutex;
+    std::condition_variable m_handoff_cond;
+    AllWindowsStats m_detached;         // guarded by m_handoff_mutex
+    uint64_t m_detached_as_of_ms = 0;   // guarded by m_handoff_mutex
+
+    // Flush scheduling; m_next_deadline_ms is written under m_mutex.
+    std::atomic<uint64_t> m_next_deadline_ms{kNoDeadline};
+    std::mutex m_deadline_mutex;
+    std::condition_variable m_deadline_cond;
+    bool m_wait_interrupted = false;    // guarded by m_deadline_mutex
+};
+
+extern template class CBasicTradeAggregator<CMinimalMetrics>;
+extern template class CBasicTradeAggregator<CFullMetrics>;
+
+using CTradeAggregator = CBasicTradeAggregator<CSelectedMetrics>;
@@ -4,14 +4,29 @@
 #include <algorithm>
 #include <csignal>
 #include <filesystem>
-#include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <thread>
 
 namespace fs = std::filesystem;
 
+namespace {
+// Upper bound on the trades the reader takes from the queue at once.
+constexpr size_t kReaderBatchTrades = 1024;
+
+SSeriesArchiveOptions MakeArchiveOptions(const SHistoryConfig& history) {
+    SSeriesArchiveOptions options;
+    options.retention_ms = history.compressed_retention_sec * 1000;
+    options.chunk_windows = static_cast<uint32_t>(history.chunk_windows);
+    options.persist_dir = history.persist_dir;
+    options.persist_max_bytes = history.persist_max_mb * 1024 * 1024;
+    options.persist_max_files = history.persist_max_files;
+    return options;
+}
+}
+
 CAppRunner::CAppRunner(int argc, char** argv)
     : m_argc(argc), m_argv(argv),
       m_ws_factory([](boost::asio::io_context& ioc, std::shared_ptr<CTradeQueue> queue, const SAppConfig& cfg) {
@@ -26,12 +41,66 @@ int CAppRunner::Run() {
     //We handle such case so there is no need to terminate
     std::signal(SIGPIPE, SIG_IGN);
     m_signals = std::make_unique<net::signal_set>(m_ioc, SIGINT, SIGTERM, SIGHUP);
+    m_signals->add(SIGUSR1);
+    ConfigureTracing(m_cfg.trace.sample_every, m_cfg.trace.ring_events);
 
-    m_trade_queue = std::make_shared<CTradeQueue>();
+    EOverflowPolicy overflow = EOverflowPolicy::Block;
+    ParseOverflowPolicy(m_cfg.queue.overflow, overflow);
+    m_trade_queue = std::make_shared<CTradeQueue>(
+        static_cast<size_t>(m_cfg.queue.capacity), overflow,
+        std::chrono::milliseconds(m_cfg.queue.block_timeout_ms), m_cfg.agg.period_ms);
     m_aggregator = std::make_shared<CTradeAggregator>(m_cfg);
+    if (m_cfg.shm.enabled) {
+        m_shm_publisher = std::make_unique<CShmPublisher>(
+            m_cfg.shm.name,
+            static_cast<uint32_t>(m_cfg.shm.window_slots),
+            m_cfg.shm.publish_trades ? static_cast<uint32_t>(m_cfg.shm.trade_slots) : 0u);
+        if (!m_shm_publisher->Open()) {
+            m_shm_publisher.reset();
+        }
+    }
+
+    if (m_cfg.ticks.enabled) {
+        m_tick_store = std::make_unique<CTickStore>(m_cfg.ticks.dir, m_cfg.ticks.file_records);
+        Log(LogLevel::INFO, "Ticks", "Recording every trade under " + m_cfg.ticks.dir);
+    }
+
+    if (m_cfg.book.enabled) {
+        auto provider = m_cfg.book.snapshot_dir.empty()
+            ? CBookManager::SnapshotProvider{}
+            : CBookManager::FileSnapshotProvider(m_cfg.book.snapshot_dir);
+        if (!provider) {
+            Log(LogLevel::ERROR, "Book", "book.snapshot_dir is not set; books will not sync.");
+        }
+        m_book_manager = std::make_shared<CBookManager>(
+            m_cfg.book, std::move(provider),
+            [aggregator = m_aggregator](const std::string& symbol, uint64_t ts, const SBookSample& sample) {
+                aggregator->AddBookSample(symbol, ts, sample);
+            });
+    }
+
+    if (m_cfg.history.enabled) {
+        m_series_store = std::make_shared<CSeriesStore>(m_cfg.agg.period_ms, m_cfg.history.retention_sec * 1000);
+        m_series_store->ConfigureArchive(MakeArchiveOptions(m_cfg.history));
+        const size_t loaded = m_series_store->LoadArchive();
+        if (loaded > 0) {
+            Log(LogLevel::INFO, "History", "Loaded " + std::to_string(loaded) + " compressed chunks from " +
+                                               m_cfg.history.persist_dir);
+        }
+        if (!m_cfg.history.socket_path.empty()) {
+            m_query_server = std::make_unique<CQueryServer>(m_ioc, m_cfg.history.socket_path, m_series_store);
+            if (!m_query_server->Start()) {
+                m_query_server.reset();
+            }
+        }
+    }
 
     StartWriter();
     StartReader();
+    // The main thread runs the io_context, so it takes the io placement.
+    ApplyThreadPlacement("io", m_cfg.threads.io);
+    SetThreadStage(EStage::Io);
+    SetTraceThreadName("io");
 
     while (m_keep_running.load()) {
         try {
@@ -39,12 +108,19 @@ int CAppRunner::Run() {
                 Log(LogLevel::INFO, "Main", "Reloading config...");
                 if (LoadAndValidateConfig()) {
                     m_aggregator->UpdateConfig(m_cfg);
+                    m_trade_queue->SetWindowPeriod(m_cfg.agg.period_ms);
+                    ConfigureTracing(m_cfg.trace.sample_every, m_cfg.trace.ring_events);
+                    if (m_series_store) {
+                        m_series_store->Reconfigure(m_cfg.agg.period_ms, m_cfg.history.retention_sec * 1000);
+                        m_series_store->ConfigureArchive(MakeArchiveOptions(m_cfg.history));
+                    }
                     StopWriter();
                     StartWriter();
                 }
             }
             m_ioc.restart();
             auto ws_client = m_ws_factory(m_ioc, m_trade_queue, m_cfg);
+            ws_client->SetBookManager(m_book_manager);
             SetupSignalHandler(ws_client);
             ws_client->Start();
             Log(LogLevel::INFO, "Main", "Entering ioc.run()...");
@@ -61,6 +137,9 @@ int CAppRunner::Run() {
 
     StopWriter();
     StopReader();
+    m_query_server.reset();
+    m_shm_publisher.reset();
+    m_tick_store.reset();
 
     Log(LogLevel::INFO, "Main", "GQC service stopped safely.");
     return 0;
@@ -71,10 +150,23 @@ void CAppRunner::SetupSignalHandler(std::shared_ptr<CWebSocketClient> ws_client)
     m_signals->add(SIGINT);
     m_signals->add(SIGTERM);
     m_signals->add(SIGHUP);
+    m_signals->add(SIGUSR1);
+    WaitForSignal(std::move(ws_client));
+}
 
+void CAppRunner::WaitForSignal(std::shared_ptr<CWebSocketClient> ws_client) {
     m_signals->async_wait([this, ws_client](const beast::error_code& ec, int signo) {
         if (ec) return;
 
+        if (signo == SIGUSR1) {
+            // The writer dumps the trace, away from the io thread.
+            m_trace_dump_requested.store(true);
+            if (m_aggregator) {
+                m_aggregator->InterruptFlushWait();
+            }
+            WaitForSignal(ws_client);
+            return;
+        }
         if (signo == SIGHUP) {
             Log(LogLevel::INFO, "Main", "SIGHUP received.");
             m_reload_requested.store(true);
@@ -105,50 +197,119 @@ bool CAppRunner::LoadAndValidateConfig() {
 
 void CAppRunner::StartWriter() {
     m_writer_stop.store(false);
+    ECompression compression = ECompression::None;
+    ParseCompression(m_cfg.output.compression, compression);
+    if (compression != ECompression::None) {
+        m_compressor = std::make_unique<CLogCompressor>(compression, m_cfg.output.compression_level,
+                                                        m_cfg.output.filename, m_cfg.output.max_files);
+        m_compressor->Start();
+    }
     m_writer = std::thread([this]() {
+        ApplyThreadPlacement("writer", m_cfg.threads.writer);
+        SetThreadStage(EStage::Writer);
+        SetTraceThreadName("writer");
+        EOutputBackend backend = EOutputBackend::Stream;
+        ParseOutputBackend(m_cfg.output.backend, backend);
+        COutputFile output(backend, m_cfg.output.filename, m_cfg.output.max_file_mb * 1024ull * 1024ull,
+                           m_cfg.output.max_files, m_cfg.output.preallocate, m_compressor.get());
+        std::ostringstream buffer;
+        SQueueStats last_queue_stats;
+        auto next_queue_check = std::chrono::steady_clock::now();
+        StageStats last_stage_stats = StageStatsSnapshot();
+        SQueueStats last_batch_stats = m_trade_queue->Stats();
+        auto last_batch_report = std::chrono::steady_clock::now();
+        auto last_stage_report = std::chrono::steady_clock::now();
         while (!m_writer_stop.load()) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(m_cfg.output.write_period_ms));
+            // Wakes when the earliest window is due (window end + write_delay_ms);
+            // write_period_ms only bounds the sleep while no window is open.
+            const std::chrono::milliseconds write_period(m_cfg.output.write_period_ms);
+            const bool due = m_aggregator->WaitForFlushDue(write_period);
+            if (m_writer_stop.load()) {
+                break;
+            }
+            if (m_trace_dump_requested.exchange(false)) {
+                const long spans = WriteTrace(m_cfg.trace.path);
+                if (spans < 0) {
+                    Log(LogLevel::ERROR, "Trace", "Cannot write " + m_cfg.trace.path);
+                } else {
+                    Log(LogLevel::INFO, "Trace", "Wrote " + std::to_string(spans) + " spans to " + m_cfg.trace.path);
+                }
+            }
 
-            auto windows_stats = m_aggregator->FlushStatistics();
-            if (windows_stats.empty()) {
+            // Overload shows up here once per write period rather than once per trade.
+            if (std::chrono::steady_clock::now() >= next_queue_check) {
+                next_queue_check = std::chrono::steady_clock::now() + write_period;
+                const SQueueStats queue_stats = m_trade_queue->Stats();
+                if (queue_stats.dropped != last_queue_stats.dropped ||
+                    queue_stats.coalesced != last_queue_stats.coalesced ||
+                    queue_stats.blocked != last_queue_stats.blocked) {
+                    Log(LogLevel::ERROR, "Queue", "Overloaded: dropped=" + std::to_string(queue_stats.dropped - last_queue_stats.dropped) +
+                        " coalesced=" + std::to_string(queue_stats.coalesced - last_queue_stats.coalesced) +
+                        " blocked=" + std::to_string(queue_stats.blocked - last_queue_stats.blocked) +
+                        " size=" + std::to_string(queue_stats.size) +
+                        " high_water_mark=" + std::to_string(queue_stats.high_water_mark));
+                }
+                last_queue_stats = queue_stats;
+            }
+            const uint64_t batch_interval_sec = m_cfg.queue.stats_interval_sec;
+            if (batch_interval_sec > 0 &&
+                std::chrono::steady_clock::now() - last_batch_report >= std::chrono::seconds(batch_interval_sec)) {
+                last_batch_report = std::chrono::steady_clock::now();
+                const SQueueStats batch_stats = m_trade_queue->Stats();
+                BatchHistogram pushed{};
+                BatchHistogram popped{};
+                for (size_t bucket = 0; bucket < kBatchBuckets; ++bucket) {
+                    pushed[bucket] = batch_stats.pushed[bucket] - last_batch_stats.pushed[bucket];
+                    popped[bucket] = batch_stats.popped[bucket] - last_batch_stats.popped[bucket];
+                }
+                Log(LogLevel::INFO, "Queue", "wakeups=" + std::to_string(batch_stats.wakeups - last_batch_stats.wakeups) +
+                    " pushes=[" + FormatBatchHistogram(pushed) + "] pops=[" + FormatBatchHistogram(popped) +
+                    "] size=" + std::to_string(batch_stats.size));
+                last_batch_stats = batch_stats;
+            }
+            const uint64_t stats_interval_sec = m_cfg.threads.stats_interval_sec;
+            if (stats_interval_sec > 0 &&
+                std::chrono::steady_clock::now() - last_stage_report >= std::chrono::seconds(stats_interval_sec)) {
+                const auto now = std::chrono::steady_clock::now();
+                const StageStats stage_stats = StageStatsSnapshot();
+                Log(LogLevel::INFO, "Stages", FormatStageStats(last_stage_stats, stage_stats,
+                                                               std::chrono::duration<double>(now - last_stage_report).count()));
+                last_stage_stats = stage_stats;
+                last_stage_report = now;
+            }
+            if (!due) {
                 continue;
             }
 
-            RotateLogsIfNeeded(m_cfg.output.filename, m_cfg.output.max_file_mb * 1024ull * 1024ull, m_cfg.output.max_files);
-
-            std::ofstream out(m_cfg.output.filename, std::ios::app);
-            if (!out) {
-                Log(LogLevel::ERROR, "Writer", "Failed to open output file: " + m_cfg.output.filename);
+            const uint64_t trace_flush_ns = TraceEnabled() ? TraceNowNs() : 0;
+            auto windows_stats = m_aggregator->FlushStatistics();
+            if (windows_stats.empty()) {
                 continue;
             }
+            if (m_shm_publisher) {
+                m_shm_publisher->PublishWindows(windows_stats, m_cfg.agg.period_ms);
+            }
+            if (m_series_store) {
+                m_series_store->Insert(windows_stats);
+            }
 
-            auto write_window = [](std::ostream& os, uint64_t window_start_ms, const CTradeAggregator::WindowStats& stats_map) {
-                os << "timestamp=" << FormatIsoUtc(window_start_ms) << "\n";
-                for (const auto& entry : stats_map) {
-                    const auto& symbol = entry.first;
-                    const auto& stats = entry.second;
-                    os << "symbol=" << symbol
-                       << " trades=" << stats.trades_count
-                       << " volume=" << std::fixed << std::setprecision(5) << stats.total_volume
-                       << " quantity=" << std::fixed << std::setprecision(5) << stats.total_quantity
-                       << " min=" << std::setprecision(2) << stats.min_price
-                       << " max=" << std::setprecision(2) << stats.max_price
-                       << " buy=" << stats.buy_count
-                       << " sell=" << stats.sell_count
-                       << "\n";
-                }
-            };
-
+            // Format once; the same text goes to the file and the console.
+            buffer.str(std::string());
             for (const auto& window_pair : windows_stats) {
-                write_window(out, window_pair.first, window_pair.second);
-                if (m_cfg.output.console_report) {
-                    write_window(std::cout, window_pair.first, window_pair.second);
-                }
+                CTradeAggregator::WriteWindow(buffer, window_pair.first, window_pair.second);
             }
-            out.flush();
+            const std::string text = buffer.str();
+            const uint64_t trace_write_ns = trace_flush_ns != 0 ? TraceNowNs() : 0;
+            output.Write(text);
             if (m_cfg.output.console_report) {
+                std::cout << text;
                 std::cout.flush();
             }
+            if (trace_flush_ns != 0) {
+                // Every flush is kept: flush = collect, publish and format, write = file and console.
+                TraceSpan("flush", trace_flush_ns, trace_write_ns);
+                TraceSpan("write", trace_write_ns, TraceNowNs());
+            }
         }
         Log(LogLevel::INFO, "Writer", "Thread finished.");
     });
@@ -156,17 +317,73 @@ void CAppRunner::StartWriter() {
 
 void CAppRunner::StopWriter() {
     m_writer_stop.store(true);
+    if (m_aggregator) {
+        m_aggregator->InterruptFlushWait();
+    }
     if (m_writer.joinable()) {
         m_writer.join();
     }
+    if (m_compressor) {
+        m_compressor->Stop();
+        m_compressor.reset();
+    }
 }
 
 void CAppRunner::StartReader() {
     m_reader = std::thread([this]() {
-        STrade t;
-        while (m_trade_queue->Pop(t)) {
-            m_aggregator->AddTrade(t);
+        ApplyThreadPlacement("reader", m_cfg.threads.reader);
+        SetThreadStage(EStage::Reader);
+        SetTraceThreadName("reader");
+        STradeBlock block;
+        block.Reserve(kReaderBatchTrades);
+        std::vector<SCoalescedTrades> coalesced;
+        const bool publish_trades = m_shm_publisher && m_cfg.shm.publish_trades;
+        auto take_coalesced = [&]() {
+            if (m_trade_queue->TakeCoalesced(coalesced)) {
+                for (const auto& partial : coalesced) {
+                    m_aggregator->AddCoalesced(partial);
+                }
+                coalesced.clear();
+            }
+        };
+        // Whatever is queued is taken in one go, so a burst costs one lock
+        // on each side instead of one per trade.
+        auto consume = [&]() {
+            // A batch holding a sampled trade is timed through to the aggregator.
+            const uint64_t trace_start_ns = block.trace_sample != 0 ? TraceNowNs() : 0;
+            if (publish_trades) {
+                m_shm_publisher->PublishTrades(block);
+            }
+            if (m_tick_store) {
+                m_tick_store->Append(block);
+            }
+            m_aggregator->AddBatch(block);
+            take_coalesced();
+            if (trace_start_ns != 0) {
+                TraceSpan("aggregate", trace_start_ns, TraceNowNs(), block.trace_sample);
+            }
+        };
+        if (m_cfg.threads.busy_poll) {
+            // Trades the core for latency: no futex wake-up between Push and the aggregator.
+            for (;;) {
+                if (m_trade_queue->TryPopBatch(block, kReaderBatchTrades)) {
+                    consume();
+                } else if (m_trade_queue->IsStopped()) {
+                    // Drain whatever was pushed before Stop().
+                    while (m_trade_queue->TryPopBatch(block, kReaderBatchTrades)) {
+                        consume();
+                    }
+                    break;
+                } else {
+                    CpuRelax();
+                }
+            }
+        } else {
+            while (m_trade_queue->PopBatch(block, kReaderBatchTrades)) {
+                consume();
+            }
         }
+        take_coalesced();
         Log(LogLevel::INFO, "Reader", "Thread finished.");
     });
 }
@@ -3,6 +3,15 @@
 #include "aggregator.hpp"
 #include "websocket_client.hpp"
 #include "config.hpp"
+#include "log_compressor.hpp"
+#include "output_file.hpp"
+#include "query_server.hpp"
+#include "series_store.hpp"
+#include "shm_publisher.hpp"
+#include "stage_stats.hpp"
+#include "thread_tuning.hpp"
+#include "tick_store.hpp"
+#include "trace.hpp"
 #include "trade_queue.hpp"
 #include "logger.hpp"
 
@@ -24,6 +33,7 @@ public:
 
 protected:
     void SetupSignalHandler(std::shared_ptr<CWebSocketClient> ws_client);
+    void WaitForSignal(std::shared_ptr<CWebSocketClient> ws_client);
     virtual bool LoadAndValidateConfig();
     void StartWriter();
     void StopWriter();
@@ -41,10 +51,21 @@ protected:
 
     std::shared_ptr<CTradeQueue> m_trade_queue;
     std::shared_ptr<CTradeAggregator> m_aggregator;
+    std::unique_ptr<CLogCompressor> m_compressor;
+    // Created once in Run(); shm settings are not reloaded on SIGHUP.
+    std::unique_ptr<CShmPublisher> m_shm_publisher;
+    // Written by the reader thread only; created once in Run() like the shm publisher.
+    std::unique_ptr<CTickStore> m_tick_store;
+    // Lives on the io thread; created once in Run() like the shm publisher.
+    std::shared_ptr<CBookManager> m_book_manager;
+    // Flushed windows for the query socket; filled by the writer, read on the io thread.
+    std::shared_ptr<CSeriesStore> m_series_store;
+    std::unique_ptr<CQueryServer> m_query_server;
 
     std::atomic<bool> m_keep_running{true};
     std::atomic<bool> m_reload_requested{false};
     std::atomic<bool> m_writer_stop{false};
+    std::atomic<bool> m_trace_dump_requested{false};  // SIGUSR1, served by the writer
 
     uint32_t m_retry_attempt{0};
 
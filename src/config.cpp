@@ -6,9 +6,15 @@
 #include <iostream>
 #include <sstream>
 
+#include <sched.h>
+
 #include <nlohmann/json.hpp>
 
+#include "feed_adapter.hpp"
+#include "log_compressor.hpp"
 #include "logger.hpp"
+#include "output_file.hpp"
+#include "trade_queue.hpp"
 
 namespace {
 std::vector<std::string> SplitPairs(const std::string& raw) {
@@ -25,6 +31,47 @@ std::vector<std::string> SplitPairs(const std::string& raw) {
     return result;
 }
 
+std::vector<int> SplitCpus(const std::string& raw) {
+    std::vector<int> result;
+    std::stringstream ss(raw);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            result.push_back(std::stoi(item));
+        }
+    }
+    return result;
+}
+
+void ApplyThreadRoleJson(SThreadRoleConfig& role, const nlohmann::json& j) {
+    if (!j.is_object()) {
+        return;
+    }
+    if (j.contains("cpus") && j["cpus"].is_array()) {
+        role.cpus.clear();
+        for (const auto& cpu : j["cpus"]) {
+            if (cpu.is_number_integer()) {
+                role.cpus.push_back(cpu.get<int>());
+            }
+        }
+    }
+    if (j.contains("fifo_priority") && j["fifo_priority"].is_number_integer()) role.fifo_priority = j["fifo_priority"];
+}
+
+bool ValidateThreadRole(const char* name, const SThreadRoleConfig& role) {
+    for (int cpu : role.cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            Log(LogLevel::ERROR, "Config", std::string("threads.") + name + ".cpus contains invalid cpu " + std::to_string(cpu));
+            return false;
+        }
+    }
+    if (role.fifo_priority < 0 || role.fifo_priority > 99) {
+        Log(LogLevel::ERROR, "Config", std::string("threads.") + name + ".fifo_priority must be in 0..99.");
+        return false;
+    }
+    return true;
+}
+
 void ApplyJsonConfig(SAppConfig& cfg, const nlohmann::json& j) {
     if (j.contains("trade_pairs") && j["trade_pairs"].is_array()) {
         std::vector<std::string> pairs;
@@ -49,6 +96,24 @@ void ApplyJsonConfig(SAppConfig& cfg, const nlohmann::json& j) {
         if (ws.contains("port") && ws["port"].is_string()) cfg.ws.port = ws["port"];
         if (ws.contains("handshake_timeout_sec") && ws["handshake_timeout_sec"].is_number_integer()) cfg.ws.handshake_timeout_sec = ws["handshake_timeout_sec"];
         if (ws.contains("idle_timeout_sec") && ws["idle_timeout_sec"].is_number_integer()) cfg.ws.idle_timeout_sec = ws["idle_timeout_sec"];
+        if (ws.contains("venue") && ws["venue"].is_string()) cfg.ws.venue = ws["venue"];
+        if (ws.contains("stream") && ws["stream"].is_string()) cfg.ws.stream = ws["stream"];
+        if (ws.contains("stats_interval_sec") && ws["stats_interval_sec"].is_number_integer()) cfg.ws.stats_interval_sec = ws["stats_interval_sec"];
+        if (ws.contains("dns_cache_sec") && ws["dns_cache_sec"].is_number_integer()) cfg.ws.dns_cache_sec = ws["dns_cache_sec"];
+        if (ws.contains("connect_race") && ws["connect_race"].is_number_integer()) cfg.ws.connect_race = ws["connect_race"];
+        if (ws.contains("tls_resume") && ws["tls_resume"].is_boolean()) cfg.ws.tls_resume = ws["tls_resume"];
+        if (ws.contains("ping_interval_sec") && ws["ping_interval_sec"].is_number_integer()) cfg.ws.ping_interval_sec = ws["ping_interval_sec"];
+        if (ws.contains("max_connection_age_sec") && ws["max_connection_age_sec"].is_number_integer()) cfg.ws.max_connection_age_sec = ws["max_connection_age_sec"];
+        if (ws.contains("rotate_lead_sec") && ws["rotate_lead_sec"].is_number_integer()) cfg.ws.rotate_lead_sec = ws["rotate_lead_sec"];
+        if (ws.contains("rotate_overlap_ms") && ws["rotate_overlap_ms"].is_number_integer()) cfg.ws.rotate_overlap_ms = ws["rotate_overlap_ms"];
+        if (ws.contains("deflate") && ws["deflate"].is_object()) {
+            auto& deflate = ws["deflate"];
+            if (deflate.contains("enabled") && deflate["enabled"].is_boolean()) cfg.ws.deflate.enabled = deflate["enabled"];
+            if (deflate.contains("client_max_window_bits") && deflate["client_max_window_bits"].is_number_integer()) cfg.ws.deflate.client_max_window_bits = deflate["client_max_window_bits"];
+            if (deflate.contains("server_max_window_bits") && deflate["server_max_window_bits"].is_number_integer()) cfg.ws.deflate.server_max_window_bits = deflate["server_max_window_bits"];
+            if (deflate.contains("client_no_context_takeover") && deflate["client_no_context_takeover"].is_boolean()) cfg.ws.deflate.client_no_context_takeover = deflate["client_no_context_takeover"];
+            if (deflate.contains("server_no_context_takeover") && deflate["server_no_context_takeover"].is_boolean()) cfg.ws.deflate.server_no_context_takeover = deflate["server_no_context_takeover"];
+        }
     }
 
     // Retry config
@@ -63,6 +128,10 @@ void ApplyJsonConfig(SAppConfig& cfg, const nlohmann::json& j) {
     if (j.contains("agg") && j["agg"].is_object()) {
         auto& agg = j["agg"];
         if (agg.contains("period_ms") && agg["period_ms"].is_number_unsigned()) cfg.agg.period_ms = agg["period_ms"];
+        if (agg.contains("arena_kb") && agg["arena_kb"].is_number_unsigned()) cfg.agg.arena_kb = agg["arena_kb"];
+        if (agg.contains("arena_hugepages") && agg["arena_hugepages"].is_boolean()) cfg.agg.arena_hugepages = agg["arena_hugepages"];
+        if (agg.contains("top_k") && agg["top_k"].is_number_unsigned()) cfg.agg.top_k = agg["top_k"];
+        if (agg.contains("sketch_slots") && agg["sketch_slots"].is_number_unsigned()) cfg.agg.sketch_slots = agg["sketch_slots"];
 
     }
 
@@ -75,6 +144,89 @@ void ApplyJsonConfig(SAppConfig& cfg, const nlohmann::json& j) {
         if (output.contains("max_file_mb") && output["max_file_mb"].is_number_unsigned()) cfg.output.max_file_mb = output["max_file_mb"];
         if (output.contains("max_files") && output["max_files"].is_number_unsigned()) cfg.output.max_files = output["max_files"];
         if (output.contains("console_report") && output["console_report"].is_boolean()) cfg.output.console_report = output["console_report"];
+        if (output.contains("compression") && output["compression"].is_string()) cfg.output.compression = output["compression"];
+        if (output.contains("compression_level") && output["compression_level"].is_number_integer()) cfg.output.compression_level = output["compression_level"];
+        if (output.contains("backend") && output["backend"].is_string()) cfg.output.backend = output["backend"];
+        if (output.contains("preallocate") && output["preallocate"].is_boolean()) cfg.output.preallocate = output["preallocate"];
+    }
+
+    // Trade queue config
+    if (j.contains("queue") && j["queue"].is_object()) {
+        auto& queue = j["queue"];
+        if (queue.contains("capacity") && queue["capacity"].is_number_unsigned()) cfg.queue.capacity = queue["capacity"];
+        if (queue.contains("overflow") && queue["overflow"].is_string()) cfg.queue.overflow = queue["overflow"];
+        if (queue.contains("block_timeout_ms") && queue["block_timeout_ms"].is_number_unsigned()) cfg.queue.block_timeout_ms = queue["block_timeout_ms"];
+        if (queue.contains("batch_max") && queue["batch_max"].is_number_unsigned()) cfg.queue.batch_max = queue["batch_max"];
+        if (queue.contains("batch_deadline_us") && queue["batch_deadline_us"].is_number_unsigned()) cfg.queue.batch_deadline_us = queue["batch_deadline_us"];
+        if (queue.contains("stats_interval_sec") && queue["stats_interval_sec"].is_number_unsigned()) cfg.queue.stats_interval_sec = queue["stats_interval_sec"];
+    }
+
+    if (j.contains("history") && j["history"].is_object()) {
+        auto& history = j["history"];
+        if (history.contains("enabled") && history["enabled"].is_boolean()) cfg.history.enabled = history["enabled"];
+        if (history.contains("retention_sec") && history["retention_sec"].is_number_unsigned()) cfg.history.retention_sec = history["retention_sec"];
+        if (history.contains("socket_path") && history["socket_path"].is_string()) cfg.history.socket_path = history["socket_path"];
+        if (history.contains("compressed_retention_sec") && history["compressed_retention_sec"].is_number_unsigned()) cfg.history.compressed_retention_sec = history["compressed_retention_sec"];
+        if (history.contains("chunk_windows") && history["chunk_windows"].is_number_unsigned()) cfg.history.chunk_windows = history["chunk_windows"];
+        if (history.contains("persist_dir") && history["persist_dir"].is_string()) cfg.history.persist_dir = history["persist_dir"];
+        if (history.contains("persist_max_mb") && history["persist_max_mb"].is_number_unsigned()) cfg.history.persist_max_mb = history["persist_max_mb"];
+        if (history.contains("persist_max_files") && history["persist_max_files"].is_number_unsigned()) cfg.history.persist_max_files = history["persist_max_files"];
+    }
+
+    // Shared-memory publisher config
+    if (j.contains("shm") && j["shm"].is_object()) {
+        auto& shm = j["shm"];
+        if (shm.contains("enabled") && shm["enabled"].is_boolean()) cfg.shm.enabled = shm["enabled"];
+        if (shm.contains("name") && shm["name"].is_string()) cfg.shm.name = shm["name"];
+        if (shm.contains("window_slots") && shm["window_slots"].is_number_unsigned()) cfg.shm.window_slots = shm["window_slots"];
+        if (shm.contains("trade_slots") && shm["trade_slots"].is_number_unsigned()) cfg.shm.trade_slots = shm["trade_slots"];
+        if (shm.contains("publish_trades") && shm["publish_trades"].is_boolean()) cfg.shm.publish_trades = shm["publish_trades"];
+    }
+
+    if (j.contains("ticks") && j["ticks"].is_object()) {
+        auto& ticks = j["ticks"];
+        if (ticks.contains("enabled") && ticks["enabled"].is_boolean()) cfg.ticks.enabled = ticks["enabled"];
+        if (ticks.contains("dir") && ticks["dir"].is_string()) cfg.ticks.dir = ticks["dir"];
+        if (ticks.contains("file_records") && ticks["file_records"].is_number_unsigned()) cfg.ticks.file_records = ticks["file_records"];
+    }
+
+    // Span tracing config
+    if (j.contains("trace") && j["trace"].is_object()) {
+        auto& trace = j["trace"];
+        if (trace.contains("sample_every") && trace["sample_every"].is_number_unsigned()) cfg.trace.sample_every = trace["sample_every"];
+        if (trace.contains("ring_events") && trace["ring_events"].is_number_unsigned()) cfg.trace.ring_events = trace["ring_events"];
+        if (trace.contains("path") && trace["path"].is_string()) cfg.trace.path = trace["path"];
+    }
+
+    // Thread placement config
+    if (j.contains("threads") && j["threads"].is_object()) {
+        auto& threads = j["threads"];
+        if (threads.contains("io")) ApplyThreadRoleJson(cfg.threads.io, threads["io"]);
+        if (threads.contains("reader")) ApplyThreadRoleJson(cfg.threads.reader, threads["reader"]);
+        if (threads.contains("writer")) ApplyThreadRoleJson(cfg.threads.writer, threads["writer"]);
+        if (threads.contains("busy_poll") && threads["busy_poll"].is_boolean()) cfg.threads.busy_poll = threads["busy_poll"];
+        if (threads.contains("stats_interval_sec") && threads["stats_interval_sec"].is_number_unsigned()) cfg.threads.stats_interval_sec = threads["stats_interval_sec"];
+    }
+
+    // Order book config
+    if (j.contains("book") && j["book"].is_object()) {
+        auto& book = j["book"];
+        if (book.contains("enabled") && book["enabled"].is_boolean()) cfg.book.enabled = book["enabled"];
+        if (book.contains("stream") && book["stream"].is_string()) cfg.book.stream = book["stream"];
+        if (book.contains("tick_size") && book["tick_size"].is_number()) cfg.book.tick_size = book["tick_size"];
+        if (book.contains("tick_sizes") && book["tick_sizes"].is_object()) {
+            for (auto it = book["tick_sizes"].begin(); it != book["tick_sizes"].end(); ++it) {
+                if (it.value().is_number()) {
+                    auto pair = it.key();
+                    std::transform(pair.begin(), pair.end(), pair.begin(), ::tolower);
+                    cfg.book.tick_sizes[pair] = it.value().get<double>();
+                }
+            }
+        }
+        if (book.contains("capacity_ticks") && book["capacity_ticks"].is_number_unsigned()) cfg.book.capacity_ticks = book["capacity_ticks"];
+        if (book.contains("levels") && book["levels"].is_number_unsigned()) cfg.book.levels = book["levels"];
+        if (book.contains("max_pending") && book["max_pending"].is_number_unsigned()) cfg.book.max_pending = book["max_pending"];
+        if (book.contains("snapshot_dir") && book["snapshot_dir"].is_string()) cfg.book.snapshot_dir = book["snapshot_dir"];
     }
 
     // Legacy fields for backward compatibility
@@ -129,6 +281,10 @@ void ApplyCliOverrides(SAppConfig& cfg, int argc, char** argv) {
             cfg.trade_pairs = SplitPairs(arg.substr(14));
         } else if (arg.rfind("--agg-period-ms=", 0) == 0) {
             cfg.agg.period_ms = std::stoull(arg.substr(16));
+        } else if (arg.rfind("--agg-top-k=", 0) == 0) {
+            cfg.agg.top_k = std::stoull(arg.substr(12));
+        } else if (arg.rfind("--agg-sketch-slots=", 0) == 0) {
+            cfg.agg.sketch_slots = std::stoull(arg.substr(19));
         } else if (arg.rfind("--output-write-period-ms=", 0) == 0) {
             cfg.output.write_period_ms = std::stoull(arg.substr(24));
         } else if (arg.rfind("--agg-use-timestamp=", 0) == 0) {
@@ -145,6 +301,69 @@ void ApplyCliOverrides(SAppConfig& cfg, int argc, char** argv) {
         } else if (arg.rfind("--output-console-report=", 0) == 0) {
             auto val = arg.substr(23);
             cfg.output.console_report = (val == "1" || val == "true" || val == "TRUE");
+        } else if (arg.rfind("--output-compression=", 0) == 0) {
+            cfg.output.compression = arg.substr(21);
+        } else if (arg.rfind("--output-compression-level=", 0) == 0) {
+            cfg.output.compression_level = std::stoi(arg.substr(27));
+        } else if (arg.rfind("--output-backend=", 0) == 0) {
+            cfg.output.backend = arg.substr(17);
+        } else if (arg.rfind("--output-preallocate=", 0) == 0) {
+            auto val = arg.substr(21);
+            cfg.output.preallocate = (val == "1" || val == "true" || val == "TRUE");
+        } else if (arg.rfind("--queue-capacity=", 0) == 0) {
+            cfg.queue.capacity = std::stoull(arg.substr(17));
+        } else if (arg.rfind("--queue-overflow=", 0) == 0) {
+            cfg.queue.overflow = arg.substr(17);
+        } else if (arg.rfind("--queue-batch-max=", 0) == 0) {
+            cfg.queue.batch_max = std::stoull(arg.substr(18));
+        } else if (arg.rfind("--queue-batch-deadline-us=", 0) == 0) {
+            cfg.queue.batch_deadline_us = std::stoull(arg.substr(26));
+        } else if (arg.rfind("--queue-stats-interval-sec=", 0) == 0) {
+            cfg.queue.stats_interval_sec = std::stoull(arg.substr(27));
+        } else if (arg.rfind("--history-enabled=", 0) == 0) {
+            auto val = arg.substr(18);
+            cfg.history.enabled = (val == "1" || val == "true" || val == "TRUE");
+        } else if (arg.rfind("--history-socket=", 0) == 0) {
+            cfg.history.socket_path = arg.substr(17);
+        } else if (arg.rfind("--history-persist-dir=", 0) == 0) {
+            cfg.history.persist_dir = arg.substr(22);
+        } else if (arg.rfind("--shm-enabled=", 0) == 0) {
+            auto val = arg.substr(14);
+            cfg.shm.enabled = (val == "1" || val == "true" || val == "TRUE");
+        } else if (arg.rfind("--shm-name=", 0) == 0) {
+            cfg.shm.name = arg.substr(11);
+        } else if (arg.rfind("--shm-publish-trades=", 0) == 0) {
+            auto val = arg.substr(21);
+            cfg.shm.publish_trades = (val == "1" || val == "true" || val == "TRUE");
+        } else if (arg.rfind("--ticks-enabled=", 0) == 0) {
+            auto val = arg.substr(16);
+            cfg.ticks.enabled = (val == "1" || val == "true" || val == "TRUE");
+        } else if (arg.rfind("--ticks-dir=", 0) == 0) {
+            cfg.ticks.dir = arg.substr(12);
+        } else if (arg.rfind("--ticks-file-records=", 0) == 0) {
+            cfg.ticks.file_records = std::stoull(arg.substr(21));
+        } else if (arg.rfind("--trace-sample-every=", 0) == 0) {
+            cfg.trace.sample_every = static_cast<uint32_t>(std::stoul(arg.substr(21)));
+        } else if (arg.rfind("--trace-ring-events=", 0) == 0) {
+            cfg.trace.ring_events = std::stoull(arg.substr(20));
+        } else if (arg.rfind("--trace-path=", 0) == 0) {
+            cfg.trace.path = arg.substr(13);
+        } else if (arg.rfind("--book-enabled=", 0) == 0) {
+            auto val = arg.substr(15);
+            cfg.book.enabled = (val == "1" || val == "true" || val == "TRUE");
+        } else if (arg.rfind("--book-snapshot-dir=", 0) == 0) {
+            cfg.book.snapshot_dir = arg.substr(20);
+        } else if (arg.rfind("--threads-io-cpus=", 0) == 0) {
+            cfg.threads.io.cpus = SplitCpus(arg.substr(18));
+        } else if (arg.rfind("--threads-reader-cpus=", 0) == 0) {
+            cfg.threads.reader.cpus = SplitCpus(arg.substr(22));
+        } else if (arg.rfind("--threads-writer-cpus=", 0) == 0) {
+            cfg.threads.writer.cpus = SplitCpus(arg.substr(22));
+        } else if (arg.rfind("--threads-busy-poll=", 0) == 0) {
+            auto val = arg.substr(20);
+            cfg.threads.busy_poll = (val == "1" || val == "true" || val == "TRUE");
+        } else if (arg.rfind("--threads-stats-interval-sec=", 0) == 0) {
+            cfg.threads.stats_interval_sec = std::stoull(arg.substr(29));
         } else if (arg.rfind("--retry-base-retry-sec=", 0) == 0) {
             cfg.retry.base_retry_sec = std::stoull(arg.substr(23));
         } else if (arg.rfind("--retry-max-retry-sec=", 0) == 0) {
@@ -159,6 +378,30 @@ void ApplyCliOverrides(SAppConfig& cfg, int argc, char** argv) {
             cfg.ws.handshake_timeout_sec = std::stoi(arg.substr(27));
         } else if (arg.rfind("--ws-idle-timeout-sec=", 0) == 0) {
             cfg.ws.idle_timeout_sec = std::stoi(arg.substr(22));
+        } else if (arg.rfind("--ws-venue=", 0) == 0) {
+            cfg.ws.venue = arg.substr(11);
+        } else if (arg.rfind("--ws-stream=", 0) == 0) {
+            cfg.ws.stream = arg.substr(12);
+        } else if (arg.rfind("--ws-deflate=", 0) == 0) {
+            auto val = arg.substr(13);
+            cfg.ws.deflate.enabled = (val == "1" || val == "true" || val == "TRUE");
+        } else if (arg.rfind("--ws-stats-interval-sec=", 0) == 0) {
+            cfg.ws.stats_interval_sec = std::stoi(arg.substr(24));
+        } else if (arg.rfind("--ws-dns-cache-sec=", 0) == 0) {
+            cfg.ws.dns_cache_sec = std::stoi(arg.substr(19));
+        } else if (arg.rfind("--ws-connect-race=", 0) == 0) {
+            cfg.ws.connect_race = std::stoi(arg.substr(18));
+        } else if (arg.rfind("--ws-tls-resume=", 0) == 0) {
+            auto val = arg.substr(16);
+            cfg.ws.tls_resume = (val == "1" || val == "true" || val == "TRUE");
+        } else if (arg.rfind("--ws-ping-interval-sec=", 0) == 0) {
+            cfg.ws.ping_interval_sec = std::stoi(arg.substr(23));
+        } else if (arg.rfind("--ws-max-connection-age-sec=", 0) == 0) {
+            cfg.ws.max_connection_age_sec = std::stoi(arg.substr(28));
+        } else if (arg.rfind("--ws-rotate-lead-sec=", 0) == 0) {
+            cfg.ws.rotate_lead_sec = std::stoi(arg.substr(21));
+        } else if (arg.rfind("--ws-rotate-overlap-ms=", 0) == 0) {
+            cfg.ws.rotate_overlap_ms = std::stoi(arg.substr(23));
         }
     }
 }
@@ -212,6 +455,14 @@ bool ValidateConfig(const SAppConfig& cfg) {
         Log(LogLevel::ERROR, "Config", "agg.period_ms must be > 0.");
         return false;
     }
+    if (cfg.agg.arena_kb < 4 || cfg.agg.arena_kb > 2048) {
+        Log(LogLevel::ERROR, "Config", "agg.arena_kb must be between 4 and 2048.");
+        return false;
+    }
+    if (cfg.agg.top_k > 0 && (cfg.agg.sketch_slots < cfg.agg.top_k || cfg.agg.sketch_slots > 65536)) {
+        Log(LogLevel::ERROR, "Config", "agg.sketch_slots must be between agg.top_k and 65536.");
+        return false;
+    }
     if (cfg.output.write_period_ms == 0) {
         Log(LogLevel::ERROR, "Config", "output.write_period_ms must be > 0.");
         return false;
@@ -228,6 +479,112 @@ bool ValidateConfig(const SAppConfig& cfg) {
         Log(LogLevel::ERROR, "Config", "output.max_files must be > 0.");
         return false;
     }
+    ECompression compression = ECompression::None;
+    if (!ParseCompression(cfg.output.compression, compression)) {
+        Log(LogLevel::ERROR, "Config", "output.compression must be one of none, zlib, zstd: " + cfg.output.compression);
+        return false;
+    }
+    if (!CompressionAvailable(compression)) {
+        Log(LogLevel::ERROR, "Config", "output.compression " + cfg.output.compression + " is not compiled in.");
+        return false;
+    }
+    if (!IsValidCompressionLevel(compression, cfg.output.compression_level)) {
+        Log(LogLevel::ERROR, "Config", "output.compression_level is out of range for " + cfg.output.compression + ".");
+        return false;
+    }
+    EOutputBackend backend = EOutputBackend::Stream;
+    if (!ParseOutputBackend(cfg.output.backend, backend)) {
+        Log(LogLevel::ERROR, "Config", "output.backend must be stream or uring: " + cfg.output.backend);
+        return false;
+    }
+    EOverflowPolicy overflow = EOverflowPolicy::Block;
+    if (!ParseOverflowPolicy(cfg.queue.overflow, overflow)) {
+        Log(LogLevel::ERROR, "Config", "queue.overflow must be one of block, drop_newest, coalesce: " + cfg.queue.overflow);
+        return false;
+    }
+    if (cfg.queue.batch_max == 0 || cfg.queue.batch_max > 4096) {
+        Log(LogLevel::ERROR, "Config", "queue.batch_max must be in 1..4096.");
+        return false;
+    }
+    if (cfg.history.enabled) {
+        if (cfg.history.retention_sec == 0 || cfg.history.retention_sec * 1000 / cfg.agg.period_ms > 10'000'000) {
+            Log(LogLevel::ERROR, "Config", "history.retention_sec must be > 0 and hold at most 10M windows.");
+            return false;
+        }
+        if (cfg.history.socket_path.size() >= 108) {
+            Log(LogLevel::ERROR, "Config", "history.socket_path is too long for a Unix socket.");
+            return false;
+        }
+        if (cfg.history.compressed_retention_sec > 0 &&
+            (cfg.history.chunk_windows == 0 || cfg.history.chunk_windows > 1'000'000)) {
+            Log(LogLevel::ERROR, "Config", "history.chunk_windows must be in 1..1000000.");
+            return false;
+        }
+        if (!cfg.history.persist_dir.empty() && (cfg.history.persist_max_mb == 0 || cfg.history.persist_max_files == 0)) {
+            Log(LogLevel::ERROR, "Config", "history.persist_max_mb and history.persist_max_files must be > 0.");
+            return false;
+        }
+    }
+    if (cfg.shm.enabled) {
+        auto is_pow2 = [](uint64_t v) { return v > 0 && v <= (1ull << 31) && (v & (v - 1)) == 0; };
+        if (cfg.shm.name.size() < 2 || cfg.shm.name[0] != '/' || cfg.shm.name.find('/', 1) != std::string::npos) {
+            Log(LogLevel::ERROR, "Config", "shm.name must look like /name: " + cfg.shm.name);
+            return false;
+        }
+        if (!is_pow2(cfg.shm.window_slots)) {
+            Log(LogLevel::ERROR, "Config", "shm.window_slots must be a power of two.");
+            return false;
+        }
+        if (cfg.shm.publish_trades && !is_pow2(cfg.shm.trade_slots)) {
+            Log(LogLevel::ERROR, "Config", "shm.trade_slots must be a power of two.");
+            return false;
+        }
+    }
+    if (cfg.ticks.enabled) {
+        if (cfg.ticks.dir.empty()) {
+            Log(LogLevel::ERROR, "Config", "ticks.dir must not be empty.");
+            return false;
+        }
+        if (cfg.ticks.file_records == 0 || cfg.ticks.file_records > (1ull << 32)) {
+            Log(LogLevel::ERROR, "Config", "ticks.file_records must be in 1..4294967296.");
+            return false;
+        }
+    }
+    if (cfg.trace.sample_every > 0) {
+        if (cfg.trace.path.empty()) {
+            Log(LogLevel::ERROR, "Config", "trace.path must not be empty.");
+            return false;
+        }
+        if (cfg.trace.ring_events < 64 || cfg.trace.ring_events > (1ull << 24)) {
+            Log(LogLevel::ERROR, "Config", "trace.ring_events must be in 64..16777216.");
+            return false;
+        }
+    }
+    if (cfg.book.enabled) {
+        if (cfg.book.stream != "depth" && cfg.book.stream != "depth@100ms") {
+            Log(LogLevel::ERROR, "Config", "book.stream must be depth or depth@100ms: " + cfg.book.stream);
+            return false;
+        }
+        if (!(cfg.book.tick_size > 0.0)) {
+            Log(LogLevel::ERROR, "Config", "book.tick_size must be > 0.");
+            return false;
+        }
+        for (const auto& entry : cfg.book.tick_sizes) {
+            if (!(entry.second > 0.0)) {
+                Log(LogLevel::ERROR, "Config", "book.tick_sizes." + entry.first + " must be > 0.");
+                return false;
+            }
+        }
+        if (cfg.book.capacity_ticks < 2 || cfg.book.levels == 0) {
+            Log(LogLevel::ERROR, "Config", "book.capacity_ticks must be >= 2 and book.levels > 0.");
+            return false;
+        }
+    }
+    if (!ValidateThreadRole("io", cfg.threads.io) ||
+        !ValidateThreadRole("reader", cfg.threads.reader) ||
+        !ValidateThreadRole("writer", cfg.threads.writer)) {
+        return false;
+    }
     if (cfg.retry.base_retry_sec <= 0) {
         Log(LogLevel::ERROR, "Config", "retry.base_retry_sec must be > 0.");
         return false;
@@ -248,6 +605,19 @@ bool ValidateConfig(const SAppConfig& cfg) {
         Log(LogLevel::ERROR, "Config", "ws.port must not be empty.");
         return false;
     }
+    EFeedVenue venue = EFeedVenue::Binance;
+    if (!ParseFeedVenue(cfg.ws.venue, venue)) {
+        Log(LogLevel::ERROR, "Config", "ws.venue must be binance or okx: " + cfg.ws.venue);
+        return false;
+    }
+    if (cfg.book.enabled && venue != EFeedVenue::Binance) {
+        Log(LogLevel::ERROR, "Config", "book.enabled needs ws.venue binance.");
+        return false;
+    }
+    if (cfg.ws.stream != "trade" && cfg.ws.stream != "aggTrade") {
+        Log(LogLevel::ERROR, "Config", "ws.stream must be trade or aggTrade: " + cfg.ws.stream);
+        return false;
+    }
     if (cfg.ws.handshake_timeout_sec <= 0) {
         Log(LogLevel::ERROR, "Config", "ws.handshake_timeout_sec must be > 0.");
         return false;
@@ -256,6 +626,33 @@ bool ValidateConfig(const SAppConfig& cfg) {
         Log(LogLevel::ERROR, "Config", "ws.idle_timeout_sec must be >= 0.");
         return false;
     }
+    if (cfg.ws.stats_interval_sec < 0) {
+        Log(LogLevel::ERROR, "Config", "ws.stats_interval_sec must be >= 0.");
+        return false;
+    }
+    if (cfg.ws.dns_cache_sec < 0 || cfg.ws.ping_interval_sec < 0) {
+        Log(LogLevel::ERROR, "Config", "ws.dns_cache_sec and ws.ping_interval_sec must be >= 0.");
+        return false;
+    }
+    if (cfg.ws.connect_race < 1) {
+        Log(LogLevel::ERROR, "Config", "ws.connect_race must be >= 1.");
+        return false;
+    }
+    if (cfg.ws.max_connection_age_sec < 0 || cfg.ws.rotate_lead_sec < 0 || cfg.ws.rotate_overlap_ms < 0) {
+        Log(LogLevel::ERROR, "Config", "ws.max_connection_age_sec, ws.rotate_lead_sec and ws.rotate_overlap_ms must be >= 0.");
+        return false;
+    }
+    if (cfg.ws.max_connection_age_sec > 0 && cfg.ws.rotate_lead_sec >= cfg.ws.max_connection_age_sec) {
+        Log(LogLevel::ERROR, "Config", "ws.rotate_lead_sec must be below ws.max_connection_age_sec.");
+        return false;
+    }
+    // zlib cannot inflate with 8 window bits in raw mode, so RFC 7692's minimum is 9 here.
+    for (const int bits : {cfg.ws.deflate.client_max_window_bits, cfg.ws.deflate.server_max_window_bits}) {
+        if (bits < 9 || bits > 15) {
+            Log(LogLevel::ERROR, "Config", "ws.deflate window bits must be between 9 and 15.");
+            return false;
+        }
+    }
     {
         std::ofstream probe(cfg.output.filename, std::ios::app);
         if (!probe) {
@@ -266,14 +663,18 @@ bool ValidateConfig(const SAppConfig& cfg) {
     return true;
 }
 
-std::string BuildStreamTarget(const std::vector<std::string>& pairs) {
+std::string BuildStreamTarget(const std::vector<std::string>& pairs, const std::string& depth_stream,
+                              const std::string& trade_stream) {
     std::ostringstream oss;
     oss << "/stream?streams=";
     for (size_t i = 0; i < pairs.size(); ++i) {
         if (i > 0) {
             oss << "/";
         }
-        oss << pairs[i] << "@trade";
+        oss << pairs[i] << "@" << trade_stream;
+        if (!depth_stream.empty()) {
+            oss << "/" << pairs[i] << "@" << depth_stream;
+        }
     }
     return oss.str();
 }
@@ -1,14 +1,37 @@
 #pragma once
 
 #include <cstdint>
+#include <map>
 #include <string>
 #include <vector>
 
+// permessage-deflate (RFC 7692) offer; the server may decline it.
+struct SWsDeflateConfig {
+    bool enabled = false;
+    int client_max_window_bits = 15;  // 9..15, our outgoing frames
+    int server_max_window_bits = 15;  // 9..15, the server's frames (our inflate window)
+    bool client_no_context_takeover = false;
+    bool server_no_context_takeover = false;
+};
+
 struct SWebSocketConfig {
     std::string host = "stream.binance.com";
     std::string port = "9443";
     int handshake_timeout_sec = 10;
     int idle_timeout_sec = 10;
+    std::string venue = "binance";  // binance | okx; see feed_adapter.hpp
+    std::string stream = "trade";  // trade | aggTrade (binance)
+    SWsDeflateConfig deflate;
+    int stats_interval_sec = 60;   // traffic/CPU log line, 0 = off
+    // Reconnects
+    int dns_cache_sec = 60;        // reuse resolved endpoints this long, 0 = resolve every time
+    int connect_race = 2;          // endpoints connected to in parallel; the first to answer wins
+    bool tls_resume = true;        // resume the previous TLS session
+    int ping_interval_sec = 15;    // ping for per-endpoint RTT, 0 = off
+    // Make-before-break rotation
+    int max_connection_age_sec = 86400;  // the server drops connections this old, 0 = no scheduled rotation
+    int rotate_lead_sec = 300;           // open the replacement this long before
+    int rotate_overlap_ms = 2000;        // both connections read this long; duplicate trade ids are dropped
 };
 
 struct SRetryConfig {
@@ -19,6 +42,10 @@ struct SRetryConfig {
 
 struct SAggregationConfig {
     uint64_t period_ms = 1000;
+    uint64_t arena_kb = 64;        // initial arena block per window, recycled across windows
+    bool arena_hugepages = false;  // carve arena blocks from 2 MiB huge page slabs
+    uint64_t top_k = 0;            // 0 = every symbol; else the top_k by volume per window plus "others"
+    uint64_t sketch_slots = 256;   // symbols tracked per window in top_k mode
 
 };
 
@@ -29,6 +56,74 @@ struct SOutputConfig {
     uint64_t max_file_mb = 10;
     uint64_t max_files = 10;
     bool console_report = false;
+    std::string compression = "none";  // none | zlib | zstd, applied to rotated files
+    int compression_level = 6;
+    std::string backend = "stream";  // stream | uring
+    bool preallocate = true;          // uring backend: fallocate each file up to max_file_mb
+};
+
+struct SQueueConfig {
+    uint64_t capacity = 262144;    // trades buffered between the io and reader threads, 0 = unbounded
+    std::string overflow = "block"; // block | drop_newest | coalesce
+    uint64_t block_timeout_ms = 100; // block: longest wait for space before the trade is dropped
+    uint64_t batch_max = 64;         // most trades the io thread pushes at once, 1 = every trade on its own
+    uint64_t batch_deadline_us = 200; // a batch is pushed once its first trade waited this long
+    uint64_t stats_interval_sec = 0;  // log wake-ups and batch size histograms this often, 0 = off
+};
+
+struct SHistoryConfig {
+    bool enabled = false;
+    uint64_t retention_sec = 6 * 3600;       // flushed windows kept in memory per symbol
+    std::string socket_path = "/tmp/cqg.sock";  // query socket, empty = no server
+    uint64_t compressed_retention_sec = 7 * 24 * 3600;  // older windows kept Gorilla-encoded, 0 = dropped
+    uint64_t chunk_windows = 3600;           // windows per sealed compressed chunk
+    std::string persist_dir;                 // sealed chunks are appended to <dir>/<SYMBOL>.gor, empty = not persisted
+    uint64_t persist_max_mb = 64;            // per chunk file before it is rotated
+    uint64_t persist_max_files = 10;
+};
+
+struct SShmConfig {
+    bool enabled = false;
+    std::string name = "/cqg_aggregates";
+    uint64_t window_slots = 4096;   // power of two
+    uint64_t trade_slots = 65536;   // power of two, used when publish_trades is set
+    bool publish_trades = false;
+};
+
+struct STickStoreConfig {
+    bool enabled = false;
+    std::string dir = "ticks";            // <dir>/<SYMBOL>/<YYYYMMDD>.ticks
+    uint64_t file_records = 1 << 20;      // preallocated records per file, doubled when full
+};
+
+struct STraceConfig {
+    uint32_t sample_every = 0;      // trace one trade in this many (and every flush), 0 = off
+    uint64_t ring_events = 65536;   // spans kept per thread, rounded up to a power of two
+    std::string path = "trace.json";  // written on SIGUSR1
+};
+
+struct SBookConfig {
+    bool enabled = false;
+    std::string stream = "depth@100ms";       // Binance diff stream: depth | depth@100ms
+    double tick_size = 0.01;                  // default price step of the flat book
+    std::map<std::string, double> tick_sizes;  // per-pair overrides, lowercase pair -> tick
+    uint32_t capacity_ticks = 16384;          // price levels kept per side around the mid
+    uint32_t levels = 5;                      // depth is reported over this many levels
+    uint32_t max_pending = 1000;              // diffs buffered while waiting for a snapshot
+    std::string snapshot_dir;                 // local <SYMBOL>.json snapshots (REST format)
+};
+
+struct SThreadRoleConfig {
+    std::vector<int> cpus;  // empty: keep the process-wide affinity
+    int fifo_priority = 0;  // 1..99 switches the thread to SCHED_FIFO, 0 keeps SCHED_OTHER
+};
+
+struct SThreadsConfig {
+    SThreadRoleConfig io;      // websocket io_context (main thread)
+    SThreadRoleConfig reader;  // queue consumer / aggregator
+    SThreadRoleConfig writer;
+    bool busy_poll = false;    // reader spins on the queue instead of sleeping on the condition variable
+    uint64_t stats_interval_sec = 0;  // log CPU (and allocations) per stage this often, 0 = off
 };
 
 struct SAppConfig {
@@ -37,8 +132,17 @@ struct SAppConfig {
     SRetryConfig retry;
     SAggregationConfig agg;
     SOutputConfig output;
+    SQueueConfig queue;
+    SHistoryConfig history;
+    SShmConfig shm;
+    STickStoreConfig ticks;
+    STraceConfig trace;
+    SThreadsConfig threads;
+    SBookConfig book;
 };
 
 SAppConfig LoadConfig(int argc, char** argv);
 bool ValidateConfig(const SAppConfig& cfg);
-std::string BuildStreamTarget(const std::vector<std::string>& pairs);
+// depth_stream, when not empty, adds "<pair>@<depth_stream>" next to every "<pair>@trade".
+std::string BuildStreamTarget(const std::vector<std::string>& pairs, const std::string& depth_stream = "",
+                              const std::string& trade_stream = "trade");
@@ -0,0 +1,50 @@
+#include "endpoint_table.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+void CEndpointTable::SetResolved(std::vector<Endpoint> endpoints, Clock::time_point now) {
+    m_resolved = std::move(endpoints);
+    m_resolved_at = now;
+}
+
+bool CEndpointTable::Fresh(Clock::time_point now) const {
+    return !m_resolved.empty() && now - m_resolved_at < m_dns_ttl;
+}
+
+std::vector<CEndpointTable::Endpoint> CEndpointTable::Ranked() const {
+    std::vector<std::tuple<bool, bool, double, size_t>> keys;
+    keys.reserve(m_resolved.size());
+    for (size_t i = 0; i < m_resolved.size(); ++i) {
+        const auto it = m_stats.find(m_resolved[i]);
+        const SEndpointStats stats = it == m_stats.end() ? SEndpointStats{} : it->second;
+        keys.emplace_back(stats.failures > 0, stats.samples == 0, stats.srtt_us, i);
+    }
+    std::sort(keys.begin(), keys.end());
+    std::vector<Endpoint> ranked;
+    ranked.reserve(keys.size());
+    for (const auto& key : keys) {
+        ranked.push_back(m_resolved[std::get<3>(key)]);
+    }
+    return ranked;
+}
+
+void CEndpointTable::RecordRtt(const Endpoint& endpoint, std::chrono::microseconds rtt) {
+    auto& stats = m_stats[endpoint];
+    const double sample = static_cast<double>(rtt.count());
+    stats.srtt_us = stats.samples == 0 ? sample : stats.srtt_us + (sample - stats.srtt_us) / 8.0;
+    ++stats.samples;
+    stats.failures = 0;
+}
+
+void CEndpointTable::RecordFailure(const Endpoint& endpoint) {
+    ++m_stats[endpoint].failures;
+}
+
+std::optional<std::chrono::microseconds> CEndpointTable::SmoothedRtt(const Endpoint& endpoint) const {
+    const auto it = m_stats.find(endpoint);
+    if (it == m_stats.end() || it->second.samples == 0) {
+        return std::nullopt;
+    }
+    return std::chrono::microseconds(static_cast<int64_t>(it->second.srtt_us));
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <vector>
+
+#include <boost/asio/ip/tcp.hpp>
+
+// What the client knows about the stream host's addresses: the last
+// resolution, kept for a fixed TTL (getaddrinfo does not report the record's
+// own), and a smoothed round-trip time per endpoint from TCP connects and
+// ping/pong. A reconnect can then skip the resolver and race the fastest
+// endpoints first. Used from the io thread only.
+class CEndpointTable {
+public:
+    using Endpoint = boost::asio::ip::tcp::endpoint;
+    using Clock = std::chrono::steady_clock;
+
+    explicit CEndpointTable(std::chrono::seconds dns_ttl) : m_dns_ttl(dns_ttl) {}
+
+    // Replaces the cached resolution; endpoints seen before keep their history.
+    void SetResolved(std::vector<Endpoint> endpoints, Clock::time_point now);
+    // True while a resolution younger than the TTL is cached.
+    bool Fresh(Clock::time_point now) const;
+    void Invalidate() { m_resolved.clear(); }
+
+    // The cached endpoints, best first: measured ones by smoothed RTT, then
+    // never measured ones in resolver order, then those whose last connect failed.
+    std::vector<Endpoint> Ranked() const;
+
+    // RFC 6298 smoothing (1/8 gain); a sample also clears the failure mark.
+    void RecordRtt(const Endpoint& endpoint, std::chrono::microseconds rtt);
+    void RecordFailure(const Endpoint& endpoint);
+    std::optional<std::chrono::microseconds> SmoothedRtt(const Endpoint& endpoint) const;
+
+private:
+    struct SEndpointStats {
+        double srtt_us = 0.0;
+        uint64_t samples = 0;
+        uint32_t failures = 0;  // consecutive, reset by the next RTT sample
+    };
+
+    const std::chrono::seconds m_dns_ttl;
+    std::vector<Endpoint> m_resolved;
+    Clock::time_point m_resolved_at{};
+    std::map<Endpoint, SEndpointStats> m_stats;
+};
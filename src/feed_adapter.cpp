@@ -0,0 +1,37 @@
+#include "feed_adapter.hpp"
+
+#include <cctype>
+
+std::string CBinanceFeed::BuildTarget(const SAppConfig& cfg) const {
+    if (cfg.trade_pairs.empty()) {
+        return "/";
+    }
+    return BuildStreamTarget(cfg.trade_pairs, cfg.book.enabled ? cfg.book.stream : "", cfg.ws.stream);
+}
+
+std::string COkxFeed::BuildSubscribe(const SAppConfig& cfg) const {
+    std::string message = R"({"op":"subscribe","args":[)";
+    for (size_t i = 0; i < cfg.trade_pairs.size(); ++i) {
+        // trade_pairs are lowercased on load; OKX instrument ids are upper case.
+        std::string inst_id = cfg.trade_pairs[i];
+        for (auto& c : inst_id) {
+            c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+        message += (i > 0 ? "," : "");
+        message += R"({"channel":"trades","instId":")" + inst_id + R"("})";
+    }
+    message += "]}";
+    return message;
+}
+
+bool ParseFeedVenue(const std::string& name, EFeedVenue& out) {
+    if (name == CBinanceFeed::kName) {
+        out = EFeedVenue::Binance;
+        return true;
+    }
+    if (name == COkxFeed::kName) {
+        out = EFeedVenue::Okx;
+        return true;
+    }
+    return false;
+}
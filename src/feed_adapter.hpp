@@ -0,0 +1,381 @@
+#pragma once
+
+#include "config.hpp"
+#include "trade.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Venue-specific parts of a public trade feed: the handshake target, the
+// subscribe message sent after the handshake and a parser for that venue's
+// trade schema. CFeedAdapter is a CRTP base; a venue class provides
+//   static constexpr const char* kName;
+//   std::string BuildTarget(const SAppConfig&) const;
+//   std::string BuildSubscribe(const SAppConfig&) const;   empty: the target subscribes
+//   std::string_view Keepalive() const;                     text frame for the ping timer, empty: none
+//   template <typename FEmit> size_t ParseTrades(std::string_view frame, FEmit& emit) const;
+// The client picks the venue once per frame with VisitFeedAdapter, a switch
+// over ws.venue, so each parser is instantiated and inlined into its own
+// read path. Neither virtual calls nor a JSON DOM are involved per message.
+
+namespace feed {
+
+inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Members of one JSON object, in order, without building a DOM. Values are
+// returned as text: string contents without the quotes (escapes left as
+// they are), nested objects and arrays with their brackets, literals as is.
+// A malformed object throws std::runtime_error.
+class CObjectScanner {
+public:
+    explicit CObjectScanner(std::string_view object) : m_text(object) {
+        SkipSpace();
+        Expect('{');
+        SkipSpace();
+        if (m_pos < m_text.size() && m_text[m_pos] == '}') {
+            ++m_pos;
+            m_done = true;
+        }
+    }
+
+    // False after the last member.
+    bool Next(std::string_view& key, std::string_view& value, bool& is_string) {
+        if (m_done) {
+            return false;
+        }
+        SkipSpace();
+        Expect('"');
+        key = ScanString();
+        SkipSpace();
+        Expect(':');
+        SkipSpace();
+        is_string = m_pos < m_text.size() && m_text[m_pos] == '"';
+        if (is_string) {
+            ++m_pos;
+            value = ScanString();
+        } else if (m_pos < m_text.size() && (m_text[m_pos] == '{' || m_text[m_pos] == '[')) {
+            value = ScanNested();
+        } else {
+            const size_t begin = m_pos;
+            while (m_pos < m_text.size() && m_text[m_pos] != ',' && m_text[m_pos] != '}' && !IsSpace(m_text[m_pos])) {
+                ++m_pos;
+            }
+            value = m_text.substr(begin, m_pos - begin);
+        }
+        SkipSpace();
+        if (m_pos < m_text.size() && m_text[m_pos] == ',') {
+            ++m_pos;
+        } else {
+            Expect('}');
+            m_done = true;
+        }
+        return true;
+    }
+
+private:
+    void SkipSpace() {
+        while (m_pos < m_text.size() && IsSpace(m_text[m_pos])) {
+            ++m_pos;
+        }
+    }
+    void Expect(char c) {
+        if (m_pos >= m_text.size() || m_text[m_pos] != c) {
+            throw std::runtime_error(std::string("Malformed JSON: expected '") + c + "'");
+        }
+        ++m_pos;
+    }
+    // After the opening quote; leaves m_pos behind the closing one.
+    std::string_view ScanString() {
+        const size_t begin = m_pos;
+        while (m_pos < m_text.size() && m_text[m_pos] != '"') {
+            m_pos += m_text[m_pos] == '\\' ? 2 : 1;
+        }
+        if (m_pos >= m_text.size()) {
+            throw std::runtime_error("Malformed JSON: unterminated string");
+        }
+        return m_text.substr(begin, m_pos++ - begin);
+    }
+    std::string_view ScanNested() {
+        const size_t begin = m_pos;
+        int depth = 0;
+        bool in_string = false;
+        for (; m_pos < m_text.size(); ++m_pos) {
+            const char c = m_text[m_pos];
+            if (in_string) {
+                if (c == '\\') {
+                    ++m_pos;
+                } else if (c == '"') {
+                    in_string = false;
+                }
+            } else if (c == '"') {
+                in_string = true;
+            } else if (c == '{' || c == '[') {
+                ++depth;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                ++m_pos;
+                return m_text.substr(begin, m_pos - begin);
+            }
+        }
+        throw std::runtime_error("Malformed JSON: unterminated object");
+    }
+
+    std::string_view m_text;
+    size_t m_pos = 0;
+    bool m_done = false;
+};
+
+inline uint64_t ToUint(std::string_view text) {
+    uint64_t value = 0;
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || end != text.data() + text.size()) {
+        throw std::runtime_error("Invalid trade data");
+    }
+    return value;
+}
+
+inline double ToDouble(std::string_view text) {
+    double value = 0.0;
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || end != text.data() + text.size()) {
+        throw std::runtime_error("Invalid trade data");
+    }
+    return value;
+}
+
+}  // namespace feed
+
+template <typename TVenue>
+class CFeedAdapter {
+public:
+    static constexpr const char* Name() { return TVenue::kName; }
+    // Request target of the websocket handshake.
+    std::string Target(const SAppConfig& cfg) const { return Self().BuildTarget(cfg); }
+    // Text frame to send once the handshake is done; empty if the target already subscribes.
+    std::string SubscribeMessage(const SAppConfig& cfg) const { return Self().BuildSubscribe(cfg); }
+    std::string_view KeepaliveMessage() const { return Self().Keepalive(); }
+    // Calls emit(STrade&&) for every trade in the frame and returns how many
+    // there were; acks, pongs and other events yield 0. A trade with missing
+    // or invalid fields throws std::runtime_error.
+    template <typename FEmit>
+    size_t ParseFrame(std::string_view frame, FEmit&& emit) const {
+        return Self().ParseTrades(frame, emit);
+    }
+
+private:
+    const TVenue& Self() const { return static_cast<const TVenue&>(*this); }
+};
+
+// Binance combined streams: {"stream":"btcusdt@trade","data":{...}}, or the
+// bare payload. @trade carries "t", @aggTrade the range "f".."l".
+class CBinanceFeed : public CFeedAdapter<CBinanceFeed> {
+public:
+    static constexpr const char* kName = "binance";
+
+    std::string BuildTarget(const SAppConfig& cfg) const;
+    std::string BuildSubscribe(const SAppConfig&) const { return {}; }
+    std::string_view Keepalive() const { return {}; }
+
+    template <typename FEmit>
+    size_t ParseTrades(std::string_view frame, FEmit& emit) const {
+        STrade trade{};
+        if (!ParseTrade(frame, trade)) {
+            return 0;
+        }
+        emit(std::move(trade));
+        return 1;
+    }
+
+    // False for events other than trades (depthUpdate).
+    static bool ParseTrade(std::string_view frame, STrade& out) {
+        std::string_view key;
+        std::string_view value;
+        bool is_string = false;
+        // Fields seen: s p q T m
+        unsigned seen = 0;
+        bool has_range = false;
+        bool has_last = false;
+        feed::CObjectScanner outer(frame);
+        feed::CObjectScanner* scanner = &outer;
+        feed::CObjectScanner data("{}");
+        while (scanner->Next(key, value, is_string)) {
+            if (key.size() == 4 && key == "data" && !is_string && !value.empty() && value.front() == '{') {
+                data = feed::CObjectScanner(value);
+                scanner = &data;
+                continue;
+            }
+            if (key.size() != 1) {
+                continue;
+            }
+            switch (key[0]) {
+            case 'e':
+                if (value != "trade" && value != "aggTrade") {
+                    return false;
+                }
+                break;
+            case 's':
+                out.symbol.assign(value.data(), value.size());
+                seen |= 1u;
+                break;
+            case 'p':
+                out.price = feed::ToDouble(value);
+                seen |= 2u;
+                break;
+            case 'q':
+                out.quantity = feed::ToDouble(value);
+                seen |= 4u;
+                break;
+            case 'T':
+                out.timestamp = feed::ToUint(value);
+                seen |= 8u;
+                break;
+            case 'm':
+                out.buyer_initiated = value == "true";
+                seen |= 16u;
+                break;
+            case 't':
+                if (!has_range) {
+                    out.first_trade_id = out.last_trade_id = feed::ToUint(value);
+                }
+                break;
+            case 'f':
+                out.first_trade_id = feed::ToUint(value);
+                has_range = true;
+                break;
+            case 'l':
+                out.last_trade_id = feed::ToUint(value);
+                has_last = true;
+                break;
+            default:
+                break;
+            }
+        }
+        if (seen != 31u || has_range != has_last || !out.IsValid()) {
+            throw std::runtime_error("Invalid trade data");
+        }
+        return true;
+    }
+};
+
+// OKX v5 public "trades" channel. Frames carry an array of trades:
+//   {"arg":{"channel":"trades","instId":"BTC-USDT"},"data":[{"instId":"BTC-USDT",
+//    "tradeId":"130639474","px":"42219.9","sz":"0.12060306","side":"buy",
+//    "ts":"1630048897897","count":"3"}]}
+// "tradeId" is the last trade of an aggregation of "count" trades, so a record
+// covers tradeId - count + 1 .. tradeId, like a Binance aggTrade.
+class COkxFeed : public CFeedAdapter<COkxFeed> {
+public:
+    static constexpr const char* kName = "okx";
+
+    std::string BuildTarget(const SAppConfig&) const { return "/ws/v5/public"; }
+    // {"op":"subscribe","args":[{"channel":"trades","instId":"BTC-USDT"},...]}
+    std::string BuildSubscribe(const SAppConfig& cfg) const;
+    // OKX drops connections that stay silent for 30 s and answers "pong".
+    std::string_view Keepalive() const { return "ping"; }
+
+    template <typename FEmit>
+    size_t ParseTrades(std::string_view frame, FEmit& emit) const {
+        if (frame.empty() || frame.front() != '{') {
+            return 0;  // "pong"
+        }
+        std::string_view key;
+        std::string_view value;
+        bool is_string = false;
+        std::string_view trades;
+        feed::CObjectScanner outer(frame);
+        while (outer.Next(key, value, is_string)) {
+            if (key == "event" && value == "error") {
+                throw std::runtime_error("OKX error frame");
+            }
+            if (key == "data" && !is_string) {
+                trades = value;
+            }
+        }
+        if (trades.size() < 2 || trades.front() != '[') {
+            return 0;  // subscribe ack or another event
+        }
+        size_t count = 0;
+        size_t pos = 1;
+        while (pos < trades.size()) {
+            const size_t begin = trades.find('{', pos);
+            if (begin == std::string_view::npos) {
+                break;
+            }
+            // Trade objects hold no nested objects or braces in strings.
+            const size_t end = trades.find('}', begin);
+            if (end == std::string_view::npos) {
+                throw std::runtime_error("Malformed JSON: unterminated object");
+            }
+            emit(ParseTrade(trades.substr(begin, end - begin + 1)));
+            ++count;
+            pos = end + 1;
+        }
+        return count;
+    }
+
+    static STrade ParseTrade(std::string_view object) {
+        STrade trade{};
+        std::string_view key;
+        std::string_view value;
+        bool is_string = false;
+        uint64_t aggregated = 1;
+        // Fields seen: instId px sz side ts tradeId
+        unsigned seen = 0;
+        feed::CObjectScanner scanner(object);
+        while (scanner.Next(key, value, is_string)) {
+            if (key == "instId") {
+                trade.symbol.assign(value.data(), value.size());
+                seen |= 1u;
+            } else if (key == "px") {
+                trade.price = feed::ToDouble(value);
+                seen |= 2u;
+            } else if (key == "sz") {
+                trade.quantity = feed::ToDouble(value);
+                seen |= 4u;
+            } else if (key == "side") {
+                // STrade::buyer_initiated carries Binance's "m" flag (the buyer
+                // was the maker), so a taker sell maps to true on both venues.
+                trade.buyer_initiated = value == "sell";
+                seen |= 8u;
+            } else if (key == "ts") {
+                trade.timestamp = feed::ToUint(value);
+                seen |= 16u;
+            } else if (key == "tradeId") {
+                trade.last_trade_id = feed::ToUint(value);
+                seen |= 32u;
+            } else if (key == "count") {
+                aggregated = std::max<uint64_t>(1, feed::ToUint(value));
+            }
+        }
+        if (seen != 63u || !trade.IsValid()) {
+            throw std::runtime_error("Invalid trade data");
+        }
+        trade.first_trade_id = trade.last_trade_id >= aggregated ? trade.last_trade_id - aggregated + 1 : 1;
+        return trade;
+    }
+};
+
+enum class EFeedVenue { Binance, Okx };
+
+// ws.venue -> EFeedVenue; false for an unknown name.
+bool ParseFeedVenue(const std::string& name, EFeedVenue& out);
+
+// Calls fn with the venue's adapter. The switch is the only per-frame
+// dispatch; every branch is its own instantiation of fn.
+template <typename FVisit>
+decltype(auto) VisitFeedAdapter(EFeedVenue venue, FVisit&& fn) {
+    switch (venue) {
+    case EFeedVenue::Okx:
+        return fn(COkxFeed{});
+    case EFeedVenue::Binance:
+    default:
+        return fn(CBinanceFeed{});
+    }
+}
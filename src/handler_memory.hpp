@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Memory for the asynchronous operations of one owner (a connection, a
+// timer), handed to Asio as the completion handler's associated allocator.
+// An operation's memory is freed before its handler runs, so a loop that
+// starts the next operation from the handler gets the same block back: after
+// the first round trip the loop allocates nothing. A few blocks are kept for
+// the operations that are in flight at the same time (a read and the
+// transport's own operations under it); requests that find no free block go
+// to operator new and are counted. Not thread-safe: one io thread per owner.
+class CHandlerMemory {
+public:
+    static constexpr size_t kBlocks = 4;
+
+    CHandlerMemory() = default;
+    ~CHandlerMemory() {
+        for (auto& block : m_blocks) {
+            ::operator delete(block.data);
+        }
+    }
+    CHandlerMemory(const CHandlerMemory&) = delete;
+    CHandlerMemory& operator=(const CHandlerMemory&) = delete;
+
+    void* Allocate(size_t size) {
+        SBlock* spare = nullptr;
+        for (auto& block : m_blocks) {
+            if (block.in_use) {
+                continue;
+            }
+            if (block.size >= size) {
+                block.in_use = true;
+                return block.data;
+            }
+            spare = spare ? spare : &block;
+        }
+        if (spare) {
+            // A free block that is too small is replaced by one that fits.
+            ::operator delete(spare->data);
+            *spare = SBlock{};
+            spare->data = ::operator new(size);
+            spare->size = size;
+            spare->in_use = true;
+            ++m_allocations;
+            return spare->data;
+        }
+        ++m_allocations;
+        ++m_overflows;
+        return ::operator new(size);
+    }
+
+    void Deallocate(void* p) noexcept {
+        for (auto& block : m_blocks) {
+            if (block.data == p) {
+                block.in_use = false;
+                return;
+            }
+        }
+        ::operator delete(p);
+    }
+
+    // Calls to operator new so far: the first use of each block, growth, and
+    // overflows (more operations in flight than blocks).
+    uint64_t Allocations() const { return m_allocations; }
+    uint64_t Overflows() const { return m_overflows; }
+
+private:
+    struct SBlock {
+        void* data = nullptr;
+        size_t size = 0;
+        bool in_use = false;
+    };
+    SBlock m_blocks[kBlocks];
+    uint64_t m_allocations = 0;
+    uint64_t m_overflows = 0;
+};
+
+template <typename T>
+class THandlerAllocator {
+public:
+    using value_type = T;
+
+    explicit THandlerAllocator(CHandlerMemory& memory) noexcept : m_memory(&memory) {}
+    template <typename U>
+    THandlerAllocator(const THandlerAllocator<U>& other) noexcept : m_memory(other.m_memory) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(m_memory->Allocate(sizeof(T) * n)); }
+    void deallocate(T* p, size_t /*n*/) noexcept { m_memory->Deallocate(p); }
+
+    template <typename U>
+    bool operator==(const THandlerAllocator<U>& other) const noexcept { return m_memory == other.m_memory; }
+    template <typename U>
+    bool operator!=(const THandlerAllocator<U>& other) const noexcept { return m_memory != other.m_memory; }
+
+private:
+    template <typename>
+    friend class THandlerAllocator;
+    CHandlerMemory* m_memory;
+};
+
+// Wraps a completion handler so that its operations allocate from memory.
+template <typename THandler>
+class TAllocHandler {
+public:
+    using allocator_type = THandlerAllocator<THandler>;
+
+    TAllocHandler(CHandlerMemory& memory, THandler handler) : m_memory(&memory), m_handler(std::move(handler)) {}
+
+    allocator_type get_allocator() const noexcept { return allocator_type(*m_memory); }
+
+    template <typename... TArgs>
+    void operator()(TArgs&&... args) {
+        m_handler(std::forward<TArgs>(args)...);
+    }
+
+private:
+    CHandlerMemory* m_memory;
+    THandler m_handler;
+};
+
+template <typename THandler>
+TAllocHandler<std::decay_t<THandler>> MakeAllocHandler(CHandlerMemory& memory, THandler&& handler) {
+    return TAllocHandler<std::decay_t<THandler>>(memory, std::forward<THandler>(handler));
+}
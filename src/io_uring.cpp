@@ -0,0 +1,140 @@
+#include "io_uring.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#endif
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define CQG_IO_URING_SYSCALLS 1
+#endif
+
+namespace {
+#ifdef CQG_IO_URING_SYSCALLS
+unsigned* RingField(void* base, uint32_t offset) {
+    return reinterpret_cast<unsigned*>(static_cast<unsigned char*>(base) + offset);
+}
+#endif
+}
+
+CIoUring::~CIoUring() {
+    if (m_sqes) {
+        ::munmap(m_sqes, m_sqes_size);
+    }
+    if (m_cq_ptr && m_cq_ptr != m_sq_ptr) {
+        ::munmap(m_cq_ptr, m_cq_size);
+    }
+    if (m_sq_ptr) {
+        ::munmap(m_sq_ptr, m_sq_size);
+    }
+    if (m_ring_fd >= 0) {
+        ::close(m_ring_fd);
+    }
+}
+
+bool CIoUring::Init(unsigned entries) {
+#ifdef CQG_IO_URING_SYSCALLS
+    io_uring_params params{};
+    const long fd = ::syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        return false;
+    }
+    m_ring_fd = static_cast<int>(fd);
+
+    m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+    }
+    m_sq_ptr = ::mmap(nullptr, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      m_ring_fd, IORING_OFF_SQ_RING);
+    if (m_sq_ptr == MAP_FAILED) {
+        m_sq_ptr = nullptr;
+        return false;
+    }
+    if (single_mmap) {
+        m_cq_ptr = m_sq_ptr;
+    } else {
+        m_cq_ptr = ::mmap(nullptr, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          m_ring_fd, IORING_OFF_CQ_RING);
+        if (m_cq_ptr == MAP_FAILED) {
+            m_cq_ptr = nullptr;
+            return false;
+        }
+    }
+    m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = ::mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    m_ring_fd, IORING_OFF_SQES);
+    if (m_sqes == MAP_FAILED) {
+        m_sqes = nullptr;
+        return false;
+    }
+
+    m_sq_tail = RingField(m_sq_ptr, params.sq_off.tail);
+    m_sq_mask = RingField(m_sq_ptr, params.sq_off.ring_mask);
+    m_sq_array = RingField(m_sq_ptr, params.sq_off.array);
+    m_cq_head = RingField(m_cq_ptr, params.cq_off.head);
+    m_cq_tail = RingField(m_cq_ptr, params.cq_off.tail);
+    m_cq_mask = RingField(m_cq_ptr, params.cq_off.ring_mask);
+    m_cqes = static_cast<unsigned char*>(m_cq_ptr) + params.cq_off.cqes;
+    return true;
+#else
+    (void)entries;
+    return false;
+#endif
+}
+
+int64_t CIoUring::Write(int fd, const void* data, size_t size, uint64_t offset) {
+#ifdef CQG_IO_URING_SYSCALLS
+    if (m_ring_fd < 0) {
+        return -EBADF;
+    }
+    // Single submitter: the tail is only written by us, the kernel reads it.
+    const unsigned tail = *m_sq_tail;
+    const unsigned index = tail & *m_sq_mask;
+    auto* sqe = static_cast<io_uring_sqe*>(m_sqes) + index;
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(data);
+    sqe->len = static_cast<uint32_t>(size);
+    sqe->off = offset;
+    m_sq_array[index] = index;
+    __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    // Wait until the completion is there: returning before it would let the
+    // caller resubmit the chunk while this write is still in flight, and
+    // take its completion for the next one. A wait can return early (a
+    // signal, a spurious wakeup); once the entry is submitted, later calls
+    // only wait.
+    unsigned to_submit = 1;
+    while (to_submit > 0 || *m_cq_head == __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE)) {
+        const long rc = ::syscall(__NR_io_uring_enter, m_ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (rc > 0) {
+            to_submit = 0;
+        } else if (rc < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return -errno;
+        }
+    }
+
+    const unsigned head = *m_cq_head;
+    const auto* cqe = static_cast<const io_uring_cqe*>(m_cqes) + (head & *m_cq_mask);
+    const int64_t res = cqe->res;
+    __atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+    return res;
+#else
+    (void)fd;
+    (void)data;
+    (void)size;
+    (void)offset;
+    return -ENOSYS;
+#endif
+}
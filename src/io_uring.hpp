@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Minimal single-threaded io_uring used by the output writer. It talks to the
+// kernel through the raw syscalls, so no liburing is needed. Callers keep a
+// plain pwrite() path for kernels or sandboxes where Init() fails.
+class CIoUring {
+public:
+    CIoUring() = default;
+    ~CIoUring();
+
+    CIoUring(const CIoUring&) = delete;
+    CIoUring& operator=(const CIoUring&) = delete;
+
+    bool Init(unsigned entries);
+    bool IsReady() const { return m_ring_fd >= 0; }
+
+    // Submits a write at the given offset and waits for its completion.
+    // Returns bytes written or -errno.
+    int64_t Write(int fd, const void* data, size_t size, uint64_t offset);
+
+private:
+    int m_ring_fd = -1;
+
+    void* m_sq_ptr = nullptr;
+    size_t m_sq_size = 0;
+    void* m_cq_ptr = nullptr;
+    size_t m_cq_size = 0;
+    void* m_sqes = nullptr;
+    size_t m_sqes_size = 0;
+
+    unsigned* m_sq_tail = nullptr;
+    unsigned* m_sq_mask = nullptr;
+    unsigned* m_sq_array = nullptr;
+    unsigned* m_cq_head = nullptr;
+    unsigned* m_cq_tail = nullptr;
+    unsigned* m_cq_mask = nullptr;
+    void* m_cqes = nullptr;
+};
@@ -0,0 +1,362 @@
+#include "log_compressor.hpp"
+
+#include "logger.hpp"
+#include "thread_tuning.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <zlib.h>
+#ifdef CQG_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr size_t kChunkSize = 128 * 1024;
+
+class CFd {
+public:
+    explicit CFd(int fd) : m_fd(fd) {}
+    ~CFd() {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+    }
+    CFd(const CFd&) = delete;
+    CFd& operator=(const CFd&) = delete;
+
+    int get() const { return m_fd; }
+    bool Close() {
+        const int fd = m_fd;
+        m_fd = -1;
+        return fd < 0 || ::close(fd) == 0;
+    }
+
+private:
+    int m_fd;
+};
+
+bool WriteAll(int fd, const unsigned char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+ssize_t ReadSome(int fd, unsigned char* data, size_t size) {
+    for (;;) {
+        const ssize_t n = ::read(fd, data, size);
+        if (n >= 0 || errno != EINTR) {
+            return n;
+        }
+    }
+}
+
+bool DeflateStream(int in_fd, int out_fd, int level, SCompressionResult& result) {
+    z_stream zs{};
+    // 15 window bits + 16 selects the gzip wrapper so that rotated files open with zcat/gunzip.
+    if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    std::vector<unsigned char> in(kChunkSize);
+    std::vector<unsigned char> out(kChunkSize);
+    bool ok = true;
+    int flush = Z_NO_FLUSH;
+    while (ok && flush != Z_FINISH) {
+        const ssize_t n = ReadSome(in_fd, in.data(), in.size());
+        if (n < 0) {
+            ok = false;
+            break;
+        }
+        result.input_bytes += static_cast<uint64_t>(n);
+        flush = (n == 0) ? Z_FINISH : Z_NO_FLUSH;
+        zs.next_in = in.data();
+        zs.avail_in = static_cast<uInt>(n);
+        do {
+            zs.next_out = out.data();
+            zs.avail_out = static_cast<uInt>(out.size());
+            if (deflate(&zs, flush) == Z_STREAM_ERROR) {
+                ok = false;
+                break;
+            }
+            const size_t produced = out.size() - zs.avail_out;
+            result.output_bytes += produced;
+            if (!WriteAll(out_fd, out.data(), produced)) {
+                ok = false;
+                break;
+            }
+        } while (zs.avail_out == 0);
+    }
+    deflateEnd(&zs);
+    return ok;
+}
+
+#ifdef CQG_HAVE_ZSTD
+bool ZstdStream(int in_fd, int out_fd, int level, SCompressionResult& result) {
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    if (!cctx) {
+        return false;
+    }
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+    std::vector<unsigned char> in(ZSTD_CStreamInSize());
+    std::vector<unsigned char> out(ZSTD_CStreamOutSize());
+    bool ok = true;
+    bool last = false;
+    while (ok && !last) {
+        const ssize_t n = ReadSome(in_fd, in.data(), in.size());
+        if (n < 0) {
+            ok = false;
+            break;
+        }
+        result.input_bytes += static_cast<uint64_t>(n);
+        last = (n == 0);
+        const ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
+        ZSTD_inBuffer input{in.data(), static_cast<size_t>(n), 0};
+        bool finished = false;
+        while (!finished) {
+            ZSTD_outBuffer output{out.data(), out.size(), 0};
+            const size_t remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+            if (ZSTD_isError(remaining)) {
+                ok = false;
+                break;
+            }
+            result.output_bytes += output.pos;
+            if (!WriteAll(out_fd, out.data(), output.pos)) {
+                ok = false;
+                break;
+            }
+            finished = last ? (remaining == 0) : (input.pos == input.size);
+        }
+    }
+    ZSTD_freeCCtx(cctx);
+    return ok;
+}
+#endif
+
+void LowerWorkerPriority() {
+    // The worker inherits the placement of whoever starts it: after a reload
+    // that is the io thread, pinned and maybe SCHED_FIFO, where a nice value
+    // has no effect. Back to the affinity the process started with and
+    // SCHED_OTHER first.
+    ApplyThreadPlacement("compressor", SThreadRoleConfig{});
+#ifdef __linux__
+    // Both calls act on the calling thread only when given its tid.
+    const auto tid = static_cast<id_t>(::syscall(SYS_gettid));
+    ::setpriority(PRIO_PROCESS, tid, 19);
+    constexpr int kIoprioWhoProcess = 1;
+    constexpr int kIoprioClassIdle = 3;
+    constexpr int kIoprioClassShift = 13;
+    ::syscall(SYS_ioprio_set, kIoprioWhoProcess, static_cast<int>(tid), kIoprioClassIdle << kIoprioClassShift);
+#endif
+}
+}
+
+bool ParseCompression(std::string_view name, ECompression& out) {
+    if (name == "none") {
+        out = ECompression::None;
+    } else if (name == "zlib") {
+        out = ECompression::Zlib;
+    } else if (name == "zstd") {
+        out = ECompression::Zstd;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool CompressionAvailable(ECompression algo) {
+#ifdef CQG_HAVE_ZSTD
+    (void)algo;
+    return true;
+#else
+    return algo != ECompression::Zstd;
+#endif
+}
+
+bool IsValidCompressionLevel(ECompression algo, int level) {
+    switch (algo) {
+    case ECompression::Zlib:
+        return level >= 1 && level <= 9;
+    case ECompression::Zstd:
+        return level >= 1 && level <= 19;
+    default:
+        return true;
+    }
+}
+
+std::string CompressionSuffix(ECompression algo) {
+    switch (algo) {
+    case ECompression::Zlib:
+        return ".gz";
+    case ECompression::Zstd:
+        return ".zst";
+    default:
+        return "";
+    }
+}
+
+CLogCompressor::CLogCompressor(ECompression algo, int level, std::string base_path, uint64_t max_files)
+    : m_algo(algo), m_level(level), m_base_path(std::move(base_path)), m_max_files(max_files) {}
+
+CLogCompressor::~CLogCompressor() {
+    Stop();
+}
+
+void CLogCompressor::Start() {
+    const fs::path base(m_base_path);
+    const fs::path dir = base.parent_path().empty() ? fs::path(".") : base.parent_path();
+    const std::string prefix = base.filename().string() + ".pending.";
+    std::vector<std::string> leftovers;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+        if (name.rfind(prefix, 0) == 0) {
+            leftovers.push_back((base.parent_path() / name).string());
+        }
+    }
+    std::sort(leftovers.begin(), leftovers.end());
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = false;
+        for (auto& path : leftovers) {
+            m_pending.push_back(std::move(path));
+        }
+    }
+    m_worker = std::thread([this]() { Run(); });
+}
+
+void CLogCompressor::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+    }
+    m_cond.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+}
+
+void CLogCompressor::Enqueue(std::string pending_path) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.push_back(std::move(pending_path));
+    }
+    m_cond.notify_one();
+}
+
+void CLogCompressor::Run() {
+    LowerWorkerPriority();
+    for (;;) {
+        std::string path;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]() { return !m_pending.empty() || m_stopped; });
+            if (m_pending.empty()) {
+                break;
+            }
+            path = std::move(m_pending.front());
+            m_pending.pop_front();
+        }
+        Process(path);
+    }
+    Log(LogLevel::INFO, "Compressor", "Thread finished.");
+}
+
+void CLogCompressor::Process(const std::string& pending_path) {
+    const std::string suffix = CompressionSuffix(m_algo);
+    const fs::path base(m_base_path);
+    const std::string target = (base.parent_path() / (base.filename().string() + ".1" + suffix)).string();
+    const std::string staged = m_base_path + ".compressing" + suffix;
+
+    SCompressionResult result;
+    if (!CompressFile(pending_path, staged, m_algo, m_level, result)) {
+        Log(LogLevel::ERROR, "Compressor", "Failed to compress " + pending_path + ", left in place.");
+        return;
+    }
+
+    // The compressed copy is durable at this point, so it is safe to drop the oldest generation.
+    std::error_code ec;
+    ShiftRotatedLogs(m_base_path, m_max_files, suffix);
+    fs::rename(staged, target, ec);
+    if (ec) {
+        Log(LogLevel::ERROR, "Compressor", "Failed to publish " + target + ": " + ec.message());
+        return;
+    }
+    fs::remove(pending_path, ec);
+
+    const double ratio = result.output_bytes > 0
+        ? static_cast<double>(result.input_bytes) / static_cast<double>(result.output_bytes) : 0.0;
+    const double mb_per_sec = result.elapsed_ms > 0.0
+        ? (static_cast<double>(result.input_bytes) / (1024.0 * 1024.0)) / (result.elapsed_ms / 1000.0) : 0.0;
+    std::ostringstream oss;
+    oss << "Compressed " << pending_path << " -> " << target
+        << " in=" << result.input_bytes << "B out=" << result.output_bytes << "B"
+        << std::fixed << std::setprecision(2)
+        << " ratio=" << ratio << " throughput=" << mb_per_sec << "MB/s"
+        << " time=" << result.elapsed_ms << "ms";
+    Log(LogLevel::INFO, "Compressor", oss.str());
+}
+
+bool CLogCompressor::CompressFile(const std::string& src, const std::string& dst,
+                                  ECompression algo, int level, SCompressionResult& result) {
+    const auto started = std::chrono::steady_clock::now();
+    result = SCompressionResult{};
+
+    CFd in(::open(src.c_str(), O_RDONLY | O_CLOEXEC));
+    if (in.get() < 0) {
+        return false;
+    }
+    const std::string tmp = dst + ".tmp";
+    CFd out(::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+    if (out.get() < 0) {
+        return false;
+    }
+
+    bool ok = false;
+    switch (algo) {
+    case ECompression::Zlib:
+        ok = DeflateStream(in.get(), out.get(), level, result);
+        break;
+#ifdef CQG_HAVE_ZSTD
+    case ECompression::Zstd:
+        ok = ZstdStream(in.get(), out.get(), level, result);
+        break;
+#endif
+    default:
+        break;
+    }
+    ok = ok && ::fsync(out.get()) == 0;
+    ok = out.Close() && ok;
+
+    std::error_code ec;
+    if (ok) {
+        fs::rename(tmp, dst, ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        fs::remove(tmp, ec);
+    }
+    result.elapsed_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - started).count();
+    return ok;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+enum class ECompression { None, Zlib, Zstd };
+
+bool ParseCompression(std::string_view name, ECompression& out);
+bool CompressionAvailable(ECompression algo);
+bool IsValidCompressionLevel(ECompression algo, int level);
+// File suffix of a compressed generation: ".gz" for zlib, ".zst" for zstd.
+std::string CompressionSuffix(ECompression algo);
+
+struct SCompressionResult {
+    uint64_t input_bytes = 0;
+    uint64_t output_bytes = 0;
+    double elapsed_ms = 0.0;
+};
+
+// Background worker that takes rotated (detached) log files, stream-compresses
+// them next to the base file and only then shifts/prunes compressed generations.
+// The writer thread only pays for Enqueue(), which never touches the disk.
+class CLogCompressor {
+public:
+    CLogCompressor(ECompression algo, int level, std::string base_path, uint64_t max_files);
+    ~CLogCompressor();
+
+    CLogCompressor(const CLogCompressor&) = delete;
+    CLogCompressor& operator=(const CLogCompressor&) = delete;
+
+    // Starts the worker and picks up "<base>.pending.*" files left by a previous run.
+    void Start();
+    // Compresses everything still queued, then joins the worker.
+    void Stop();
+    void Enqueue(std::string pending_path);
+
+    // Compresses src into dst (written as dst + ".tmp" and renamed on success).
+    static bool CompressFile(const std::string& src, const std::string& dst,
+                             ECompression algo, int level, SCompressionResult& result);
+
+private:
+    void Run();
+    void Process(const std::string& pending_path);
+
+    const ECompression m_algo;
+    const int m_level;
+    const std::string m_base_path;
+    const uint64_t m_max_files;
+
+    std::deque<std::string> m_pending;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stopped{false};
+    std::thread m_worker;
+};
@@ -29,38 +29,79 @@ void Log(LogLevel level, std::string_view component, std::string_view message) {
     os << std::put_time(&tm, "[%Y-%m-%d %H:%M:%S]") << " [" << (level == LogLevel::INFO ? "INFO" : "ERROR") << "] [" << component << "] " << message << std::endl;
 }
 
-void RotateLogsIfNeeded(const std::string& path, uint64_t max_bytes, uint64_t max_files) {
+namespace {
+bool IsLogFull(const std::string& path, uint64_t max_bytes) {
     namespace fs = std::filesystem;
     std::error_code ec;
     if (!fs::exists(path, ec)) {
-        return;
+        return false;
     }
     const auto size = fs::file_size(path, ec);
-    if (ec || size < max_bytes) {
-        return;
-    }
+    return !ec && size >= max_bytes;
+}
+}
 
+void ShiftRotatedLogs(const std::string& path, uint64_t max_files, const std::string& suffix) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
     const fs::path base(path);
     const fs::path dir = base.parent_path();
     const std::string filename = base.filename().string();
 
     // Remove the oldest
-    fs::path oldest = dir / (filename + "." + std::to_string(max_files));
+    fs::path oldest = dir / (filename + "." + std::to_string(max_files) + suffix);
     if (fs::exists(oldest, ec)) {
         fs::remove(oldest, ec);
     }
 
     // Shift existing files
     for (uint64_t i = max_files; i > 1; --i) {
-        fs::path from = dir / (filename + "." + std::to_string(i - 1));
-        fs::path to = dir / (filename + "." + std::to_string(i));
+        fs::path from = dir / (filename + "." + std::to_string(i - 1) + suffix);
+        fs::path to = dir / (filename + "." + std::to_string(i) + suffix);
         if (fs::exists(from, ec)) {
             fs::rename(from, to, ec);
         }
     }
+}
+
+void RotateLogsIfNeeded(const std::string& path, uint64_t max_bytes, uint64_t max_files) {
+    if (IsLogFull(path, max_bytes)) {
+        RotateLogs(path, max_files);
+    }
+}
+
+void RotateLogs(const std::string& path, uint64_t max_files) {
+    namespace fs = std::filesystem;
+    ShiftRotatedLogs(path, max_files, "");
 
     // Rotate current
-    fs::path rotated = dir / (filename + ".1");
+    std::error_code ec;
+    const fs::path base(path);
+    fs::path rotated = base.parent_path() / (base.filename().string() + ".1");
     fs::rename(base, rotated, ec);
 }
 
+std::string DetachLogIfNeeded(const std::string& path, uint64_t max_bytes) {
+    if (!IsLogFull(path, max_bytes)) {
+        return {};
+    }
+    return DetachLog(path);
+}
+
+std::string DetachLog(const std::string& path) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    const uint64_t now_ms = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+    std::string pending = path + ".pending." + std::to_string(now_ms);
+    for (int i = 1; fs::exists(pending, ec); ++i) {
+        pending = path + ".pending." + std::to_string(now_ms) + "-" + std::to_string(i);
+    }
+    fs::rename(path, pending, ec);
+    if (ec) {
+        Log(LogLevel::ERROR, "Rotate", "Failed to detach " + path + ": " + ec.message());
+        return {};
+    }
+    return pending;
+}
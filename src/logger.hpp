@@ -13,3 +13,14 @@ void Log(LogLevel level, std::string_view component, std::string_view message);
 
 std::string FormatIsoUtc(uint64_t timestamp_ms);
 void RotateLogsIfNeeded(const std::string& path, uint64_t max_bytes, uint64_t max_files);
+// Unconditional variant for callers that track the file size themselves.
+void RotateLogs(const std::string& path, uint64_t max_files);
+
+// Renames a full log file to a unique "<path>.pending.<n>" name and returns it,
+// or returns an empty string if the file is still below max_bytes.
+// Generations are not shifted here; that is left to whoever consumes the pending file.
+std::string DetachLogIfNeeded(const std::string& path, uint64_t max_bytes);
+std::string DetachLog(const std::string& path);
+// Shifts "<path>.N<suffix>" generations up by one, dropping the ones beyond max_files,
+// so that "<path>.1<suffix>" is free afterwards.
+void ShiftRotatedLogs(const std::string& path, uint64_t max_files, const std::string& suffix);
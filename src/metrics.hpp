@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Optional per-window metrics, chosen at compile time on top of the core
+// statistics (trades, quantity, volume, min/max, buy/sell) that the output,
+// shm feed and history depend on. A metric is a policy class:
+//   struct State;                                            per symbol and window
+//   static void Add(State&, double price, double quantity);  on every trade
+//   template <typename TStats>
+//   static void Print(std::ostream&, const State&, const TStats& core);
+// CMetricSet folds over the list, so a build pays only for what it lists and
+// the trade loop has no per-metric switches.
+
+// Volume-weighted average price, derived from the core sums: no state, no per-trade work.
+struct SVwapMetric {
+    struct State {};
+    static void Add(State&, double, double) {}
+    template <typename TStats>
+    static void Print(std::ostream& os, const State&, const TStats& core) {
+        os << " vwap=" << std::setprecision(5) << (core.total_quantity > 0.0 ? core.total_volume / core.total_quantity : 0.0);
+    }
+};
+
+// Standard deviation of trade prices. Sums are taken relative to the first
+// price of the window, which keeps them small and avoids a division per trade.
+struct SPriceStddevMetric {
+    struct State {
+        uint64_t count = 0;
+        double shift = 0.0;
+        double sum = 0.0;
+        double sum_sq = 0.0;
+    };
+    static void Add(State& s, double price, double) {
+        if (s.count == 0) {
+            s.shift = price;
+        }
+        const double d = price - s.shift;
+        s.sum += d;
+        s.sum_sq += d * d;
+        ++s.count;
+    }
+    static double Value(const State& s) {
+        if (s.count == 0) {
+            return 0.0;
+        }
+        const double n = static_cast<double>(s.count);
+        return std::sqrt(std::max(0.0, (s.sum_sq - s.sum * s.sum / n) / n));
+    }
+    template <typename TStats>
+    static void Print(std::ostream& os, const State& s, const TStats&) {
+        os << " stddev=" << std::setprecision(5) << Value(s);
+    }
+};
+
+// Streaming price quantile with the P-square estimator (Jain & Chlamtac):
+// five markers, constant memory, no sorting after the first five trades.
+template <unsigned TPercent>
+struct SPriceQuantileMetric {
+    static_assert(TPercent > 0 && TPercent < 100, "quantile must be within (0, 100)");
+    static constexpr double kP = TPercent / 100.0;
+
+    struct State {
+        uint64_t count = 0;
+        double heights[5] = {};
+        double positions[5] = {1, 2, 3, 4, 5};
+        double desired[5] = {1, 1 + 2 * kP, 1 + 4 * kP, 3 + 2 * kP, 5};
+    };
+
+    static void Add(State& s, double x, double) {
+        if (s.count < 5) {
+            s.heights[s.count++] = x;
+            if (s.count == 5) {
+                std::sort(s.heights, s.heights + 5);
+            }
+            return;
+        }
+        int k = 0;
+        if (x < s.heights[0]) {
+            s.heights[0] = x;
+        } else if (x >= s.heights[4]) {
+            s.heights[4] = x;
+            k = 3;
+        } else {
+            while (x >= s.heights[k + 1]) {
+                ++k;
+            }
+        }
+        for (int i = k + 1; i < 5; ++i) {
+            s.positions[i] += 1.0;
+        }
+        static constexpr double kIncrements[5] = {0, kP / 2, kP, (1 + kP) / 2, 1};
+        for (int i = 0; i < 5; ++i) {
+            s.desired[i] += kIncrements[i];
+        }
+        ++s.count;
+        for (int i = 1; i < 4; ++i) {
+            const double d = s.desired[i] - s.positions[i];
+            if ((d >= 1.0 && s.positions[i + 1] - s.positions[i] > 1.0) ||
+                (d <= -1.0 && s.positions[i - 1] - s.positions[i] < -1.0)) {
+                const int step = d >= 0.0 ? 1 : -1;
+                const double candidate = Parabolic(s, i, step);
+                if (s.heights[i - 1] < candidate && candidate < s.heights[i + 1]) {
+                    s.heights[i] = candidate;
+                } else {
+                    s.heights[i] += step * (s.heights[i + step] - s.heights[i]) / (s.positions[i + step] - s.positions[i]);
+                }
+                s.positions[i] += step;
+            }
+        }
+    }
+
+    static double Value(const State& s) {
+        if (s.count >= 5) {
+            return s.heights[2];
+        }
+        if (s.count == 0) {
+            return 0.0;
+        }
+        // Exact on the first few trades.
+        double sorted[5];
+        std::copy(s.heights, s.heights + s.count, sorted);
+        std::sort(sorted, sorted + s.count);
+        return sorted[static_cast<size_t>(std::lround(kP * static_cast<double>(s.count - 1)))];
+    }
+
+    template <typename TStats>
+    static void Print(std::ostream& os, const State& s, const TStats&) {
+        os << " p" << TPercent << "=" << std::setprecision(2) << Value(s);
+    }
+
+private:
+    static double Parabolic(const State& s, int i, int step) {
+        const double* q = s.heights;
+        const double* n = s.positions;
+        return q[i] + step / (n[i + 1] - n[i - 1]) *
+                          ((n[i] - n[i - 1] + step) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                           (n[i + 1] - n[i] - step) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+    }
+};
+
+template <typename... TMetrics>
+class CMetricSet {
+public:
+    static constexpr size_t kSize = sizeof...(TMetrics);
+
+    void Add(double price, double quantity) { AddEach(price, quantity, std::index_sequence_for<TMetrics...>{}); }
+    template <typename TStats>
+    void Print(std::ostream& os, const TStats& core) const {
+        PrintEach(os, core, std::index_sequence_for<TMetrics...>{});
+    }
+    template <typename TMetric>
+    const typename TMetric::State& Get() const {
+        return std::get<IndexOf<TMetric>()>(m_states);
+    }
+
+private:
+    template <size_t... I>
+    void AddEach([[maybe_unused]] double price, [[maybe_unused]] double quantity, std::index_sequence<I...>) {
+        (TMetrics::Add(std::get<I>(m_states), price, quantity), ...);
+    }
+    template <typename TStats, size_t... I>
+    void PrintEach(std::ostream& os, const TStats& core, std::index_sequence<I...>) const {
+        (TMetrics::Print(os, std::get<I>(m_states), core), ...);
+    }
+    template <typename TMetric>
+    static constexpr size_t IndexOf() {
+        constexpr bool matches[] = {std::is_same_v<TMetric, TMetrics>..., false};
+        size_t index = 0;
+        while (index < kSize && !matches[index]) {
+            ++index;
+        }
+        return index;
+    }
+
+    std::tuple<typename TMetrics::State...> m_states;
+};
+
+// Metric sets the aggregator is instantiated with (see aggregator.cpp).
+using CMinimalMetrics = CMetricSet<>;
+using CFullMetrics = CMetricSet<SVwapMetric, SPriceStddevMetric, SPriceQuantileMetric<50>, SPriceQuantileMetric<99>>;
+
+// The set a deployment is built with: cmake -DCQG_METRICS=full.
+#if defined(CQG_METRICS_FULL)
+using CSelectedMetrics = CFullMetrics;
+#else
+using CSelectedMetrics = CMinimalMetrics;
+#endif
@@ -0,0 +1,357 @@
+#include "order_book.hpp"
+
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+
+namespace {
+std::vector<std::pair<double, double>> ParseLevels(const nlohmann::json& levels) {
+    std::vector<std::pair<double, double>> result;
+    result.reserve(levels.size());
+    for (const auto& level : levels) {
+        result.emplace_back(std::stod(level.at(0).get<std::string>()),
+                            std::stod(level.at(1).get<std::string>()));
+    }
+    return result;
+}
+
+std::string ToLower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+}
+
+SDepthUpdate SDepthUpdate::FromJson(const nlohmann::json& j) {
+    SDepthUpdate u;
+    u.symbol = j.at("s").get<std::string>();
+    u.event_time = j.at("E").get<uint64_t>();
+    u.first_update_id = j.at("U").get<uint64_t>();
+    u.final_update_id = j.at("u").get<uint64_t>();
+    u.bids = ParseLevels(j.at("b"));
+    u.asks = ParseLevels(j.at("a"));
+    return u;
+}
+
+SDepthSnapshot SDepthSnapshot::FromJson(const nlohmann::json& j) {
+    SDepthSnapshot s;
+    s.last_update_id = j.at("lastUpdateId").get<uint64_t>();
+    s.bids = ParseLevels(j.at("bids"));
+    s.asks = ParseLevels(j.at("asks"));
+    return s;
+}
+
+bool SDepthSnapshot::LoadFile(const std::string& path, SDepthSnapshot& out) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    try {
+        nlohmann::json j;
+        in >> j;
+        out = FromJson(j);
+        return true;
+    } catch (const std::exception& e) {
+        Log(LogLevel::ERROR, "Book", "Bad snapshot " + path + ": " + e.what());
+        return false;
+    }
+}
+
+CFlatOrderBook::CFlatOrderBook(double tick_size, uint32_t capacity_ticks)
+    : m_tick_size(tick_size),
+      m_capacity(capacity_ticks),
+      m_bids(capacity_ticks, 0.0),
+      m_asks(capacity_ticks, 0.0) {}
+
+void CFlatOrderBook::Clear() {
+    std::fill(m_bids.begin(), m_bids.end(), 0.0);
+    std::fill(m_asks.begin(), m_asks.end(), 0.0);
+    m_best_bid = m_best_ask = -1;
+    m_empty = true;
+}
+
+void CFlatOrderBook::ApplySnapshot(const SDepthSnapshot& snapshot) {
+    Clear();
+    // Centre the window on the snapshot's mid so both sides get half of it.
+    double anchor = 0.0;
+    if (!snapshot.bids.empty() && !snapshot.asks.empty()) {
+        anchor = (snapshot.bids.front().first + snapshot.asks.front().first) / 2.0;
+    } else if (!snapshot.bids.empty()) {
+        anchor = snapshot.bids.front().first;
+    } else if (!snapshot.asks.empty()) {
+        anchor = snapshot.asks.front().first;
+    } else {
+        return;
+    }
+    m_base = ToTick(anchor) - m_capacity / 2;
+    m_empty = false;
+    for (const auto& level : snapshot.bids) {
+        Set(true, level.first, level.second);
+    }
+    for (const auto& level : snapshot.asks) {
+        Set(false, level.first, level.second);
+    }
+}
+
+int64_t CFlatOrderBook::ToTick(double price) const {
+    return static_cast<int64_t>(std::llround(price / m_tick_size));
+}
+
+bool CFlatOrderBook::EnsureInRange(int64_t tick) {
+    if (m_empty) {
+        m_base = tick - m_capacity / 2;
+        m_empty = false;
+        return true;
+    }
+    const int64_t index = tick - m_base;
+    if (index >= 0 && index < m_capacity) {
+        return true;
+    }
+    int64_t centre = tick;
+    if (HasTop()) {
+        centre = m_base + (m_best_bid + m_best_ask) / 2;
+    } else if (m_best_bid >= 0) {
+        centre = m_base + m_best_bid;
+    } else if (m_best_ask >= 0) {
+        centre = m_base + m_best_ask;
+    }
+    if (std::llabs(tick - centre) >= m_capacity / 2) {
+        return false;
+    }
+    Recenter(centre - m_capacity / 2);
+    return true;
+}
+
+void CFlatOrderBook::Recenter(int64_t new_base) {
+    const int64_t shift = new_base - m_base;
+    for (auto* side : {&m_bids, &m_asks}) {
+        auto& v = *side;
+        if (std::llabs(shift) >= m_capacity) {
+            std::fill(v.begin(), v.end(), 0.0);
+        } else if (shift > 0) {
+            std::move(v.begin() + shift, v.end(), v.begin());
+            std::fill(v.end() - shift, v.end(), 0.0);
+        } else if (shift < 0) {
+            std::move_backward(v.begin(), v.end() + shift, v.end());
+            std::fill(v.begin(), v.begin() - shift, 0.0);
+        }
+    }
+    m_base = new_base;
+    RescanBest();
+}
+
+void CFlatOrderBook::RescanBest() {
+    m_best_bid = -1;
+    for (int64_t i = m_capacity - 1; i >= 0; --i) {
+        if (m_bids[i] > 0.0) {
+            m_best_bid = i;
+            break;
+        }
+    }
+    m_best_ask = -1;
+    for (int64_t i = 0; i < m_capacity; ++i) {
+        if (m_asks[i] > 0.0) {
+            m_best_ask = i;
+            break;
+        }
+    }
+}
+
+void CFlatOrderBook::Set(bool is_bid, double price, double quantity) {
+    const int64_t tick = ToTick(price);
+    const bool outside = m_empty || tick - m_base < 0 || tick - m_base >= m_capacity;
+    if (outside && quantity <= 0.0) {
+        return;  // removing a level we never stored
+    }
+    if (!EnsureInRange(tick)) {
+        return;
+    }
+    const int64_t index = tick - m_base;
+    if (is_bid) {
+        m_bids[index] = quantity;
+        if (quantity > 0.0) {
+            m_best_bid = std::max(m_best_bid, index);
+        } else if (index == m_best_bid) {
+            while (m_best_bid >= 0 && m_bids[m_best_bid] <= 0.0) {
+                --m_best_bid;
+            }
+        }
+    } else {
+        m_asks[index] = quantity;
+        if (quantity > 0.0) {
+            if (m_best_ask < 0 || index < m_best_ask) {
+                m_best_ask = index;
+            }
+        } else if (index == m_best_ask) {
+            while (m_best_ask < m_capacity && m_asks[m_best_ask] <= 0.0) {
+                ++m_best_ask;
+            }
+            if (m_best_ask == m_capacity) {
+                m_best_ask = -1;
+            }
+        }
+    }
+}
+
+double CFlatOrderBook::BestBid() const {
+    return m_best_bid >= 0 ? static_cast<double>(m_base + m_best_bid) * m_tick_size : 0.0;
+}
+
+double CFlatOrderBook::BestAsk() const {
+    return m_best_ask >= 0 ? static_cast<double>(m_base + m_best_ask) * m_tick_size : 0.0;
+}
+
+double CFlatOrderBook::Depth(bool is_bid, uint32_t levels) const {
+    double total = 0.0;
+    uint32_t seen = 0;
+    if (is_bid) {
+        for (int64_t i = m_best_bid; i >= 0 && seen < levels; --i) {
+            if (m_bids[i] > 0.0) {
+                total += m_bids[i];
+                ++seen;
+            }
+        }
+    } else if (m_best_ask >= 0) {
+        for (int64_t i = m_best_ask; i < m_capacity && seen < levels; ++i) {
+            if (m_asks[i] > 0.0) {
+                total += m_asks[i];
+                ++seen;
+            }
+        }
+    }
+    return total;
+}
+
+size_t CFlatOrderBook::LevelCount(bool is_bid) const {
+    const auto& side = is_bid ? m_bids : m_asks;
+    return static_cast<size_t>(std::count_if(side.begin(), side.end(), [](double q) { return q > 0.0; }));
+}
+
+CBookManager::CBookManager(const SBookConfig& cfg, SnapshotProvider provider, SampleSink sink)
+    : m_cfg(cfg), m_provider(std::move(provider)), m_sink(std::move(sink)) {}
+
+CBookManager::SnapshotProvider CBookManager::FileSnapshotProvider(std::string dir) {
+    return [dir = std::move(dir)](const std::string& symbol, SDepthSnapshot& out) {
+        std::string name = symbol;
+        std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+        return SDepthSnapshot::LoadFile(dir + "/" + name + ".json", out);
+    };
+}
+
+CBookManager::SSymbolBook& CBookManager::GetBook(const std::string& symbol) {
+    auto it = m_books.find(symbol);
+    if (it == m_books.end()) {
+        double tick = m_cfg.tick_size;
+        auto tick_it = m_cfg.tick_sizes.find(ToLower(symbol));
+        if (tick_it != m_cfg.tick_sizes.end()) {
+            tick = tick_it->second;
+        }
+        it = m_books.emplace(symbol, SSymbolBook(CFlatOrderBook(tick, m_cfg.capacity_ticks))).first;
+    }
+    return it->second;
+}
+
+void CBookManager::OnDepthUpdate(SDepthUpdate update) {
+    const std::string symbol = update.symbol;
+    auto& state = GetBook(symbol);
+    if (state.synced) {
+        Apply(symbol, state, update);
+        return;
+    }
+    state.pending.push_back(std::move(update));
+    if (state.pending.size() > m_cfg.max_pending) {
+        state.pending.erase(state.pending.begin());
+    }
+    TrySync(symbol, state);
+}
+
+void CBookManager::Reset() {
+    for (auto& entry : m_books) {
+        entry.second.synced = false;
+        entry.second.pending.clear();
+        entry.second.book.Clear();
+        entry.second.next_snapshot_attempt = {};
+    }
+}
+
+bool CBookManager::IsSynced(const std::string& symbol) const {
+    auto it = m_books.find(symbol);
+    return it != m_books.end() && it->second.synced;
+}
+
+bool CBookManager::IsAhead(const SDepthUpdate& update) const {
+    auto it = m_books.find(update.symbol);
+    return it != m_books.end() && it->second.synced && update.first_update_id > it->second.last_update_id + 1;
+}
+
+const CFlatOrderBook* CBookManager::Book(const std::string& symbol) const {
+    auto it = m_books.find(symbol);
+    return it == m_books.end() ? nullptr : &it->second.book;
+}
+
+void CBookManager::TrySync(const std::string& symbol, SSymbolBook& state) {
+    const auto now = std::chrono::steady_clock::now();
+    if (!m_provider || now < state.next_snapshot_attempt) {
+        return;
+    }
+    state.next_snapshot_attempt = now + std::chrono::seconds(1);
+    SDepthSnapshot snapshot;
+    if (!m_provider(symbol, snapshot)) {
+        return;
+    }
+    state.book.ApplySnapshot(snapshot);
+    state.synced = true;
+    state.first_after_snapshot = true;
+    state.last_update_id = snapshot.last_update_id;
+
+    auto pending = std::move(state.pending);
+    state.pending.clear();
+    for (size_t i = 0; i < pending.size(); ++i) {
+        if (!Apply(symbol, state, pending[i])) {
+            // Snapshot did not line up; keep the rest buffered for the next attempt.
+            std::move(pending.begin() + static_cast<std::ptrdiff_t>(i) + 1, pending.end(),
+                      std::back_inserter(state.pending));
+            return;
+        }
+    }
+    Log(LogLevel::INFO, "Book", symbol + " synced at update " + std::to_string(state.last_update_id));
+}
+
+bool CBookManager::Apply(const std::string& symbol, SSymbolBook& state, SDepthUpdate& update) {
+    if (update.final_update_id <= state.last_update_id) {
+        return true;  // already contained in the snapshot
+    }
+    const bool in_sequence = state.first_after_snapshot
+        ? update.first_update_id <= state.last_update_id + 1
+        : update.first_update_id == state.last_update_id + 1;
+    if (!in_sequence) {
+        Log(LogLevel::ERROR, "Book", symbol + " sequence gap at " + std::to_string(update.first_update_id) +
+            " (expected " + std::to_string(state.last_update_id + 1) + "), resyncing");
+        state.synced = false;
+        state.book.Clear();
+        state.pending.clear();
+        state.pending.push_back(std::move(update));
+        return false;
+    }
+    for (const auto& level : update.bids) {
+        state.book.Set(true, level.first, level.second);
+    }
+    for (const auto& level : update.asks) {
+        state.book.Set(false, level.first, level.second);
+    }
+    state.last_update_id = update.final_update_id;
+    state.first_after_snapshot = false;
+
+    if (m_sink && state.book.HasTop()) {
+        SBookSample sample;
+        sample.best_bid = state.book.BestBid();
+        sample.best_ask = state.book.BestAsk();
+        sample.bid_depth = state.book.Depth(true, m_cfg.levels);
+        sample.ask_depth = state.book.Depth(false, m_cfg.levels);
+        m_sink(symbol, update.event_time, sample);
+    }
+    return true;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "config.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// Binance diff-depth event ("e":"depthUpdate"); levels are (price, quantity),
+// quantity 0 removes the level.
+struct SDepthUpdate {
+    std::string symbol;
+    uint64_t event_time = 0;
+    uint64_t first_update_id = 0;  // U
+    uint64_t final_update_id = 0;  // u
+    std::vector<std::pair<double, double>> bids;
+    std::vector<std::pair<double, double>> asks;
+
+    static SDepthUpdate FromJson(const nlohmann::json& j);
+};
+
+// REST /api/v3/depth response, or a local file with the same layout.
+struct SDepthSnapshot {
+    uint64_t last_update_id = 0;
+    std::vector<std::pair<double, double>> bids;
+    std::vector<std::pair<double, double>> asks;
+
+    static SDepthSnapshot FromJson(const nlohmann::json& j);
+    static bool LoadFile(const std::string& path, SDepthSnapshot& out);
+};
+
+// Price-indexed book: one contiguous quantity array per side covering
+// capacity ticks around the mid price, index = price / tick_size - base.
+// Levels that fall outside the window after re-centring are dropped; they
+// are too far from the top to matter for top-of-book and depth-at-N.
+class CFlatOrderBook {
+public:
+    CFlatOrderBook(double tick_size, uint32_t capacity_ticks);
+
+    void Clear();
+    void ApplySnapshot(const SDepthSnapshot& snapshot);
+    void Set(bool is_bid, double price, double quantity);
+
+    bool HasTop() const { return m_best_bid >= 0 && m_best_ask >= 0; }
+    double BestBid() const;
+    double BestAsk() const;
+    // Quantity summed over the best `levels` non-empty levels of one side.
+    double Depth(bool is_bid, uint32_t levels) const;
+    size_t LevelCount(bool is_bid) const;
+
+private:
+    int64_t ToTick(double price) const;
+    bool EnsureInRange(int64_t tick);
+    void Recenter(int64_t new_base);
+    void RescanBest();
+
+    const double m_tick_size;
+    const int64_t m_capacity;
+    int64_t m_base = 0;
+    bool m_empty = true;
+    std::vector<double> m_bids;
+    std::vector<double> m_asks;
+    int64_t m_best_bid = -1;  // array index, -1 when the side is empty
+    int64_t m_best_ask = -1;
+};
+
+struct SBookSample {
+    double best_bid = 0.0;
+    double best_ask = 0.0;
+    double bid_depth = 0.0;
+    double ask_depth = 0.0;
+};
+
+// Keeps one CFlatOrderBook per symbol in sync with Binance's snapshot+diff
+// rules and reports a sample after every applied update. Runs on the io thread.
+class CBookManager {
+public:
+    using SnapshotProvider = std::function<bool(const std::string& symbol, SDepthSnapshot& out)>;
+    using SampleSink = std::function<void(const std::string& symbol, uint64_t timestamp_ms, const SBookSample& sample)>;
+
+    CBookManager(const SBookConfig& cfg, SnapshotProvider provider, SampleSink sink);
+
+    void OnDepthUpdate(SDepthUpdate update);
+    // Drops sync state, e.g. after a reconnect; books resync from a fresh snapshot.
+    void Reset();
+
+    bool IsSynced(const std::string& symbol) const;
+    // True if the update would leave a gap in a synced book. During a
+    // connection rotation it comes from the connection that is ahead, and
+    // the other one will deliver the diffs in between.
+    bool IsAhead(const SDepthUpdate& update) const;
+    const CFlatOrderBook* Book(const std::string& symbol) const;
+
+    // Snapshot provider reading "<dir>/<SYMBOL>.json".
+    static SnapshotProvider FileSnapshotProvider(std::string dir);
+
+private:
+    struct SSymbolBook {
+        explicit SSymbolBook(CFlatOrderBook b) : book(std::move(b)) {}
+        CFlatOrderBook book;
+        bool synced = false;
+        bool first_after_snapshot = false;
+        uint64_t last_update_id = 0;
+        std::vector<SDepthUpdate> pending;
+        std::chrono::steady_clock::time_point next_snapshot_attempt{};
+    };
+
+    SSymbolBook& GetBook(const std::string& symbol);
+    void TrySync(const std::string& symbol, SSymbolBook& state);
+    // Returns false on a sequence gap, after which the book is unsynced.
+    bool Apply(const std::string& symbol, SSymbolBook& state, SDepthUpdate& update);
+
+    SBookConfig m_cfg;
+    SnapshotProvider m_provider;
+    SampleSink m_sink;
+    std::unordered_map<std::string, SSymbolBook> m_books;
+};
@@ -0,0 +1,154 @@
+#include "output_file.hpp"
+
+#include "logger.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool ParseOutputBackend(std::string_view name, EOutputBackend& out) {
+    if (name == "stream") {
+        out = EOutputBackend::Stream;
+    } else if (name == "uring") {
+        out = EOutputBackend::Uring;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+COutputFile::COutputFile(EOutputBackend backend, std::string path, uint64_t max_bytes, uint64_t max_files,
+                         bool preallocate, CLogCompressor* compressor)
+    : m_backend(backend),
+      m_path(std::move(path)),
+      m_max_bytes(max_bytes),
+      m_max_files(max_files),
+      m_preallocate(preallocate),
+      m_compressor(compressor) {
+    if (m_backend == EOutputBackend::Uring) {
+        m_uring = std::make_unique<CIoUring>();
+        if (m_uring->Init(8)) {
+            Log(LogLevel::INFO, "Writer", "Output backend: io_uring.");
+        } else {
+            m_uring.reset();
+            Log(LogLevel::INFO, "Writer", "io_uring unavailable, using pwrite.");
+        }
+    }
+}
+
+COutputFile::~COutputFile() {
+    CloseDirect();
+}
+
+bool COutputFile::Write(std::string_view data) {
+    return m_backend == EOutputBackend::Uring ? WriteDirect(data) : WriteStream(data);
+}
+
+bool COutputFile::WriteStream(std::string_view data) {
+    if (m_compressor) {
+        // Only a rename happens here; compression and pruning run on the compressor thread.
+        auto detached = DetachLogIfNeeded(m_path, m_max_bytes);
+        if (!detached.empty()) {
+            m_compressor->Enqueue(std::move(detached));
+        }
+    } else {
+        RotateLogsIfNeeded(m_path, m_max_bytes, m_max_files);
+    }
+
+    std::ofstream out(m_path, std::ios::app);
+    if (!out) {
+        Log(LogLevel::ERROR, "Writer", "Failed to open output file: " + m_path);
+        return false;
+    }
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+bool COutputFile::WriteDirect(std::string_view data) {
+    if (m_fd < 0 && !OpenDirect()) {
+        return false;
+    }
+    if (m_size >= m_max_bytes) {
+        Rotate();
+        if (m_fd < 0) {
+            return false;
+        }
+    }
+
+    const char* ptr = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        int64_t n = 0;
+        if (m_uring) {
+            n = m_uring->Write(m_fd, ptr, left, m_size);
+            if (n == -EINVAL || n == -EOPNOTSUPP || n == -ENOSYS) {
+                // Kernel without IORING_OP_WRITE: stay on pwrite from now on.
+                m_uring.reset();
+                Log(LogLevel::INFO, "Writer", "io_uring write unsupported, using pwrite.");
+                continue;
+            }
+        } else {
+            n = ::pwrite(m_fd, ptr, left, static_cast<off_t>(m_size));
+            if (n < 0) {
+                n = -errno;
+            }
+        }
+        if (n == -EINTR || n == -EAGAIN) {
+            continue;
+        }
+        if (n <= 0) {
+            Log(LogLevel::ERROR, "Writer", "Write to " + m_path + " failed: " + std::strerror(static_cast<int>(-n)));
+            return false;
+        }
+        ptr += n;
+        left -= static_cast<size_t>(n);
+        m_size += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+bool COutputFile::OpenDirect() {
+    m_fd = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        Log(LogLevel::ERROR, "Writer", "Failed to open output file: " + m_path);
+        return false;
+    }
+    // The only stat of the file's life; afterwards the size is tracked in memory.
+    struct stat st {};
+    m_size = (::fstat(m_fd, &st) == 0) ? static_cast<uint64_t>(st.st_size) : 0;
+    if (m_preallocate && m_size < m_max_bytes) {
+        // KEEP_SIZE reserves the blocks without moving EOF, so readers never see a zero-filled tail.
+        ::fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(m_max_bytes));
+    }
+    return true;
+}
+
+void COutputFile::CloseDirect() {
+    if (m_fd < 0) {
+        return;
+    }
+    if (m_preallocate) {
+        // Give back the preallocated blocks past the data.
+        ::ftruncate(m_fd, static_cast<off_t>(m_size));
+    }
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+void COutputFile::Rotate() {
+    CloseDirect();
+    if (m_compressor) {
+        auto detached = DetachLog(m_path);
+        if (!detached.empty()) {
+            m_compressor->Enqueue(std::move(detached));
+        }
+    } else {
+        RotateLogs(m_path, m_max_files);
+    }
+    OpenDirect();
+}
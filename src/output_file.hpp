@@ -0,0 +1,53 @@
+#pragma once
+
+#include "io_uring.hpp"
+#include "log_compressor.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// stream: std::ofstream reopened per flush, size checked with stat before every write.
+// uring:  fd kept open, file preallocated to max_file_mb, size tracked in memory and
+//         writes submitted through io_uring (pwrite if io_uring is unavailable).
+enum class EOutputBackend { Stream, Uring };
+
+bool ParseOutputBackend(std::string_view name, EOutputBackend& out);
+
+// Output file with size-based rotation. Rotated files are either shifted to
+// "<path>.N" or, when a compressor is given, detached and handed to it.
+class COutputFile {
+public:
+    COutputFile(EOutputBackend backend, std::string path, uint64_t max_bytes, uint64_t max_files,
+                bool preallocate, CLogCompressor* compressor);
+    ~COutputFile();
+
+    COutputFile(const COutputFile&) = delete;
+    COutputFile& operator=(const COutputFile&) = delete;
+
+    bool Write(std::string_view data);
+
+    EOutputBackend Backend() const { return m_backend; }
+    bool UsingIoUring() const { return m_uring && m_uring->IsReady(); }
+    // Logical size of the current file as tracked by the uring backend.
+    uint64_t Size() const { return m_size; }
+
+private:
+    bool WriteStream(std::string_view data);
+    bool WriteDirect(std::string_view data);
+    bool OpenDirect();
+    void CloseDirect();
+    void Rotate();
+
+    const EOutputBackend m_backend;
+    const std::string m_path;
+    const uint64_t m_max_bytes;
+    const uint64_t m_max_files;
+    const bool m_preallocate;
+    CLogCompressor* m_compressor;
+
+    std::unique_ptr<CIoUring> m_uring;
+    int m_fd = -1;
+    uint64_t m_size = 0;
+};
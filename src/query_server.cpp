@@ -0,0 +1,204 @@
+#include "query_server.hpp"
+
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <sstream>
+
+#include <nlohmann/json.hpp>
+
+#include <unistd.h>
+
+namespace net = boost::asio;
+using local_stream = net::local::stream_protocol;
+
+namespace {
+constexpr size_t kMaxRequestBytes = 4096;
+
+uint64_t NowMs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// Request bytes are echoed back (command, symbol) and need not be UTF-8:
+// replace what is invalid rather than throw on the io thread.
+std::string Dump(const nlohmann::json& reply) {
+    return reply.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+nlohmann::json AggregateToJson(const std::string& symbol, uint64_t from_ms, uint64_t to_ms,
+                               const SSeriesAggregate& agg) {
+    return {
+        {"symbol", symbol},
+        {"from", from_ms},
+        {"to", to_ms},
+        {"windows", agg.windows},
+        {"trades", agg.trades_count},
+        {"quantity", agg.total_quantity},
+        {"volume", agg.total_volume},
+        {"vwap", agg.total_quantity > 0.0 ? agg.total_volume / agg.total_quantity : 0.0},
+        {"min", agg.min_price},
+        {"max", agg.max_price},
+        {"buy", agg.buy_count},
+        {"sell", agg.sell_count},
+    };
+}
+
+class CQuerySession : public std::enable_shared_from_this<CQuerySession> {
+public:
+    CQuerySession(local_stream::socket socket, std::shared_ptr<const CSeriesStore> store)
+        : m_socket(std::move(socket)), m_buffer(kMaxRequestBytes), m_store(std::move(store)) {}
+
+    void Start() { DoRead(); }
+
+private:
+    void DoRead() {
+        net::async_read_until(m_socket, m_buffer, '\n',
+            [self = shared_from_this()](const boost::system::error_code& ec, std::size_t bytes) {
+                self->OnRead(ec, bytes);
+            });
+    }
+
+    void OnRead(const boost::system::error_code& ec, std::size_t bytes) {
+        if (ec) {
+            return;  // peer closed, or the request line exceeded kMaxRequestBytes
+        }
+        std::string line(net::buffers_begin(m_buffer.data()), net::buffers_begin(m_buffer.data()) + bytes);
+        m_buffer.consume(bytes);
+        try {
+            m_reply = CQueryServer::HandleRequest(*m_store, line);
+        } catch (const std::exception& e) {
+            // A bad request must not reach m_ioc.run(): that would reset the market data connection.
+            m_reply = Dump(nlohmann::json{{"error", std::string("bad request: ") + e.what()}});
+        }
+        m_reply.push_back('\n');
+        net::async_write(m_socket, net::buffer(m_reply),
+            [self = shared_from_this()](const boost::system::error_code& write_ec, std::size_t) {
+                if (!write_ec) {
+                    self->DoRead();
+                }
+            });
+    }
+
+    local_stream::socket m_socket;
+    net::streambuf m_buffer;
+    std::string m_reply;
+    std::shared_ptr<const CSeriesStore> m_store;
+};
+}
+
+CQueryServer::CQueryServer(net::io_context& ioc, std::string socket_path, std::shared_ptr<const CSeriesStore> store)
+    : m_acceptor(ioc), m_socket_path(std::move(socket_path)), m_store(std::move(store)) {}
+
+CQueryServer::~CQueryServer() {
+    Stop();
+}
+
+bool CQueryServer::Start() {
+    ::unlink(m_socket_path.c_str());
+    boost::system::error_code ec;
+    const local_stream::endpoint endpoint(m_socket_path);
+    m_acceptor.open(endpoint.protocol(), ec);
+    if (!ec) {
+        m_acceptor.bind(endpoint, ec);
+    }
+    if (!ec) {
+        m_acceptor.listen(net::socket_base::max_listen_connections, ec);
+    }
+    if (ec) {
+        Log(LogLevel::ERROR, "Query", "Cannot listen on " + m_socket_path + ": " + ec.message());
+        m_acceptor.close(ec);
+        return false;
+    }
+    Log(LogLevel::INFO, "Query", "Listening on " + m_socket_path);
+    DoAccept();
+    return true;
+}
+
+void CQueryServer::Stop() {
+    if (!m_acceptor.is_open()) {
+        return;
+    }
+    boost::system::error_code ec;
+    m_acceptor.close(ec);
+    ::unlink(m_socket_path.c_str());
+}
+
+void CQueryServer::DoAccept() {
+    m_acceptor.async_accept([this](const boost::system::error_code& ec, local_stream::socket socket) {
+        if (ec == net::error::operation_aborted || !m_acceptor.is_open()) {
+            return;
+        }
+        if (!ec) {
+            std::make_shared<CQuerySession>(std::move(socket), m_store)->Start();
+        }
+        DoAccept();
+    });
+}
+
+std::string CQueryServer::HandleRequest(const CSeriesStore& store, const std::string& line) {
+    const auto started = std::chrono::steady_clock::now();
+    std::istringstream in(line);
+    std::string command;
+    std::string symbol;
+    in >> command >> symbol;
+    // Through unsigned char: bytes above 0x7f are negative chars, undefined for toupper.
+    const auto upper = [](unsigned char c) { return static_cast<char>(std::toupper(c)); };
+    std::transform(command.begin(), command.end(), command.begin(), upper);
+    std::transform(symbol.begin(), symbol.end(), symbol.begin(), upper);
+
+    nlohmann::json reply;
+    if (command == "SYMBOLS") {
+        reply = {{"symbols", store.Symbols()}};
+    } else if (command == "RANGE" || command == "AGG") {
+        uint64_t from_ms = 0;
+        uint64_t to_ms = 0;
+        if (!(in >> from_ms >> to_ms)) {
+            return Dump(nlohmann::json{{"error", "usage: " + command + " <symbol> <from_ms> <to_ms>"}});
+        }
+        if (command == "AGG") {
+            reply = AggregateToJson(symbol, from_ms, to_ms, store.Aggregate(symbol, from_ms, to_ms));
+        } else {
+            auto windows = nlohmann::json::array();
+            for (const auto& p : store.Range(symbol, from_ms, to_ms)) {
+                windows.push_back({
+                    {"t", p.window_start},
+                    {"trades", p.trades_count},
+                    {"quantity", p.total_quantity},
+                    {"volume", p.total_volume},
+                    {"min", p.min_price},
+                    {"max", p.max_price},
+                    {"buy", p.buy_count},
+                    {"sell", p.sell_count},
+                });
+            }
+            reply = {{"symbol", symbol}, {"windows", std::move(windows)}};
+        }
+    } else if (command == "LAST") {
+        uint64_t duration_ms = 0;
+        if (!(in >> duration_ms)) {
+            return Dump(nlohmann::json{{"error", "usage: LAST <symbol> <duration_ms>"}});
+        }
+        const uint64_t to_ms = NowMs();
+        const uint64_t from_ms = to_ms > duration_ms ? to_ms - duration_ms : 0;
+        reply = AggregateToJson(symbol, from_ms, to_ms, store.Aggregate(symbol, from_ms, to_ms));
+    } else if (command == "STATS") {
+        const auto usage = store.MemoryUsage();
+        reply = {
+            {"symbols", usage.symbols},
+            {"hot_windows", usage.hot_windows},
+            {"hot_bytes", usage.hot_bytes},
+            {"archived_windows", usage.archived_windows},
+            {"archived_bytes", usage.archived_bytes},
+            {"archived_bytes_per_window",
+             usage.archived_windows > 0 ? static_cast<double>(usage.archived_bytes) / usage.archived_windows : 0.0},
+        };
+    } else {
+        return Dump(nlohmann::json{{"error", "unknown command: " + command}});
+    }
+    reply["elapsed_us"] = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    return Dump(reply);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "series_store.hpp"
+
+#include <memory>
+#include <string>
+
+#include <boost/asio.hpp>
+
+// Line-oriented query API over a Unix domain socket, served from the
+// service's io_context. One request per line, one JSON object per reply line:
+//   SYMBOLS
+//   RANGE <symbol> <from_ms> <to_ms>   windows starting in [from, to)
+//   AGG <symbol> <from_ms> <to_ms>     statistics combined over [from, to)
+//   LAST <symbol> <duration_ms>        AGG over the last duration_ms
+//   STATS                              memory used by the ring and the compressed tier
+// Errors come back as {"error": "..."}.
+class CQueryServer {
+public:
+    CQueryServer(boost::asio::io_context& ioc, std::string socket_path, std::shared_ptr<const CSeriesStore> store);
+    ~CQueryServer();
+
+    // Replaces a stale socket file, binds and starts accepting. Logs and returns false on failure.
+    bool Start();
+    void Stop();
+
+    static std::string HandleRequest(const CSeriesStore& store, const std::string& line);
+
+private:
+    void DoAccept();
+
+    boost::asio::local::stream_protocol::acceptor m_acceptor;
+    std::string m_socket_path;
+    std::shared_ptr<const CSeriesStore> m_store;
+};
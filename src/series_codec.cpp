@@ -0,0 +1,326 @@
+#include "series_codec.hpp"
+
+#include <cstring>
+#include <fstream>
+
+namespace {
+constexpr uint32_t kChunkMagic = 0x43514743;  // "CGQC"
+
+uint64_t ZigZag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+int64_t UnZigZag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+uint64_t DoubleBits(double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+double BitsDouble(uint64_t bits) {
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+// Delta-of-delta buckets: control prefix and payload width.
+struct SDodBucket {
+    uint64_t prefix;
+    unsigned prefix_bits;
+    unsigned payload_bits;
+};
+constexpr SDodBucket kDodBuckets[] = {
+    {0b10, 2, 7},
+    {0b110, 3, 9},
+    {0b1110, 4, 12},
+    {0b1111, 4, 64},
+};
+}
+
+void CBitWriter::Write(uint64_t value, unsigned bits) {
+    while (bits > 0) {
+        const unsigned used = static_cast<unsigned>(m_bits % 8);
+        if (used == 0) {
+            m_bytes.push_back(0);
+        }
+        const unsigned room = 8 - used;
+        const unsigned take = bits < room ? bits : room;
+        const uint64_t chunk = (value >> (bits - take)) & ((1u << take) - 1);
+        m_bytes.back() |= static_cast<uint8_t>(chunk << (room - take));
+        m_bits += take;
+        bits -= take;
+    }
+}
+
+void CBitWriter::Clear() {
+    m_bytes.clear();
+    m_bits = 0;
+}
+
+bool CBitReader::Read(unsigned bits, uint64_t& out) {
+    if (m_pos + bits > m_bits) {
+        return false;
+    }
+    out = 0;
+    while (bits > 0) {
+        const unsigned used = static_cast<unsigned>(m_pos % 8);
+        const unsigned room = 8 - used;
+        const unsigned take = bits < room ? bits : room;
+        const uint8_t byte = m_data[m_pos / 8];
+        const uint64_t chunk = (byte >> (room - take)) & ((1u << take) - 1);
+        out = (out << take) | chunk;
+        m_pos += take;
+        bits -= take;
+    }
+    return true;
+}
+
+bool CBitReader::ReadBit(bool& out) {
+    uint64_t v = 0;
+    if (!Read(1, v)) {
+        return false;
+    }
+    out = v != 0;
+    return true;
+}
+
+void CSeriesEncoder::WriteDouble(SXorState& state, double value) {
+    const uint64_t bits = DoubleBits(value);
+    const uint64_t x = bits ^ state.prev;
+    state.prev = bits;
+    if (x == 0) {
+        m_writer.WriteBit(false);
+        return;
+    }
+    m_writer.WriteBit(true);
+    unsigned leading = static_cast<unsigned>(__builtin_clzll(x));
+    const unsigned trailing = static_cast<unsigned>(__builtin_ctzll(x));
+    if (leading > 31) {
+        leading = 31;
+    }
+    if (state.leading != 0xff && leading >= state.leading && trailing >= state.trailing) {
+        // Meaningful bits fit in the previous window.
+        m_writer.WriteBit(false);
+        m_writer.Write(x >> state.trailing, 64 - state.leading - state.trailing);
+        return;
+    }
+    const unsigned meaningful = 64 - leading - trailing;
+    m_writer.WriteBit(true);
+    m_writer.Write(leading, 5);
+    m_writer.Write(meaningful == 64 ? 0 : meaningful, 6);
+    m_writer.Write(x >> trailing, meaningful);
+    state.leading = leading;
+    state.trailing = trailing;
+}
+
+void CSeriesEncoder::WriteVarint(uint64_t value) {
+    do {
+        const uint64_t group = value & 0x7f;
+        value >>= 7;
+        m_writer.Write((value != 0 ? 0x80 : 0) | group, 8);
+    } while (value != 0);
+}
+
+void CSeriesEncoder::Append(const SSeriesPoint& point) {
+    if (m_count == 0) {
+        m_first_window_start = point.window_start;
+        m_writer.Write(point.window_start, 64);
+    } else {
+        const int64_t delta = static_cast<int64_t>(point.window_start - m_last_window_start);
+        const uint64_t dod = ZigZag(delta - m_prev_delta);
+        m_prev_delta = delta;
+        if (dod == 0) {
+            m_writer.WriteBit(false);
+        } else {
+            for (const auto& bucket : kDodBuckets) {
+                if (bucket.payload_bits == 64 || dod < (1ull << bucket.payload_bits)) {
+                    m_writer.Write(bucket.prefix, bucket.prefix_bits);
+                    m_writer.Write(dod, bucket.payload_bits);
+                    break;
+                }
+            }
+        }
+    }
+    m_last_window_start = point.window_start;
+
+    WriteVarint(point.trades_count);
+    WriteVarint(point.buy_count);
+    const bool sell_implied = point.buy_count <= point.trades_count &&
+                              point.sell_count == point.trades_count - point.buy_count;
+    m_writer.WriteBit(!sell_implied);
+    if (!sell_implied) {
+        WriteVarint(point.sell_count);
+    }
+    WriteDouble(m_quantity, point.total_quantity);
+    WriteDouble(m_volume, point.total_volume);
+    WriteDouble(m_min, point.min_price);
+    WriteDouble(m_max, point.max_price);
+    ++m_count;
+}
+
+SSeriesChunk CSeriesEncoder::Seal() {
+    SSeriesChunk chunk;
+    chunk.first_window_start = m_first_window_start;
+    chunk.last_window_start = m_last_window_start;
+    chunk.count = m_count;
+    chunk.bits = m_writer.BitCount();
+    chunk.bytes = m_writer.Bytes();
+    chunk.bytes.shrink_to_fit();
+    *this = CSeriesEncoder();
+    return chunk;
+}
+
+bool CSeriesDecoder::ReadDouble(SXorState& state, double& value) {
+    bool nonzero = false;
+    if (!m_reader.ReadBit(nonzero)) {
+        return false;
+    }
+    if (nonzero) {
+        bool new_window = false;
+        if (!m_reader.ReadBit(new_window)) {
+            return false;
+        }
+        if (new_window) {
+            uint64_t leading = 0;
+            uint64_t meaningful = 0;
+            if (!m_reader.Read(5, leading) || !m_reader.Read(6, meaningful)) {
+                return false;
+            }
+            if (meaningful == 0) {
+                meaningful = 64;
+            }
+            state.leading = static_cast<unsigned>(leading);
+            state.trailing = static_cast<unsigned>(64 - leading - meaningful);
+        }
+        uint64_t bits = 0;
+        if (!m_reader.Read(64 - state.leading - state.trailing, bits)) {
+            return false;
+        }
+        state.prev ^= bits << state.trailing;
+    }
+    value = BitsDouble(state.prev);
+    return true;
+}
+
+bool CSeriesDecoder::ReadVarint(uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        uint64_t group = 0;
+        if (!m_reader.Read(8, group)) {
+            return false;
+        }
+        value |= (group & 0x7f) << shift;
+        if ((group & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CSeriesDecoder::Next(SSeriesPoint& point) {
+    if (m_remaining == 0) {
+        return false;
+    }
+    if (m_first) {
+        if (!m_reader.Read(64, m_prev_window_start)) {
+            return false;
+        }
+        m_first = false;
+    } else {
+        bool has_dod = false;
+        if (!m_reader.ReadBit(has_dod)) {
+            return false;
+        }
+        uint64_t dod = 0;
+        if (has_dod) {
+            unsigned payload_bits = 0;
+            for (unsigned i = 0; i < 3 && payload_bits == 0; ++i) {
+                bool more = false;
+                if (!m_reader.ReadBit(more)) {
+                    return false;
+                }
+                if (!more) {
+                    payload_bits = kDodBuckets[i].payload_bits;
+                }
+            }
+            if (payload_bits == 0) {
+                payload_bits = kDodBuckets[3].payload_bits;
+            }
+            if (!m_reader.Read(payload_bits, dod)) {
+                return false;
+            }
+        }
+        m_prev_delta += UnZigZag(dod);
+        m_prev_window_start += static_cast<uint64_t>(m_prev_delta);
+    }
+    point.window_start = m_prev_window_start;
+
+    bool explicit_sell = false;
+    if (!ReadVarint(point.trades_count) || !ReadVarint(point.buy_count) || !m_reader.ReadBit(explicit_sell)) {
+        return false;
+    }
+    if (explicit_sell) {
+        if (!ReadVarint(point.sell_count)) {
+            return false;
+        }
+    } else {
+        point.sell_count = point.trades_count - point.buy_count;
+    }
+    if (!ReadDouble(m_quantity, point.total_quantity) || !ReadDouble(m_volume, point.total_volume) ||
+        !ReadDouble(m_min, point.min_price) || !ReadDouble(m_max, point.max_price)) {
+        return false;
+    }
+    --m_remaining;
+    return true;
+}
+
+bool AppendChunkFile(const std::string& path, uint64_t period_ms, const SSeriesChunk& chunk) {
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    if (!out) {
+        return false;
+    }
+    const uint32_t magic = kChunkMagic;
+    const uint64_t byte_count = chunk.bytes.size();
+    out.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+    out.write(reinterpret_cast<const char*>(&chunk.count), sizeof(chunk.count));
+    out.write(reinterpret_cast<const char*>(&period_ms), sizeof(period_ms));
+    out.write(reinterpret_cast<const char*>(&chunk.first_window_start), sizeof(chunk.first_window_start));
+    out.write(reinterpret_cast<const char*>(&chunk.last_window_start), sizeof(chunk.last_window_start));
+    out.write(reinterpret_cast<const char*>(&chunk.bits), sizeof(chunk.bits));
+    out.write(reinterpret_cast<const char*>(&byte_count), sizeof(byte_count));
+    out.write(reinterpret_cast<const char*>(chunk.bytes.data()), static_cast<std::streamsize>(byte_count));
+    return static_cast<bool>(out);
+}
+
+bool ReadChunkFile(const std::string& path, std::vector<std::pair<uint64_t, SSeriesChunk>>& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    for (;;) {
+        uint32_t magic = 0;
+        if (!in.read(reinterpret_cast<char*>(&magic), sizeof(magic))) {
+            return in.eof() && in.gcount() == 0;
+        }
+        SSeriesChunk chunk;
+        uint64_t period_ms = 0;
+        uint64_t byte_count = 0;
+        in.read(reinterpret_cast<char*>(&chunk.count), sizeof(chunk.count));
+        in.read(reinterpret_cast<char*>(&period_ms), sizeof(period_ms));
+        in.read(reinterpret_cast<char*>(&chunk.first_window_start), sizeof(chunk.first_window_start));
+        in.read(reinterpret_cast<char*>(&chunk.last_window_start), sizeof(chunk.last_window_start));
+        in.read(reinterpret_cast<char*>(&chunk.bits), sizeof(chunk.bits));
+        in.read(reinterpret_cast<char*>(&byte_count), sizeof(byte_count));
+        if (!in || magic != kChunkMagic || byte_count != (chunk.bits + 7) / 8 || byte_count > (64u << 20)) {
+            return false;
+        }
+        chunk.bytes.resize(byte_count);
+        if (!in.read(reinterpret_cast<char*>(chunk.bytes.data()), static_cast<std::streamsize>(byte_count))) {
+            return false;
+        }
+        out.emplace_back(period_ms, std::move(chunk));
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One stored window of a symbol.
+struct SSeriesPoint {
+    uint64_t window_start = 0;
+    uint64_t trades_count = 0;
+    double total_quantity = 0.0;
+    double total_volume = 0.0;
+    double min_price = 0.0;
+    double max_price = 0.0;
+    uint64_t buy_count = 0;
+    uint64_t sell_count = 0;
+};
+
+// Append-only bit stream, most significant bit first.
+class CBitWriter {
+public:
+    void Write(uint64_t value, unsigned bits);
+    void WriteBit(bool bit) { Write(bit ? 1u : 0u, 1); }
+    const std::vector<uint8_t>& Bytes() const { return m_bytes; }
+    size_t BitCount() const { return m_bits; }
+    void Clear();
+
+private:
+    std::vector<uint8_t> m_bytes;
+    size_t m_bits = 0;
+};
+
+class CBitReader {
+public:
+    CBitReader(const uint8_t* data, size_t bit_count) : m_data(data), m_bits(bit_count) {}
+    // False when the stream is exhausted.
+    bool Read(unsigned bits, uint64_t& out);
+    bool ReadBit(bool& out);
+
+private:
+    const uint8_t* m_data;
+    size_t m_bits;
+    size_t m_pos = 0;
+};
+
+// Sealed run of consecutive windows of one symbol.
+struct SSeriesChunk {
+    uint64_t first_window_start = 0;
+    uint64_t last_window_start = 0;
+    uint32_t count = 0;
+    uint64_t bits = 0;
+    std::vector<uint8_t> bytes;
+};
+
+// Gorilla-style encoder: window starts as delta-of-delta, the four doubles
+// XOR-ed against their previous value with leading/trailing zero reuse, and
+// counts as varints (sell_count is usually trades - buy and then costs one bit).
+// Points are expected in increasing window order but any order decodes.
+class CSeriesEncoder {
+public:
+    void Append(const SSeriesPoint& point);
+    uint32_t Count() const { return m_count; }
+    uint64_t FirstWindowStart() const { return m_first_window_start; }
+    uint64_t LastWindowStart() const { return m_last_window_start; }
+    const CBitWriter& Stream() const { return m_writer; }
+    // Returns the encoded chunk and starts a new one.
+    SSeriesChunk Seal();
+
+private:
+    struct SXorState {
+        uint64_t prev = 0;
+        unsigned leading = 0xff;  // 0xff: no window to reuse yet
+        unsigned trailing = 0;
+    };
+    void WriteDouble(SXorState& state, double value);
+    void WriteVarint(uint64_t value);
+
+    CBitWriter m_writer;
+    uint32_t m_count = 0;
+    uint64_t m_first_window_start = 0;
+    uint64_t m_last_window_start = 0;
+    int64_t m_prev_delta = 0;
+    SXorState m_quantity;
+    SXorState m_volume;
+    SXorState m_min;
+    SXorState m_max;
+};
+
+// Streaming decoder over an encoded chunk (or an encoder's open stream).
+class CSeriesDecoder {
+public:
+    CSeriesDecoder(const uint8_t* data, size_t bits, uint32_t count) : m_reader(data, bits), m_remaining(count) {}
+    explicit CSeriesDecoder(const SSeriesChunk& chunk)
+        : CSeriesDecoder(chunk.bytes.data(), static_cast<size_t>(chunk.bits), chunk.count) {}
+
+    // False after the last point, or on a truncated stream.
+    bool Next(SSeriesPoint& point);
+
+private:
+    struct SXorState {
+        uint64_t prev = 0;
+        unsigned leading = 0;
+        unsigned trailing = 0;
+    };
+    bool ReadDouble(SXorState& state, double& value);
+    bool ReadVarint(uint64_t& value);
+
+    CBitReader m_reader;
+    uint32_t m_remaining;
+    bool m_first = true;
+    uint64_t m_prev_window_start = 0;
+    int64_t m_prev_delta = 0;
+    SXorState m_quantity;
+    SXorState m_volume;
+    SXorState m_min;
+    SXorState m_max;
+};
+
+// On-disk chunk log: a sequence of self-describing chunk records.
+bool AppendChunkFile(const std::string& path, uint64_t period_ms, const SSeriesChunk& chunk);
+// Reads (period_ms, chunk) records; stops at the first damaged one and
+// returns false then, keeping the records read so far.
+bool ReadChunkFile(const std::string& path, std::vector<std::pair<uint64_t, SSeriesChunk>>& out);
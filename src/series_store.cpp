@@ -0,0 +1,383 @@
+#include "series_store.hpp"
+
+#include "logger.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+
+namespace {
+constexpr uint64_t kEmptySlot = std::numeric_limits<uint64_t>::max();
+constexpr uint64_t kSlotBytes = 8 * sizeof(uint64_t);  // one entry in each of the eight columns
+const std::string kArchiveSuffix = ".gor";
+
+void PersistChunks(const std::vector<std::pair<std::string, SSeriesChunk>>& chunks,
+                   const SSeriesArchiveOptions& options, uint64_t period_ms) {
+    for (const auto& entry : chunks) {
+        const std::string path = options.persist_dir + "/" + entry.first + kArchiveSuffix;
+        RotateLogsIfNeeded(path, options.persist_max_bytes, options.persist_max_files);
+        if (!AppendChunkFile(path, period_ms, entry.second)) {
+            Log(LogLevel::ERROR, "History", "Cannot append a chunk to " + path);
+        }
+    }
+}
+
+// Decodes points of one chunk or open stream that start in [from_ms, to_ms).
+template <typename TFn>
+void DecodeRange(CSeriesDecoder decoder, uint64_t from_ms, uint64_t to_ms, TFn& fn) {
+    SSeriesPoint point;
+    while (decoder.Next(point) && point.window_start < to_ms) {
+        if (point.window_start >= from_ms) {
+            fn(point);
+        }
+    }
+}
+}
+
+CSeriesStore::SColumns::SColumns(size_t capacity)
+    : window(capacity, kEmptySlot),
+      trades_count(capacity, 0),
+      total_quantity(capacity, 0.0),
+      total_volume(capacity, 0.0),
+      min_price(capacity, 0.0),
+      max_price(capacity, 0.0),
+      buy_count(capacity, 0),
+      sell_count(capacity, 0) {}
+
+CSeriesStore::CSeriesStore(uint64_t period_ms, uint64_t retention_ms) {
+    Reconfigure(period_ms, retention_ms);
+}
+
+void CSeriesStore::Reconfigure(uint64_t period_ms, uint64_t retention_ms) {
+    period_ms = std::max<uint64_t>(period_ms, 1);
+    const auto capacity = static_cast<size_t>(std::max<uint64_t>((retention_ms + period_ms - 1) / period_ms, 1));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (period_ms == m_period_ms && capacity == m_capacity) {
+        return;
+    }
+    m_period_ms = period_ms;
+    m_capacity = capacity;
+    m_series.clear();
+}
+
+void CSeriesStore::ConfigureArchive(const SSeriesArchiveOptions& options) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_archive = options;
+    m_archive.chunk_windows = std::max<uint32_t>(m_archive.chunk_windows, 1);
+    if (m_archive.retention_ms == 0) {
+        for (auto& entry : m_series) {
+            entry.second.open = CSeriesEncoder();
+            entry.second.sealed.clear();
+        }
+    }
+}
+
+size_t CSeriesStore::LoadArchive() {
+    namespace fs = std::filesystem;
+    SSeriesArchiveOptions options;
+    uint64_t period_ms = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        options = m_archive;
+        period_ms = m_period_ms;
+    }
+    if (options.retention_ms == 0 || options.persist_dir.empty()) {
+        return 0;
+    }
+    std::unordered_map<std::string, std::vector<SSeriesChunk>> loaded;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(options.persist_dir, ec)) {
+        // <SYMBOL>.gor and its rotated <SYMBOL>.gor.<n> files.
+        const std::string name = entry.path().filename().string();
+        const size_t suffix = name.find(kArchiveSuffix);
+        if (suffix == std::string::npos || suffix == 0) {
+            continue;
+        }
+        std::vector<std::pair<uint64_t, SSeriesChunk>> records;
+        if (!ReadChunkFile(entry.path().string(), records)) {
+            Log(LogLevel::ERROR, "History", "Damaged chunk file " + entry.path().string() + ", using the readable part");
+        }
+        auto& chunks = loaded[name.substr(0, suffix)];
+        for (auto& record : records) {
+            if (record.first == period_ms && record.second.count > 0) {
+                chunks.push_back(std::move(record.second));
+            }
+        }
+    }
+
+    size_t count = 0;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (period_ms != m_period_ms) {
+        return 0;
+    }
+    for (auto& entry : loaded) {
+        auto& chunks = entry.second;
+        if (chunks.empty()) {
+            continue;
+        }
+        std::sort(chunks.begin(), chunks.end(), [](const SSeriesChunk& a, const SSeriesChunk& b) {
+            return a.first_window_start < b.first_window_start;
+        });
+        const uint64_t newest_ms = chunks.back().last_window_start;
+        auto it = m_series.find(entry.first);
+        if (it == m_series.end()) {
+            it = m_series.emplace(entry.first, SColumns(m_capacity)).first;
+        }
+        auto& c = it->second;
+        for (auto& chunk : chunks) {
+            if (chunk.last_window_start + m_archive.retention_ms >= newest_ms) {
+                c.sealed.push_back(std::move(chunk));
+                ++count;
+            }
+        }
+        c.newest = std::max(c.newest, newest_ms / m_period_ms);
+        c.any = true;
+    }
+    return count;
+}
+
+uint64_t CSeriesStore::PeriodMs() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_period_ms;
+}
+
+size_t CSeriesStore::Capacity() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_capacity;
+}
+
+void CSeriesStore::Insert(const CTradeAggregator::AllWindowsStats& windows) {
+    PendingChunks to_persist;
+    SSeriesArchiveOptions options;
+    uint64_t period_ms = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& window_pair : windows) {
+            for (const auto& entry : window_pair.second) {
+                InsertLocked(window_pair.first, std::string(entry.first), entry.second, to_persist);
+            }
+        }
+        if (to_persist.empty()) {
+            return;
+        }
+        options = m_archive;
+        period_ms = m_period_ms;
+    }
+    PersistChunks(to_persist, options, period_ms);
+}
+
+void CSeriesStore::Insert(uint64_t window_start, const std::string& symbol,
+                          const CTradeAggregator::SSymbolStats& stats) {
+    PendingChunks to_persist;
+    SSeriesArchiveOptions options;
+    uint64_t period_ms = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        InsertLocked(window_start, symbol, stats, to_persist);
+        if (to_persist.empty()) {
+            return;
+        }
+        options = m_archive;
+        period_ms = m_period_ms;
+    }
+    PersistChunks(to_persist, options, period_ms);
+}
+
+void CSeriesStore::InsertLocked(uint64_t window_start, const std::string& symbol,
+                                const CTradeAggregator::SSymbolStats& stats, PendingChunks& to_persist) {
+    if (stats.trades_count == 0) {
+        return;  // book-only windows carry no trade statistics
+    }
+    auto it = m_series.find(symbol);
+    if (it == m_series.end()) {
+        it = m_series.emplace(symbol, SColumns(m_capacity)).first;
+    }
+    auto& c = it->second;
+    const uint64_t window = window_start / m_period_ms;
+    if (window + m_capacity <= c.newest) {
+        return;  // older than the retention
+    }
+    if (c.any && window > c.newest) {
+        EvictLocked(symbol, c, window, to_persist);
+    }
+    const size_t slot = static_cast<size_t>(window % m_capacity);
+    if (c.window[slot] == window) {
+        c.trades_count[slot] += stats.trades_count;
+        c.total_quantity[slot] += stats.total_quantity;
+        c.total_volume[slot] += stats.total_volume;
+        c.min_price[slot] = std::min(c.min_price[slot], stats.min_price);
+        c.max_price[slot] = std::max(c.max_price[slot], stats.max_price);
+        c.buy_count[slot] += stats.buy_count;
+        c.sell_count[slot] += stats.sell_count;
+        return;
+    }
+    c.window[slot] = window;
+    c.trades_count[slot] = stats.trades_count;
+    c.total_quantity[slot] = stats.total_quantity;
+    c.total_volume[slot] = stats.total_volume;
+    c.min_price[slot] = stats.min_price;
+    c.max_price[slot] = stats.max_price;
+    c.buy_count[slot] = stats.buy_count;
+    c.sell_count[slot] = stats.sell_count;
+    c.newest = std::max(c.newest, window);
+    c.any = true;
+}
+
+void CSeriesStore::EvictLocked(const std::string& symbol, SColumns& c, uint64_t window, PendingChunks& to_persist) {
+    // Slots of the windows (newest, window] still hold windows that are now out of the retention.
+    const uint64_t first = std::max(c.newest + 1, window + 1 >= m_capacity ? window + 1 - m_capacity : 0);
+    std::vector<SSeriesPoint> evicted;
+    for (uint64_t x = first; x <= window; ++x) {
+        const size_t slot = static_cast<size_t>(x % m_capacity);
+        if (c.window[slot] == kEmptySlot || c.window[slot] >= x) {
+            continue;
+        }
+        if (m_archive.retention_ms > 0) {
+            SSeriesPoint p;
+            p.window_start = c.window[slot] * m_period_ms;
+            p.trades_count = c.trades_count[slot];
+            p.total_quantity = c.total_quantity[slot];
+            p.total_volume = c.total_volume[slot];
+            p.min_price = c.min_price[slot];
+            p.max_price = c.max_price[slot];
+            p.buy_count = c.buy_count[slot];
+            p.sell_count = c.sell_count[slot];
+            evicted.push_back(p);
+        }
+        c.window[slot] = kEmptySlot;
+    }
+    if (evicted.empty()) {
+        return;
+    }
+    std::sort(evicted.begin(), evicted.end(), [](const SSeriesPoint& a, const SSeriesPoint& b) {
+        return a.window_start < b.window_start;
+    });
+    for (const auto& p : evicted) {
+        c.open.Append(p);
+        if (c.open.Count() >= m_archive.chunk_windows) {
+            c.sealed.push_back(c.open.Seal());
+            if (!m_archive.persist_dir.empty()) {
+                to_persist.emplace_back(symbol, c.sealed.back());
+            }
+        }
+    }
+    const uint64_t newest_ms = window * m_period_ms;
+    while (!c.sealed.empty() && c.sealed.front().last_window_start + m_archive.retention_ms < newest_ms) {
+        c.sealed.pop_front();
+    }
+}
+
+template <typename TFn>
+void CSeriesStore::ForEachInRange(const std::string& symbol, uint64_t from_ms, uint64_t to_ms, TFn&& fn) const {
+    auto it = m_series.find(symbol);
+    if (it == m_series.end() || to_ms <= from_ms) {
+        return;
+    }
+    const auto& c = it->second;
+    // Archived windows are all older than the ones in the ring.
+    for (const auto& chunk : c.sealed) {
+        if (chunk.last_window_start >= from_ms && chunk.first_window_start < to_ms) {
+            DecodeRange(CSeriesDecoder(chunk), from_ms, to_ms, fn);
+        }
+    }
+    if (c.open.Count() > 0 && c.open.LastWindowStart() >= from_ms && c.open.FirstWindowStart() < to_ms) {
+        const auto& stream = c.open.Stream();
+        DecodeRange(CSeriesDecoder(stream.Bytes().data(), stream.BitCount(), c.open.Count()), from_ms, to_ms, fn);
+    }
+
+    uint64_t first = (from_ms + m_period_ms - 1) / m_period_ms;
+    uint64_t last = (to_ms - 1) / m_period_ms;
+    // Only the newest m_capacity windows can still be in the ring.
+    const uint64_t oldest = c.newest + 1 >= m_capacity ? c.newest + 1 - m_capacity : 0;
+    first = std::max(first, oldest);
+    last = std::min(last, c.newest);
+    if (first > last) {
+        return;
+    }
+    SSeriesPoint p;
+    for (uint64_t window = first; window <= last; ++window) {
+        const size_t slot = static_cast<size_t>(window % m_capacity);
+        if (c.window[slot] != window) {
+            continue;
+        }
+        p.window_start = window * m_period_ms;
+        p.trades_count = c.trades_count[slot];
+        p.total_quantity = c.total_quantity[slot];
+        p.total_volume = c.total_volume[slot];
+        p.min_price = c.min_price[slot];
+        p.max_price = c.max_price[slot];
+        p.buy_count = c.buy_count[slot];
+        p.sell_count = c.sell_count[slot];
+        fn(p);
+    }
+}
+
+std::vector<SSeriesPoint> CSeriesStore::Range(const std::string& symbol, uint64_t from_ms, uint64_t to_ms) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<SSeriesPoint> points;
+    ForEachInRange(symbol, from_ms, to_ms, [&](const SSeriesPoint& p) { points.push_back(p); });
+    return points;
+}
+
+SSeriesAggregate CSeriesStore::Aggregate(const std::string& symbol, uint64_t from_ms, uint64_t to_ms) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    SSeriesAggregate agg;
+    double min_price = std::numeric_limits<double>::max();
+    double max_price = std::numeric_limits<double>::lowest();
+    ForEachInRange(symbol, from_ms, to_ms, [&](const SSeriesPoint& p) {
+        ++agg.windows;
+        agg.trades_count += p.trades_count;
+        agg.total_quantity += p.total_quantity;
+        agg.total_volume += p.total_volume;
+        min_price = std::min(min_price, p.min_price);
+        max_price = std::max(max_price, p.max_price);
+        agg.buy_count += p.buy_count;
+        agg.sell_count += p.sell_count;
+    });
+    if (agg.windows > 0) {
+        agg.min_price = min_price;
+        agg.max_price = max_price;
+    }
+    return agg;
+}
+
+std::vector<std::string> CSeriesStore::Symbols() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::string> symbols;
+    symbols.reserve(m_series.size());
+    for (const auto& entry : m_series) {
+        symbols.push_back(entry.first);
+    }
+    std::sort(symbols.begin(), symbols.end());
+    return symbols;
+}
+
+uint64_t CSeriesStore::Newest() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t newest = 0;
+    bool any = false;
+    for (const auto& entry : m_series) {
+        newest = std::max(newest, entry.second.newest);
+        any = any || entry.second.any;
+    }
+    return any ? newest * m_period_ms : 0;
+}
+
+SSeriesMemoryUsage CSeriesStore::MemoryUsage() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    SSeriesMemoryUsage usage;
+    usage.symbols = m_series.size();
+    for (const auto& entry : m_series) {
+        const auto& c = entry.second;
+        usage.hot_bytes += m_capacity * kSlotBytes;
+        usage.hot_windows += static_cast<uint64_t>(
+            std::count_if(c.window.begin(), c.window.end(), [](uint64_t w) { return w != kEmptySlot; }));
+        for (const auto& chunk : c.sealed) {
+            usage.archived_windows += chunk.count;
+            usage.archived_bytes += chunk.bytes.size();
+        }
+        usage.archived_windows += c.open.Count();
+        usage.archived_bytes += c.open.Stream().Bytes().size();
+    }
+    return usage;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "aggregator.hpp"
+#include "series_codec.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Statistics combined over a time range.
+struct SSeriesAggregate {
+    uint64_t windows = 0;  // windows with data inside the range
+    uint64_t trades_count = 0;
+    double total_quantity = 0.0;
+    double total_volume = 0.0;
+    double min_price = 0.0;
+    double max_price = 0.0;
+    uint64_t buy_count = 0;
+    uint64_t sell_count = 0;
+};
+
+// Compressed tier behind the column rings; retention_ms == 0 disables it.
+struct SSeriesArchiveOptions {
+    uint64_t retention_ms = 0;
+    uint32_t chunk_windows = 3600;  // windows per sealed chunk
+    std::string persist_dir;        // sealed chunks are appended to <dir>/<SYMBOL>.gor, empty = memory only
+    uint64_t persist_max_bytes = 64ull << 20;
+    uint64_t persist_max_files = 10;
+};
+
+struct SSeriesMemoryUsage {
+    size_t symbols = 0;
+    uint64_t hot_windows = 0;       // stored windows in the rings
+    uint64_t hot_bytes = 0;         // ring columns, allocated for every slot
+    uint64_t archived_windows = 0;
+    uint64_t archived_bytes = 0;    // sealed chunks plus the open streams
+};
+
+// Recent flushed windows kept in memory, one set of column arrays per symbol.
+// Each column is a ring indexed by window number modulo the capacity, so
+// inserting, merging a late window and finding the first window of a range
+// are O(1), and a range query is a linear scan over contiguous arrays.
+// With an archive configured, windows leaving the ring are appended to a
+// per-symbol Gorilla-encoded stream (see series_codec.hpp) that is sealed
+// into immutable chunks every chunk_windows windows; queries decode the
+// overlapping chunks and then read the ring.
+// Writer inserts, the query server reads; both take the same mutex.
+class CSeriesStore {
+public:
+    CSeriesStore(uint64_t period_ms, uint64_t retention_ms);
+
+    void ConfigureArchive(const SSeriesArchiveOptions& options);
+    // Reads persisted chunks recorded with the current period back into the
+    // archive; returns the number of chunks loaded.
+    size_t LoadArchive();
+
+    uint64_t PeriodMs() const;
+    size_t Capacity() const;
+    // Switches to a new window period / retention on config reload; stored
+    // data is dropped only when either of them actually changes.
+    void Reconfigure(uint64_t period_ms, uint64_t retention_ms);
+
+    // Windows that were flushed before (late trades) are merged into the stored one.
+    void Insert(const CTradeAggregator::AllWindowsStats& windows);
+    void Insert(uint64_t window_start, const std::string& symbol, const CTradeAggregator::SSymbolStats& stats);
+
+    // Windows starting in [from_ms, to_ms), oldest first.
+    std::vector<SSeriesPoint> Range(const std::string& symbol, uint64_t from_ms, uint64_t to_ms) const;
+    SSeriesAggregate Aggregate(const std::string& symbol, uint64_t from_ms, uint64_t to_ms) const;
+    std::vector<std::string> Symbols() const;
+    // Start of the newest stored window across all symbols, 0 when empty.
+    uint64_t Newest() const;
+    SSeriesMemoryUsage MemoryUsage() const;
+
+private:
+    struct SColumns {
+        explicit SColumns(size_t capacity);
+        std::vector<uint64_t> window;  // window number (start / period); ~0 for an empty slot
+        std::vector<uint64_t> trades_count;
+        std::vector<double> total_quantity;
+        std::vector<double> total_volume;
+        std::vector<double> min_price;
+        std::vector<double> max_price;
+        std::vector<uint64_t> buy_count;
+        std::vector<uint64_t> sell_count;
+        uint64_t newest = 0;  // window number of the newest insert
+        bool any = false;     // newest is meaningful
+        CSeriesEncoder open;  // windows evicted from the ring since the last seal
+        std::deque<SSeriesChunk> sealed;
+    };
+    using PendingChunks = std::vector<std::pair<std::string, SSeriesChunk>>;
+
+    void InsertLocked(uint64_t window_start, const std::string& symbol,
+                      const CTradeAggregator::SSymbolStats& stats, PendingChunks& to_persist);
+    // Moves ring windows that fall out of the retention once `window` is the newest into the archive.
+    void EvictLocked(const std::string& symbol, SColumns& c, uint64_t window, PendingChunks& to_persist);
+    // Calls fn(point) for every stored window of symbol in [from_ms, to_ms), oldest first.
+    template <typename TFn>
+    void ForEachInRange(const std::string& symbol, uint64_t from_ms, uint64_t to_ms, TFn&& fn) const;
+
+    uint64_t m_period_ms = 1;
+    size_t m_capacity = 1;
+    SSeriesArchiveOptions m_archive;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, SColumns> m_series;
+};
@@ -0,0 +1,125 @@
+#include "shm_publisher.hpp"
+
+#include "logger.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+CShmPublisher::CShmPublisher(std::string name, uint32_t window_slots, uint32_t trade_slots)
+    : m_name(std::move(name)), m_window_slots(window_slots), m_trade_slots(trade_slots) {}
+
+CShmPublisher::~CShmPublisher() {
+    if (m_header) {
+        ::munmap(m_header, m_size);
+        ::shm_unlink(m_name.c_str());
+    }
+}
+
+bool CShmPublisher::Open() {
+    const size_t size = ShmSegmentSize(m_window_slots, m_trade_slots);
+    const int fd = ::shm_open(m_name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        Log(LogLevel::ERROR, "Shm", "shm_open " + m_name + " failed: " + std::strerror(errno));
+        return false;
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        Log(LogLevel::ERROR, "Shm", "ftruncate " + m_name + " failed: " + std::strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        Log(LogLevel::ERROR, "Shm", "mmap " + m_name + " failed: " + std::strerror(errno));
+        return false;
+    }
+    std::memset(addr, 0, size);
+
+    auto* bytes = static_cast<unsigned char*>(addr);
+    m_header = new (addr) SShmHeader{};
+    m_header->version = kShmVersion;
+    m_header->window_slots = m_window_slots;
+    m_header->trade_slots = m_trade_slots;
+    m_header->windows_offset = sizeof(SShmHeader);
+    m_header->trades_offset = m_header->windows_offset + m_window_slots * sizeof(TShmSlot<SShmWindowRecord>);
+    m_header->total_size = size;
+    m_windows = reinterpret_cast<TShmSlot<SShmWindowRecord>*>(bytes + m_header->windows_offset);
+    m_trades = reinterpret_cast<TShmSlot<SShmTradeRecord>*>(bytes + m_header->trades_offset);
+    m_size = size;
+    // Readers validate the magic, so it is written last.
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = kShmMagic;
+
+    Log(LogLevel::INFO, "Shm", "Publishing to " + m_name + " (" + std::to_string(size) + " bytes)");
+    return true;
+}
+
+template <typename TRecord>
+void CShmPublisher::Publish(TShmSlot<TRecord>* slots, uint32_t slot_count,
+                            std::atomic<uint64_t>& published, const TRecord& record) {
+    const uint64_t n = published.load(std::memory_order_relaxed) + 1;
+    auto& slot = slots[n & (slot_count - 1)];
+    slot.seq.store(n * 2 - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot.record, &record, sizeof(TRecord));
+    slot.seq.store(n * 2, std::memory_order_release);
+    published.store(n, std::memory_order_release);
+}
+
+void CShmPublisher::PublishWindows(const CTradeAggregator::AllWindowsStats& windows, uint64_t period_ms) {
+    if (!m_header) {
+        return;
+    }
+    SShmWindowRecord record{};
+    for (const auto& window_pair : windows) {
+        record.window_start_ms = window_pair.first;
+        record.period_ms = period_ms;
+        for (const auto& entry : window_pair.second) {
+            const auto& stats = entry.second;
+            CopyShmSymbol(record.symbol, entry.first);
+            record.trades_count = stats.trades_count;
+            record.total_quantity = stats.total_quantity;
+            record.total_volume = stats.total_volume;
+            // A symbol with book samples only has no prices, as in the writer's output.
+            const bool has_trades = stats.trades_count > 0;
+            record.min_price = has_trades ? stats.min_price : 0.0;
+            record.max_price = has_trades ? stats.max_price : 0.0;
+            record.buy_count = stats.buy_count;
+            record.sell_count = stats.sell_count;
+            Publish(m_windows, m_window_slots, m_header->windows_published, record);
+        }
+    }
+}
+
+void CShmPublisher::PublishTrade(const STrade& trade) {
+    if (!m_header || m_trade_slots == 0) {
+        return;
+    }
+    SShmTradeRecord record{};
+    CopyShmSymbol(record.symbol, trade.symbol);
+    record.price = trade.price;
+    record.quantity = trade.quantity;
+    record.timestamp = trade.timestamp;
+    record.buyer_initiated = trade.buyer_initiated ? 1 : 0;
+    record.trade_count = static_cast<uint32_t>(trade.TradeCount());
+    record.last_trade_id = trade.last_trade_id;
+    Publish(m_trades, m_trade_slots, m_header->trades_published, record);
+}
+
+void CShmPublisher::PublishTrades(const STradeBlock& block) {
+    if (!m_header || m_trade_slots == 0) {
+        return;
+    }
+    SShmTradeRecord record{};
+    for (size_t i = 0; i < block.Size(); ++i) {
+        CopyShmSymbol(record.symbol, block.symbols[block.symbol_index[i]]);
+        record.price = block.price[i];
+        record.quantity = block.quantity[i];
+        record.timestamp = block.timestamp[i];
+        record.buyer_initiated = block.buyer_initiated[i];
+        record.trade_count = static_cast<uint32_t>(block.trade_count[i]);
+        record.last_trade_id = block.last_trade_id[i];
+        Publish(m_trades, m_trade_slots, m_header->trades_published, record);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "aggregator.hpp"
+#include "shm_reader.hpp"
+#include "trade.hpp"
+#include "trade_block.hpp"
+
+#include <cstdint>
+#include <string>
+
+// Publishes closed windows (writer thread) and optionally raw trades (reader
+// thread) into a POSIX shared-memory segment laid out as in shm_reader.hpp.
+// Each ring has exactly one producing thread, so publishing is wait-free.
+class CShmPublisher {
+public:
+    CShmPublisher(std::string name, uint32_t window_slots, uint32_t trade_slots);
+    ~CShmPublisher();
+
+    CShmPublisher(const CShmPublisher&) = delete;
+    CShmPublisher& operator=(const CShmPublisher&) = delete;
+
+    // Creates (or re-initialises) and maps the segment. Returns false on failure.
+    bool Open();
+    bool IsOpen() const { return m_header != nullptr; }
+
+    void PublishWindows(const CTradeAggregator::AllWindowsStats& windows, uint64_t period_ms);
+    void PublishTrade(const STrade& trade);
+    void PublishTrades(const STradeBlock& block);
+
+private:
+    template <typename TRecord>
+    static void Publish(TShmSlot<TRecord>* slots, uint32_t slot_count,
+                        std::atomic<uint64_t>& published, const TRecord& record);
+
+    const std::string m_name;
+    const uint32_t m_window_slots;
+    const uint32_t m_trade_slots;
+
+    SShmHeader* m_header = nullptr;
+    TShmSlot<SShmWindowRecord>* m_windows = nullptr;
+    TShmSlot<SShmTradeRecord>* m_trades = nullptr;
+    size_t m_size = 0;
+};
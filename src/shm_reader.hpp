@@ -0,0 +1,199 @@
+#pragma once
+// Header-only layout of the shared-memory segment published by CShmPublisher,
+// plus a reader API for local consumers. Only depends on the C++ standard
+// library and POSIX, so it can be copied into other projects as is.
+//
+// Each ring is a power-of-two array of slots guarded by a per-slot sequence
+// number (seqlock): the publisher makes the sequence odd while it writes the
+// record and even (2 * record number) once the record is complete. Readers
+// copy the record and accept it only if the sequence was the expected even
+// value before and after the copy. Reading never enters the kernel.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr uint32_t kShmMagic = 0x31475143;  // "CQG1"
+constexpr uint32_t kShmVersion = 2;
+constexpr size_t kShmSymbolSize = 16;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory rings need lock-free 64-bit atomics");
+
+struct SShmWindowRecord {
+    uint64_t window_start_ms;
+    uint64_t period_ms;
+    char symbol[kShmSymbolSize];  // NUL-terminated, truncated if longer
+    uint64_t trades_count;
+    double total_quantity;
+    double total_volume;
+    double min_price;
+    double max_price;
+    uint64_t buy_count;
+    uint64_t sell_count;
+};
+
+struct SShmTradeRecord {
+    char symbol[kShmSymbolSize];
+    double price;
+    double quantity;
+    uint64_t timestamp;
+    uint8_t buyer_initiated;
+    uint32_t trade_count;    // > 1 for @aggTrade records
+    uint64_t last_trade_id;  // exchange id of the (last) trade, 0 when unknown
+};
+
+template <typename TRecord>
+struct alignas(64) TShmSlot {
+    std::atomic<uint64_t> seq;
+    TRecord record;
+};
+
+// The id still fits the 64-byte slot next to the sequence number.
+static_assert(sizeof(TShmSlot<SShmTradeRecord>) == 64, "trade slots are one cache line");
+
+struct SShmHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t window_slots;
+    uint32_t trade_slots;
+    uint64_t windows_offset;
+    uint64_t trades_offset;
+    uint64_t total_size;
+    alignas(64) std::atomic<uint64_t> windows_published;
+    alignas(64) std::atomic<uint64_t> trades_published;
+};
+
+inline size_t ShmSegmentSize(uint32_t window_slots, uint32_t trade_slots) {
+    return sizeof(SShmHeader) + window_slots * sizeof(TShmSlot<SShmWindowRecord>) +
+           trade_slots * sizeof(TShmSlot<SShmTradeRecord>);
+}
+
+inline void CopyShmSymbol(char (&dst)[kShmSymbolSize], std::string_view symbol) {
+    const size_t n = symbol.size() < kShmSymbolSize - 1 ? symbol.size() : kShmSymbolSize - 1;
+    std::memcpy(dst, symbol.data(), n);
+    std::memset(dst + n, 0, kShmSymbolSize - n);
+}
+
+// Sequential cursor over one ring. Records that were overwritten before the
+// cursor reached them are skipped and counted in Lost().
+template <typename TRecord>
+class TShmRingCursor {
+public:
+    TShmRingCursor() = default;
+    TShmRingCursor(const TShmSlot<TRecord>* slots, uint32_t slot_count, const std::atomic<uint64_t>* published)
+        : m_slots(slots), m_mask(slot_count - 1), m_published(published) {}
+
+    // Continue from the newest record instead of replaying what is still in the ring.
+    void SeekToLatest() { m_next = m_published->load(std::memory_order_acquire) + 1; }
+
+    bool Next(TRecord& out) {
+        for (;;) {
+            const uint64_t head = m_published->load(std::memory_order_acquire);
+            if (m_next > head) {
+                return false;
+            }
+            if (head - m_next > m_mask) {
+                const uint64_t oldest = head - m_mask;
+                m_lost += oldest - m_next;
+                m_next = oldest;
+            }
+            const auto& slot = m_slots[m_next & m_mask];
+            const uint64_t expected = m_next * 2;
+            const uint64_t before = slot.seq.load(std::memory_order_acquire);
+            if (before == expected) {
+                std::memcpy(&out, &slot.record, sizeof(TRecord));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.seq.load(std::memory_order_relaxed) == expected) {
+                    ++m_next;
+                    return true;
+                }
+            }
+            if (before < expected) {
+                // Published counter is ahead of the slot only while it is being rewritten.
+                continue;
+            }
+            // Lapped by the publisher; the loop resynchronises on the new head.
+            ++m_lost;
+            ++m_next;
+        }
+    }
+
+    uint64_t Lost() const { return m_lost; }
+
+private:
+    const TShmSlot<TRecord>* m_slots = nullptr;
+    uint64_t m_mask = 0;
+    const std::atomic<uint64_t>* m_published = nullptr;
+    uint64_t m_next = 1;
+    uint64_t m_lost = 0;
+};
+
+class CShmReader {
+public:
+    CShmReader() = default;
+    ~CShmReader() { Close(); }
+
+    CShmReader(const CShmReader&) = delete;
+    CShmReader& operator=(const CShmReader&) = delete;
+
+    bool Open(const std::string& name) {
+        Close();
+        const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SShmHeader)) {
+            ::close(fd);
+            return false;
+        }
+        void* addr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        m_base = addr;
+        m_size = static_cast<size_t>(st.st_size);
+        const auto* header = Header();
+        if (header->magic != kShmMagic || header->version != kShmVersion || header->total_size > m_size) {
+            Close();
+            return false;
+        }
+        const auto* bytes = static_cast<const unsigned char*>(m_base);
+        m_windows = TShmRingCursor<SShmWindowRecord>(
+            reinterpret_cast<const TShmSlot<SShmWindowRecord>*>(bytes + header->windows_offset),
+            header->window_slots, &header->windows_published);
+        m_trades = TShmRingCursor<SShmTradeRecord>(
+            reinterpret_cast<const TShmSlot<SShmTradeRecord>*>(bytes + header->trades_offset),
+            header->trade_slots, &header->trades_published);
+        return true;
+    }
+
+    void Close() {
+        if (m_base) {
+            ::munmap(m_base, m_size);
+            m_base = nullptr;
+            m_size = 0;
+        }
+    }
+
+    bool IsOpen() const { return m_base != nullptr; }
+    const SShmHeader* Header() const { return static_cast<const SShmHeader*>(m_base); }
+
+    TShmRingCursor<SShmWindowRecord>& Windows() { return m_windows; }
+    TShmRingCursor<SShmTradeRecord>& Trades() { return m_trades; }
+
+private:
+    void* m_base = nullptr;
+    size_t m_size = 0;
+    TShmRingCursor<SShmWindowRecord> m_windows;
+    TShmRingCursor<SShmTradeRecord> m_trades;
+};
@@ -0,0 +1,249 @@
+#include "stage_stats.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+#include <pthread.h>
+#include <time.h>
+
+namespace {
+constexpr size_t kMaxThreads = 256;
+
+// Written by its own thread only (plain load + store, no lock prefix), read
+// by the reporter.
+struct alignas(64) SThreadSlot {
+    std::atomic<bool> used{false};
+    std::atomic<uint8_t> stage{static_cast<uint8_t>(EStage::Other)};
+    std::atomic<bool> has_clock{false};
+    std::atomic<clockid_t> clock{};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> allocated_bytes{0};
+    std::atomic<uint64_t> frees{0};
+    std::atomic<uint64_t> freed_bytes{0};
+};
+
+struct SRetired {
+    std::atomic<uint64_t> cpu_ns{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> allocated_bytes{0};
+    std::atomic<uint64_t> frees{0};
+    std::atomic<uint64_t> freed_bytes{0};
+};
+
+SThreadSlot g_slots[kMaxThreads];
+SRetired g_retired[kStageCount];
+
+uint64_t ClockNs(clockid_t clock) {
+    timespec ts{};
+    if (::clock_gettime(clock, &ts) != 0) {
+        return 0;  // the thread is gone; its time is in g_retired
+    }
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// The calling thread's slot, claimed on first use and folded into g_retired
+// when the thread exits. Nothing here allocates through operator new.
+class CThreadHandle {
+public:
+    ~CThreadHandle() {
+        if (!m_slot) {
+            return;
+        }
+        auto& retired = g_retired[m_slot->stage.load(std::memory_order_relaxed)];
+        retired.cpu_ns.fetch_add(ClockNs(CLOCK_THREAD_CPUTIME_ID), std::memory_order_relaxed);
+        retired.allocations.fetch_add(m_slot->allocations.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        retired.allocated_bytes.fetch_add(m_slot->allocated_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        retired.frees.fetch_add(m_slot->frees.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        retired.freed_bytes.fetch_add(m_slot->freed_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        m_slot->used.store(false, std::memory_order_release);
+        m_slot = nullptr;
+        m_exited = true;
+    }
+
+    // Null once the thread is exiting, or when every slot is taken.
+    SThreadSlot* Slot() {
+        if (m_slot || m_exited) {
+            return m_slot;
+        }
+        for (auto& slot : g_slots) {
+            bool expected = false;
+            if (!slot.used.load(std::memory_order_relaxed) &&
+                slot.used.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                slot.stage.store(static_cast<uint8_t>(EStage::Other), std::memory_order_relaxed);
+                slot.allocations.store(0, std::memory_order_relaxed);
+                slot.allocated_bytes.store(0, std::memory_order_relaxed);
+                slot.frees.store(0, std::memory_order_relaxed);
+                slot.freed_bytes.store(0, std::memory_order_relaxed);
+                clockid_t clock{};
+                const bool has_clock = ::pthread_getcpuclockid(::pthread_self(), &clock) == 0;
+                slot.clock.store(clock, std::memory_order_relaxed);
+                slot.has_clock.store(has_clock, std::memory_order_release);
+                m_slot = &slot;
+                break;
+            }
+        }
+        m_exited = !m_slot;  // no slot: stop trying
+        return m_slot;
+    }
+
+private:
+    SThreadSlot* m_slot = nullptr;
+    bool m_exited = false;
+};
+
+thread_local CThreadHandle t_handle;
+}
+
+const char* StageName(EStage stage) {
+    switch (stage) {
+    case EStage::Io: return "io";
+    case EStage::Reader: return "reader";
+    case EStage::Writer: return "writer";
+    case EStage::Other: return "other";
+    }
+    return "other";
+}
+
+void SetThreadStage(EStage stage) {
+    if (SThreadSlot* slot = t_handle.Slot()) {
+        // What the thread counted so far stays with its old stage.
+        auto& retired = g_retired[slot->stage.load(std::memory_order_relaxed)];
+        retired.allocations.fetch_add(slot->allocations.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        retired.allocated_bytes.fetch_add(slot->allocated_bytes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        retired.frees.fetch_add(slot->frees.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        retired.freed_bytes.fetch_add(slot->freed_bytes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        const uint64_t cpu_ns = ClockNs(CLOCK_THREAD_CPUTIME_ID);
+        retired.cpu_ns.fetch_add(cpu_ns, std::memory_order_relaxed);
+        g_retired[static_cast<size_t>(stage)].cpu_ns.fetch_sub(cpu_ns, std::memory_order_relaxed);
+        slot->stage.store(static_cast<uint8_t>(stage), std::memory_order_relaxed);
+    }
+}
+
+StageStats StageStatsSnapshot() {
+    StageStats stats{};
+    for (size_t i = 0; i < kStageCount; ++i) {
+        stats[i].cpu_ns = g_retired[i].cpu_ns.load(std::memory_order_relaxed);
+        stats[i].allocations = g_retired[i].allocations.load(std::memory_order_relaxed);
+        stats[i].allocated_bytes = g_retired[i].allocated_bytes.load(std::memory_order_relaxed);
+        stats[i].frees = g_retired[i].frees.load(std::memory_order_relaxed);
+        stats[i].freed_bytes = g_retired[i].freed_bytes.load(std::memory_order_relaxed);
+    }
+    for (const auto& slot : g_slots) {
+        if (!slot.used.load(std::memory_order_acquire)) {
+            continue;
+        }
+        auto& stage = stats[slot.stage.load(std::memory_order_relaxed)];
+        if (slot.has_clock.load(std::memory_order_acquire)) {
+            stage.cpu_ns += ClockNs(slot.clock.load(std::memory_order_relaxed));
+        }
+        stage.allocations += slot.allocations.load(std::memory_order_relaxed);
+        stage.allocated_bytes += slot.allocated_bytes.load(std::memory_order_relaxed);
+        stage.frees += slot.frees.load(std::memory_order_relaxed);
+        stage.freed_bytes += slot.freed_bytes.load(std::memory_order_relaxed);
+        ++stage.threads;
+    }
+    return stats;
+}
+
+bool StageAllocationsCounted() {
+#ifdef CQG_ALLOC_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::string FormatStageStats(const StageStats& before, const StageStats& now, double seconds) {
+    if (seconds <= 0.0) {
+        seconds = 1.0;
+    }
+    const bool allocations = StageAllocationsCounted();
+    std::string text;
+    uint64_t live_bytes = 0;
+    char buf[160];
+    for (size_t i = 0; i < kStageCount; ++i) {
+        const auto& a = before[i];
+        const auto& b = now[i];
+        int n = std::snprintf(buf, sizeof(buf), "%s%s cpu=%.1f%%", i == 0 ? "" : " | ", StageName(static_cast<EStage>(i)),
+                              static_cast<double>(b.cpu_ns - a.cpu_ns) / seconds / 1e7);
+        if (allocations) {
+            n += std::snprintf(buf + n, sizeof(buf) - static_cast<size_t>(n), " allocs/s=%.0f alloc_kb/s=%.1f",
+                               static_cast<double>(b.allocations - a.allocations) / seconds,
+                               static_cast<double>(b.allocated_bytes - a.allocated_bytes) / seconds / 1024.0);
+        }
+        std::snprintf(buf + n, sizeof(buf) - static_cast<size_t>(n), " threads=%u", b.threads);
+        text += buf;
+        live_bytes += b.allocated_bytes - b.freed_bytes;
+    }
+    if (allocations) {
+        std::snprintf(buf, sizeof(buf), " | live_mb=%.1f", static_cast<double>(live_bytes) / (1024.0 * 1024.0));
+        text += buf;
+    }
+    return text;
+}
+
+#ifdef CQG_ALLOC_STATS
+// The hook: every replaceable non-aligned operator new/delete. Aligned ones
+// keep the library's, which pairs them with its own deletes.
+namespace {
+void Bump(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void* CountedAlloc(std::size_t size, bool nothrow) {
+    void* p = nullptr;
+    while (!(p = std::malloc(size ? size : 1))) {
+        const std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            if (nothrow) {
+                return nullptr;
+            }
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+    if (SThreadSlot* slot = t_handle.Slot()) {
+        Bump(slot->allocations, 1);
+        Bump(slot->allocated_bytes, ::malloc_usable_size(p));
+    }
+    return p;
+}
+
+void CountedFree(void* p) noexcept {
+    if (!p) {
+        return;
+    }
+    if (SThreadSlot* slot = t_handle.Slot()) {
+        Bump(slot->frees, 1);
+        Bump(slot->freed_bytes, ::malloc_usable_size(p));
+    }
+    std::free(p);
+}
+}
+
+void* operator new(std::size_t size) { return CountedAlloc(size, false); }
+void* operator new[](std::size_t size) { return CountedAlloc(size, false); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return CountedAlloc(size, true);
+    } catch (...) {
+        return nullptr;
+    }
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return CountedAlloc(size, true);
+    } catch (...) {
+        return nullptr;
+    }
+}
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, std::size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+#endif
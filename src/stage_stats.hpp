@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// CPU time and heap allocations per pipeline stage, to tell which stage
+// grows when the process does. Each thread is tagged with its stage once;
+// until then it counts as Other. CPU time comes from the thread CPU clocks,
+// and is always available. Allocations are counted by a global operator new
+// hook compiled in with -DCQG_ALLOC_STATS=ON. The hook keeps its counters
+// per thread, so it takes no lock and shares no cache line with other
+// threads. Counts are approximate while threads start and exit.
+enum class EStage : uint8_t { Io, Reader, Writer, Other };
+constexpr size_t kStageCount = 4;
+
+const char* StageName(EStage stage);
+
+// Accounts the calling thread's CPU time and allocations to stage from now on.
+void SetThreadStage(EStage stage);
+
+struct SStageStats {
+    uint64_t cpu_ns = 0;
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+    uint64_t frees = 0;
+    uint64_t freed_bytes = 0;
+    uint32_t threads = 0;  // live threads tagged with the stage
+};
+using StageStats = std::array<SStageStats, kStageCount>;
+
+// Totals since start, including threads that have exited.
+StageStats StageStatsSnapshot();
+// True when the allocation hook is compiled in.
+bool StageAllocationsCounted();
+
+// "io cpu=12.5% allocs/s=1200 alloc_kb/s=96.0 threads=1 | reader ... | live_mb=41.2",
+// from two snapshots seconds apart. live_mb (allocated - freed over all
+// stages; memory moves between stages with the trades) is left out without
+// the hook.
+std::string FormatStageStats(const StageStats& before, const StageStats& now, double seconds);
@@ -0,0 +1,99 @@
+#include "thread_tuning.hpp"
+
+#include "logger.hpp"
+
+#include <cstring>
+#include <sstream>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace {
+cpu_set_t ReadProcessAffinity() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return set;
+}
+
+// Captured during static initialisation, before any thread had a chance to be pinned.
+const cpu_set_t g_initial_affinity = ReadProcessAffinity();
+
+std::string FormatCpuSet(const cpu_set_t& set) {
+    std::ostringstream oss;
+    bool first = true;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &set)) {
+            continue;
+        }
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &set)) {
+            ++last;
+        }
+        oss << (first ? "" : ",") << cpu;
+        if (last > cpu) {
+            oss << "-" << last;
+        }
+        first = false;
+        cpu = last;
+    }
+    return oss.str();
+}
+}
+
+void ApplyThreadPlacement(std::string_view role_name, const SThreadRoleConfig& role) {
+    const pthread_t self = pthread_self();
+
+    cpu_set_t set = g_initial_affinity;
+    if (!role.cpus.empty()) {
+        CPU_ZERO(&set);
+        for (int cpu : role.cpus) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    if (const int rc = pthread_setaffinity_np(self, sizeof(set), &set); rc != 0) {
+        Log(LogLevel::ERROR, "Threads", std::string(role_name) + ": failed to set affinity: " + std::strerror(rc));
+    }
+
+    sched_param param{};
+    int policy = SCHED_OTHER;
+    if (role.fifo_priority > 0) {
+        policy = SCHED_FIFO;
+        param.sched_priority = role.fifo_priority;
+    }
+    if (const int rc = pthread_setschedparam(self, policy, &param); rc != 0) {
+        Log(LogLevel::ERROR, "Threads", std::string(role_name) + ": failed to set scheduling policy: " + std::strerror(rc));
+    }
+
+    Log(LogLevel::INFO, "Threads", std::string(role_name) + " " + DescribeThreadPlacement());
+}
+
+std::string DescribeThreadPlacement() {
+    const pthread_t self = pthread_self();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    pthread_getaffinity_np(self, sizeof(set), &set);
+
+    int policy = SCHED_OTHER;
+    sched_param param{};
+    pthread_getschedparam(self, &policy, &param);
+
+    std::ostringstream oss;
+    oss << "cpus=" << FormatCpuSet(set) << " policy=";
+    switch (policy) {
+    case SCHED_FIFO:
+        oss << "SCHED_FIFO/" << param.sched_priority;
+        break;
+    case SCHED_RR:
+        oss << "SCHED_RR/" << param.sched_priority;
+        break;
+    default:
+        oss << "SCHED_OTHER";
+        break;
+    }
+    return oss.str();
+}
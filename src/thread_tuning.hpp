@@ -0,0 +1,26 @@
+#pragma once
+
+#include "config.hpp"
+
+#include <string>
+#include <string_view>
+
+// Pins the calling thread to role.cpus (or restores the affinity the process
+// started with when the list is empty) and switches it to SCHED_FIFO with
+// role.fifo_priority, or back to SCHED_OTHER when it is 0. Setting both
+// explicitly keeps threads from inheriting the placement of the thread that
+// spawned them. Failures are logged and leave the thread as it was.
+// The effective placement is logged under the given role name.
+void ApplyThreadPlacement(std::string_view role_name, const SThreadRoleConfig& role);
+
+// "cpus=0-3,6 policy=SCHED_FIFO/50" for the calling thread.
+std::string DescribeThreadPlacement();
+
+// Spin-wait hint for busy-polling loops.
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
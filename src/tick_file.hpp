@@ -0,0 +1,228 @@
+#pragma once
+// Header-only layout of the tick files written by CTickStore, plus a reader.
+// Only depends on the C++ standard library and POSIX, like shm_reader.hpp.
+//
+// One file per symbol and UTC day: <dir>/<SYMBOL>/<YYYYMMDD>.ticks. A file is
+// a page-aligned header followed by fixed-width records in arrival order.
+// The header holds the number of committed records, which the writer
+// advances with a release store after each record. It also holds a sparse
+// time index with one slot per minute of the day: the number of the first
+// record written at or after the start of that minute. A time-range scan
+// looks up two slots and reads the records in between, a contiguous array.
+// The scan assumes that a symbol's trade timestamps do not go backwards,
+// which is how exchanges deliver them.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr uint32_t kTickMagic = 0x4B434954;  // "TICK"
+constexpr uint32_t kTickVersion = 1;
+constexpr uint64_t kTickDayMs = 86400000;
+constexpr uint64_t kTickIndexBucketMs = 60000;
+constexpr size_t kTickIndexBuckets = kTickDayMs / kTickIndexBucketMs;
+constexpr uint64_t kTickIndexUnset = ~0ull;
+constexpr size_t kTickSymbolSize = 32;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "tick files need lock-free 64-bit atomics");
+
+struct STickRecord {
+    uint64_t timestamp;
+    double price;
+    double quantity;
+    uint64_t last_trade_id;  // 0 when unknown
+    uint32_t trade_count;    // trades the record stands for; the ids are last - count + 1 .. last
+    uint8_t buyer_initiated;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(STickRecord) == 40, "tick records are 40 bytes");
+
+struct STickFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t index_bucket_ms;
+    uint64_t day_start_ms;
+    uint64_t capacity;  // records the file has room for
+    uint64_t records_offset;
+    uint64_t next_bucket;  // first index slot the writer has not filled yet
+    char symbol[kTickSymbolSize];
+    alignas(64) std::atomic<uint64_t> count;
+    uint64_t index[kTickIndexBuckets];
+};
+
+constexpr uint64_t kTickRecordsOffset = (sizeof(STickFileHeader) + 4095) / 4096 * 4096;
+
+inline uint64_t TickFileSize(uint64_t capacity) {
+    return kTickRecordsOffset + capacity * sizeof(STickRecord);
+}
+
+// "YYYYMMDD" of the UTC day containing timestamp_ms.
+inline std::string TickDayName(uint64_t timestamp_ms) {
+    const std::time_t seconds = static_cast<std::time_t>(timestamp_ms / 1000);
+    std::tm tm{};
+    ::gmtime_r(&seconds, &tm);
+    char buf[16];
+    std::strftime(buf, sizeof(buf), "%Y%m%d", &tm);
+    return buf;
+}
+
+// Directory name of a symbol: '/' and NUL cannot appear in a path component.
+inline std::string TickSymbolDir(std::string symbol) {
+    for (auto& c : symbol) {
+        c = c == '/' ? '_' : c;
+    }
+    return symbol;
+}
+
+inline std::filesystem::path TickFilePath(const std::string& dir, const std::string& symbol, uint64_t timestamp_ms) {
+    return std::filesystem::path(dir) / TickSymbolDir(symbol) / (TickDayName(timestamp_ms) + ".ticks");
+}
+
+// Read-only mapping of one tick file. The records committed at Open() time
+// are visible; Refresh() picks up what the writer added since, as far as the
+// mapping reaches.
+class CTickFileReader {
+public:
+    CTickFileReader() = default;
+    ~CTickFileReader() { Close(); }
+    CTickFileReader(const CTickFileReader&) = delete;
+    CTickFileReader& operator=(const CTickFileReader&) = delete;
+
+    bool Open(const std::string& path) {
+        Close();
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < kTickRecordsOffset) {
+            ::close(fd);
+            return false;
+        }
+        void* addr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        m_size = static_cast<size_t>(st.st_size);
+        m_header = static_cast<const STickFileHeader*>(addr);
+        if (m_header->magic != kTickMagic || m_header->version != kTickVersion ||
+            m_header->record_size != sizeof(STickRecord) || m_header->records_offset != kTickRecordsOffset) {
+            Close();
+            return false;
+        }
+        m_records = reinterpret_cast<const STickRecord*>(static_cast<const char*>(addr) + kTickRecordsOffset);
+        // Sequential scans: let the kernel read ahead aggressively.
+        ::madvise(addr, m_size, MADV_SEQUENTIAL);
+        Refresh();
+        return true;
+    }
+
+    void Close() {
+        if (m_header) {
+            ::munmap(const_cast<STickFileHeader*>(m_header), m_size);
+        }
+        m_header = nullptr;
+        m_records = nullptr;
+        m_size = 0;
+        m_count = 0;
+    }
+
+    void Refresh() {
+        const uint64_t mapped = (m_size - kTickRecordsOffset) / sizeof(STickRecord);
+        const uint64_t count = m_header->count.load(std::memory_order_acquire);
+        m_count = count < mapped ? count : mapped;
+    }
+
+    uint64_t Count() const { return m_count; }
+    const STickRecord* Records() const { return m_records; }
+    uint64_t DayStartMs() const { return m_header->day_start_ms; }
+    std::string Symbol() const { return std::string(m_header->symbol, ::strnlen(m_header->symbol, kTickSymbolSize)); }
+
+    // Records [first, last) that may fall in [from_ms, to_ms), from the index.
+    // Callers still filter by timestamp at the edges.
+    void Bounds(uint64_t from_ms, uint64_t to_ms, uint64_t& first, uint64_t& last) const {
+        first = Slot(from_ms);
+        // The bucket after the one holding the last millisecond of the range.
+        last = to_ms == 0 ? 0 : to_ms - 1 >= m_header->day_start_ms + kTickDayMs - kTickIndexBucketMs
+                                    ? m_count
+                                    : Slot(to_ms - 1 + kTickIndexBucketMs);
+        if (first > last) {
+            first = last;
+        }
+    }
+
+    // Calls fn(const STickRecord&) for every record with from_ms <= timestamp < to_ms.
+    template <typename FVisit>
+    uint64_t Scan(uint64_t from_ms, uint64_t to_ms, FVisit&& fn) const {
+        uint64_t first = 0;
+        uint64_t last = 0;
+        Bounds(from_ms, to_ms, first, last);
+        uint64_t visited = 0;
+        for (uint64_t i = first; i < last; ++i) {
+            const STickRecord& record = m_records[i];
+            if (record.timestamp >= from_ms && record.timestamp < to_ms) {
+                fn(record);
+                ++visited;
+            }
+        }
+        return visited;
+    }
+
+private:
+    // First record at or after the start of the bucket holding timestamp_ms.
+    uint64_t Slot(uint64_t timestamp_ms) const {
+        if (timestamp_ms <= m_header->day_start_ms) {
+            return 0;
+        }
+        const uint64_t bucket = (timestamp_ms - m_header->day_start_ms) / kTickIndexBucketMs;
+        if (bucket >= kTickIndexBuckets) {
+            return m_count;
+        }
+        const uint64_t slot = m_header->index[bucket];
+        return slot == kTickIndexUnset || slot > m_count ? m_count : slot;
+    }
+
+    const STickFileHeader* m_header = nullptr;
+    const STickRecord* m_records = nullptr;
+    size_t m_size = 0;
+    uint64_t m_count = 0;
+};
+
+// Calls fn(const STickRecord&) for every record of symbol with
+// from_ms <= timestamp < to_ms, day file by day file in date order. Returns
+// the number of records visited; a missing symbol visits nothing.
+template <typename FVisit>
+uint64_t ScanTicks(const std::string& dir, const std::string& symbol, uint64_t from_ms, uint64_t to_ms, FVisit&& fn) {
+    std::error_code ec;
+    std::vector<std::string> days;
+    for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path(dir) / TickSymbolDir(symbol), ec)) {
+        if (entry.path().extension() == ".ticks") {
+            days.push_back(entry.path().string());
+        }
+    }
+    // YYYYMMDD names sort by date.
+    std::sort(days.begin(), days.end());
+    uint64_t visited = 0;
+    CTickFileReader reader;
+    for (const auto& path : days) {
+        if (reader.Open(path) && reader.DayStartMs() < to_ms && reader.DayStartMs() + kTickDayMs > from_ms) {
+            visited += reader.Scan(from_ms, to_ms, fn);
+        }
+    }
+    return visited;
+}
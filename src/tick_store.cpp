@@ -0,0 +1,225 @@
+#include "tick_store.hpp"
+
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+CTickStore::CTickStore(std::string dir, uint64_t file_records)
+    : m_dir(std::move(dir)), m_file_records(file_records > 0 ? file_records : 1) {}
+
+CTickStore::~CTickStore() {
+    for (auto& entry : m_symbols) {
+        for (auto& file : entry.second.files) {
+            Close(file);
+        }
+    }
+    if (m_written > 0 || m_dropped > 0) {
+        Log(LogLevel::INFO, "Ticks", "Wrote " + std::to_string(m_written) + " ticks to " + m_dir +
+                                         (m_dropped > 0 ? ", dropped " + std::to_string(m_dropped) : ""));
+    }
+}
+
+bool CTickStore::Append(const STrade& trade) {
+    STickRecord record{};
+    record.timestamp = trade.timestamp;
+    record.price = trade.price;
+    record.quantity = trade.quantity;
+    record.last_trade_id = trade.last_trade_id;
+    record.trade_count = static_cast<uint32_t>(trade.TradeCount());
+    record.buyer_initiated = trade.buyer_initiated ? 1 : 0;
+    return Append(Symbol(trade.symbol), record);
+}
+
+void CTickStore::Append(const STradeBlock& block) {
+    // One map lookup per symbol and block instead of one per trade.
+    m_block_symbols.assign(block.symbols.size(), nullptr);
+    STickRecord record{};
+    for (size_t i = 0; i < block.Size(); ++i) {
+        const uint32_t index = block.symbol_index[i];
+        auto*& files = m_block_symbols[index];
+        if (!files) {
+            files = &Symbol(block.symbols[index]);
+        }
+        record.timestamp = block.timestamp[i];
+        record.price = block.price[i];
+        record.quantity = block.quantity[i];
+        record.last_trade_id = block.last_trade_id[i];
+        record.trade_count = static_cast<uint32_t>(block.trade_count[i]);
+        record.buyer_initiated = block.buyer_initiated[i];
+        Append(*files, record);
+    }
+}
+
+CTickStore::SSymbolFiles& CTickStore::Symbol(const std::string& symbol) {
+    auto it = m_symbols.find(symbol);
+    if (it == m_symbols.end()) {
+        it = m_symbols.emplace(symbol, SSymbolFiles{}).first;
+        it->second.symbol = symbol;
+    }
+    return it->second;
+}
+
+bool CTickStore::Append(SSymbolFiles& files, const STickRecord& record) {
+    SFile* file = FileFor(files, record.timestamp);
+    if (!file) {
+        ++m_dropped;
+        return false;
+    }
+    const uint64_t n = file->header->count.load(std::memory_order_relaxed);
+    if (n == file->header->capacity && !Grow(*file, files.symbol)) {
+        ++m_dropped;
+        return false;
+    }
+    // Grow() may have moved the mapping.
+    STickFileHeader& header = *file->header;
+    file->records[n] = record;
+    // Every minute up to this record's starts here, including minutes without trades.
+    const uint64_t bucket = (record.timestamp - file->day_start_ms) / kTickIndexBucketMs;
+    while (header.next_bucket <= bucket) {
+        header.index[header.next_bucket++] = n;
+    }
+    header.count.store(n + 1, std::memory_order_release);
+    ++m_written;
+    return true;
+}
+
+CTickStore::SFile* CTickStore::FileFor(SSymbolFiles& files, uint64_t timestamp_ms) {
+    const uint64_t day_start_ms = timestamp_ms / kTickDayMs * kTickDayMs;
+    for (auto& file : files.files) {
+        if (file.header && file.day_start_ms == day_start_ms) {
+            return &file;
+        }
+    }
+    if (files.failed_day_ms == day_start_ms) {
+        return nullptr;
+    }
+    // Replace the older day.
+    SFile& slot = !files.files[0].header ? files.files[0]
+                : !files.files[1].header ? files.files[1]
+                : files.files[0].day_start_ms < files.files[1].day_start_ms ? files.files[0] : files.files[1];
+    Close(slot);
+    if (!Open(files.symbol, day_start_ms, slot)) {
+        files.failed_day_ms = day_start_ms;
+        return nullptr;
+    }
+    return &slot;
+}
+
+bool CTickStore::Open(const std::string& symbol, uint64_t day_start_ms, SFile& file) {
+    const auto path = TickFilePath(m_dir, symbol, day_start_ms);
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    if (ec) {
+        Log(LogLevel::ERROR, "Ticks", "Cannot create " + path.parent_path().string() + ": " + ec.message());
+        return false;
+    }
+    file.fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (file.fd < 0) {
+        Log(LogLevel::ERROR, "Ticks", "open " + path.string() + " failed: " + std::strerror(errno));
+        return false;
+    }
+    struct stat st {};
+    if (::fstat(file.fd, &st) != 0) {
+        Log(LogLevel::ERROR, "Ticks", "fstat " + path.string() + " failed: " + std::strerror(errno));
+        Close(file);
+        return false;
+    }
+    file.day_start_ms = day_start_ms;
+
+    if (st.st_size > 0) {
+        // Resume an existing file where the last run stopped.
+        if (static_cast<uint64_t>(st.st_size) < kTickRecordsOffset) {
+            Log(LogLevel::ERROR, "Ticks", "Not a tick file, leaving it alone: " + path.string());
+            Close(file);
+            return false;
+        }
+        if (!Map(file, static_cast<size_t>(st.st_size), path.string())) {
+            return false;
+        }
+        const STickFileHeader& header = *file.header;
+        if (header.magic != kTickMagic ||
+            header.version != kTickVersion || header.record_size != sizeof(STickRecord) ||
+            header.day_start_ms != day_start_ms || TickFileSize(header.capacity) > static_cast<uint64_t>(st.st_size) ||
+            header.count.load(std::memory_order_relaxed) > header.capacity) {
+            Log(LogLevel::ERROR, "Ticks", "Not a tick file for this day, leaving it alone: " + path.string());
+            Close(file);
+            return false;
+        }
+        Log(LogLevel::INFO, "Ticks", "Appending to " + path.string() + " after " +
+                                         std::to_string(header.count.load(std::memory_order_relaxed)) + " ticks");
+        return true;
+    }
+
+    const uint64_t size = TickFileSize(m_file_records);
+    if (::ftruncate(file.fd, static_cast<off_t>(size)) != 0) {
+        Log(LogLevel::ERROR, "Ticks", "ftruncate " + path.string() + " failed: " + std::strerror(errno));
+        Close(file);
+        return false;
+    }
+    // Reserve the blocks up front so appends do not fault into block allocation; best effort.
+    ::fallocate(file.fd, 0, 0, static_cast<off_t>(size));
+    if (!Map(file, static_cast<size_t>(size), path.string())) {
+        return false;
+    }
+    STickFileHeader& header = *file.header;
+    header.version = kTickVersion;
+    header.record_size = sizeof(STickRecord);
+    header.index_bucket_ms = kTickIndexBucketMs;
+    header.day_start_ms = day_start_ms;
+    header.capacity = m_file_records;
+    header.records_offset = kTickRecordsOffset;
+    header.next_bucket = 0;
+    std::memset(header.symbol, 0, sizeof(header.symbol));
+    std::memcpy(header.symbol, symbol.data(), std::min(symbol.size(), sizeof(header.symbol)));
+    std::memset(header.index, 0xFF, sizeof(header.index));
+    header.count.store(0, std::memory_order_relaxed);
+    // Readers validate the magic, so it is written last.
+    std::atomic_thread_fence(std::memory_order_release);
+    header.magic = kTickMagic;
+    return true;
+}
+
+bool CTickStore::Map(SFile& file, size_t size, const std::string& path) {
+    void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd, 0);
+    if (addr == MAP_FAILED) {
+        Log(LogLevel::ERROR, "Ticks", "mmap " + path + " failed: " + std::strerror(errno));
+        Close(file);
+        return false;
+    }
+    file.header = static_cast<STickFileHeader*>(addr);
+    file.records = reinterpret_cast<STickRecord*>(static_cast<char*>(addr) + kTickRecordsOffset);
+    file.size = size;
+    return true;
+}
+
+bool CTickStore::Grow(SFile& file, const std::string& symbol) {
+    const uint64_t capacity = file.header->capacity * 2;
+    const uint64_t size = TickFileSize(capacity);
+    const auto path = TickFilePath(m_dir, symbol, file.day_start_ms).string();
+    if (::ftruncate(file.fd, static_cast<off_t>(size)) != 0) {
+        Log(LogLevel::ERROR, "Ticks", "ftruncate " + path + " failed: " + std::strerror(errno));
+        return false;
+    }
+    ::fallocate(file.fd, 0, static_cast<off_t>(file.size), static_cast<off_t>(size - file.size));
+    ::munmap(file.header, file.size);
+    file.header = nullptr;
+    if (!Map(file, static_cast<size_t>(size), path)) {
+        return false;
+    }
+    // Readers only look past the old capacity once they remap.
+    file.header->capacity = capacity;
+    return true;
+}
+
+void CTickStore::Close(SFile& file) {
+    if (file.header) {
+        ::munmap(file.header, file.size);
+    }
+    if (file.fd >= 0) {
+        ::close(file.fd);
+    }
+    file = SFile{};
+}
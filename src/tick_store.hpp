@@ -0,0 +1,76 @@
+#pragma once
+
+#include "tick_file.hpp"
+#include "trade.hpp"
+#include "trade_block.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Appends every trade the reader thread takes off the queue to the tick
+// files described in tick_file.hpp. Files are preallocated, mapped and
+// written in place, so a trade costs a 40-byte store and a release of the
+// record count; the kernel writes the pages back. Only the reader thread
+// calls Append; readers in other processes map the files read-only.
+//
+// A full file is grown to twice its capacity. An existing file is reopened
+// and appended to, so restarts keep one file per symbol and day. Errors are
+// logged once per file and the trades are counted as dropped: the tick store
+// never stops the feed.
+class CTickStore {
+public:
+    CTickStore(std::string dir, uint64_t file_records);
+    ~CTickStore();
+
+    CTickStore(const CTickStore&) = delete;
+    CTickStore& operator=(const CTickStore&) = delete;
+
+    bool Append(const STrade& trade);
+    void Append(const STradeBlock& block);
+
+    uint64_t Written() const { return m_written; }
+    uint64_t Dropped() const { return m_dropped; }
+
+private:
+    struct SFile {
+        uint64_t day_start_ms = kTickIndexUnset;
+        int fd = -1;
+        STickFileHeader* header = nullptr;
+        STickRecord* records = nullptr;
+        size_t size = 0;
+    };
+    // Trades arrive in time order, so a symbol writes to at most today's and
+    // yesterday's file around midnight.
+    struct SSymbolFiles {
+        std::string symbol;
+        SFile files[2];
+        uint64_t failed_day_ms = kTickIndexUnset;  // day whose file could not be opened
+    };
+
+    SSymbolFiles& Symbol(const std::string& symbol);
+    bool Append(SSymbolFiles& files, const STickRecord& record);
+    SFile* FileFor(SSymbolFiles& files, uint64_t timestamp_ms);
+    bool Open(const std::string& symbol, uint64_t day_start_ms, SFile& file);
+    bool Map(SFile& file, size_t size, const std::string& path);
+    bool Grow(SFile& file, const std::string& symbol);
+    static void Close(SFile& file);
+
+    const std::string m_dir;
+    const uint64_t m_file_records;
+    std::unordered_map<std::string, SSymbolFiles> m_symbols;
+    std::vector<SSymbolFiles*> m_block_symbols;  // by STradeBlock::symbol_index, rebuilt per block
+    uint64_t m_written = 0;
+    uint64_t m_dropped = 0;
+};
+
+// The trade a tick record was written from.
+inline STrade TickToTrade(const std::string& symbol, const STickRecord& record) {
+    STrade trade{symbol, record.price, record.quantity, record.timestamp, record.buyer_initiated != 0};
+    if (record.last_trade_id != 0) {
+        trade.last_trade_id = record.last_trade_id;
+        trade.first_trade_id = record.last_trade_id - (record.trade_count > 0 ? record.trade_count - 1 : 0);
+    }
+    return trade;
+}
@@ -0,0 +1,220 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace trace_detail {
+std::atomic<uint32_t> g_sample_every{0};
+}
+
+namespace {
+constexpr size_t kMaxTraceThreads = 128;
+
+struct SSpan {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start_ns{0};
+    std::atomic<uint64_t> end_ns{0};
+    std::atomic<uint64_t> sample{0};
+    std::atomic<bool> trade{false};
+};
+
+struct SSpanCopy {
+    const char* name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t sample;
+    bool trade;
+};
+
+// Single writer. claimed moves before a slot is rewritten and head after,
+// so a reader can tell which of the slots it copied were overwritten
+// meanwhile (the seqlock pattern, per ring rather than per slot).
+class CTraceRing {
+public:
+    CTraceRing(size_t capacity, const char* name)
+        : m_spans(new SSpan[capacity]), m_mask(capacity - 1), m_tid(static_cast<long>(::syscall(SYS_gettid))) {
+        m_name.store(name, std::memory_order_relaxed);
+    }
+
+    void Record(const char* name, uint64_t start_ns, uint64_t end_ns, uint64_t sample, bool trade) {
+        const uint64_t head = m_head.load(std::memory_order_relaxed);
+        m_claimed.store(head + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        SSpan& span = m_spans[head & m_mask];
+        span.name.store(name, std::memory_order_relaxed);
+        span.start_ns.store(start_ns, std::memory_order_relaxed);
+        span.end_ns.store(end_ns, std::memory_order_relaxed);
+        span.sample.store(sample, std::memory_order_relaxed);
+        span.trade.store(trade, std::memory_order_relaxed);
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+    void Copy(std::vector<SSpanCopy>& out) const {
+        const uint64_t capacity = m_mask + 1;
+        const uint64_t head = m_head.load(std::memory_order_acquire);
+        const uint64_t first = head > capacity ? head - capacity : 0;
+        const size_t begin = out.size();
+        for (uint64_t i = first; i < head; ++i) {
+            const SSpan& span = m_spans[i & m_mask];
+            out.push_back({span.name.load(std::memory_order_relaxed), span.start_ns.load(std::memory_order_relaxed),
+                           span.end_ns.load(std::memory_order_relaxed), span.sample.load(std::memory_order_relaxed),
+                           span.trade.load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t claimed = m_claimed.load(std::memory_order_relaxed);
+        const uint64_t valid = claimed > capacity ? claimed - capacity : 0;
+        if (valid > first) {
+            const auto stale = static_cast<size_t>(std::min(valid, head) - first);
+            out.erase(out.begin() + static_cast<std::ptrdiff_t>(begin),
+                      out.begin() + static_cast<std::ptrdiff_t>(begin + stale));
+        }
+    }
+
+    void SetName(const char* name) { m_name.store(name, std::memory_order_relaxed); }
+    const char* Name() const { return m_name.load(std::memory_order_relaxed); }
+    long Tid() const { return m_tid; }
+
+private:
+    std::unique_ptr<SSpan[]> m_spans;
+    const uint64_t m_mask;
+    const long m_tid;
+    std::atomic<const char*> m_name{nullptr};
+    alignas(64) std::atomic<uint64_t> m_head{0};
+    std::atomic<uint64_t> m_claimed{0};
+};
+
+std::atomic<size_t> g_ring_events{65536};
+std::atomic<uint64_t> g_next_sample{0};
+// Rings live for the process, so the spans of threads that exited (a writer
+// restarted by a reload) are still in the next dump.
+std::atomic<CTraceRing*> g_rings[kMaxTraceThreads];
+std::atomic<size_t> g_ring_count{0};
+
+thread_local CTraceRing* t_ring = nullptr;
+thread_local bool t_no_ring = false;  // the registry was full
+thread_local const char* t_name = nullptr;
+thread_local uint64_t t_pushes = 0;
+thread_local uint64_t t_samples = 0;
+thread_local uint64_t t_last_sample = 0;
+
+CTraceRing* ThreadRing() {
+    if (t_ring || t_no_ring) {
+        return t_ring;
+    }
+    const size_t index = g_ring_count.fetch_add(1, std::memory_order_relaxed);
+    if (index >= kMaxTraceThreads) {
+        t_no_ring = true;
+        return nullptr;
+    }
+    t_ring = new CTraceRing(g_ring_events.load(std::memory_order_relaxed), t_name);
+    g_rings[index].store(t_ring, std::memory_order_release);
+    return t_ring;
+}
+
+void Record(const char* name, uint64_t start_ns, uint64_t end_ns, uint64_t sample, bool trade) {
+    if (CTraceRing* ring = ThreadRing()) {
+        ring->Record(name, start_ns, end_ns < start_ns ? start_ns : end_ns, sample, trade);
+    }
+}
+}
+
+void ConfigureTracing(uint32_t sample_every, size_t ring_events) {
+    size_t capacity = 64;
+    while (capacity < ring_events) {
+        capacity *= 2;
+    }
+    g_ring_events.store(capacity, std::memory_order_relaxed);
+    trace_detail::g_sample_every.store(sample_every, std::memory_order_relaxed);
+}
+
+uint64_t TraceNowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void SetTraceThreadName(const char* name) {
+    t_name = name;
+    if (t_ring) {
+        t_ring->SetName(name);
+    }
+}
+
+uint64_t TraceSampleTrade() {
+    const uint32_t every = trace_detail::g_sample_every.load(std::memory_order_relaxed);
+    if (every == 0 || ++t_pushes % every != 0) {
+        return 0;
+    }
+    ++t_samples;
+    t_last_sample = g_next_sample.fetch_add(1, std::memory_order_relaxed) + 1;
+    return t_last_sample;
+}
+
+uint64_t TraceThreadSamples() { return t_samples; }
+uint64_t TraceLastSample() { return t_last_sample; }
+
+void TraceSpan(const char* name, uint64_t start_ns, uint64_t end_ns, uint64_t sample) {
+    Record(name, start_ns, end_ns, sample, false);
+}
+
+void TraceTradeSpan(const char* name, uint64_t start_ns, uint64_t end_ns, uint64_t sample) {
+    Record(name, start_ns, end_ns, sample, true);
+}
+
+long WriteTrace(const std::string& path) {
+    const std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "w");
+    if (!f) {
+        return -1;
+    }
+    const long pid = static_cast<long>(::getpid());
+    std::fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                    "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":0,\"args\":{\"name\":\"cqg\"}}",
+                 pid);
+    long written = 0;
+    std::vector<SSpanCopy> spans;
+    const size_t rings = std::min(g_ring_count.load(std::memory_order_relaxed), kMaxTraceThreads);
+    for (size_t r = 0; r < rings; ++r) {
+        const CTraceRing* ring = g_rings[r].load(std::memory_order_acquire);
+        if (!ring) {
+            continue;  // claimed, not published yet
+        }
+        const char* name = ring->Name();
+        std::fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+                     pid, ring->Tid(), name ? name : "thread");
+        spans.clear();
+        ring->Copy(spans);
+        for (const auto& span : spans) {
+            const double ts_us = static_cast<double>(span.start_ns) / 1000.0;
+            const double end_us = static_cast<double>(span.end_ns) / 1000.0;
+            if (span.trade) {
+                // Async pair on the trade's own track, keyed by the sample id.
+                std::fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"trade\",\"ph\":\"b\",\"id\":%llu,\"pid\":%ld,\"tid\":%ld,\"ts\":%.3f}"
+                                ",\n{\"name\":\"%s\",\"cat\":\"trade\",\"ph\":\"e\",\"id\":%llu,\"pid\":%ld,\"tid\":%ld,\"ts\":%.3f}",
+                             span.name, static_cast<unsigned long long>(span.sample), pid, ring->Tid(), ts_us,
+                             span.name, static_cast<unsigned long long>(span.sample), pid, ring->Tid(), end_us);
+            } else if (span.sample != 0) {
+                std::fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"cqg\",\"ph\":\"X\",\"pid\":%ld,\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f,"
+                                "\"args\":{\"sample\":%llu}}",
+                             span.name, pid, ring->Tid(), ts_us, end_us - ts_us, static_cast<unsigned long long>(span.sample));
+            } else {
+                std::fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"cqg\",\"ph\":\"X\",\"pid\":%ld,\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f}",
+                             span.name, pid, ring->Tid(), ts_us, end_us - ts_us);
+            }
+            ++written;
+        }
+    }
+    std::fprintf(f, "\n]}\n");
+    const bool ok = std::fflush(f) == 0 && !std::ferror(f);
+    std::fclose(f);
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return -1;
+    }
+    return written;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Sampled spans of the pipeline, dumped as Chrome trace-event JSON (open in
+// chrome://tracing or ui.perfetto.dev) to see where a late window's time
+// went. One trade in sample_every gets a sample id when it is pushed to the
+// trade queue; its websocket read, parse, queue wait and the reader batch
+// that aggregates it are recorded under that id, and every writer flush is
+// recorded as well. Each thread writes to its own ring of the last
+// ring_events spans (single writer, no lock); WriteTrace copies the rings
+// while they are being written and drops the spans that were overwritten
+// meanwhile. With tracing off, every call site costs the TraceEnabled()
+// branch and nothing else.
+
+namespace trace_detail {
+extern std::atomic<uint32_t> g_sample_every;
+}
+
+inline bool TraceEnabled() {
+    return trace_detail::g_sample_every.load(std::memory_order_relaxed) != 0;
+}
+
+// sample_every 0 turns tracing off. ring_events applies to the rings of
+// threads that record their first span afterwards.
+void ConfigureTracing(uint32_t sample_every, size_t ring_events);
+
+// Steady clock, the time base of all spans.
+uint64_t TraceNowNs();
+
+// Names the calling thread's track in the trace (a string literal).
+void SetTraceThreadName(const char* name);
+
+// Counts one trade pushed by the calling thread: a new sample id every
+// sample_every-th call, 0 otherwise. Ids are unique across threads.
+uint64_t TraceSampleTrade();
+// Samples taken by the calling thread so far and the last id it got, so a
+// producer can tell whether the trades it just pushed included a sample.
+uint64_t TraceThreadSamples();
+uint64_t TraceLastSample();
+
+// A span on the calling thread's track. name must be a string literal;
+// sample 0 means not tied to a trade.
+void TraceSpan(const char* name, uint64_t start_ns, uint64_t end_ns, uint64_t sample = 0);
+// A span of one sampled trade that is not work of the calling thread
+// (waiting for the network, sitting in the queue): shown on the trade's own
+// track rather than the thread's.
+void TraceTradeSpan(const char* name, uint64_t start_ns, uint64_t end_ns, uint64_t sample);
+
+// Writes every thread's ring to path (through a temporary file and a
+// rename). Returns the number of spans written, or -1 on error.
+long WriteTrace(const std::string& path);
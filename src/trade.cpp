@@ -13,6 +13,10 @@ STrade STrade::FromJson(const std::string& raw_data) {
     if (j.contains("data")) {
         j = j["data"];
     }
+    return FromJson(j);
+}
+
+STrade STrade::FromJson(const nlohmann::json& j) {
     STrade t{
         j["s"].get<std::string>(),
         std::stod(j["p"].get<std::string>()),
@@ -20,6 +24,12 @@ STrade STrade::FromJson(const std::string& raw_data) {
         j["T"].get<uint64_t>(),
         j["m"].get<bool>()
     };
+    if (const auto first = j.find("f"); first != j.end()) {
+        t.first_trade_id = first->get<uint64_t>();
+        t.last_trade_id = j.at("l").get<uint64_t>();
+    } else if (const auto id = j.find("t"); id != j.end()) {
+        t.first_trade_id = t.last_trade_id = id->get<uint64_t>();
+    }
     if (!t.IsValid()) {
         throw std::runtime_error("Invalid trade data");
     }
@@ -10,7 +10,18 @@ struct STrade {
     double quantity;
     uint64_t timestamp;
     bool buyer_initiated;
+    // Exchange trade id range covered by this record: t..t for @trade,
+    // f..l for @aggTrade. Both 0 when unknown.
+    uint64_t first_trade_id = 0;
+    uint64_t last_trade_id = 0;
 
     bool IsValid() const;
+    // Number of exchange trades this record stands for; 1 unless it carries an id range.
+    uint64_t TradeCount() const {
+        return last_trade_id >= first_trade_id && last_trade_id != 0 ? last_trade_id - first_trade_id + 1 : 1;
+    }
     static STrade FromJson(const std::string& raw_data);
+    // Takes an already parsed trade object (the "data" member of a combined-stream
+    // frame); both @trade and @aggTrade payloads are accepted.
+    static STrade FromJson(const nlohmann::json& j);
 };
\ No newline at end of file
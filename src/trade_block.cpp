@@ -0,0 +1,221 @@
+#include "trade_block.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define CQG_HAVE_AVX2_PATH 1
+#endif
+
+void STradeBlock::Reserve(size_t trades) {
+    symbol_index.reserve(trades);
+    price.reserve(trades);
+    quantity.reserve(trades);
+    timestamp.reserve(trades);
+    trade_count.reserve(trades);
+    buyer_initiated.reserve(trades);
+    first_trade_id.reserve(trades);
+    last_trade_id.reserve(trades);
+}
+
+void STradeBlock::Clear() {
+    symbol_index.clear();
+    price.clear();
+    quantity.clear();
+    timestamp.clear();
+    trade_count.clear();
+    buyer_initiated.clear();
+    first_trade_id.clear();
+    last_trade_id.clear();
+    trace_sample = 0;
+}
+
+uint32_t STradeBlock::Intern(const std::string& symbol) {
+    // Consecutive trades are often for the same symbol; otherwise a probe of
+    // a small open-addressed table keyed by the cached hashes.
+    const size_t hash = std::hash<std::string>{}(symbol);
+    if (m_last_symbol < symbols.size() && m_symbol_hashes[m_last_symbol] == hash &&
+        symbols[m_last_symbol] == symbol) {
+        return m_last_symbol;
+    }
+    if (!m_slots.empty()) {
+        const size_t mask = m_slots.size() - 1;
+        for (size_t slot = hash & mask; m_slots[slot] != 0; slot = (slot + 1) & mask) {
+            const uint32_t index = m_slots[slot] - 1;
+            if (m_symbol_hashes[index] == hash && symbols[index] == symbol) {
+                m_last_symbol = index;
+                return index;
+            }
+        }
+    }
+    symbols.push_back(symbol);
+    m_symbol_hashes.push_back(hash);
+    m_last_symbol = static_cast<uint32_t>(symbols.size() - 1);
+    if (symbols.size() * 2 > m_slots.size()) {
+        // Keep the load factor at or below one half.
+        m_slots.assign(std::max<size_t>(16, m_slots.size() * 2), 0);
+        for (uint32_t index = 0; index < symbols.size(); ++index) {
+            InsertSlot(index);
+        }
+    } else {
+        InsertSlot(m_last_symbol);
+    }
+    return m_last_symbol;
+}
+
+void STradeBlock::InsertSlot(uint32_t index) {
+    const size_t mask = m_slots.size() - 1;
+    size_t slot = m_symbol_hashes[index] & mask;
+    while (m_slots[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    m_slots[slot] = index + 1;
+}
+
+bool STradeBlock::Append(const STrade& trade) {
+    if (!trade.IsValid()) {
+        return false;
+    }
+    symbol_index.push_back(Intern(trade.symbol));
+    price.push_back(trade.price);
+    quantity.push_back(trade.quantity);
+    timestamp.push_back(trade.timestamp);
+    trade_count.push_back(trade.TradeCount());
+    buyer_initiated.push_back(trade.buyer_initiated ? 1 : 0);
+    first_trade_id.push_back(trade.first_trade_id);
+    last_trade_id.push_back(trade.last_trade_id);
+    return true;
+}
+
+STrade STradeBlock::At(size_t i) const {
+    STrade trade{symbols[symbol_index[i]], price[i], quantity[i], timestamp[i], buyer_initiated[i] != 0};
+    trade.first_trade_id = first_trade_id[i];
+    trade.last_trade_id = last_trade_id[i];
+    return trade;
+}
+
+STradeReduction ReduceTradesPortable(const double* price, const double* quantity, const uint64_t* trade_count,
+                                     const uint8_t* buyer_initiated, size_t n) {
+    // Four independent lanes: no loop-carried dependency on a single
+    // accumulator, and a shape the compiler can map to vector registers.
+    constexpr size_t kLanes = 4;
+    double qty[kLanes] = {};
+    double vol[kLanes] = {};
+    double lo[kLanes];
+    double hi[kLanes];
+    uint64_t count[kLanes] = {};
+    uint64_t buyer[kLanes] = {};
+    std::fill(lo, lo + kLanes, std::numeric_limits<double>::max());
+    std::fill(hi, hi + kLanes, std::numeric_limits<double>::lowest());
+    size_t i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+        for (size_t l = 0; l < kLanes; ++l) {
+            const double p = price[i + l];
+            qty[l] += quantity[i + l];
+            vol[l] += p * quantity[i + l];
+            lo[l] = std::min(lo[l], p);
+            hi[l] = std::max(hi[l], p);
+            count[l] += trade_count[i + l];
+            buyer[l] += trade_count[i + l] & (0 - static_cast<uint64_t>(buyer_initiated[i + l]));
+        }
+    }
+    for (size_t l = 0; i < n; ++i, l = (l + 1) % kLanes) {
+        qty[l] += quantity[i];
+        vol[l] += price[i] * quantity[i];
+        lo[l] = std::min(lo[l], price[i]);
+        hi[l] = std::max(hi[l], price[i]);
+        count[l] += trade_count[i];
+        buyer[l] += buyer_initiated[i] ? trade_count[i] : 0;
+    }
+    STradeReduction r;
+    for (size_t l = 0; l < kLanes; ++l) {
+        r.total_quantity += qty[l];
+        r.total_volume += vol[l];
+        r.min_price = std::min(r.min_price, lo[l]);
+        r.max_price = std::max(r.max_price, hi[l]);
+        r.trades_count += count[l];
+        r.buyer_initiated_count += buyer[l];
+    }
+    return r;
+}
+
+#if defined(CQG_HAVE_AVX2_PATH)
+namespace {
+__attribute__((target("avx2")))
+STradeReduction ReduceTradesAvx2(const double* price, const double* quantity, const uint64_t* trade_count,
+                                 const uint8_t* buyer_initiated, size_t n) {
+    __m256d qty = _mm256_setzero_pd();
+    __m256d vol = _mm256_setzero_pd();
+    __m256d lo = _mm256_set1_pd(std::numeric_limits<double>::max());
+    __m256d hi = _mm256_set1_pd(std::numeric_limits<double>::lowest());
+    __m256i count = _mm256_setzero_si256();
+    __m256i buyer = _mm256_setzero_si256();
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d p = _mm256_loadu_pd(price + i);
+        const __m256d q = _mm256_loadu_pd(quantity + i);
+        qty = _mm256_add_pd(qty, q);
+        vol = _mm256_add_pd(vol, _mm256_mul_pd(p, q));
+        lo = _mm256_min_pd(lo, p);
+        hi = _mm256_max_pd(hi, p);
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(trade_count + i));
+        count = _mm256_add_epi64(count, c);
+        // Four 0/1 flags widened to 64-bit lanes, then turned into all-ones / zero masks.
+        int32_t flags;
+        __builtin_memcpy(&flags, buyer_initiated + i, sizeof(flags));
+        const __m256i mask = _mm256_sub_epi64(zero, _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(flags)));
+        buyer = _mm256_add_epi64(buyer, _mm256_and_si256(c, mask));
+    }
+    alignas(32) double qty_lanes[4];
+    alignas(32) double vol_lanes[4];
+    alignas(32) double lo_lanes[4];
+    alignas(32) double hi_lanes[4];
+    alignas(32) uint64_t count_lanes[4];
+    alignas(32) uint64_t buyer_lanes[4];
+    _mm256_store_pd(qty_lanes, qty);
+    _mm256_store_pd(vol_lanes, vol);
+    _mm256_store_pd(lo_lanes, lo);
+    _mm256_store_pd(hi_lanes, hi);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(count_lanes), count);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(buyer_lanes), buyer);
+    STradeReduction r;
+    for (size_t l = 0; l < 4; ++l) {
+        r.total_quantity += qty_lanes[l];
+        r.total_volume += vol_lanes[l];
+        r.min_price = std::min(r.min_price, lo_lanes[l]);
+        r.max_price = std::max(r.max_price, hi_lanes[l]);
+        r.trades_count += count_lanes[l];
+        r.buyer_initiated_count += buyer_lanes[l];
+    }
+    for (; i < n; ++i) {
+        r.total_quantity += quantity[i];
+        r.total_volume += price[i] * quantity[i];
+        r.min_price = std::min(r.min_price, price[i]);
+        r.max_price = std::max(r.max_price, price[i]);
+        r.trades_count += trade_count[i];
+        r.buyer_initiated_count += buyer_initiated[i] ? trade_count[i] : 0;
+    }
+    return r;
+}
+}
+#endif
+
+bool ReduceTradesUsesAvx2() {
+#if defined(CQG_HAVE_AVX2_PATH)
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+STradeReduction ReduceTrades(const double* price, const double* quantity, const uint64_t* trade_count,
+                             const uint8_t* buyer_initiated, size_t n) {
+#if defined(CQG_HAVE_AVX2_PATH)
+    if (ReduceTradesUsesAvx2()) {
+        return ReduceTradesAvx2(price, quantity, trade_count, buyer_initiated, n);
+    }
+#endif
+    return ReduceTradesPortable(price, quantity, trade_count, buyer_initiated, n);
+}
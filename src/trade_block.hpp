@@ -0,0 +1,65 @@
+#pragma once
+
+#include "trade.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+// A batch of trades in structure-of-arrays layout, handed from the queue to
+// the aggregator in one piece. Symbols are interned: symbol_index points into
+// symbols, which survives Clear() so a steady feed does not copy symbol
+// strings. Invalid trades are rejected by Append, so consumers can reduce
+// the columns without per-trade checks.
+struct STradeBlock {
+    std::vector<std::string> symbols;
+    std::vector<uint32_t> symbol_index;
+    std::vector<double> price;
+    std::vector<double> quantity;
+    std::vector<uint64_t> timestamp;
+    std::vector<uint64_t> trade_count;      // STrade::TradeCount()
+    std::vector<uint8_t> buyer_initiated;   // 0 / 1
+    std::vector<uint64_t> first_trade_id;
+    std::vector<uint64_t> last_trade_id;
+    uint64_t trace_sample = 0;  // a traced trade in this batch (trace.hpp), 0 = none
+
+    size_t Size() const { return price.size(); }
+    bool Empty() const { return price.empty(); }
+    void Reserve(size_t trades);
+    // Drops the trades, keeps the interned symbols and the capacity.
+    void Clear();
+    // False (and nothing appended) for an invalid trade.
+    bool Append(const STrade& trade);
+    STrade At(size_t i) const;
+
+private:
+    uint32_t Intern(const std::string& symbol);
+    void InsertSlot(uint32_t index);
+    std::vector<size_t> m_symbol_hashes;  // parallel to symbols
+    std::vector<uint32_t> m_slots;        // index + 1 into symbols, 0 = empty
+    uint32_t m_last_symbol = 0;
+};
+
+// Column reductions over n trades. buyer_initiated trades are the ones the
+// aggregator counts as sells.
+struct STradeReduction {
+    uint64_t trades_count = 0;
+    uint64_t buyer_initiated_count = 0;
+    double total_quantity = 0.0;
+    double total_volume = 0.0;
+    double min_price = std::numeric_limits<double>::max();
+    double max_price = std::numeric_limits<double>::lowest();
+};
+
+// Uses AVX2 when the CPU supports it (checked once), the portable loop otherwise.
+// Sums are accumulated in several lanes, so they can differ from a sequential
+// sum in the last bits.
+STradeReduction ReduceTrades(const double* price, const double* quantity, const uint64_t* trade_count,
+                             const uint8_t* buyer_initiated, size_t n);
+// The portable loop, regardless of the CPU; for tests and benchmarks.
+STradeReduction ReduceTradesPortable(const double* price, const double* quantity, const uint64_t* trade_count,
+                                     const uint8_t* buyer_initiated, size_t n);
+bool ReduceTradesUsesAvx2();
@@ -1,38 +1,398 @@
 #include "trade_queue.hpp"
 
+#include "trace.hpp"
+
+#include <algorithm>
+
+bool ParseOverflowPolicy(std::string_view name, EOverflowPolicy& out) {
+    if (name == "block") {
+        out = EOverflowPolicy::Block;
+    } else if (name == "drop_newest") {
+        out = EOverflowPolicy::DropNewest;
+    } else if (name == "coalesce") {
+        out = EOverflowPolicy::Coalesce;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+size_t BatchBucket(size_t trades) {
+    size_t bucket = 0;
+    while (trades > 1 && bucket + 1 < kBatchBuckets) {
+        trades >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+std::string FormatBatchHistogram(const BatchHistogram& histogram) {
+    std::string text;
+    for (size_t bucket = 0; bucket < kBatchBuckets; ++bucket) {
+        if (histogram[bucket] != 0) {
+            text += (text.empty() ? "" : " ") + std::to_string(1u << bucket) + ":" + std::to_string(histogram[bucket]);
+        }
+    }
+    return text.empty() ? "-" : text;
+}
+
 CTradeQueue::CTradeQueue() : m_stopped(false) {}
 
+CTradeQueue::CTradeQueue(size_t capacity, EOverflowPolicy policy,
+                         std::chrono::milliseconds block_timeout, uint64_t window_ms)
+    : m_stopped(false),
+      m_capacity(capacity),
+      m_policy(policy),
+      m_block_timeout(block_timeout),
+      m_window_ms(std::max<uint64_t>(window_ms, 1)) {}
+
 void CTradeQueue::Push(STrade trade) {
+    bool notify = false;
     {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (m_stopped) {
-            return;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::chrono::steady_clock::time_point deadline{};
+        if (PushLocked(lock, trade, nullptr, deadline)) {
+            ++m_stats.pushed[0];
+            notify = m_waiting_consumers != 0;
         }
-        m_queue.push(std::move(trade));
     }
-    m_cond.notify_one();
+    if (notify) {
+        m_cond.notify_one();
+    }
 }
 
-bool CTradeQueue::Pop(STrade& trade) {
-    std::unique_lock<std::mutex> lock(m_mutex);
+void CTradeQueue::PushTraced(STrade trade, const STracedTrade& traced) {
+    bool notify = false;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::chrono::steady_clock::time_point deadline{};
+        if (PushLocked(lock, trade, &traced, deadline)) {
+            ++m_stats.pushed[0];
+            notify = m_waiting_consumers != 0;
+        }
+    }
+    if (notify) {
+        m_cond.notify_one();
+    }
+}
+
+void CTradeQueue::PushBatch(std::vector<STrade>& trades) {
+    PushBatchImpl(trades, nullptr);
+}
 
+void CTradeQueue::PushBatch(std::vector<STrade>& trades, std::vector<STracedTrade>& traced) {
+    PushBatchImpl(trades, &traced);
+    traced.clear();
+}
+
+void CTradeQueue::PushBatchImpl(std::vector<STrade>& trades, const std::vector<STracedTrade>* traced) {
+    static const STracedTrade kNotSampled{};
+    bool notify = false;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        size_t queued = 0;
+        size_t next_traced = 0;
+        std::chrono::steady_clock::time_point deadline{};
+        for (size_t i = 0; i < trades.size(); ++i) {
+            const STracedTrade* tag = nullptr;
+            if (traced) {
+                tag = &kNotSampled;
+                if (next_traced < traced->size() && (*traced)[next_traced].index == i) {
+                    tag = &(*traced)[next_traced++];
+                }
+            }
+            queued += PushLocked(lock, trades[i], tag, deadline) ? 1 : 0;
+        }
+        if (queued != 0) {
+            ++m_stats.pushed[BatchBucket(queued)];
+            notify = m_waiting_consumers != 0;
+        }
+    }
+    trades.clear();
+    if (notify) {
+        m_cond.notify_one();
+    }
+}
+
+bool CTradeQueue::PushLocked(std::unique_lock<std::mutex>& lock, STrade& trade, const STracedTrade* traced,
+                             std::chrono::steady_clock::time_point& deadline) {
+    // A trade sampled by its producer already has read and parse spans.
+    const auto not_queued = [traced](const char* what) {
+        if (traced && traced->sample != 0) {
+            TraceTradeSpan(what, traced->taken_ns, TraceNowNs(), traced->sample);
+        }
+        return false;
+    };
+    if (m_stopped) {
+        return not_queued("dropped");
+    }
+    if (m_capacity != 0 && m_queue.size() >= m_capacity) {
+        switch (m_policy) {
+        case EOverflowPolicy::Block: {
+            // Bounded wait: the producer is the io thread, which also has
+            // to keep answering pings and signals. One deadline per batch,
+            // so the trades left once it passed drop without waiting. A
+            // batch may have filled the queue before the consumer heard of it.
+            if (m_waiting_consumers != 0) {
+                m_cond.notify_one();
+            }
+            if (deadline == std::chrono::steady_clock::time_point{}) {
+                deadline = std::chrono::steady_clock::now() + m_block_timeout;
+            }
+            ++m_stats.blocked;
+            ++m_waiting_producers;
+            const bool has_space = m_not_full.wait_until(lock, deadline, [this]() {
+                return m_queue.size() < m_capacity || m_stopped;
+            });
+            --m_waiting_producers;
+            if (m_stopped) {
+                return not_queued("dropped");
+            }
+            if (!has_space) {
+                ++m_stats.dropped;
+                return not_queued("dropped");
+            }
+            break;
+        }
+        case EOverflowPolicy::DropNewest:
+            ++m_stats.dropped;
+            return not_queued("dropped");
+        case EOverflowPolicy::Coalesce:
+            Coalesce(trade);
+            return not_queued("coalesced");
+        }
+    }
+    m_queue.push(std::move(trade));
+    if (traced) {
+        if (traced->sample != 0) {
+            m_traced.push_back({m_pushed, traced->sample, traced->taken_ns});
+        }
+    } else if (TraceEnabled()) {
+        // Sampled once queued: a dropped or coalesced trade takes no sample id.
+        if (const uint64_t sample = TraceSampleTrade()) {
+            m_traced.push_back({m_pushed, sample, TraceNowNs()});
+        }
+    }
+    ++m_pushed;
+    m_size.store(m_queue.size(), std::memory_order_release);
+    m_stats.high_water_mark = std::max(m_stats.high_water_mark, m_queue.size());
+    return true;
+}
+
+void CTradeQueue::WaitForTradesLocked(std::unique_lock<std::mutex>& lock) {
+    if (!m_queue.empty() || m_stopped) {
+        return;
+    }
+    ++m_waiting_consumers;
     m_cond.wait(lock, [this]() {
         return !m_queue.empty() || m_stopped;
     });
+    --m_waiting_consumers;
+    ++m_stats.wakeups;
+}
+
+void CTradeQueue::Coalesce(const STrade& trade) {
+    if (!trade.IsValid()) {
+        return;
+    }
+    const uint64_t window_start = (trade.timestamp / m_window_ms) * m_window_ms;
+    auto& partial = m_coalesced[{trade.symbol, window_start}];
+    if (partial.trades_count == 0) {
+        partial.symbol = trade.symbol;
+        partial.window_start = window_start;
+    }
+    const uint64_t count = trade.TradeCount();
+    partial.trades_count += count;
+    partial.total_quantity += trade.quantity;
+    partial.total_volume += trade.price * trade.quantity;
+    partial.min_price = std::min(partial.min_price, trade.price);
+    partial.max_price = std::max(partial.max_price, trade.price);
+    if (trade.buyer_initiated) {
+        partial.sell_count += count;
+    } else {
+        partial.buy_count += count;
+    }
+    ++m_stats.coalesced;
+    m_has_coalesced.store(true, std::memory_order_release);
+}
 
+bool CTradeQueue::Pop(STrade& trade) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    WaitForTradesLocked(lock);
     if (m_stopped && m_queue.empty()) {
         return false;
     }
 
     trade = std::move(m_queue.front());
     m_queue.pop();
+    ++m_popped;
+    ++m_stats.popped[0];
+    PopTracedLocked(nullptr);
+    m_size.store(m_queue.size(), std::memory_order_release);
+    if (m_waiting_producers != 0) {
+        m_not_full.notify_one();
+    }
+    return true;
+}
+
+bool CTradeQueue::TryPop(STrade& trade) {
+    if (m_size.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_queue.empty()) {
+        return false;
+    }
+    trade = std::move(m_queue.front());
+    m_queue.pop();
+    ++m_popped;
+    ++m_stats.popped[0];
+    PopTracedLocked(nullptr);
+    m_size.store(m_queue.size(), std::memory_order_release);
+    if (m_waiting_producers != 0) {
+        m_not_full.notify_one();
+    }
     return true;
 }
 
+bool CTradeQueue::PopBatch(STradeBlock& block, size_t max_trades) {
+    block.Clear();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    WaitForTradesLocked(lock);
+    if (m_stopped && m_queue.empty()) {
+        return false;
+    }
+    MoveToBlockLocked(block, max_trades);
+    return true;
+}
+
+bool CTradeQueue::TryPopBatch(STradeBlock& block, size_t max_trades) {
+    block.Clear();
+    if (m_size.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_queue.empty()) {
+        return false;
+    }
+    MoveToBlockLocked(block, max_trades);
+    return true;
+}
+
+void CTradeQueue::MoveToBlockLocked(STradeBlock& block, size_t max_trades) {
+    size_t taken = 0;
+    for (; taken < std::max<size_t>(max_trades, 1) && !m_queue.empty(); ++taken) {
+        block.Append(m_queue.front());
+        m_queue.pop();
+        ++m_popped;
+    }
+    ++m_stats.popped[BatchBucket(taken)];
+    PopTracedLocked(&block);
+    m_size.store(m_queue.size(), std::memory_order_release);
+    if (m_waiting_producers != 0) {
+        m_not_full.notify_all();
+    }
+}
+
+void CTradeQueue::PopTracedLocked(STradeBlock* block) {
+    while (!m_traced.empty() && m_traced.front().position < m_popped) {
+        const STracedPush& traced = m_traced.front();
+        TraceTradeSpan("queue", traced.since_ns, TraceNowNs(), traced.sample);
+        if (block) {
+            block->trace_sample = traced.sample;
+        }
+        m_traced.pop_front();
+    }
+}
+
+bool CTradeQueue::TakeCoalesced(std::vector<SCoalescedTrades>& out) {
+    if (!m_has_coalesced.load(std::memory_order_acquire)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& entry : m_coalesced) {
+        out.push_back(std::move(entry.second));
+    }
+    m_coalesced.clear();
+    m_has_coalesced.store(false, std::memory_order_release);
+    return !out.empty();
+}
+
 void CTradeQueue::Stop() {
     {
         std::lock_guard<std::mutex> lock(m_mutex);
-        m_stopped = true;
+        m_stopped.store(true, std::memory_order_release);
     }
     m_cond.notify_all();
+    m_not_full.notify_all();
+}
+
+void CTradeQueue::SetWindowPeriod(uint64_t window_ms) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_window_ms = std::max<uint64_t>(window_ms, 1);
+}
+
+SQueueStats CTradeQueue::Stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    SQueueStats stats = m_stats;
+    stats.size = m_queue.size();
+    return stats;
+}
+
+CTradeBatcher::CTradeBatcher(CTradeQueue& queue, size_t max_batch, std::chrono::microseconds deadline)
+    : m_queue(queue), m_max_batch(std::max<size_t>(max_batch, 1)), m_deadline(deadline) {
+    m_batch.reserve(m_max_batch);
+}
+
+void CTradeBatcher::Add(STrade trade) {
+    const bool tracing = TraceEnabled();
+    const uint64_t sample = tracing ? TraceSampleTrade() : 0;
+    const uint64_t sample_ns = sample != 0 ? TraceNowNs() : 0;
+    if (m_batch.empty() && m_target <= 1) {
+        // The reader keeps up: no reason to hold the trade back.
+        if (tracing) {
+            m_queue.PushTraced(std::move(trade), {0, sample, sample_ns});
+        } else {
+            m_queue.Push(std::move(trade));
+        }
+        Adapt();
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (m_batch.empty()) {
+        m_first_added = now;
+    }
+    if (sample != 0) {
+        m_traced.push_back({m_batch.size(), sample, sample_ns});
+    }
+    m_batch.push_back(std::move(trade));
+    if (m_batch.size() >= m_target || now - m_first_added >= m_deadline) {
+        Flush();
+    }
+}
+
+void CTradeBatcher::Flush() {
+    if (m_batch.empty()) {
+        return;
+    }
+    // Trades held while tracing was on were sampled already.
+    const bool traced = TraceEnabled() || !m_traced.empty();
+    if (m_batch.size() == 1) {
+        if (traced) {
+            m_queue.PushTraced(std::move(m_batch.front()), m_traced.empty() ? STracedTrade{} : m_traced.front());
+        } else {
+            m_queue.Push(std::move(m_batch.front()));
+        }
+        m_batch.clear();
+        m_traced.clear();
+    } else if (traced) {
+        m_queue.PushBatch(m_batch, m_traced);
+    } else {
+        m_queue.PushBatch(m_batch);
+    }
+    Adapt();
+}
+
+void CTradeBatcher::Adapt() {
+    m_target = std::min(std::max<size_t>(m_queue.Depth(), 1), m_max_batch);
 }
@@ -1,22 +1,189 @@
 #pragma once
 
 #include "trade.hpp"
+#include "trade_block.hpp"
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <cstdint>
+#include <limits>
+#include <map>
 #include <mutex>
 #include <queue>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// What Push does when a bounded queue is full.
+enum class EOverflowPolicy {
+    Block,       // wait for space (up to the block timeout, then drop)
+    DropNewest,  // drop the incoming trade
+    Coalesce     // fold the trade into a per-symbol, per-window partial aggregate
+};
+
+// "block" | "drop_newest" | "coalesce"
+bool ParseOverflowPolicy(std::string_view name, EOverflowPolicy& out);
+
+// Trades folded together by the coalesce policy while the queue was full.
+// The window statistics stay exact; only the individual trades are lost.
+struct SCoalescedTrades {
+    std::string symbol;
+    uint64_t window_start = 0;
+    uint64_t trades_count = 0;
+    double total_quantity = 0.0;
+    double total_volume = 0.0;
+    double min_price = std::numeric_limits<double>::max();
+    double max_price = std::numeric_limits<double>::lowest();
+    uint64_t buy_count = 0;
+    uint64_t sell_count = 0;
+};
+
+// Batch sizes in power-of-two buckets: 1, 2-3, 4-7, ..., 512 and more.
+constexpr size_t kBatchBuckets = 11;
+using BatchHistogram = std::array<uint64_t, kBatchBuckets>;
+size_t BatchBucket(size_t trades);
+// "1:120 2:35 4:3", the non-empty buckets by lower bound, "-" when all are.
+std::string FormatBatchHistogram(const BatchHistogram& histogram);
+
+struct SQueueStats {
+    size_t size = 0;
+    size_t high_water_mark = 0;
+    uint64_t dropped = 0;    // trades lost to drop_newest or a block timeout
+    uint64_t coalesced = 0;  // trades folded into partial aggregates
+    uint64_t blocked = 0;    // pushes that had to wait for space
+    uint64_t wakeups = 0;    // times the consumer slept on the empty queue and was woken
+    BatchHistogram pushed{};  // trades per Push / PushBatch that queued something
+    BatchHistogram popped{};  // trades per Pop / PopBatch / TryPopBatch
+};
+
+// A trade its producer sampled (trace.hpp) before pushing it: its index in
+// the producer's batch, its sample id and when the producer took it, where
+// its "queue" span starts.
+struct STracedTrade {
+    size_t index = 0;
+    uint64_t sample = 0;
+    uint64_t taken_ns = 0;
+};
 
 class CTradeQueue {
 public:
+    // Unbounded.
     CTradeQueue();
+    // capacity 0 means unbounded. window_ms is the aggregation period used to
+    // key coalesced partials so they never straddle a window.
+    CTradeQueue(size_t capacity, EOverflowPolicy policy,
+                std::chrono::milliseconds block_timeout = std::chrono::milliseconds(100),
+                uint64_t window_ms = 1000);
 
     virtual void Push(STrade trade);
+    // Queues the trades (each under the overflow policy) with one lock and at
+    // most one wake-up, then clears trades.
+    void PushBatch(std::vector<STrade>& trades);
+    // For producers that sample trades themselves (CTradeBatcher): the
+    // trades are not sampled again, traced lists the sampled ones in index
+    // order (cleared too), and a sampled trade that is not queued ends its
+    // track with a "dropped" or "coalesced" span. PushTraced takes one trade,
+    // traced.sample 0 when it has none.
+    void PushTraced(STrade trade, const STracedTrade& traced);
+    void PushBatch(std::vector<STrade>& trades, std::vector<STracedTrade>& traced);
+    // Trades queued right now, without the lock.
+    size_t Depth() const { return m_size.load(std::memory_order_relaxed); }
     bool Pop(STrade& trade);
+    // Non-blocking pop for busy-polling consumers: spins on an atomic size
+    // hint and only takes the lock when something is queued.
+    bool TryPop(STrade& trade);
+    // Batch versions for the reader: the block is cleared, then filled with
+    // up to max_trades queued trades under one lock (invalid ones are
+    // dropped by STradeBlock::Append). PopBatch waits like Pop for the first
+    // trade but never for a full batch.
+    bool PopBatch(STradeBlock& block, size_t max_trades);
+    bool TryPopBatch(STradeBlock& block, size_t max_trades);
+    // Moves partial aggregates built by the coalesce policy into out. Cheap
+    // when there are none; consumers call it after every Pop and once more
+    // after the queue stopped.
+    bool TakeCoalesced(std::vector<SCoalescedTrades>& out);
+    bool IsStopped() const { return m_stopped.load(std::memory_order_acquire); }
     void Stop();
 
+    void SetWindowPeriod(uint64_t window_ms);
+    SQueueStats Stats() const;
+
 private:
+    // False when the trade was not queued (dropped, coalesced, or stopped).
+    // traced is null when the queue samples the trade itself. deadline ends
+    // the block policy's wait; the first wait sets it when it is still zero,
+    // so all trades of a batch share one block_timeout.
+    bool PushLocked(std::unique_lock<std::mutex>& lock, STrade& trade, const STracedTrade* traced,
+                    std::chrono::steady_clock::time_point& deadline);
+    void PushBatchImpl(std::vector<STrade>& trades, const std::vector<STracedTrade>* traced);
+    void WaitForTradesLocked(std::unique_lock<std::mutex>& lock);
+    void Coalesce(const STrade& trade);
+    void MoveToBlockLocked(STradeBlock& block, size_t max_trades);
+    void PopTracedLocked(STradeBlock* block);
+
+    // Sampled trades (trace.hpp) by position in the push order, for their queue wait.
+    struct STracedPush {
+        uint64_t position = 0;
+        uint64_t sample = 0;
+        uint64_t since_ns = 0;
+    };
+
     std::queue<STrade> m_queue;
-    std::mutex m_mutex;
+    mutable std::mutex m_mutex;
     std::condition_variable m_cond;
-    bool m_stopped;
-};
\ No newline at end of file
+    std::condition_variable m_not_full;
+    std::atomic<size_t> m_size{0};
+    std::atomic<bool> m_stopped;
+
+    const size_t m_capacity = 0;
+    const EOverflowPolicy m_policy = EOverflowPolicy::Block;
+    const std::chrono::milliseconds m_block_timeout{100};
+    uint64_t m_window_ms = 1000;
+    size_t m_waiting_producers = 0;
+    size_t m_waiting_consumers = 0;  // producers only notify when someone sleeps
+    std::map<std::pair<std::string, uint64_t>, SCoalescedTrades> m_coalesced;
+    std::atomic<bool> m_has_coalesced{false};
+    uint64_t m_pushed = 0;
+    uint64_t m_popped = 0;
+    std::deque<STracedPush> m_traced;
+    SQueueStats m_stats;
+};
+
+// Producer side of the queue for the io thread: trades are collected in a
+// local batch and queued together. The batch is as large as the queue is
+// deep (at most max_batch): a reader that keeps up leaves the queue empty,
+// so every trade is pushed on its own and waits for nothing, while a reader
+// that falls behind gets fewer, larger pushes and fewer wake-ups, and the
+// batch adds no delay beyond the backlog already queued. A batch is also
+// pushed once its first trade is older than deadline, and by Flush(), which
+// the owner calls when its event loop runs out of work. With tracing on,
+// trades are sampled by Add, while the frame that carried them is parsed,
+// and a sampled trade's "queue" span includes its time in the batch.
+// Not thread-safe.
+class CTradeBatcher {
+public:
+    CTradeBatcher(CTradeQueue& queue, size_t max_batch, std::chrono::microseconds deadline);
+    ~CTradeBatcher() { Flush(); }
+    CTradeBatcher(const CTradeBatcher&) = delete;
+    CTradeBatcher& operator=(const CTradeBatcher&) = delete;
+
+    void Add(STrade trade);
+    void Flush();
+    bool Pending() const { return !m_batch.empty(); }
+    size_t Target() const { return m_target; }
+
+private:
+    void Adapt();
+
+    CTradeQueue& m_queue;
+    const size_t m_max_batch;
+    const std::chrono::microseconds m_deadline;
+    size_t m_target = 1;
+    std::vector<STrade> m_batch;
+    std::vector<STracedTrade> m_traced;  // sampled trades of m_batch
+    std::chrono::steady_clock::time_point m_first_added{};
+};
@@ -2,137 +2,529 @@
 
 #include <algorithm>
 #include <iostream>
+#include <utility>
 
+#include <openssl/bio.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
+#include <time.h>
 
+#include "feed_adapter.hpp"
 #include "logger.hpp"
+#include "trace.hpp"
+
+namespace {
+uint64_t ThreadCpuNs() {
+    timespec ts{};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+uint64_t ElapsedMs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(to - from).count());
+}
+
+std::string EndpointText(const tcp::endpoint& endpoint) {
+    return endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
+}
+
+// Slot of the owning client in the SSL_CTX. Not the app data slot: asio keeps
+// its verify callback there and deletes it with the context.
+int ClientExDataIndex() {
+    static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+}
 
 CWebSocketClient::CWebSocketClient(net::io_context& ioc, std::shared_ptr<CTradeQueue> tq, const SAppConfig& cfg)
         : m_ioc(ioc),
             m_ssl_ctx(ssl::context::tlsv12_client),
             m_resolver(ioc),
             m_reconnect_timer(ioc),
+            m_stats_timer(ioc),
+            m_ping_timer(ioc),
+            m_rotate_timer(ioc),
+            m_overlap_timer(ioc),
             m_trade_queue(tq),
-            m_cfg(cfg) {
+            m_cfg(cfg),
+            m_batcher(*tq, cfg.queue.batch_max, std::chrono::microseconds(cfg.queue.batch_deadline_us)),
+            m_endpoints(std::chrono::seconds(cfg.ws.dns_cache_sec)) {
+        ParseFeedVenue(m_cfg.ws.venue, m_venue);
         m_ssl_ctx.set_default_verify_paths();
+        if (m_cfg.ws.tls_resume) {
+            // Keep the newest session (TLS 1.3 tickets arrive after the
+            // handshake) and offer it on the next connect.
+            SSL_CTX* native = m_ssl_ctx.native_handle();
+            SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_set_ex_data(native, ClientExDataIndex(), this);
+            SSL_CTX_sess_set_new_cb(native, &CWebSocketClient::OnNewTlsSession);
+        }
+}
+
+int CWebSocketClient::OnNewTlsSession(SSL* ssl, SSL_SESSION* session) {
+    auto* self = static_cast<CWebSocketClient*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ClientExDataIndex()));
+    self->m_tls_session.reset(session);
+    return 1;  // the reference is ours now
 }
 
 void CWebSocketClient::Start() {
     StartConnect();
+    ScheduleStats();
 }
 
 void CWebSocketClient::Stop() {
+    m_batcher.Flush();
     m_reconnect_timer.cancel();
+    m_stats_timer.cancel();
     CloseConnection();
 }
 
 void CWebSocketClient::StartConnect() {
     m_reconnect_scheduled = false;
-    m_ws.emplace(m_ioc, m_ssl_ctx);
+    m_conn = std::make_shared<SConnection>(m_ioc, m_ssl_ctx);
+    Connect(m_conn);
+}
+
+void CWebSocketClient::Connect(const ConnectionPtr& conn) {
+    if (m_cfg.ws.deflate.enabled) {
+        websocket::permessage_deflate pmd;
+        pmd.client_enable = true;
+        pmd.client_max_window_bits = m_cfg.ws.deflate.client_max_window_bits;
+        pmd.server_max_window_bits = m_cfg.ws.deflate.server_max_window_bits;
+        pmd.client_no_context_takeover = m_cfg.ws.deflate.client_no_context_takeover;
+        pmd.server_no_context_takeover = m_cfg.ws.deflate.server_no_context_takeover;
+        conn->ws.set_option(pmd);
+    }
 
+    conn->connect_started = std::chrono::steady_clock::now();
+    if (m_endpoints.Fresh(conn->connect_started)) {
+        ++m_reconnect.dns_cache_hits;
+        StartRace(conn, m_endpoints.Ranked());
+        return;
+    }
     m_resolver.async_resolve(m_cfg.ws.host,
                              m_cfg.ws.port,
-                             beast::bind_front_handler(&CWebSocketClient::OnResolve,
-                                                       shared_from_this()));
+                             [self = shared_from_this(), conn](beast::error_code ec, tcp::resolver::results_type results) {
+                                 self->OnResolve(conn, ec, std::move(results));
+                             });
 }
 
-void CWebSocketClient::OnResolve(beast::error_code ec,
+void CWebSocketClient::OnResolve(const ConnectionPtr& conn, beast::error_code ec,
                                tcp::resolver::results_type results) {
-    if (!m_ws) {
+    if (!Owns(conn)) {
         return;
     }
     if (ec) {
-        ScheduleReconnect("resolve", ec);
+        Fail(conn, "resolve", ec);
+        return;
+    }
+
+    std::vector<tcp::endpoint> endpoints;
+    for (const auto& entry : results) {
+        endpoints.push_back(entry.endpoint());
+    }
+    m_endpoints.SetResolved(std::move(endpoints), std::chrono::steady_clock::now());
+    StartRace(conn, m_endpoints.Ranked());
+}
+
+void CWebSocketClient::StartRace(const ConnectionPtr& conn, std::vector<tcp::endpoint> endpoints) {
+    if (endpoints.empty()) {
+        Fail(conn, "resolve", net::error::host_not_found);
         return;
     }
+    auto race = std::make_shared<SConnectRace>();
+    const size_t n = std::min<size_t>(endpoints.size(), static_cast<size_t>(m_cfg.ws.connect_race));
+    race->endpoints.assign(endpoints.begin(), endpoints.begin() + static_cast<std::ptrdiff_t>(n));
+    race->pending = n;
+    race->started = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n; ++i) {
+        race->sockets.emplace_back(m_ioc);
+    }
+    conn->race = race;
+    for (size_t i = 0; i < n; ++i) {
+        race->sockets[i].async_connect(
+            race->endpoints[i], [self = shared_from_this(), conn, race, i](beast::error_code ec) {
+                self->OnRaceConnect(conn, race, i, ec);
+            });
+    }
+}
 
-    beast::get_lowest_layer(*m_ws).async_connect(
-        results,
-        beast::bind_front_handler(&CWebSocketClient::OnConnect, shared_from_this()));
+void CWebSocketClient::OnRaceConnect(const ConnectionPtr& conn, const std::shared_ptr<SConnectRace>& race,
+                                     size_t index, beast::error_code ec) {
+    beast::error_code ignored;
+    auto& socket = race->sockets[index];
+    --race->pending;
+    if (!Owns(conn) || race != conn->race || race->won) {
+        socket.close(ignored);
+        return;
+    }
+    const tcp::endpoint& endpoint = race->endpoints[index];
+    if (ec) {
+        m_endpoints.RecordFailure(endpoint);
+        if (race->pending == 0) {
+            // Every endpoint tried failed: the addresses may have moved.
+            m_endpoints.Invalidate();
+            Fail(conn, "connect", ec);
+        }
+        return;
+    }
+    race->won = true;
+    m_endpoints.RecordRtt(endpoint, std::chrono::duration_cast<std::chrono::microseconds>(
+                                        std::chrono::steady_clock::now() - race->started));
+    for (size_t i = 0; i < race->sockets.size(); ++i) {
+        if (i != index) {
+            race->sockets[i].close(ignored);
+        }
+    }
+    // Small writes back to back (TLS Finished, then the upgrade request) would
+    // otherwise wait on the server's delayed ACK.
+    socket.set_option(tcp::no_delay(true), ignored);
+    beast::get_lowest_layer(conn->ws).socket() = std::move(socket);
+    conn->race.reset();
+    OnConnect(conn, {}, endpoint);
 }
 
-void CWebSocketClient::OnConnect(beast::error_code ec,
-                               tcp::resolver::endpoint_type ep) {
-    if (!m_ws) {
+void CWebSocketClient::OnConnect(const ConnectionPtr& conn, beast::error_code ec, tcp::endpoint ep) {
+    if (!Owns(conn)) {
         return;
     }
     if (ec) {
-        ScheduleReconnect("connect", ec);
+        Fail(conn, "connect", ec);
         return;
     }
+    conn->endpoint = ep;
 
-    if (!SSL_set_tlsext_host_name(m_ws->next_layer().native_handle(), m_cfg.ws.host.c_str())) {
+    if (!SSL_set_tlsext_host_name(conn->ws.next_layer().native_handle(), m_cfg.ws.host.c_str())) {
         beast::error_code sni_ec{static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()};
-        ScheduleReconnect("sni", sni_ec);
+        Fail(conn, "sni", sni_ec);
         return;
     }
 
     auto opt = websocket::stream_base::timeout::suggested(beast::role_type::client);
     opt.handshake_timeout = std::chrono::seconds(m_cfg.ws.handshake_timeout_sec);
     opt.idle_timeout = std::chrono::seconds(m_cfg.ws.idle_timeout_sec);
-    m_ws->set_option(opt);
+    conn->ws.set_option(opt);
 
-    m_ws->next_layer().async_handshake(
+    if (m_cfg.ws.tls_resume && m_tls_session) {
+        SSL_set_session(conn->ws.next_layer().native_handle(), m_tls_session.get());
+    }
+    conn->ws.next_layer().async_handshake(
         ssl::stream_base::client,
-        beast::bind_front_handler(&CWebSocketClient::OnSslHandshake, shared_from_this()));
+        [self = shared_from_this(), conn](beast::error_code handshake_ec) { self->OnSslHandshake(conn, handshake_ec); });
 }
 
-void CWebSocketClient::OnSslHandshake(beast::error_code ec) {
-    if (!m_ws) {
+void CWebSocketClient::OnSslHandshake(const ConnectionPtr& conn, beast::error_code ec) {
+    if (!Owns(conn)) {
         return;
     }
     if (ec) {
-        ScheduleReconnect("ssl_handshake", ec);
+        Fail(conn, "ssl_handshake", ec);
         return;
     }
 
     std::string host_header = m_cfg.ws.host + ":" + m_cfg.ws.port;
-    m_ws->async_handshake(
+    conn->handshake_response = {};
+    conn->ws.async_handshake(
+        conn->handshake_response,
         host_header,
-        m_cfg.trade_pairs.empty() ? "/" : BuildStreamTarget(m_cfg.trade_pairs),
-        beast::bind_front_handler(&CWebSocketClient::OnWebsocketHandshake,
-                                  shared_from_this()));
+        VisitFeedAdapter(m_venue, [this](const auto& adapter) { return adapter.Target(m_cfg); }),
+        [self = shared_from_this(), conn](beast::error_code handshake_ec) { self->OnWebsocketHandshake(conn, handshake_ec); });
 }
 
-void CWebSocketClient::OnWebsocketHandshake(beast::error_code ec) {
-    if (!m_ws) {
+void CWebSocketClient::OnWebsocketHandshake(const ConnectionPtr& conn, beast::error_code ec) {
+    if (!Owns(conn)) {
         return;
     }
     if (ec) {
-        ScheduleReconnect("ws_handshake", ec);
+        Fail(conn, "ws_handshake", ec);
         return;
     }
 
+    const auto now = std::chrono::steady_clock::now();
+    conn->established = true;
     m_retry_attempt = 0;
+    const bool rotation = conn == m_standby;
+    if (rotation) {
+        // Make before break: the new connection takes over and the old one
+        // keeps reading for the overlap, its trades deduplicated by id.
+        if (m_retiring) {
+            Close(m_retiring);
+        }
+        m_retiring = m_conn;
+        m_conn = conn;
+        m_standby.reset();
+        ++m_reconnect.rotations;
+        m_overlap_timer.expires_after(std::chrono::milliseconds(m_cfg.ws.rotate_overlap_ms));
+        m_overlap_timer.async_wait(beast::bind_front_handler(&CWebSocketClient::OnOverlapTimer, shared_from_this()));
+    } else if (m_book_manager) {
+        // Diffs missed while disconnected make every book stale.
+        m_book_manager->Reset();
+    }
+
+    // The server lists the extensions it accepted; no header means no compression.
+    const auto extensions = conn->handshake_response[beast::http::field::sec_websocket_extensions];
+    m_traffic.deflate_negotiated = extensions.find("permessage-deflate") != beast::string_view::npos;
+    if (m_cfg.ws.deflate.enabled) {
+        Log(m_traffic.deflate_negotiated ? LogLevel::INFO : LogLevel::ERROR, "Client",
+            m_traffic.deflate_negotiated ? "permessage-deflate negotiated: " + std::string(extensions)
+                                         : "permessage-deflate was offered but declined by the server.");
+    }
 
-    Log(LogLevel::INFO, "Client", "Connected to Binance! Streaming trades...");
-    m_ws->async_read(m_buffer,
-                     beast::bind_front_handler(&CWebSocketClient::OnRead,
-                                               shared_from_this()));
+    const bool resumed = SSL_session_reused(conn->ws.next_layer().native_handle()) == 1;
+    ++m_reconnect.connects;
+    m_reconnect.tls_resumed += resumed ? 1 : 0;
+    m_reconnect.last_connect_ms = ElapsedMs(conn->connect_started, now);
+    const std::string setup = "connect " + std::to_string(m_reconnect.last_connect_ms) + " ms to " +
+                              EndpointText(conn->endpoint) +
+                              (resumed ? ", TLS session resumed" : ", full TLS handshake");
+    if (rotation) {
+        Log(LogLevel::INFO, "Client", "Rotated to a new connection (" + setup + "), overlapping for " +
+            std::to_string(m_cfg.ws.rotate_overlap_ms) + " ms");
+    } else if (m_disconnected_at != std::chrono::steady_clock::time_point{}) {
+        ++m_reconnect.reconnects;
+        m_reconnect.last_gap_ms = ElapsedMs(m_disconnected_at, now);
+        m_reconnect.max_gap_ms = std::max(m_reconnect.max_gap_ms, m_reconnect.last_gap_ms);
+        m_disconnected_at = {};
+        Log(LogLevel::INFO, "Client", "Reconnected after a " + std::to_string(m_reconnect.last_gap_ms) + " ms gap (" + setup + ")");
+    } else {
+        Log(LogLevel::INFO, "Client", "Connected (" + setup + ")");
+    }
+
+    std::weak_ptr<SConnection> weak_conn = conn;
+    conn->ws.control_callback([this, weak_conn](websocket::frame_type kind, beast::string_view) {
+        const auto current = weak_conn.lock();
+        if (!current || current != m_conn) {
+            return;
+        }
+        if (kind == websocket::frame_type::pong && m_ping_sent != std::chrono::steady_clock::time_point{}) {
+            m_endpoints.RecordRtt(current->endpoint, std::chrono::duration_cast<std::chrono::microseconds>(
+                                                         std::chrono::steady_clock::now() - m_ping_sent));
+            m_ping_sent = {};
+        } else if (kind == websocket::frame_type::close) {
+            // The server is about to drop us: get the replacement going now.
+            const auto& reason = current->ws.reason();
+            StartStandby("close frame " + std::to_string(reason.code) +
+                         (reason.reason.empty() ? "" : " " + std::string(reason.reason.c_str())));
+        }
+    });
+    m_ping_sent = {};
+    SchedulePing();
+    if (m_cfg.ws.max_connection_age_sec > 0) {
+        ScheduleRotation(std::chrono::seconds(std::max(0, m_cfg.ws.max_connection_age_sec - m_cfg.ws.rotate_lead_sec)));
+    }
+
+    if (!rotation) {
+        Log(LogLevel::INFO, "Client", std::string("Connected to ") + VenueName() + "! Streaming trades...");
+    }
+    conn->outgoing = VisitFeedAdapter(m_venue, [this](const auto& adapter) { return adapter.SubscribeMessage(m_cfg); });
+    if (!conn->outgoing.empty()) {
+        // Reads may start right away; a websocket stream allows one read and one write in flight.
+        conn->writing = true;
+        conn->ws.async_write(net::buffer(conn->outgoing),
+                             [self = shared_from_this(), conn](beast::error_code write_ec, std::size_t) {
+                                 conn->writing = false;
+                                 if (write_ec && self->Owns(conn)) {
+                                     self->Fail(conn, "subscribe", write_ec);
+                                 }
+                             });
+    }
+    StartRead(SReadHandler{shared_from_this(), conn, &conn->read_memory});
 }
 
-void CWebSocketClient::OnRead(beast::error_code ec,
-                            std::size_t /*bytes_transferred*/) {
-    if (!m_ws) {
+void CWebSocketClient::SchedulePing() {
+    if (m_cfg.ws.ping_interval_sec <= 0) {
         return;
     }
-    if (ec) {
-        ScheduleReconnect("read", ec);
+    m_ping_timer.expires_after(std::chrono::seconds(m_cfg.ws.ping_interval_sec));
+    m_ping_timer.async_wait(
+        MakeAllocHandler(m_timer_memory, beast::bind_front_handler(&CWebSocketClient::OnPingTimer, shared_from_this())));
+}
+
+void CWebSocketClient::OnPingTimer(beast::error_code ec) {
+    if (ec || !m_conn || !m_conn->established) {
+        return;
+    }
+    // An unanswered ping is superseded; a dead connection shows up on the read side.
+    m_ping_sent = std::chrono::steady_clock::now();
+    m_conn->ws.async_ping({}, [self = shared_from_this(), conn = m_conn](beast::error_code) {});
+    const std::string_view keepalive =
+        VisitFeedAdapter(m_venue, [](const auto& adapter) { return adapter.KeepaliveMessage(); });
+    if (!keepalive.empty() && !m_conn->writing) {
+        m_conn->writing = true;
+        m_conn->ws.async_write(net::buffer(keepalive.data(), keepalive.size()),
+                               [conn = m_conn](beast::error_code, std::size_t) { conn->writing = false; });
+    }
+    SchedulePing();
+}
+
+void CWebSocketClient::ScheduleRotation(std::chrono::seconds delay) {
+    m_rotate_timer.expires_after(delay);
+    m_rotate_timer.async_wait([self = shared_from_this()](beast::error_code ec) {
+        if (!ec) {
+            self->StartStandby("connection age");
+        }
+    });
+}
+
+void CWebSocketClient::StartStandby(const std::string& reason) {
+    if (m_standby || !m_conn || !m_conn->established) {
+        return;
+    }
+    Log(LogLevel::INFO, "Client", "Opening a replacement connection (" + reason + ")");
+    m_standby = std::make_shared<SConnection>(m_ioc, m_ssl_ctx);
+    Connect(m_standby);
+}
+
+void CWebSocketClient::OnOverlapTimer(beast::error_code ec) {
+    if (ec || !m_retiring) {
         return;
     }
+    Log(LogLevel::INFO, "Client", "Closing the previous connection; " +
+        std::to_string(m_reconnect.duplicates_dropped) + " duplicate trades dropped so far");
+    m_retiring->ws.async_close(websocket::close_code::normal,
+                               [self = shared_from_this(), conn = m_retiring](beast::error_code) {
+                                   // The pending read ends as well and finds the connection gone.
+                                   if (conn == self->m_retiring) {
+                                       self->Close(conn);
+                                       self->m_retiring.reset();
+                                   }
+                               });
+}
+
+void CWebSocketClient::SReadHandler::operator()(beast::error_code ec, std::size_t bytes_transferred) {
+    CWebSocketClient& client = *self;
+    if (client.OnRead(conn, ec, bytes_transferred)) {
+        client.StartRead(std::move(*this));
+    }
+}
+
+void CWebSocketClient::StartRead(SReadHandler handler) {
+    SConnection& conn = *handler.conn;
+    if (m_cfg.ws.stats_interval_sec > 0) {
+        conn.read_issued_cpu_ns = ThreadCpuNs();
+    }
+    if (TraceEnabled()) {
+        conn.read_issued_ns = TraceNowNs();
+    }
+    conn.ws.async_read(conn.buffer, std::move(handler));
+}
+
+bool CWebSocketClient::OnRead(const ConnectionPtr& conn, beast::error_code ec,
+                            std::size_t /*bytes_transferred*/) {
+    if (!Owns(conn)) {
+        return false;
+    }
+    if (ec) {
+        Fail(conn, "read", ec);
+        return false;
+    }
+    if (m_cfg.ws.stats_interval_sec > 0 && conn->read_issued_cpu_ns != 0) {
+        m_traffic.read_cpu_ns += ThreadCpuNs() - conn->read_issued_cpu_ns;
+    }
+    ++m_traffic.messages;
+    m_traffic.payload_bytes += conn->buffer.size();
+    // The read and parse of a frame are kept when it carried a sampled trade.
+    const uint64_t trace_read_ns = TraceEnabled() ? TraceNowNs() : 0;
+    const uint64_t trace_samples = trace_read_ns != 0 ? TraceThreadSamples() : 0;
+    // Unset when tracing was off as the read was issued.
+    const uint64_t read_issued_ns = std::exchange(conn->read_issued_ns, 0);
 
     try {
-        STrade trade = STrade::FromJson(beast::buffers_to_string(m_buffer.data()));
-        m_trade_queue->Push(std::move(trade));
+        const auto data = conn->buffer.data();
+        const std::string_view frame(static_cast<const char*>(data.data()), data.size());
+        const size_t trades = VisitFeedAdapter(m_venue, [&](const auto& adapter) {
+            return adapter.ParseFrame(frame, [&](STrade&& trade) {
+                if (!IsDuplicate(conn, trade)) {
+                    m_batcher.Add(std::move(trade));
+                }
+            });
+        });
+        if (trace_read_ns != 0 && TraceThreadSamples() != trace_samples) {
+            const uint64_t sample = TraceLastSample();
+            if (read_issued_ns != 0) {
+                TraceTradeSpan("read", read_issued_ns, trace_read_ns, sample);
+            }
+            TraceSpan("parse", trace_read_ns, TraceNowNs(), sample);
+        }
+        if (trades == 0 && m_book_manager) {
+            // Depth diffs (Binance only) still go through the JSON DOM.
+            const auto json = nlohmann::json::parse(frame);
+            const auto& payload = json.contains("data") ? json["data"] : json;
+            if (payload.value("e", "") == "depthUpdate") {
+                // Diffs both connections deliver are skipped by update id. While
+                // two connections stream, a diff from the one that is ahead waits
+                // for the other instead of forcing a resync.
+                SDepthUpdate update = SDepthUpdate::FromJson(payload);
+                if (!(m_retiring && m_book_manager->IsAhead(update))) {
+                    m_book_manager->OnDepthUpdate(std::move(update));
+                }
+            }
+        }
     } catch (const std::exception& e) {
-        Log(LogLevel::ERROR, "Client", "JSON Error: " + std::string(e.what()) + " | Data: " + beast::buffers_to_string(m_buffer.data()));
+        Log(LogLevel::ERROR, "Client", "JSON Error: " + std::string(e.what()) + " | Data: " + beast::buffers_to_string(conn->buffer.data()));
     }
 
-    m_buffer.consume(m_buffer.size());
-    m_ws->async_read(m_buffer,
-                     beast::bind_front_handler(&CWebSocketClient::OnRead,
-                                               shared_from_this()));
+    if (m_batcher.Pending() && !m_flush_posted) {
+        m_flush_posted = true;
+        net::post(m_ioc, MakeAllocHandler(m_flush_memory, [self = shared_from_this()]() {
+            self->m_flush_posted = false;
+            self->m_batcher.Flush();
+        }));
+    }
+    conn->buffer.consume(conn->buffer.size());
+    return true;
+}
+
+bool CWebSocketClient::IsDuplicate(const ConnectionPtr& conn, const STrade& trade) {
+    if (trade.last_trade_id == 0) {
+        return false;
+    }
+    const uint64_t id = trade.last_trade_id;
+    auto& own = conn->trade_ids[trade.symbol];
+    if (own.first == 0) {
+        own.first = id;
+    }
+    own.last = id;
+    auto covers = [&trade, id](const TradeIdRanges& ranges) {
+        const auto it = ranges.find(trade.symbol);
+        return it != ranges.end() && it->second.first <= id && id <= it->second.last;
+    };
+    bool duplicate = covers(m_closed_trade_ids);
+    for (const ConnectionPtr* slot : {&m_conn, &m_standby, &m_retiring}) {
+        duplicate = duplicate || (*slot && *slot != conn && covers((*slot)->trade_ids));
+    }
+    m_reconnect.duplicates_dropped += duplicate ? 1 : 0;
+    return duplicate;
+}
+
+void CWebSocketClient::Fail(const ConnectionPtr& conn, std::string_view reason, beast::error_code ec) {
+    if (conn == m_retiring) {
+        Close(conn);
+        m_retiring.reset();
+        return;
+    }
+    if (conn == m_standby) {
+        Log(LogLevel::ERROR, "Client", "Replacement connection failed (" + std::string(reason) + "): " + ec.message());
+        Close(conn);
+        m_standby.reset();
+        ScheduleRotation(std::chrono::seconds(m_cfg.retry.base_retry_sec));
+        return;
+    }
+    if (m_standby) {
+        // The active connection is gone before the replacement is ready: the
+        // replacement becomes the active one and the gap is that of its setup.
+        Log(LogLevel::ERROR, "Client", "Connection error (" + std::string(reason) + "): " + ec.message() +
+            "; switching to the replacement being set up");
+        if (m_reconnect.connects > 0 && m_disconnected_at == std::chrono::steady_clock::time_point{}) {
+            m_disconnected_at = std::chrono::steady_clock::now();
+        }
+        Close(m_conn);
+        m_conn = std::move(m_standby);
+        m_standby.reset();
+        m_traffic.deflate_negotiated = false;
+        return;
+    }
+    ScheduleReconnect(reason, ec);
 }
 
 void CWebSocketClient::ScheduleReconnect(std::string_view reason, beast::error_code ec) {
@@ -142,6 +534,9 @@ void CWebSocketClient::ScheduleReconnect(std::string_view reason, beast::error_c
     }
 
     m_reconnect_scheduled = true;
+    if (m_reconnect.connects > 0 && m_disconnected_at == std::chrono::steady_clock::time_point{}) {
+        m_disconnected_at = std::chrono::steady_clock::now();
+    }
 
     Log(LogLevel::ERROR, "Client", "Connection error (" + std::string(reason) + "): " + (ec ? ec.message() : "unknown"));
 
@@ -157,14 +552,40 @@ void CWebSocketClient::ScheduleReconnect(std::string_view reason, beast::error_c
 }
 
 void CWebSocketClient::CloseConnection() {
-    beast::error_code ec;
     m_resolver.cancel();
-    if (m_ws && beast::get_lowest_layer(*m_ws).socket().is_open()) {
-        m_ws->next_layer().shutdown(ec);
-        beast::get_lowest_layer(*m_ws).close();
+    m_ping_timer.cancel();
+    m_rotate_timer.cancel();
+    m_overlap_timer.cancel();
+    m_ping_sent = {};
+    m_traffic.deflate_negotiated = false;
+    for (ConnectionPtr* slot : {&m_conn, &m_standby, &m_retiring}) {
+        if (*slot) {
+            Close(*slot);
+            slot->reset();
+        }
+    }
+}
+
+void CWebSocketClient::Close(const ConnectionPtr& conn) {
+    beast::error_code ec;
+    if (conn->race) {
+        // Connects still in flight would otherwise keep the io_context busy.
+        for (auto& socket : conn->race->sockets) {
+            socket.close(ec);
+        }
+        conn->race.reset();
+    }
+    BIO* rbio = SSL_get_rbio(conn->ws.next_layer().native_handle());
+    m_wire_bytes_closed += rbio ? BIO_number_read(rbio) : 0;
+    if (beast::get_lowest_layer(conn->ws).socket().is_open()) {
+        conn->ws.next_layer().shutdown(ec);
+        beast::get_lowest_layer(conn->ws).close();
+    }
+    conn->buffer.consume(conn->buffer.size());
+    if (!conn->trade_ids.empty()) {
+        m_closed_trade_ids = std::move(conn->trade_ids);
+        conn->trade_ids.clear();
     }
-    m_ws.reset();
-    m_buffer.consume(m_buffer.size());
 }
 
 void CWebSocketClient::OnReconnectTimer(beast::error_code timer_ec) {
@@ -175,4 +596,63 @@ void CWebSocketClient::OnReconnectTimer(beast::error_code timer_ec) {
         ++m_retry_attempt;
     }
     StartConnect();
-}
\ No newline at end of file
+}
+
+uint64_t CWebSocketClient::CurrentWireBytes() const {
+    uint64_t bytes = m_wire_bytes_closed;
+    for (const ConnectionPtr* slot : {&m_conn, &m_standby, &m_retiring}) {
+        if (*slot) {
+            // Bytes OpenSSL pulled from the socket side for this connection.
+            BIO* rbio = SSL_get_rbio((*slot)->ws.next_layer().native_handle());
+            bytes += rbio ? BIO_number_read(rbio) : 0;
+        }
+    }
+    return bytes;
+}
+
+SWsTrafficStats CWebSocketClient::TrafficStats() const {
+    SWsTrafficStats stats = m_traffic;
+    stats.wire_bytes = CurrentWireBytes();
+    return stats;
+}
+
+void CWebSocketClient::ScheduleStats() {
+    if (m_cfg.ws.stats_interval_sec <= 0) {
+        return;
+    }
+    m_stats_timer.expires_after(std::chrono::seconds(m_cfg.ws.stats_interval_sec));
+    m_stats_timer.async_wait(
+        MakeAllocHandler(m_timer_memory, beast::bind_front_handler(&CWebSocketClient::OnStatsTimer, shared_from_this())));
+}
+
+void CWebSocketClient::OnStatsTimer(beast::error_code ec) {
+    if (ec) {
+        return;
+    }
+    const SWsTrafficStats now = TrafficStats();
+    const uint64_t messages = now.messages - m_traffic_logged.messages;
+    const uint64_t payload = now.payload_bytes - m_traffic_logged.payload_bytes;
+    const uint64_t wire = now.wire_bytes - m_traffic_logged.wire_bytes;
+    const uint64_t cpu_ns = now.read_cpu_ns - m_traffic_logged.read_cpu_ns;
+    m_traffic_logged = now;
+    if (messages > 0) {
+        const double ratio = wire == 0 ? 0.0 : static_cast<double>(payload) / static_cast<double>(wire);
+        Log(LogLevel::INFO, "Client", "Traffic: messages=" + std::to_string(messages) +
+            " payload_bytes=" + std::to_string(payload) + " wire_bytes=" + std::to_string(wire) +
+            " ratio=" + std::to_string(ratio) +
+            " read_cpu_ns_per_msg=" + std::to_string(cpu_ns / messages) +
+            " deflate=" + (now.deflate_negotiated ? "on" : "off") + RttText());
+    }
+    ScheduleStats();
+}
+
+std::string CWebSocketClient::RttText() const {
+    if (!m_conn || !m_conn->established) {
+        return "";
+    }
+    const auto rtt = m_endpoints.SmoothedRtt(m_conn->endpoint);
+    if (!rtt) {
+        return "";
+    }
+    return " endpoint=" + EndpointText(m_conn->endpoint) + " srtt_us=" + std::to_string(rtt->count());
+}
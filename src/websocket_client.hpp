@@ -1,13 +1,18 @@
 #pragma once
 
 #include "config.hpp"
+#include "endpoint_table.hpp"
+#include "feed_adapter.hpp"
+#include "handler_memory.hpp"
+#include "order_book.hpp"
 #include "trade_queue.hpp"
 
 #include <chrono>
 #include <memory>
-#include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
@@ -21,6 +26,34 @@ namespace beast = boost::beast;
 namespace websocket = beast::websocket;
 using tcp = net::ip::tcp;
 
+// Read-side counters of the client, over all connections.
+struct SWsTrafficStats {
+    uint64_t messages = 0;
+    uint64_t payload_bytes = 0;  // message bytes after inflate, as handed to the parser
+    uint64_t wire_bytes = 0;     // TLS bytes read from the socket
+    // io thread CPU from issuing a read to its completion: TLS, websocket
+    // framing and, with permessage-deflate, inflate. Sampled only while
+    // ws.stats_interval_sec > 0.
+    uint64_t read_cpu_ns = 0;
+    bool deflate_negotiated = false;  // on the current connection
+};
+
+// Connection setup of the client. The gap runs from the failure that dropped
+// the previous connection to the next completed websocket handshake, so it
+// includes the retry backoff; connect is resolve (or cache) to handshake.
+struct SWsReconnectStats {
+    uint64_t connects = 0;
+    uint64_t reconnects = 0;
+    uint64_t dns_cache_hits = 0;
+    uint64_t tls_resumed = 0;
+    uint64_t last_connect_ms = 0;
+    uint64_t last_gap_ms = 0;
+    uint64_t max_gap_ms = 0;
+    // Make-before-break rotations and the trades both connections delivered.
+    uint64_t rotations = 0;
+    uint64_t duplicates_dropped = 0;
+};
+
 class CWebSocketClient : public std::enable_shared_from_this<CWebSocketClient> {
 public:
     CWebSocketClient(net::io_context& ioc,
@@ -28,35 +61,151 @@ public:
                    const SAppConfig& cfg);
     virtual void Start();
     void Stop();
+    // Routes depthUpdate frames to the book manager and subscribes to the depth streams.
+    void SetBookManager(std::shared_ptr<CBookManager> book_manager) { m_book_manager = std::move(book_manager); }
 
     bool is_reconnect_scheduled() const { return m_reconnect_scheduled; }
+    SWsTrafficStats TrafficStats() const;
+    const SWsReconnectStats& ReconnectStats() const { return m_reconnect; }
+    const CEndpointTable& Endpoints() const { return m_endpoints; }
 
     friend class WebSocketClientTestHelper;
 
 protected:
+    // Starts the active connection from scratch.
     virtual void StartConnect();
 
 private:
-    void OnResolve(beast::error_code ec, tcp::resolver::results_type results);
-    void OnConnect(beast::error_code ec, tcp::resolver::endpoint_type endpoint);
-    void OnSslHandshake(beast::error_code ec);
-    void OnWebsocketHandshake(beast::error_code ec);
-    void OnRead(beast::error_code ec, std::size_t bytes_transferred);
+    // Parallel TCP connects to the best endpoints; the first to complete is
+    // kept and the others are closed.
+    struct SConnectRace {
+        std::vector<tcp::endpoint> endpoints;
+        std::vector<tcp::socket> sockets;
+        size_t pending = 0;
+        bool won = false;
+        std::chrono::steady_clock::time_point started;
+    };
+    // One websocket connection. Normally there is only the active one; a
+    // rotation adds a standby while it is being set up, and keeps the old one
+    // reading (retiring) for ws.rotate_overlap_ms after the switch.
+    // Trade ids one connection delivered for a symbol. A connection joins the
+    // exchange's stream somewhere and then sees every trade, so the ids it
+    // covers are exactly [first, last].
+    struct STradeIdRange {
+        uint64_t first = 0;
+        uint64_t last = 0;
+    };
+    using TradeIdRanges = std::unordered_map<std::string, STradeIdRange>;
+    struct SConnection {
+        SConnection(net::io_context& ioc, ssl::context& ctx) : ws(ioc, ctx) {}
+        websocket::stream<beast::ssl_stream<beast::tcp_stream>> ws;
+        beast::flat_buffer buffer;
+        websocket::response_type handshake_response;
+        std::shared_ptr<SConnectRace> race;
+        tcp::endpoint endpoint;
+        std::chrono::steady_clock::time_point connect_started{};
+        bool established = false;
+        uint64_t read_issued_cpu_ns = 0;
+        uint64_t read_issued_ns = 0;  // tracing only
+        TradeIdRanges trade_ids;
+        std::string outgoing;  // subscribe message while it is being written
+        bool writing = false;  // a text frame is in flight; keepalives skip a beat
+        CHandlerMemory read_memory;  // the read loop's operations, reused from one message to the next
+    };
+    using ConnectionPtr = std::shared_ptr<SConnection>;
+    // Completion handler of the read loop. Its references to the client and
+    // the connection are moved on to the next read instead of copied, so the
+    // steady-state loop does no reference counting, and its operations
+    // allocate from the connection's read_memory.
+    struct SReadHandler {
+        std::shared_ptr<CWebSocketClient> self;
+        ConnectionPtr conn;
+        CHandlerMemory* memory;
+
+        using allocator_type = THandlerAllocator<SReadHandler>;
+        allocator_type get_allocator() const noexcept { return allocator_type(*memory); }
+        void operator()(beast::error_code ec, std::size_t bytes_transferred);
+    };
+    struct SSslSessionFree {
+        void operator()(SSL_SESSION* session) const { SSL_SESSION_free(session); }
+    };
+
+    bool Owns(const ConnectionPtr& conn) const { return conn && (conn == m_conn || conn == m_standby || conn == m_retiring); }
+    void Connect(const ConnectionPtr& conn);
+    void OnResolve(const ConnectionPtr& conn, beast::error_code ec, tcp::resolver::results_type results);
+    void StartRace(const ConnectionPtr& conn, std::vector<tcp::endpoint> endpoints);
+    void OnRaceConnect(const ConnectionPtr& conn, const std::shared_ptr<SConnectRace>& race, size_t index,
+                       beast::error_code ec);
+    static int OnNewTlsSession(SSL* ssl, SSL_SESSION* session);
+    void OnConnect(const ConnectionPtr& conn, beast::error_code ec, tcp::endpoint endpoint);
+    void OnSslHandshake(const ConnectionPtr& conn, beast::error_code ec);
+    void OnWebsocketHandshake(const ConnectionPtr& conn, beast::error_code ec);
+    void StartRead(SReadHandler handler);
+    // Returns true when the connection reads on.
+    bool OnRead(const ConnectionPtr& conn, beast::error_code ec, std::size_t bytes_transferred);
+    const char* VenueName() const {
+        return VisitFeedAdapter(m_venue, [](const auto& adapter) { return adapter.Name(); });
+    }
+    // Drops the trade if another connection, live or the last one closed,
+    // already delivered its trade id. Either of two overlapping connections
+    // may be ahead, so a plain high-water mark would drop trades the lagging
+    // one has not delivered yet.
+    bool IsDuplicate(const ConnectionPtr& conn, const STrade& trade);
+    // Routes a failed connection: a retiring or standby one is just dropped,
+    // the active one hands over to the standby if there is one and
+    // reconnects otherwise.
+    void Fail(const ConnectionPtr& conn, std::string_view reason, beast::error_code ec);
     void ScheduleReconnect(std::string_view reason, beast::error_code ec = {});
     void CloseConnection();
+    void Close(const ConnectionPtr& conn);
     void OnReconnectTimer(beast::error_code timer_ec);
+    void SchedulePing();
+    void OnPingTimer(beast::error_code ec);
+    void ScheduleRotation(std::chrono::seconds delay);
+    void StartStandby(const std::string& reason);
+    void OnOverlapTimer(beast::error_code ec);
+    void ScheduleStats();
+    void OnStatsTimer(beast::error_code ec);
+    uint64_t CurrentWireBytes() const;
+    std::string RttText() const;
 
     net::io_context& m_ioc;
     ssl::context m_ssl_ctx;
     tcp::resolver m_resolver;
-    std::optional<websocket::stream<beast::ssl_stream<beast::tcp_stream>>> m_ws;
-    beast::flat_buffer m_buffer;
+    ConnectionPtr m_conn;
+    ConnectionPtr m_standby;
+    ConnectionPtr m_retiring;
+    CHandlerMemory m_timer_memory;  // the periodic ping and stats timers
     net::steady_timer m_reconnect_timer;
+    net::steady_timer m_stats_timer;
+    net::steady_timer m_ping_timer;
+    net::steady_timer m_rotate_timer;
+    net::steady_timer m_overlap_timer;
 
     SAppConfig m_cfg;
+    EFeedVenue m_venue = EFeedVenue::Binance;
 
     std::shared_ptr<CTradeQueue> m_trade_queue;
+    std::shared_ptr<CBookManager> m_book_manager;
+    // Trades go to the queue through the batcher. A batch left over when a
+    // read completes is pushed by a posted handler, which runs once the
+    // handlers already ready have run: the io loop has gone idle.
+    CTradeBatcher m_batcher;
+    CHandlerMemory m_flush_memory;
+    bool m_flush_posted{false};
 
     bool m_reconnect_scheduled{false};
     uint32_t m_retry_attempt{0};
-};
\ No newline at end of file
+
+    SWsTrafficStats m_traffic;
+    SWsTrafficStats m_traffic_logged;   // as of the previous stats line
+    uint64_t m_wire_bytes_closed{0};    // read by connections already closed
+
+    CEndpointTable m_endpoints;
+    std::unique_ptr<SSL_SESSION, SSslSessionFree> m_tls_session;
+    std::chrono::steady_clock::time_point m_disconnected_at{};  // epoch while connected
+    std::chrono::steady_clock::time_point m_ping_sent{};        // epoch when no ping is outstanding
+    SWsReconnectStats m_reconnect;
+    // Ranges of the connection closed last, whose replacement may still be behind it.
+    TradeIdRanges m_closed_trade_ids;
+};
@@ -0,0 +1,102 @@
+#include "window_arena.hpp"
+
+#include "logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include <sys/mman.h>
+
+CArenaPool::CArenaPool(size_t block_bytes, bool hugepages, size_t max_free_blocks)
+    : m_block_bytes(std::min(std::max<size_t>(block_bytes, 4096), kSlabBytes)),
+      m_hugepages(hugepages),
+      m_max_free_blocks(max_free_blocks) {}
+
+CArenaPool::~CArenaPool() {
+    if (m_hugepages) {
+        for (void* slab : m_slabs) {
+            munmap(slab, kSlabBytes);
+        }
+    } else {
+        for (void* block : m_free) {
+            ::operator delete(block);
+        }
+    }
+}
+
+void CArenaPool::MapSlab() {
+    void* slab = mmap(nullptr, kSlabBytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (slab == MAP_FAILED) {
+        const int hugetlb_errno = errno;
+        // No reserved huge pages: ask for transparent ones instead.
+        slab = mmap(nullptr, kSlabBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (slab == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        madvise(slab, kSlabBytes, MADV_HUGEPAGE);
+        if (m_slabs.empty()) {
+            Log(LogLevel::INFO, "Arena", std::string("MAP_HUGETLB unavailable (") + std::strerror(hugetlb_errno) +
+                "), using transparent huge pages");
+        }
+    }
+    m_slabs.push_back(slab);
+    auto* bytes = static_cast<std::byte*>(slab);
+    for (size_t offset = 0; offset + m_block_bytes <= kSlabBytes; offset += m_block_bytes) {
+        m_free.push_back(bytes + offset);
+        ++m_allocated;
+    }
+}
+
+void* CArenaPool::Acquire() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_free.empty()) {
+        if (m_hugepages) {
+            MapSlab();
+        } else {
+            ++m_allocated;
+            return ::operator new(m_block_bytes);
+        }
+    }
+    void* block = m_free.back();
+    m_free.pop_back();
+    return block;
+}
+
+void CArenaPool::Release(void* block) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Slab blocks always go back to the free list; heap blocks only up to the cap.
+    if (m_hugepages || m_free.size() < m_max_free_blocks) {
+        m_free.push_back(block);
+        return;
+    }
+    --m_allocated;
+    ::operator delete(block);
+}
+
+size_t CArenaPool::AllocatedBlocks() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_allocated;
+}
+
+size_t CArenaPool::FreeBlocks() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_free.size();
+}
+
+CWindowArena::CWindowArena() : m_resource(std::pmr::new_delete_resource()) {}
+
+CWindowArena::CWindowArena(std::shared_ptr<CArenaPool> pool)
+    : m_pool(std::move(pool)),
+      m_block(m_pool->Acquire()),
+      m_resource(m_block, m_pool->BlockBytes(), std::pmr::new_delete_resource()) {}
+
+CWindowArena::~CWindowArena() {
+    m_resource.release();
+    if (m_pool) {
+        m_pool->Release(m_block);
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+// Fixed-size blocks backing the per-window arenas, recycled from one window
+// to the next so a steady stream of windows does not touch the global heap.
+// With hugepages set, blocks are carved out of 2 MiB MAP_HUGETLB slabs (or
+// THP-advised mappings when no huge pages are reserved); slabs are only
+// unmapped with the pool. Thread-safe: the reader acquires, the writer releases.
+class CArenaPool {
+public:
+    static constexpr size_t kSlabBytes = 2u * 1024u * 1024u;
+
+    CArenaPool(size_t block_bytes, bool hugepages, size_t max_free_blocks = 8);
+    ~CArenaPool();
+    CArenaPool(const CArenaPool&) = delete;
+    CArenaPool& operator=(const CArenaPool&) = delete;
+
+    size_t BlockBytes() const { return m_block_bytes; }
+    bool UsingHugepages() const { return m_hugepages; }
+    void* Acquire();
+    void Release(void* block);
+
+    // Blocks currently obtained from the system (in use or idle), and idle blocks.
+    size_t AllocatedBlocks() const;
+    size_t FreeBlocks() const;
+
+private:
+    void MapSlab();
+
+    const size_t m_block_bytes;
+    const bool m_hugepages;
+    const size_t m_max_free_blocks;
+    mutable std::mutex m_mutex;
+    std::vector<void*> m_free;
+    std::vector<void*> m_slabs;
+    size_t m_allocated = 0;
+};
+
+// Monotonic arena of one aggregation window. The initial buffer is a pool
+// block that goes back to the pool when the arena dies; anything beyond it
+// comes from the global heap and is released at the same time.
+class CWindowArena {
+public:
+    // Without a pool the arena grows on the global heap only.
+    CWindowArena();
+    explicit CWindowArena(std::shared_ptr<CArenaPool> pool);
+    ~CWindowArena();
+    CWindowArena(const CWindowArena&) = delete;
+    CWindowArena& operator=(const CWindowArena&) = delete;
+
+    std::pmr::memory_resource* Resource() { return &m_resource; }
+
+private:
+    std::shared_ptr<CArenaPool> m_pool;
+    void* m_block = nullptr;
+    std::pmr::monotonic_buffer_resource m_resource;
+};
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <atomic>
 #include <thread>
 #include "aggregator.hpp"
 #include "trade.hpp"
@@ -78,3 +79,182 @@ TEST(AggregatorTest, Aggregate_UsingTimestamp) {
 
 
 
+
+TEST(AggregatorTest, AggTradeCountsUnderlyingTrades) {
+    SAppConfig cfg;
+    CTradeAggregator agg(cfg);
+    STrade agg_trade{"BTCUSDT", 100.0, 3.0, 1000, false};
+    agg_trade.first_trade_id = 10;
+    agg_trade.last_trade_id = 12;
+    agg.AddTrade(agg_trade);
+    agg.AddTrade({"BTCUSDT", 101.0, 1.0, 1000, true});
+
+    const auto stats = agg.FlushStatistics().at(1000).at("BTCUSDT");
+    EXPECT_EQ(stats.trades_count, 4u);
+    EXPECT_EQ(stats.buy_count, 3u);
+    EXPECT_EQ(stats.sell_count, 1u);
+    EXPECT_DOUBLE_EQ(stats.total_quantity, 4.0);
+}
+
+TEST(AggregatorTest, AddCoalescedMergesIntoWindow) {
+    SAppConfig cfg;
+    CTradeAggregator agg(cfg);
+    agg.AddTrade({"BTCUSDT", 100.0, 1.0, 1000, true});
+    SCoalescedTrades partial;
+    partial.symbol = "BTCUSDT";
+    partial.window_start = 1000;
+    partial.trades_count = 3;
+    partial.total_quantity = 2.0;
+    partial.total_volume = 230.0;
+    partial.min_price = 95.0;
+    partial.max_price = 120.0;
+    partial.buy_count = 2;
+    partial.sell_count = 1;
+    agg.AddCoalesced(partial);
+
+    const auto stats = agg.FlushStatistics().at(1000).at("BTCUSDT");
+    EXPECT_EQ(stats.trades_count, 4u);
+    EXPECT_DOUBLE_EQ(stats.total_volume, 330.0);
+    EXPECT_DOUBLE_EQ(stats.min_price, 95.0);
+    EXPECT_DOUBLE_EQ(stats.max_price, 120.0);
+    EXPECT_EQ(stats.buy_count, 2u);
+    EXPECT_EQ(stats.sell_count, 2u);
+}
+
+TEST(AggregatorTest, FlushDuringAddsLosesNothing) {
+    SAppConfig cfg;
+    cfg.agg.period_ms = 10;
+    CTradeAggregator agg(cfg);
+    constexpr uint64_t kTrades = 200000;
+    std::atomic<bool> done{false};
+    std::thread producer([&]() {
+        for (uint64_t i = 0; i < kTrades; ++i) {
+            agg.AddTrade({"BTCUSDT", 100.0, 1.0, 1000 + i / 100, (i & 1) != 0});
+        }
+        done.store(true);
+    });
+    uint64_t flushed = 0;
+    size_t flushes_with_windows = 0;
+    auto collect = [&]() {
+        const auto windows = agg.FlushStatistics();
+        flushes_with_windows += windows.empty() ? 0 : 1;
+        for (const auto& window : windows) {
+            flushed += window.second.at("BTCUSDT").trades_count;
+        }
+    };
+    while (!done.load()) {
+        collect();
+    }
+    producer.join();
+    collect();
+    EXPECT_EQ(flushed, kTrades);
+    EXPECT_GT(flushes_with_windows, 0u);
+}
+
+TEST(AggregatorTest, FlushTwiceInSameMillisecondSeesLateWindow) {
+    SAppConfig cfg;
+    CTradeAggregator agg(cfg);
+    agg.AddTrade({"BTCUSDT", 100.0, 1.0, 1000, true});
+    EXPECT_EQ(agg.FlushStatistics().size(), 1u);
+    agg.AddTrade({"BTCUSDT", 101.0, 1.0, 1000, true});
+    const auto late = agg.FlushStatistics();
+    ASSERT_EQ(late.size(), 1u);
+    EXPECT_EQ(late.at(1000).at("BTCUSDT").trades_count, 1u);
+}
+
+TEST(AggregatorTest, WaitForFlushDueFollowsEarliestWindow) {
+    SAppConfig cfg;
+    cfg.agg.period_ms = 1000;
+    CTradeAggregator agg(cfg);
+    EXPECT_EQ(agg.NextFlushDeadlineMs(), CTradeAggregator::kNoDeadline);
+    EXPECT_FALSE(agg.WaitForFlushDue(std::chrono::milliseconds(5)));
+
+    agg.AddTrade({"BTCUSDT", 100.0, 1.0, 3500, true});
+    agg.AddTrade({"BTCUSDT", 100.0, 1.0, 1500, true});
+    EXPECT_EQ(agg.NextFlushDeadlineMs(), 2000u);
+    EXPECT_TRUE(agg.WaitForFlushDue(std::chrono::milliseconds(5)));
+    EXPECT_EQ(agg.FlushStatistics().size(), 2u);
+    EXPECT_EQ(agg.NextFlushDeadlineMs(), CTradeAggregator::kNoDeadline);
+}
+
+TEST(AggregatorTest, WaitForFlushDueWakesOnNewWindowAndInterrupt) {
+    SAppConfig cfg;
+    CTradeAggregator agg(cfg);
+    std::thread producer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        agg.AddTrade({"BTCUSDT", 100.0, 1.0, 1000, true});
+    });
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(agg.WaitForFlushDue(std::chrono::seconds(10)));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    producer.join();
+
+    agg.InterruptFlushWait();
+    EXPECT_FALSE(agg.WaitForFlushDue(std::chrono::seconds(10)));
+}
+
+TEST(AggregatorTest, TopKKeepsHeavyHittersAndRollsUpOthers) {
+    SAppConfig cfg;
+    cfg.agg.top_k = 2;
+    cfg.agg.sketch_slots = 4;
+    CTradeAggregator agg(cfg);
+    // Two heavy symbols among a long tail, interleaved so the tail churns the sketch.
+    double tail_volume = 0.0;
+    for (int i = 0; i < 100; ++i) {
+        agg.AddTrade({"BTCUSDT", 100.0, 1.0, 1000, true});
+        agg.AddTrade({"ETHUSDT", 50.0, 1.0, 1000, false});
+        agg.AddTrade({"TAIL" + std::to_string(i) + "USDT", 1.0, 1.0, 1000, false});
+        tail_volume += 1.0;
+    }
+
+    const auto windows = agg.FlushStatistics();
+    const auto& window = windows.at(1000);
+    ASSERT_EQ(window.size(), 3u);
+    EXPECT_EQ(window.at("BTCUSDT").trades_count, 100u);
+    EXPECT_DOUBLE_EQ(window.at("BTCUSDT").total_volume, 10000.0);
+    EXPECT_EQ(window.at("ETHUSDT").trades_count, 100u);
+    const auto& others = window.at(CTradeAggregator::WindowStats::kOthersSymbol);
+    EXPECT_EQ(others.trades_count, 100u);
+    EXPECT_DOUBLE_EQ(others.total_volume, tail_volume);
+    EXPECT_EQ(others.buy_count, 100u);
+    EXPECT_DOUBLE_EQ(others.min_price, 1.0);
+}
+
+TEST(AggregatorTest, TopKBoundsTrackedSymbols) {
+    CTradeAggregator::WindowStats window(std::make_unique<CWindowArena>(), 8, 3);
+    uint64_t trades = 0;
+    for (int i = 0; i < 1000; ++i) {
+        auto& stats = window.Track("S" + std::to_string(i % 250));
+        stats.trades_count += 1;
+        stats.total_volume += 1.0 + static_cast<double>(i % 250);
+        stats.min_price = std::min(stats.min_price, 1.0);
+        stats.max_price = std::max(stats.max_price, 1.0);
+        ++trades;
+        EXPECT_LE(window.size(), 8u);
+    }
+    window.KeepTopK();
+    EXPECT_EQ(window.size(), 4u);
+    uint64_t total = 0;
+    for (const auto& entry : window) {
+        total += entry.second.trades_count;
+    }
+    EXPECT_EQ(total, trades);
+}
+
+TEST(AggregatorTest, TopKDropsBookSamplesOfUntrackedSymbols) {
+    SAppConfig cfg;
+    cfg.agg.top_k = 1;
+    cfg.agg.sketch_slots = 1;
+    CTradeAggregator agg(cfg);
+    agg.AddTrade({"BTCUSDT", 100.0, 1.0, 1000, true});
+    SBookSample sample{};
+    sample.best_bid = 99.0;
+    sample.best_ask = 101.0;
+    agg.AddBookSample("BTCUSDT", 1000, sample);
+    agg.AddBookSample("ETHUSDT", 1000, sample);
+
+    const auto windows = agg.FlushStatistics();
+    const auto& window = windows.at(1000);
+    EXPECT_EQ(window.size(), 1u);
+    EXPECT_EQ(window.at("BTCUSDT").book.samples, 1u);
+}
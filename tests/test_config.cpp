@@ -41,4 +41,139 @@ TEST(ConfigTest, BuildStreamTarget) {
     std::string target = BuildStreamTarget(pairs);
     EXPECT_NE(target.find("btcusdt"), std::string::npos);
     EXPECT_NE(target.find("ethusdt"), std::string::npos);
+    EXPECT_EQ(BuildStreamTarget(pairs, "", "aggTrade"), "/stream?streams=btcusdt@aggTrade/ethusdt@aggTrade");
+}
+
+TEST(ConfigTest, ValidateConfig_InvalidWsStream) {
+    SAppConfig cfg;
+    cfg.ws.stream = "aggTrade";
+    EXPECT_TRUE(ValidateConfig(cfg));
+    cfg.ws.stream = "kline_1m";
+    EXPECT_FALSE(ValidateConfig(cfg));
+}
+
+TEST(ConfigTest, ValidateConfig_InvalidWsDeflate) {
+    SAppConfig cfg;
+    cfg.ws.deflate.enabled = true;
+    cfg.ws.deflate.server_max_window_bits = 9;
+    EXPECT_TRUE(ValidateConfig(cfg));
+    cfg.ws.deflate.server_max_window_bits = 8;
+    EXPECT_FALSE(ValidateConfig(cfg));
+    cfg.ws.deflate.server_max_window_bits = 15;
+    cfg.ws.deflate.client_max_window_bits = 16;
+    EXPECT_FALSE(ValidateConfig(cfg));
+    cfg.ws.deflate.client_max_window_bits = 15;
+    cfg.ws.stats_interval_sec = -1;
+    EXPECT_FALSE(ValidateConfig(cfg));
+}
+
+TEST(ConfigTest, ValidateConfig_InvalidWsReconnect) {
+    SAppConfig cfg;
+    cfg.ws.connect_race = 0;
+    EXPECT_FALSE(ValidateConfig(cfg));
+    cfg.ws.connect_race = 1;
+    cfg.ws.dns_cache_sec = -1;
+    EXPECT_FALSE(ValidateConfig(cfg));
+    cfg.ws.dns_cache_sec = 0;
+    cfg.ws.ping_interval_sec = 0;
+    EXPECT_TRUE(ValidateConfig(cfg));
+    cfg.ws.rotate_lead_sec = cfg.ws.max_connection_age_sec;
+    EXPECT_FALSE(ValidateConfig(cfg));
+    cfg.ws.max_connection_age_sec = 0;  // no scheduled rotation: the lead is unused
+    EXPECT_TRUE(ValidateConfig(cfg));
+    cfg.ws.rotate_overlap_ms = -1;
+    EXPECT_FALSE(ValidateConfig(cfg));
+}
+
+TEST(ConfigTest, ValidateConfig_InvalidWsVenue) {
+    SAppConfig cfg;
+    cfg.ws.venue = "kraken";
+    EXPECT_FALSE(ValidateConfig(cfg));
+    cfg.ws.venue = "okx";
+    EXPECT_TRUE(ValidateConfig(cfg));
+    cfg.book.enabled = true;  // depth snapshots and diffs are Binance's
+    EXPECT_FALSE(ValidateConfig(cfg));
+}
+
+TEST(ConfigTest, ValidateConfig_InvalidTicks) {
+    SAppConfig cfg;
+    cfg.ticks.enabled = true;
+    EXPECT_TRUE(ValidateConfig(cfg));
+    cfg.ticks.file_records = 0;
+    EXPECT_FALSE(ValidateConfig(cfg));
+    cfg.ticks.file_records = 1024;
+    cfg.ticks.dir.clear();
+    EXPECT_FALSE(ValidateConfig(cfg));
+}
+
+TEST(ConfigTest, ValidateConfig_InvalidQueueBatch) {
+    SAppConfig cfg;
+    cfg.queue.batch_max = 1;
+    EXPECT_TRUE(ValidateConfig(cfg));
+    cfg.queue.batch_max = 0;
+    EXPECT_FALSE(ValidateConfig(cfg));
+    cfg.queue.batch_max = 8192;
+    EXPECT_FALSE(ValidateConfig(cfg));
+}
+
+TEST(ConfigTest, ValidateConfig_InvalidTopK) {
+    SAppConfig cfg;
+    cfg.agg.top_k = 20;
+    cfg.agg.sketch_slots = 20;
+    EXPECT_TRUE(ValidateConfig(cfg));
+    cfg.agg.sketch_slots = 10;
+    EXPECT_FALSE(ValidateConfig(cfg));
+    cfg.agg.sketch_slots = 100000;
+    EXPECT_FALSE(ValidateConfig(cfg));
+}
+
+TEST(ConfigTest, ValidateConfig_InvalidCompression) {
+    SAppConfig cfg;
+    cfg.output.compression = "lz4";
+    EXPECT_FALSE(ValidateConfig(cfg));
+    cfg.output.compression = "zlib";
+    EXPECT_TRUE(ValidateConfig(cfg));
+    cfg.output.compression_level = 42;
+    EXPECT_FALSE(ValidateConfig(cfg));
+}
+
+TEST(ConfigTest, ValidateConfig_InvalidThreads) {
+    SAppConfig cfg;
+    cfg.threads.reader.cpus = {-1};
+    EXPECT_FALSE(ValidateConfig(cfg));
+    cfg.threads.reader.cpus = {0};
+    cfg.threads.writer.fifo_priority = 100;
+    EXPECT_FALSE(ValidateConfig(cfg));
+}
+
+TEST(ConfigTest, ValidateConfig_InvalidBook) {
+    SAppConfig cfg;
+    cfg.book.enabled = true;
+    EXPECT_TRUE(ValidateConfig(cfg));
+    cfg.book.stream = "depth@1s";
+    EXPECT_FALSE(ValidateConfig(cfg));
+    cfg.book.stream = "depth";
+    cfg.book.tick_sizes["btcusdt"] = 0.0;
+    EXPECT_FALSE(ValidateConfig(cfg));
+}
+
+TEST(ConfigTest, ValidateConfig_InvalidQueueOverflow) {
+    SAppConfig cfg;
+    cfg.queue.overflow = "coalesce";
+    EXPECT_TRUE(ValidateConfig(cfg));
+    cfg.queue.overflow = "drop_oldest";
+    EXPECT_FALSE(ValidateConfig(cfg));
+}
+
+TEST(ConfigTest, ValidateConfig_InvalidHistoryArchive) {
+    SAppConfig cfg;
+    cfg.history.enabled = true;
+    EXPECT_TRUE(ValidateConfig(cfg));
+    cfg.history.chunk_windows = 0;
+    EXPECT_FALSE(ValidateConfig(cfg));
+    cfg.history.compressed_retention_sec = 0;
+    EXPECT_TRUE(ValidateConfig(cfg));
+    cfg.history.persist_dir = "/tmp";
+    cfg.history.persist_max_files = 0;
+    EXPECT_FALSE(ValidateConfig(cfg));
 }
@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include "endpoint_table.hpp"
+
+namespace {
+CEndpointTable::Endpoint Ep(const char* address) {
+    return {boost::asio::ip::make_address(address), 9443};
+}
+}
+
+TEST(EndpointTableTest, CacheExpiresAfterTtl) {
+    CEndpointTable table(std::chrono::seconds(60));
+    const auto t0 = CEndpointTable::Clock::now();
+    EXPECT_FALSE(table.Fresh(t0));
+    table.SetResolved({Ep("10.0.0.1")}, t0);
+    EXPECT_TRUE(table.Fresh(t0 + std::chrono::seconds(59)));
+    EXPECT_FALSE(table.Fresh(t0 + std::chrono::seconds(60)));
+    table.SetResolved({Ep("10.0.0.1")}, t0);
+    table.Invalidate();
+    EXPECT_FALSE(table.Fresh(t0));
+}
+
+TEST(EndpointTableTest, RanksByRttThenUnmeasuredThenFailed) {
+    CEndpointTable table(std::chrono::seconds(60));
+    table.SetResolved({Ep("10.0.0.1"), Ep("10.0.0.2"), Ep("10.0.0.3"), Ep("10.0.0.4")},
+                      CEndpointTable::Clock::now());
+    table.RecordFailure(Ep("10.0.0.1"));
+    table.RecordRtt(Ep("10.0.0.3"), std::chrono::microseconds(9000));
+    table.RecordRtt(Ep("10.0.0.4"), std::chrono::microseconds(2000));
+    const std::vector<CEndpointTable::Endpoint> expected{Ep("10.0.0.4"), Ep("10.0.0.3"), Ep("10.0.0.2"),
+                                                         Ep("10.0.0.1")};
+    EXPECT_EQ(table.Ranked(), expected);
+
+    // A sample clears the failure; the history survives a new resolution.
+    table.RecordRtt(Ep("10.0.0.1"), std::chrono::microseconds(1000));
+    table.SetResolved({Ep("10.0.0.3"), Ep("10.0.0.1")}, CEndpointTable::Clock::now());
+    const std::vector<CEndpointTable::Endpoint> after{Ep("10.0.0.1"), Ep("10.0.0.3")};
+    EXPECT_EQ(table.Ranked(), after);
+}
+
+TEST(EndpointTableTest, SmoothsRtt) {
+    CEndpointTable table(std::chrono::seconds(60));
+    EXPECT_FALSE(table.SmoothedRtt(Ep("10.0.0.1")).has_value());
+    table.RecordRtt(Ep("10.0.0.1"), std::chrono::microseconds(8000));
+    table.RecordRtt(Ep("10.0.0.1"), std::chrono::microseconds(16000));
+    EXPECT_EQ(table.SmoothedRtt(Ep("10.0.0.1"))->count(), 9000);
+}
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include "feed_adapter.hpp"
+#include <string>
+#include <vector>
+
+namespace {
+// Frames as the venues send them, including the events around the trades.
+const char* const kOkxFrames[] = {
+    R"({"event":"subscribe","arg":{"channel":"trades","instId":"BTC-USDT"},"connId":"a4d3ae55"})",
+    R"({"arg":{"channel":"trades","instId":"BTC-USDT"},"data":[{"instId":"BTC-USDT","tradeId":"130639474","px":"42219.9","sz":"0.12060306","side":"buy","ts":"1630048897897","count":"3"}]})",
+    R"({"arg":{"channel":"trades","instId":"ETH-USDT"},"data":[{"instId":"ETH-USDT","tradeId":"9001","px":"3050.25","sz":"1.5","side":"sell","ts":"1630048897901","count":"1"},{"instId":"ETH-USDT","tradeId":"9002","px":"3050.3","sz":"0.25","side":"buy","ts":"1630048897901","count":"1"}]})",
+    "pong",
+};
+
+template <typename TAdapter>
+std::vector<STrade> ParseAll(const TAdapter& adapter, const std::vector<std::string>& frames) {
+    std::vector<STrade> trades;
+    for (const auto& frame : frames) {
+        adapter.ParseFrame(frame, [&](STrade&& t) { trades.push_back(std::move(t)); });
+    }
+    return trades;
+}
+}
+
+TEST(FeedAdapterTest, BinanceMatchesJsonParser) {
+    const std::vector<std::string> frames{
+        R"({"stream":"btcusdt@trade","data":{"e":"trade","E":123457,"s":"BTCUSDT","t":42,"p":"100.5","q":"0.25","T":123456,"m":true,"M":true}})",
+        R"({"stream":"btcusdt@aggTrade","data":{"e":"aggTrade","E":123457,"s":"BTCUSDT","a":26129,"p":"100.5","q":"3.0","f":100,"l":104,"T":123456,"m":false,"M":true}})",
+        R"({"s":"ETHUSDT","p":"10.0","q":"1.0","T":123456,"m":true})",
+    };
+    const auto trades = ParseAll(CBinanceFeed{}, frames);
+    ASSERT_EQ(trades.size(), frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        const STrade expected = STrade::FromJson(frames[i]);
+        EXPECT_EQ(trades[i].symbol, expected.symbol);
+        EXPECT_DOUBLE_EQ(trades[i].price, expected.price);
+        EXPECT_DOUBLE_EQ(trades[i].quantity, expected.quantity);
+        EXPECT_EQ(trades[i].timestamp, expected.timestamp);
+        EXPECT_EQ(trades[i].buyer_initiated, expected.buyer_initiated);
+        EXPECT_EQ(trades[i].first_trade_id, expected.first_trade_id);
+        EXPECT_EQ(trades[i].last_trade_id, expected.last_trade_id);
+    }
+
+    // Depth diffs are left to the book; broken trades throw like FromJson.
+    EXPECT_EQ(ParseAll(CBinanceFeed{}, {R"({"stream":"btcusdt@depth","data":{"e":"depthUpdate","E":1,"s":"BTCUSDT","U":1,"u":2,"b":[],"a":[]}})"}).size(), 0u);
+    EXPECT_THROW(ParseAll(CBinanceFeed{}, {R"({"s":"","p":"100.0","q":"1.0","T":123456,"m":true})"}), std::runtime_error);
+    EXPECT_THROW(ParseAll(CBinanceFeed{}, {R"({"s":"BTCUSDT","p":"abc","q":"1.0","T":123456,"m":true})"}), std::runtime_error);
+    EXPECT_THROW(ParseAll(CBinanceFeed{}, {R"({"s":"BTCUSDT","p":"100.0")"}), std::runtime_error);
+}
+
+TEST(FeedAdapterTest, OkxTradesFrames) {
+    const auto trades = ParseAll(COkxFeed{}, std::vector<std::string>(std::begin(kOkxFrames), std::end(kOkxFrames)));
+    ASSERT_EQ(trades.size(), 3u);
+    EXPECT_EQ(trades[0].symbol, "BTC-USDT");
+    EXPECT_DOUBLE_EQ(trades[0].price, 42219.9);
+    EXPECT_DOUBLE_EQ(trades[0].quantity, 0.12060306);
+    EXPECT_EQ(trades[0].timestamp, 1630048897897u);
+    EXPECT_FALSE(trades[0].buyer_initiated);  // taker buy: the buyer was not the maker
+    EXPECT_EQ(trades[0].first_trade_id, 130639472u);
+    EXPECT_EQ(trades[0].last_trade_id, 130639474u);
+    EXPECT_EQ(trades[0].TradeCount(), 3u);
+    EXPECT_EQ(trades[1].symbol, "ETH-USDT");
+    EXPECT_TRUE(trades[1].buyer_initiated);
+    EXPECT_EQ(trades[1].TradeCount(), 1u);
+    EXPECT_EQ(trades[2].last_trade_id, 9002u);
+
+    EXPECT_THROW(ParseAll(COkxFeed{}, {R"({"event":"error","code":"60012","msg":"Invalid request"})"}), std::runtime_error);
+    EXPECT_THROW(ParseAll(COkxFeed{}, {R"({"arg":{},"data":[{"instId":"BTC-USDT","px":"1.0","sz":"1.0","side":"buy","ts":"1"}]})"}),
+                 std::runtime_error);
+}
+
+TEST(FeedAdapterTest, TargetsAndSubscriptions) {
+    SAppConfig cfg;
+    cfg.trade_pairs = {"btcusdt", "ethusdt"};
+    EXPECT_EQ(CBinanceFeed{}.Target(cfg), "/stream?streams=btcusdt@trade/ethusdt@trade");
+    EXPECT_EQ(CBinanceFeed{}.SubscribeMessage(cfg), "");
+
+    cfg.trade_pairs = {"btc-usdt", "eth-usdt"};
+    EXPECT_EQ(COkxFeed{}.Target(cfg), "/ws/v5/public");
+    EXPECT_EQ(COkxFeed{}.SubscribeMessage(cfg),
+              R"({"op":"subscribe","args":[{"channel":"trades","instId":"BTC-USDT"},{"channel":"trades","instId":"ETH-USDT"}]})");
+    EXPECT_EQ(COkxFeed{}.KeepaliveMessage(), "ping");
+
+    EFeedVenue venue = EFeedVenue::Binance;
+    EXPECT_TRUE(ParseFeedVenue("okx", venue));
+    EXPECT_EQ(venue, EFeedVenue::Okx);
+    EXPECT_FALSE(ParseFeedVenue("kraken", venue));
+    EXPECT_STREQ(VisitFeedAdapter(venue, [](const auto& adapter) { return adapter.Name(); }), "okx");
+}
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include "handler_memory.hpp"
+#include <boost/asio.hpp>
+#include <functional>
+
+TEST(HandlerMemoryTest, RecyclesFreedBlocks) {
+    CHandlerMemory memory;
+    void* a = memory.Allocate(256);
+    memory.Deallocate(a);
+    EXPECT_EQ(memory.Allocate(200), a);  // a smaller request reuses the block
+    EXPECT_EQ(memory.Allocations(), 1u);
+
+    void* b = memory.Allocate(512);  // a is in use
+    EXPECT_NE(b, a);
+    memory.Deallocate(a);
+    memory.Deallocate(b);
+    EXPECT_EQ(memory.Allocations(), 2u);
+
+    // Growth replaces a free block that is too small.
+    void* blocks[CHandlerMemory::kBlocks];
+    for (auto& block : blocks) {
+        block = memory.Allocate(512);
+    }
+    EXPECT_EQ(memory.Allocations(), 2u + CHandlerMemory::kBlocks - 1);
+    EXPECT_EQ(memory.Overflows(), 0u);
+
+    // Every block in use: the next request goes to operator new.
+    void* extra = memory.Allocate(64);
+    EXPECT_EQ(memory.Overflows(), 1u);
+    memory.Deallocate(extra);
+    for (auto* block : blocks) {
+        memory.Deallocate(block);
+    }
+    EXPECT_EQ(memory.Allocations(), 2u + CHandlerMemory::kBlocks);
+}
+
+TEST(HandlerMemoryTest, AsioOperationsLoopWithoutAllocating) {
+    boost::asio::io_context ioc;
+    boost::asio::steady_timer timer(ioc);
+    CHandlerMemory memory;
+    int remaining = 1000;
+    std::function<void()> arm = [&]() {
+        timer.expires_after(std::chrono::microseconds(0));
+        timer.async_wait(MakeAllocHandler(memory, [&](boost::system::error_code ec) {
+            if (!ec && --remaining > 0) {
+                arm();
+            }
+        }));
+    };
+    arm();
+    ioc.run();
+    EXPECT_EQ(remaining, 0);
+    EXPECT_EQ(memory.Allocations(), 1u);
+    EXPECT_EQ(memory.Overflows(), 0u);
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include "log_compressor.hpp"
+#include "logger.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <zlib.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+fs::path MakeTempDir(const std::string& name) {
+    fs::path dir = fs::temp_directory_path() / name;
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    return dir;
+}
+
+void WriteText(const fs::path& path, const std::string& text) {
+    std::ofstream out(path, std::ios::trunc);
+    out << text;
+}
+
+std::string Gunzip(const fs::path& path) {
+    gzFile gz = gzopen(path.string().c_str(), "rb");
+    std::string result;
+    char buf[4096];
+    int n = 0;
+    while ((n = gzread(gz, buf, sizeof(buf))) > 0) {
+        result.append(buf, static_cast<size_t>(n));
+    }
+    gzclose(gz);
+    return result;
+}
+
+std::string SampleLog(int windows) {
+    std::ostringstream oss;
+    for (int i = 0; i < windows; ++i) {
+        oss << "timestamp=2024-01-01T00:00:0" << (i % 10) << "Z\n"
+            << "symbol=BTCUSDT trades=12 volume=1234.50000 quantity=1.00000 min=100.00 max=110.00 buy=6 sell=6\n";
+    }
+    return oss.str();
+}
+}
+
+TEST(LogCompressorTest, ParseCompression) {
+    ECompression algo = ECompression::None;
+    EXPECT_TRUE(ParseCompression("zlib", algo));
+    EXPECT_EQ(algo, ECompression::Zlib);
+    EXPECT_TRUE(ParseCompression("none", algo));
+    EXPECT_EQ(algo, ECompression::None);
+    EXPECT_FALSE(ParseCompression("lz4", algo));
+    EXPECT_EQ(CompressionSuffix(ECompression::Zlib), ".gz");
+    EXPECT_FALSE(IsValidCompressionLevel(ECompression::Zlib, 0));
+}
+
+TEST(LogCompressorTest, CompressFileRoundTrip) {
+    const auto dir = MakeTempDir("cqg_compress_roundtrip");
+    const std::string text = SampleLog(500);
+    WriteText(dir / "in.log", text);
+
+    SCompressionResult result;
+    ASSERT_TRUE(CLogCompressor::CompressFile((dir / "in.log").string(), (dir / "out.gz").string(),
+                                             ECompression::Zlib, 6, result));
+    EXPECT_EQ(result.input_bytes, text.size());
+    EXPECT_LT(result.output_bytes, result.input_bytes);
+    EXPECT_FALSE(fs::exists(dir / "out.gz.tmp"));
+    EXPECT_EQ(Gunzip(dir / "out.gz"), text);
+    fs::remove_all(dir);
+}
+
+TEST(LogCompressorTest, RotationKeepsMaxCompressedGenerations) {
+    const auto dir = MakeTempDir("cqg_compress_rotation");
+    const std::string base = (dir / "aggregates.log").string();
+
+    CLogCompressor compressor(ECompression::Zlib, 6, base, 2);
+    compressor.Start();
+    for (int i = 0; i < 3; ++i) {
+        WriteText(base, SampleLog(i + 1));
+        auto pending = DetachLogIfNeeded(base, 1);
+        ASSERT_FALSE(pending.empty());
+        EXPECT_FALSE(fs::exists(base));
+        compressor.Enqueue(pending);
+    }
+    compressor.Stop();
+
+    EXPECT_EQ(Gunzip(base + ".1.gz"), SampleLog(3));
+    EXPECT_EQ(Gunzip(base + ".2.gz"), SampleLog(2));
+    EXPECT_FALSE(fs::exists(base + ".3.gz"));
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        EXPECT_EQ(entry.path().filename().string().find(".pending."), std::string::npos);
+    }
+    fs::remove_all(dir);
+}
+
+TEST(LogCompressorTest, StartPicksUpLeftoverPendingFiles) {
+    const auto dir = MakeTempDir("cqg_compress_leftover");
+    const std::string base = (dir / "aggregates.log").string();
+    WriteText(base + ".pending.1000", SampleLog(4));
+
+    CLogCompressor compressor(ECompression::Zlib, 1, base, 3);
+    compressor.Start();
+    compressor.Stop();
+
+    EXPECT_FALSE(fs::exists(base + ".pending.1000"));
+    EXPECT_EQ(Gunzip(base + ".1.gz"), SampleLog(4));
+    fs::remove_all(dir);
+}
+
+TEST(LogCompressorTest, DetachSkipsSmallFile) {
+    const auto dir = MakeTempDir("cqg_compress_small");
+    const std::string base = (dir / "aggregates.log").string();
+    WriteText(base, "x");
+    EXPECT_TRUE(DetachLogIfNeeded(base, 1024).empty());
+    EXPECT_TRUE(fs::exists(base));
+    fs::remove_all(dir);
+}
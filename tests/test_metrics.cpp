@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include "aggregator.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+STrade MakeTrade(double price, double quantity = 1.0) {
+    return {"BTCUSDT", price, quantity, 1000, false};
+}
+}
+
+TEST(MetricsTest, StddevMatchesTwoPassFormula) {
+    SPriceStddevMetric::State state;
+    const std::vector<double> prices{65000.10, 65000.30, 64999.90, 65001.00, 65000.50};
+    for (double p : prices) {
+        SPriceStddevMetric::Add(state, p, 1.0);
+    }
+    double mean = 0.0;
+    for (double p : prices) {
+        mean += p / prices.size();
+    }
+    double var = 0.0;
+    for (double p : prices) {
+        var += (p - mean) * (p - mean) / prices.size();
+    }
+    EXPECT_NEAR(SPriceStddevMetric::Value(state), std::sqrt(var), 1e-9);
+    EXPECT_DOUBLE_EQ(SPriceStddevMetric::Value(SPriceStddevMetric::State{}), 0.0);
+}
+
+TEST(MetricsTest, QuantileEstimateIsCloseToExact) {
+    std::mt19937_64 rng(7);
+    std::normal_distribution<double> price(3200.0, 5.0);
+    SPriceQuantileMetric<50>::State median;
+    SPriceQuantileMetric<99>::State p99;
+    std::vector<double> prices;
+    for (int i = 0; i < 20000; ++i) {
+        const double p = price(rng);
+        prices.push_back(p);
+        SPriceQuantileMetric<50>::Add(median, p, 1.0);
+        SPriceQuantileMetric<99>::Add(p99, p, 1.0);
+    }
+    std::sort(prices.begin(), prices.end());
+    EXPECT_NEAR(SPriceQuantileMetric<50>::Value(median), prices[prices.size() / 2], 0.2);
+    EXPECT_NEAR(SPriceQuantileMetric<99>::Value(p99), prices[prices.size() * 99 / 100], 0.5);
+
+    // Exact while there are fewer than five samples.
+    SPriceQuantileMetric<50>::State few;
+    for (double p : {3.0, 1.0, 2.0}) {
+        SPriceQuantileMetric<50>::Add(few, p, 1.0);
+    }
+    EXPECT_DOUBLE_EQ(SPriceQuantileMetric<50>::Value(few), 2.0);
+}
+
+TEST(MetricsTest, MinimalSetAddsNothing) {
+    EXPECT_EQ(CMinimalMetrics::kSize, 0u);
+    EXPECT_LT(sizeof(CBasicTradeAggregator<CMinimalMetrics>::SSymbolStats),
+              sizeof(CBasicTradeAggregator<CFullMetrics>::SSymbolStats));
+    std::ostringstream os;
+    CMinimalMetrics().Print(os, CBasicTradeAggregator<CMinimalMetrics>::SSymbolStats{});
+    EXPECT_TRUE(os.str().empty());
+}
+
+TEST(MetricsTest, FullAggregatorComputesAndPrintsMetrics) {
+    SAppConfig cfg;
+    CBasicTradeAggregator<CFullMetrics> agg(cfg);
+    agg.AddTrade(MakeTrade(100.0, 1.0));
+    agg.AddTrade(MakeTrade(110.0, 3.0));
+    agg.AddTrade(MakeTrade(120.0, 1.0));
+    const auto windows = agg.FlushStatistics();
+    ASSERT_EQ(windows.size(), 1u);
+    const auto& stats = windows.begin()->second.at("BTCUSDT");
+    EXPECT_EQ(stats.trades_count, 3u);
+    EXPECT_NEAR(SPriceStddevMetric::Value(stats.metrics.Get<SPriceStddevMetric>()), std::sqrt(200.0 / 3.0), 1e-9);
+    EXPECT_DOUBLE_EQ(SPriceQuantileMetric<50>::Value(stats.metrics.Get<SPriceQuantileMetric<50>>()), 110.0);
+
+    std::ostringstream os;
+    os << std::fixed;
+    stats.metrics.Print(os, stats);
+    EXPECT_EQ(os.str(), " vwap=110.00000 stddev=8.16497 p50=110.00 p99=120.00");
+}
@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include "aggregator.hpp"
+#include "config.hpp"
+#include "order_book.hpp"
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+SDepthUpdate MakeUpdate(uint64_t first, uint64_t last,
+                        std::vector<std::pair<double, double>> bids,
+                        std::vector<std::pair<double, double>> asks) {
+    SDepthUpdate u;
+    u.symbol = "BTCUSDT";
+    u.event_time = 1000 + last;
+    u.first_update_id = first;
+    u.final_update_id = last;
+    u.bids = std::move(bids);
+    u.asks = std::move(asks);
+    return u;
+}
+
+fs::path WriteSnapshot(const std::string& dir_name, uint64_t last_update_id) {
+    fs::path dir = fs::temp_directory_path() / dir_name;
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::ofstream(dir / "BTCUSDT.json")
+        << R"({"lastUpdateId":)" << last_update_id
+        << R"(,"bids":[["100.00","1.0"],["99.99","2.0"],["99.90","3.0"]],)"
+        << R"("asks":[["100.02","1.5"],["100.05","2.5"]]})";
+    return dir;
+}
+}
+
+TEST(OrderBookTest, FlatBookTopAndDepth) {
+    CFlatOrderBook book(0.01, 1024);
+    book.Set(true, 100.00, 1.0);
+    book.Set(true, 99.98, 2.0);
+    book.Set(false, 100.03, 0.5);
+    book.Set(false, 100.01, 0.7);
+    ASSERT_TRUE(book.HasTop());
+    EXPECT_DOUBLE_EQ(book.BestBid(), 100.00);
+    EXPECT_DOUBLE_EQ(book.BestAsk(), 100.01);
+    EXPECT_DOUBLE_EQ(book.Depth(true, 5), 3.0);
+    EXPECT_DOUBLE_EQ(book.Depth(false, 1), 0.7);
+
+    book.Set(true, 100.00, 0.0);
+    book.Set(false, 100.01, 0.0);
+    EXPECT_DOUBLE_EQ(book.BestBid(), 99.98);
+    EXPECT_DOUBLE_EQ(book.BestAsk(), 100.03);
+    EXPECT_EQ(book.LevelCount(true), 1u);
+}
+
+TEST(OrderBookTest, FlatBookRecentersWhenPriceMoves) {
+    CFlatOrderBook book(1.0, 16);
+    book.Set(true, 100.0, 1.0);
+    book.Set(false, 101.0, 1.0);
+    // Far outside the window relative to the current mid: ignored.
+    book.Set(true, 10.0, 5.0);
+    EXPECT_EQ(book.LevelCount(true), 1u);
+
+    // Market moves up step by step; the window follows the mid.
+    for (int p = 102; p <= 130; ++p) {
+        book.Set(false, p - 1, 0.0);
+        book.Set(true, p - 2, 0.0);
+        book.Set(true, p - 1, 1.0);
+        book.Set(false, p, 1.0);
+    }
+    EXPECT_DOUBLE_EQ(book.BestBid(), 129.0);
+    EXPECT_DOUBLE_EQ(book.BestAsk(), 130.0);
+}
+
+TEST(OrderBookTest, ManagerSyncsFromSnapshotAndDetectsGaps) {
+    const auto dir = WriteSnapshot("cqg_book_sync", 105);
+    SBookConfig cfg;
+    cfg.levels = 2;
+    std::vector<SBookSample> samples;
+    CBookManager manager(cfg, CBookManager::FileSnapshotProvider(dir.string()),
+                         [&](const std::string&, uint64_t, const SBookSample& s) { samples.push_back(s); });
+
+    // Fully covered by the snapshot: dropped.
+    manager.OnDepthUpdate(MakeUpdate(100, 104, {{100.00, 9.0}}, {}));
+    ASSERT_TRUE(manager.IsSynced("BTCUSDT"));
+    EXPECT_TRUE(samples.empty());
+
+    // Straddles lastUpdateId + 1: applied.
+    manager.OnDepthUpdate(MakeUpdate(104, 107, {{100.01, 0.5}}, {{100.02, 0.0}}));
+    ASSERT_EQ(samples.size(), 1u);
+    EXPECT_DOUBLE_EQ(samples.back().best_bid, 100.01);
+    EXPECT_DOUBLE_EQ(samples.back().best_ask, 100.05);
+    EXPECT_DOUBLE_EQ(samples.back().bid_depth, 1.5);
+    EXPECT_DOUBLE_EQ(samples.back().ask_depth, 2.5);
+
+    manager.OnDepthUpdate(MakeUpdate(108, 108, {}, {{100.03, 1.0}}));
+    EXPECT_EQ(samples.size(), 2u);
+    EXPECT_DOUBLE_EQ(samples.back().best_ask, 100.03);
+
+    // Gap: 109 missing.
+    EXPECT_FALSE(manager.IsAhead(MakeUpdate(109, 109, {}, {})));
+    EXPECT_TRUE(manager.IsAhead(MakeUpdate(110, 111, {}, {})));
+    manager.OnDepthUpdate(MakeUpdate(110, 111, {}, {}));
+    EXPECT_FALSE(manager.IsSynced("BTCUSDT"));
+    EXPECT_EQ(samples.size(), 2u);
+    fs::remove_all(dir);
+}
+
+TEST(OrderBookTest, ManagerBuffersUntilSnapshotAvailable) {
+    SBookConfig cfg;
+    bool available = false;
+    int calls = 0;
+    CBookManager manager(cfg,
+        [&](const std::string&, SDepthSnapshot& out) {
+            ++calls;
+            if (!available) {
+                return false;
+            }
+            out.last_update_id = 10;
+            out.bids = {{50.0, 1.0}};
+            out.asks = {{50.5, 1.0}};
+            return true;
+        },
+        nullptr);
+    manager.OnDepthUpdate(MakeUpdate(9, 11, {{50.1, 2.0}}, {}));
+    EXPECT_FALSE(manager.IsSynced("BTCUSDT"));
+    EXPECT_EQ(calls, 1);
+    manager.Reset();
+    available = true;
+    manager.OnDepthUpdate(MakeUpdate(9, 11, {{50.1, 2.0}}, {}));
+    ASSERT_TRUE(manager.IsSynced("BTCUSDT"));
+    EXPECT_DOUBLE_EQ(manager.Book("BTCUSDT")->BestBid(), 50.1);
+}
+
+TEST(OrderBookTest, DepthUpdateFromJson) {
+    auto j = nlohmann::json::parse(
+        R"({"e":"depthUpdate","E":123456,"s":"BTCUSDT","U":157,"u":160,"b":[["0.0024","10"]],"a":[["0.0026","100"]]})");
+    auto u = SDepthUpdate::FromJson(j);
+    EXPECT_EQ(u.symbol, "BTCUSDT");
+    EXPECT_EQ(u.first_update_id, 157u);
+    EXPECT_EQ(u.final_update_id, 160u);
+    ASSERT_EQ(u.bids.size(), 1u);
+    EXPECT_DOUBLE_EQ(u.asks[0].second, 100.0);
+}
+
+TEST(OrderBookTest, BookSamplesFeedAggregator) {
+    SAppConfig cfg;
+    CTradeAggregator agg(cfg);
+    agg.AddTrade({"BTCUSDT", 100.0, 1.0, 1500, true});
+    agg.AddBookSample("BTCUSDT", 1200, {99.0, 101.0, 3.0, 4.0});
+    agg.AddBookSample("BTCUSDT", 1800, {99.5, 100.5, 5.0, 6.0});
+    agg.AddBookSample("ETHUSDT", 1800, {10.0, 10.1, 1.0, 1.0});
+    auto windows = agg.FlushStatistics();
+    const auto& btc = windows.at(1000).at("BTCUSDT");
+    EXPECT_EQ(btc.trades_count, 1u);
+    EXPECT_EQ(btc.book.samples, 2u);
+    EXPECT_DOUBLE_EQ(btc.book.spread_sum, 3.0);
+    EXPECT_DOUBLE_EQ(btc.book.best_bid, 99.5);
+    EXPECT_DOUBLE_EQ(btc.book.ask_depth, 6.0);
+    EXPECT_EQ(windows.at(1000).at("ETHUSDT").trades_count, 0u);
+}
+
+TEST(OrderBookTest, StreamTargetIncludesDepth) {
+    EXPECT_EQ(BuildStreamTarget({"btcusdt"}, "depth@100ms"), "/stream?streams=btcusdt@trade/btcusdt@depth@100ms");
+    EXPECT_EQ(BuildStreamTarget({"btcusdt"}), "/stream?streams=btcusdt@trade");
+}
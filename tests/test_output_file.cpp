@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include "output_file.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+fs::path MakeTempDir(const std::string& name) {
+    fs::path dir = fs::temp_directory_path() / name;
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    return dir;
+}
+
+std::string ReadText(const fs::path& path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+}
+
+TEST(OutputFileTest, ParseOutputBackend) {
+    EOutputBackend backend = EOutputBackend::Stream;
+    EXPECT_TRUE(ParseOutputBackend("uring", backend));
+    EXPECT_EQ(backend, EOutputBackend::Uring);
+    EXPECT_FALSE(ParseOutputBackend("mmap", backend));
+}
+
+TEST(OutputFileTest, UringBackendAppendsAndTracksSize) {
+    const auto dir = MakeTempDir("cqg_output_uring");
+    const auto path = dir / "aggregates.log";
+    {
+        std::ofstream(path) << "existing\n";
+    }
+    {
+        COutputFile output(EOutputBackend::Uring, path.string(), 1024 * 1024, 3, true, nullptr);
+        ASSERT_TRUE(output.Write("line one\n"));
+        ASSERT_TRUE(output.Write("line two\n"));
+        EXPECT_EQ(output.Size(), 27u);
+        // Preallocation must not move EOF while the file is open.
+        EXPECT_EQ(fs::file_size(path), 27u);
+    }
+    EXPECT_EQ(ReadText(path), "existing\nline one\nline two\n");
+    fs::remove_all(dir);
+}
+
+TEST(OutputFileTest, UringBackendRotatesOnTrackedSize) {
+    const auto dir = MakeTempDir("cqg_output_rotate");
+    const auto path = dir / "aggregates.log";
+    {
+        COutputFile output(EOutputBackend::Uring, path.string(), 10, 2, true, nullptr);
+        ASSERT_TRUE(output.Write("first-chunk\n"));
+        ASSERT_TRUE(output.Write("second-chunk\n"));
+        ASSERT_TRUE(output.Write("third-chunk\n"));
+        EXPECT_EQ(output.Size(), 12u);
+    }
+    EXPECT_EQ(ReadText(path), "third-chunk\n");
+    EXPECT_EQ(ReadText(dir / "aggregates.log.1"), "second-chunk\n");
+    EXPECT_EQ(ReadText(dir / "aggregates.log.2"), "first-chunk\n");
+    fs::remove_all(dir);
+}
+
+TEST(OutputFileTest, UringBackendHandsRotatedFileToCompressor) {
+    const auto dir = MakeTempDir("cqg_output_compress");
+    const auto path = dir / "aggregates.log";
+    CLogCompressor compressor(ECompression::Zlib, 6, path.string(), 2);
+    compressor.Start();
+    {
+        COutputFile output(EOutputBackend::Uring, path.string(), 4, 2, false, &compressor);
+        ASSERT_TRUE(output.Write("abcdef\n"));
+        ASSERT_TRUE(output.Write("ghijkl\n"));
+    }
+    compressor.Stop();
+    EXPECT_EQ(ReadText(path), "ghijkl\n");
+    EXPECT_TRUE(fs::exists(dir / "aggregates.log.1.gz"));
+    fs::remove_all(dir);
+}
+
+TEST(OutputFileTest, StreamBackendRotates) {
+    const auto dir = MakeTempDir("cqg_output_stream");
+    const auto path = dir / "aggregates.log";
+    COutputFile output(EOutputBackend::Stream, path.string(), 10, 2, false, nullptr);
+    ASSERT_TRUE(output.Write("first-chunk\n"));
+    ASSERT_TRUE(output.Write("second-chunk\n"));
+    EXPECT_EQ(ReadText(path), "second-chunk\n");
+    EXPECT_EQ(ReadText(dir / "aggregates.log.1"), "first-chunk\n");
+    fs::remove_all(dir);
+}
@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+#include "series_codec.hpp"
+#include "series_store.hpp"
+
+#include <cmath>
+#include <filesystem>
+#include <random>
+
+#include <unistd.h>
+
+namespace {
+// Windows of a liquid symbol: a 0.01-tick random walk and lot-sized quantities.
+std::vector<SSeriesPoint> MakeSeries(size_t count, uint64_t start_ms, uint64_t period_ms) {
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int> step(-20, 20);
+    std::uniform_int_distribution<int> trades(1, 200);
+    std::uniform_int_distribution<int> lots(1, 50000);
+    double price = 60000.0;
+    std::vector<SSeriesPoint> points;
+    for (size_t i = 0; i < count; ++i) {
+        SSeriesPoint p;
+        p.window_start = start_ms + i * period_ms;
+        p.trades_count = static_cast<uint64_t>(trades(rng));
+        p.buy_count = p.trades_count / 2;
+        p.sell_count = p.trades_count - p.buy_count;
+        p.min_price = price;
+        price = std::round((price + step(rng) * 0.01) * 100.0) / 100.0;
+        p.max_price = std::max(p.min_price, price);
+        p.min_price = std::min(p.min_price, price);
+        p.total_quantity = lots(rng) * 0.00001;
+        p.total_volume = p.total_quantity * price;
+        points.push_back(p);
+    }
+    return points;
+}
+
+void ExpectSamePoint(const SSeriesPoint& a, const SSeriesPoint& b) {
+    EXPECT_EQ(a.window_start, b.window_start);
+    EXPECT_EQ(a.trades_count, b.trades_count);
+    EXPECT_EQ(a.buy_count, b.buy_count);
+    EXPECT_EQ(a.sell_count, b.sell_count);
+    // Bit-exact: the XOR encoding is lossless.
+    EXPECT_EQ(a.total_quantity, b.total_quantity);
+    EXPECT_EQ(a.total_volume, b.total_volume);
+    EXPECT_EQ(a.min_price, b.min_price);
+    EXPECT_EQ(a.max_price, b.max_price);
+}
+
+CTradeAggregator::SSymbolStats ToStats(const SSeriesPoint& p) {
+    CTradeAggregator::SSymbolStats stats;
+    stats.trades_count = p.trades_count;
+    stats.total_quantity = p.total_quantity;
+    stats.total_volume = p.total_volume;
+    stats.min_price = p.min_price;
+    stats.max_price = p.max_price;
+    stats.buy_count = p.buy_count;
+    stats.sell_count = p.sell_count;
+    return stats;
+}
+}
+
+TEST(SeriesCodecTest, BitStreamRoundTrip) {
+    CBitWriter writer;
+    writer.Write(0b101, 3);
+    writer.Write(0xdeadbeefcafef00dull, 64);
+    writer.WriteBit(true);
+    writer.Write(0x7f, 7);
+    EXPECT_EQ(writer.BitCount(), 75u);
+    EXPECT_EQ(writer.Bytes().size(), 10u);
+
+    CBitReader reader(writer.Bytes().data(), writer.BitCount());
+    uint64_t v = 0;
+    bool bit = false;
+    ASSERT_TRUE(reader.Read(3, v));
+    EXPECT_EQ(v, 0b101u);
+    ASSERT_TRUE(reader.Read(64, v));
+    EXPECT_EQ(v, 0xdeadbeefcafef00dull);
+    ASSERT_TRUE(reader.ReadBit(bit));
+    EXPECT_TRUE(bit);
+    ASSERT_TRUE(reader.Read(7, v));
+    EXPECT_EQ(v, 0x7fu);
+    EXPECT_FALSE(reader.ReadBit(bit));
+}
+
+TEST(SeriesCodecTest, EncodeDecodeIsLossless) {
+    auto points = MakeSeries(1000, 1700000000000, 1000);
+    // A gap, out-of-order windows, an explicit sell count and special values.
+    for (size_t i = 10; i < points.size(); ++i) {
+        points[i].window_start += 5000;
+    }
+    for (size_t i = 500; i < points.size(); i += 7) {
+        points[i].window_start += 3000;
+    }
+    points[20].sell_count = 3;
+    points[30].total_volume = 0.0;
+    points[31].total_volume = -1.5;
+
+    CSeriesEncoder encoder;
+    for (const auto& p : points) {
+        encoder.Append(p);
+    }
+    const auto chunk = encoder.Seal();
+    EXPECT_EQ(chunk.count, points.size());
+    EXPECT_EQ(chunk.first_window_start, points.front().window_start);
+    EXPECT_EQ(chunk.last_window_start, points.back().window_start);
+    EXPECT_EQ(encoder.Count(), 0u);
+
+    CSeriesDecoder decoder(chunk);
+    SSeriesPoint p;
+    for (const auto& expected : points) {
+        ASSERT_TRUE(decoder.Next(p));
+        ExpectSamePoint(p, expected);
+    }
+    EXPECT_FALSE(decoder.Next(p));
+
+    // A truncated stream stops instead of reading past the end.
+    CSeriesDecoder truncated(chunk.bytes.data(), static_cast<size_t>(chunk.bits / 2), chunk.count);
+    size_t decoded = 0;
+    while (truncated.Next(p)) {
+        ++decoded;
+    }
+    EXPECT_LT(decoded, points.size());
+}
+
+TEST(SeriesCodecTest, CompressionRatio) {
+    const auto busy = MakeSeries(3600, 1700000000000, 1000);
+    CSeriesEncoder encoder;
+    for (const auto& p : busy) {
+        encoder.Append(p);
+    }
+    const double raw = static_cast<double>(busy.size() * sizeof(SSeriesPoint));
+    const double busy_ratio = raw / static_cast<double>(encoder.Seal().bytes.size());
+
+    // A quiet symbol: mostly single trades at an unchanged price.
+    auto quiet = busy;
+    for (size_t i = 0; i < quiet.size(); ++i) {
+        auto& p = quiet[i];
+        p.trades_count = 1;
+        p.buy_count = 1;
+        p.sell_count = 0;
+        p.min_price = p.max_price = 60000.0 + static_cast<double>(i / 600);
+        p.total_quantity = 0.001;
+        p.total_volume = 0.001 * p.min_price;
+    }
+    for (const auto& p : quiet) {
+        encoder.Append(p);
+    }
+    const double quiet_ratio = raw / static_cast<double>(encoder.Seal().bytes.size());
+    std::cout << "compression ratio: busy " << busy_ratio << "x, quiet " << quiet_ratio << "x\n";
+    EXPECT_GT(busy_ratio, 2.0);
+    EXPECT_GT(quiet_ratio, 10.0);
+}
+
+TEST(SeriesCodecTest, ChunkFileRoundTrip) {
+    const std::string path = "/tmp/cqg_test_chunks_" + std::to_string(::getpid()) + ".gor";
+    std::filesystem::remove(path);
+    CSeriesEncoder encoder;
+    for (const auto& p : MakeSeries(100, 1000, 1000)) {
+        encoder.Append(p);
+    }
+    const auto first = encoder.Seal();
+    encoder.Append(MakeSeries(1, 500000, 1000).front());
+    const auto second = encoder.Seal();
+    ASSERT_TRUE(AppendChunkFile(path, 1000, first));
+    ASSERT_TRUE(AppendChunkFile(path, 250, second));
+
+    std::vector<std::pair<uint64_t, SSeriesChunk>> records;
+    ASSERT_TRUE(ReadChunkFile(path, records));
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].first, 1000u);
+    EXPECT_EQ(records[0].second.bytes, first.bytes);
+    EXPECT_EQ(records[1].first, 250u);
+    EXPECT_EQ(records[1].second.last_window_start, 500000u);
+
+    // A torn tail keeps the complete records.
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+    records.clear();
+    EXPECT_FALSE(ReadChunkFile(path, records));
+    EXPECT_EQ(records.size(), 1u);
+    std::filesystem::remove(path);
+}
+
+TEST(SeriesCodecTest, StoreQueriesSpanArchiveAndRing) {
+    const std::string dir = "/tmp/cqg_test_archive_" + std::to_string(::getpid());
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    SSeriesArchiveOptions options;
+    options.retention_ms = 3600 * 1000;
+    options.chunk_windows = 50;
+    options.persist_dir = dir;
+    const auto points = MakeSeries(300, 1000000, 1000);
+    {
+        CSeriesStore store(1000, 60 * 1000);  // 60 windows in the ring
+        store.ConfigureArchive(options);
+        for (const auto& p : points) {
+            store.Insert(p.window_start, "BTCUSDT", ToStats(p));
+        }
+        // Everything is still queryable: 240 archived (4 sealed chunks + 40 open), 60 in the ring.
+        const auto range = store.Range("BTCUSDT", 0, 10000000);
+        ASSERT_EQ(range.size(), points.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            ExpectSamePoint(range[i], points[i]);
+        }
+        const auto middle = store.Range("BTCUSDT", points[45].window_start, points[255].window_start);
+        ASSERT_EQ(middle.size(), 210u);
+        EXPECT_EQ(middle.front().window_start, points[45].window_start);
+        EXPECT_EQ(store.Aggregate("BTCUSDT", 0, 10000000).windows, 300u);
+
+        const auto usage = store.MemoryUsage();
+        EXPECT_EQ(usage.hot_windows, 60u);
+        EXPECT_EQ(usage.archived_windows, 240u);
+        EXPECT_EQ(usage.hot_bytes, 60u * 64u);
+        EXPECT_LT(usage.archived_bytes, 240u * 64u / 2);
+    }
+
+    // Sealed chunks were persisted and come back after a restart.
+    CSeriesStore restarted(1000, 60 * 1000);
+    restarted.ConfigureArchive(options);
+    EXPECT_EQ(restarted.LoadArchive(), 4u);
+    const auto range = restarted.Range("BTCUSDT", 0, 10000000);
+    ASSERT_EQ(range.size(), 200u);
+    ExpectSamePoint(range.back(), points[199]);
+    EXPECT_EQ(restarted.Newest(), points[199].window_start);
+
+    // Chunks recorded with another period are ignored.
+    CSeriesStore other_period(500, 60 * 1000);
+    other_period.ConfigureArchive(options);
+    EXPECT_EQ(other_period.LoadArchive(), 0u);
+
+    // Without an archive, evicted windows are dropped as before.
+    CSeriesStore no_archive(1000, 60 * 1000);
+    for (const auto& p : points) {
+        no_archive.Insert(p.window_start, "BTCUSDT", ToStats(p));
+    }
+    EXPECT_EQ(no_archive.Range("BTCUSDT", 0, 10000000).size(), 60u);
+    std::filesystem::remove_all(dir);
+}
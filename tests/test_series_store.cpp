@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include "query_server.hpp"
+#include "series_store.hpp"
+
+#include <thread>
+
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+CTradeAggregator::SSymbolStats MakeStats(uint64_t trades, double quantity, double price) {
+    CTradeAggregator::SSymbolStats stats;
+    stats.trades_count = trades;
+    stats.total_quantity = quantity;
+    stats.total_volume = quantity * price;
+    stats.min_price = price;
+    stats.max_price = price;
+    stats.buy_count = trades;
+    return stats;
+}
+}
+
+TEST(SeriesStoreTest, RangeAndAggregate) {
+    CSeriesStore store(1000, 60 * 1000);
+    for (uint64_t i = 0; i < 10; ++i) {
+        store.Insert(100000 + i * 1000, "BTCUSDT", MakeStats(1, 1.0, 100.0 + static_cast<double>(i)));
+    }
+    store.Insert(105000, "ETHUSDT", MakeStats(2, 4.0, 10.0));
+
+    const auto points = store.Range("BTCUSDT", 102000, 105000);
+    ASSERT_EQ(points.size(), 3u);
+    EXPECT_EQ(points.front().window_start, 102000u);
+    EXPECT_DOUBLE_EQ(points.back().min_price, 104.0);
+
+    const auto agg = store.Aggregate("BTCUSDT", 0, 200000);
+    EXPECT_EQ(agg.windows, 10u);
+    EXPECT_EQ(agg.trades_count, 10u);
+    EXPECT_DOUBLE_EQ(agg.total_quantity, 10.0);
+    EXPECT_DOUBLE_EQ(agg.min_price, 100.0);
+    EXPECT_DOUBLE_EQ(agg.max_price, 109.0);
+    EXPECT_EQ(store.Aggregate("XRPUSDT", 0, 200000).windows, 0u);
+    EXPECT_EQ(store.Symbols(), (std::vector<std::string>{"BTCUSDT", "ETHUSDT"}));
+    EXPECT_EQ(store.Newest(), 109000u);
+}
+
+TEST(SeriesStoreTest, LateWindowsMergeAndRetentionExpires) {
+    CSeriesStore store(1000, 5000);
+    store.Insert(1000, "BTCUSDT", MakeStats(1, 1.0, 100.0));
+    store.Insert(1000, "BTCUSDT", MakeStats(2, 1.0, 90.0));  // re-flushed after late trades
+    auto agg = store.Aggregate("BTCUSDT", 1000, 2000);
+    EXPECT_EQ(agg.trades_count, 3u);
+    EXPECT_DOUBLE_EQ(agg.min_price, 90.0);
+    EXPECT_DOUBLE_EQ(agg.max_price, 100.0);
+
+    for (uint64_t ts = 2000; ts <= 8000; ts += 1000) {
+        store.Insert(ts, "BTCUSDT", MakeStats(1, 1.0, 100.0));
+    }
+    // Capacity is 5 windows: 4000..8000 remain.
+    const auto points = store.Range("BTCUSDT", 0, 10000);
+    ASSERT_EQ(points.size(), 5u);
+    EXPECT_EQ(points.front().window_start, 4000u);
+    // Too old to store any more.
+    store.Insert(2000, "BTCUSDT", MakeStats(7, 1.0, 100.0));
+    EXPECT_EQ(store.Aggregate("BTCUSDT", 0, 10000).trades_count, 5u);
+
+    store.Reconfigure(1000, 5000);
+    EXPECT_EQ(store.Range("BTCUSDT", 0, 10000).size(), 5u);
+    store.Reconfigure(500, 5000);
+    EXPECT_TRUE(store.Range("BTCUSDT", 0, 10000).empty());
+}
+
+TEST(SeriesStoreTest, HandleRequest) {
+    CSeriesStore store(1000, 60 * 1000);
+    store.Insert(1000, "BTCUSDT", MakeStats(2, 2.0, 100.0));
+    store.Insert(2000, "BTCUSDT", MakeStats(1, 2.0, 110.0));
+
+    auto agg = nlohmann::json::parse(CQueryServer::HandleRequest(store, "agg btcusdt 0 3000\n"));
+    EXPECT_EQ(agg["trades"], 3);
+    EXPECT_DOUBLE_EQ(agg["vwap"].get<double>(), 105.0);
+    EXPECT_TRUE(agg.contains("elapsed_us"));
+
+    auto range = nlohmann::json::parse(CQueryServer::HandleRequest(store, "RANGE BTCUSDT 2000 3000"));
+    ASSERT_EQ(range["windows"].size(), 1u);
+    EXPECT_EQ(range["windows"][0]["t"], 2000);
+
+    EXPECT_TRUE(nlohmann::json::parse(CQueryServer::HandleRequest(store, "RANGE BTCUSDT x")).contains("error"));
+    EXPECT_TRUE(nlohmann::json::parse(CQueryServer::HandleRequest(store, "DELETE")).contains("error"));
+}
+
+TEST(SeriesStoreTest, HandleRequestWithInvalidUtf8) {
+    CSeriesStore store(1000, 60 * 1000);
+    // Echoed back in the error, the bytes must still dump as valid JSON.
+    auto unknown = nlohmann::json::parse(CQueryServer::HandleRequest(store, "\xff\xfe BTCUSDT"));
+    ASSERT_TRUE(unknown.contains("error"));
+    EXPECT_NE(unknown["error"].get<std::string>().find("unknown command"), std::string::npos);
+    EXPECT_TRUE(nlohmann::json::parse(CQueryServer::HandleRequest(store, "RANGE \xc3\x28")).contains("error"));
+    EXPECT_NO_THROW(nlohmann::json::parse(CQueryServer::HandleRequest(store, "RANGE BTC\xff 0 1000")));
+}
+
+TEST(SeriesStoreTest, QueryServerOverUnixSocket) {
+    const std::string path = "/tmp/cqg_test_query_" + std::to_string(::getpid()) + ".sock";
+    auto store = std::make_shared<CSeriesStore>(1000, 60 * 1000);
+    store->Insert(1000, "ETHUSDT", MakeStats(4, 1.0, 10.0));
+
+    boost::asio::io_context ioc;
+    CQueryServer server(ioc, path, store);
+    ASSERT_TRUE(server.Start());
+    std::thread io([&]() { ioc.run(); });
+
+    boost::asio::local::stream_protocol::socket socket(ioc);
+    socket.connect(boost::asio::local::stream_protocol::endpoint(path));
+    const std::string request = "SYMBOLS\n\xff\xfe\nAGG ETHUSDT 0 5000\n";
+    boost::asio::write(socket, boost::asio::buffer(request));
+    boost::asio::streambuf reply;
+    std::istream in(&reply);
+    auto read_line = [&]() {
+        boost::asio::read_until(socket, reply, '\n');
+        std::string line;
+        std::getline(in, line);
+        return nlohmann::json::parse(line);
+    };
+    EXPECT_EQ(read_line()["symbols"][0], "ETHUSDT");
+    // A non-UTF-8 line gets an error reply and keeps the session open.
+    EXPECT_TRUE(read_line().contains("error"));
+    EXPECT_EQ(read_line()["trades"], 4);
+
+    socket.close();
+    ioc.stop();
+    io.join();
+}
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include "shm_publisher.hpp"
+#include "shm_reader.hpp"
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+std::string UniqueShmName(const std::string& tag) {
+    return "/cqg_test_" + tag + "_" + std::to_string(::getpid());
+}
+}
+
+TEST(ShmPublisherTest, WindowsRoundTrip) {
+    const auto name = UniqueShmName("windows");
+    CShmPublisher publisher(name, 8, 0);
+    ASSERT_TRUE(publisher.Open());
+
+    CShmReader reader;
+    ASSERT_TRUE(reader.Open(name));
+
+    CTradeAggregator::AllWindowsStats windows;
+    auto& stats = windows[1000]["BTCUSDT"];
+    stats.trades_count = 3;
+    stats.total_quantity = 2.5;
+    stats.total_volume = 250.0;
+    stats.min_price = 99.0;
+    stats.max_price = 101.0;
+    stats.buy_count = 1;
+    stats.sell_count = 2;
+    publisher.PublishWindows(windows, 1000);
+
+    SShmWindowRecord record{};
+    ASSERT_TRUE(reader.Windows().Next(record));
+    EXPECT_EQ(record.window_start_ms, 1000u);
+    EXPECT_EQ(record.period_ms, 1000u);
+    EXPECT_STREQ(record.symbol, "BTCUSDT");
+    EXPECT_EQ(record.trades_count, 3u);
+    EXPECT_DOUBLE_EQ(record.total_volume, 250.0);
+    EXPECT_DOUBLE_EQ(record.min_price, 99.0);
+    EXPECT_EQ(record.sell_count, 2u);
+    EXPECT_FALSE(reader.Windows().Next(record));
+    SShmTradeRecord trade{};
+    EXPECT_FALSE(reader.Trades().Next(trade));
+}
+
+TEST(ShmPublisherTest, BookOnlySymbolHasNoPrices) {
+    const auto name = UniqueShmName("book_only");
+    CShmPublisher publisher(name, 8, 0);
+    ASSERT_TRUE(publisher.Open());
+    CShmReader reader;
+    ASSERT_TRUE(reader.Open(name));
+
+    CTradeAggregator::AllWindowsStats windows;
+    windows[1000]["BTCUSDT"].book.samples = 2;
+    publisher.PublishWindows(windows, 1000);
+
+    SShmWindowRecord record{};
+    ASSERT_TRUE(reader.Windows().Next(record));
+    EXPECT_EQ(record.trades_count, 0u);
+    EXPECT_DOUBLE_EQ(record.min_price, 0.0);
+    EXPECT_DOUBLE_EQ(record.max_price, 0.0);
+}
+
+TEST(ShmPublisherTest, SlowReaderCountsLostRecords) {
+    const auto name = UniqueShmName("lapped");
+    CShmPublisher publisher(name, 4, 4);
+    ASSERT_TRUE(publisher.Open());
+    CShmReader reader;
+    ASSERT_TRUE(reader.Open(name));
+
+    for (uint64_t i = 1; i <= 10; ++i) {
+        STrade trade{"ETHUSDT", 100.0 + static_cast<double>(i), 1.0, i, false};
+        trade.first_trade_id = trade.last_trade_id = 1000 + i;
+        publisher.PublishTrade(trade);
+    }
+    SShmTradeRecord record{};
+    std::vector<uint64_t> seen;
+    while (reader.Trades().Next(record)) {
+        EXPECT_EQ(record.last_trade_id, 1000 + record.timestamp);
+        seen.push_back(record.timestamp);
+    }
+    // Only the last 4 records still live in a 4-slot ring.
+    ASSERT_EQ(seen.size(), 4u);
+    EXPECT_EQ(seen.front(), 7u);
+    EXPECT_EQ(seen.back(), 10u);
+    EXPECT_EQ(reader.Trades().Lost(), 6u);
+}
+
+TEST(ShmPublisherTest, ConcurrentReaderSeesConsistentRecords) {
+    const auto name = UniqueShmName("concurrent");
+    CShmPublisher publisher(name, 4, 64);
+    ASSERT_TRUE(publisher.Open());
+    CShmReader reader;
+    ASSERT_TRUE(reader.Open(name));
+
+    constexpr uint64_t kCount = 200000;
+    std::thread producer([&]() {
+        for (uint64_t i = 1; i <= kCount; ++i) {
+            // price and quantity are derived from the timestamp so torn reads are detectable
+            publisher.PublishTrade({"BTCUSDT", static_cast<double>(i), static_cast<double>(i) * 2.0, i, true});
+        }
+    });
+    uint64_t received = 0;
+    uint64_t last = 0;
+    SShmTradeRecord record{};
+    while (last < kCount) {
+        if (!reader.Trades().Next(record)) {
+            continue;
+        }
+        ASSERT_DOUBLE_EQ(record.price, static_cast<double>(record.timestamp));
+        ASSERT_DOUBLE_EQ(record.quantity, static_cast<double>(record.timestamp) * 2.0);
+        ASSERT_GT(record.timestamp, last);
+        last = record.timestamp;
+        ++received;
+    }
+    producer.join();
+    EXPECT_EQ(received + reader.Trades().Lost(), kCount);
+}
+
+TEST(ShmPublisherTest, OpenMissingSegmentFails) {
+    CShmReader reader;
+    EXPECT_FALSE(reader.Open(UniqueShmName("missing")));
+}
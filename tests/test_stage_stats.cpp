@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include "stage_stats.hpp"
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+void Spin(std::chrono::milliseconds duration) {
+    const auto until = std::chrono::steady_clock::now() + duration;
+    volatile uint64_t sink = 0;
+    while (std::chrono::steady_clock::now() < until) {
+        sink = sink + 1;
+    }
+}
+}
+
+TEST(StageStatsTest, ChargesCpuToTheThreadsStage) {
+    const StageStats before = StageStatsSnapshot();
+    std::thread writer([] {
+        SetThreadStage(EStage::Writer);
+        Spin(std::chrono::milliseconds(30));
+    });
+    writer.join();
+    const StageStats after = StageStatsSnapshot();
+    const auto writer_index = static_cast<size_t>(EStage::Writer);
+    const auto reader_index = static_cast<size_t>(EStage::Reader);
+    // The exited thread's time is kept.
+    EXPECT_GE(after[writer_index].cpu_ns - before[writer_index].cpu_ns, 20000000u);
+    EXPECT_EQ(after[reader_index].cpu_ns, before[reader_index].cpu_ns);
+    EXPECT_EQ(after[writer_index].threads, before[writer_index].threads);
+}
+
+TEST(StageStatsTest, CountsAllocationsWhenTheHookIsBuilt) {
+    if (!StageAllocationsCounted()) {
+        GTEST_SKIP() << "built without CQG_ALLOC_STATS";
+    }
+    const StageStats before = StageStatsSnapshot();
+    std::thread reader([] {
+        SetThreadStage(EStage::Reader);
+        std::vector<std::unique_ptr<char[]>> blocks;
+        for (int i = 0; i < 100; ++i) {
+            blocks.emplace_back(new char[1000]);
+        }
+    });
+    reader.join();
+    const StageStats after = StageStatsSnapshot();
+    const auto& a = before[static_cast<size_t>(EStage::Reader)];
+    const auto& b = after[static_cast<size_t>(EStage::Reader)];
+    EXPECT_GE(b.allocations - a.allocations, 100u);
+    EXPECT_GE(b.allocated_bytes - a.allocated_bytes, 100000u);
+    EXPECT_GE(b.frees - a.frees, 100u);
+}
+
+TEST(StageStatsTest, FormatsRatesPerStage) {
+    StageStats before{};
+    StageStats now{};
+    now[static_cast<size_t>(EStage::Io)].cpu_ns = 500000000;  // half a core over one second
+    now[static_cast<size_t>(EStage::Io)].threads = 1;
+    now[static_cast<size_t>(EStage::Reader)].allocations = 2000;
+    const std::string text = FormatStageStats(before, now, 1.0);
+    EXPECT_NE(text.find("io cpu=50.0% "), std::string::npos) << text;
+    EXPECT_NE(text.find("| reader cpu=0.0%"), std::string::npos) << text;
+    EXPECT_EQ(text.find("allocs/s=2000") != std::string::npos, StageAllocationsCounted()) << text;
+}
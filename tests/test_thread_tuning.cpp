@@ -0,0 +1,28 @@
+#include <gtest/gtest.h>
+#include "thread_tuning.hpp"
+#include <sched.h>
+#include <thread>
+
+TEST(ThreadTuningTest, PinAndRestoreAffinity) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    int first_cpu = 0;
+    while (!CPU_ISSET(first_cpu, &allowed)) {
+        ++first_cpu;
+    }
+
+    std::thread worker([&]() {
+        SThreadRoleConfig role;
+        role.cpus = {first_cpu};
+        ApplyThreadPlacement("test", role);
+        EXPECT_EQ(DescribeThreadPlacement(), "cpus=" + std::to_string(first_cpu) + " policy=SCHED_OTHER");
+
+        ApplyThreadPlacement("test", SThreadRoleConfig{});
+        cpu_set_t restored;
+        CPU_ZERO(&restored);
+        pthread_getaffinity_np(pthread_self(), sizeof(restored), &restored);
+        EXPECT_TRUE(CPU_EQUAL(&restored, &allowed));
+    });
+    worker.join();
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include "tick_store.hpp"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr uint64_t kDay = 1699920000000;  // 2023-11-14T00:00:00Z
+
+fs::path MakeTempDir(const std::string& name) {
+    fs::path dir = fs::temp_directory_path() / name;
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    return dir;
+}
+
+STrade MakeTrade(const std::string& symbol, uint64_t ts, uint64_t id, uint64_t count = 1) {
+    STrade trade{symbol, 100.0 + static_cast<double>(id % 7), 0.5 * static_cast<double>(id % 3 + 1), ts, id % 2 == 0};
+    trade.last_trade_id = id;
+    trade.first_trade_id = id - count + 1;
+    return trade;
+}
+
+std::vector<STrade> ScanAll(const fs::path& dir, const std::string& symbol, uint64_t from_ms = 0,
+                            uint64_t to_ms = ~0ull) {
+    std::vector<STrade> trades;
+    ScanTicks(dir.string(), symbol, from_ms, to_ms,
+              [&](const STickRecord& record) { trades.push_back(TickToTrade(symbol, record)); });
+    return trades;
+}
+}
+
+TEST(TickStoreTest, PartitionsBySymbolAndDay) {
+    const auto dir = MakeTempDir("cqg_ticks_partitions");
+    std::vector<STrade> btc{MakeTrade("BTCUSDT", kDay + 1000, 10), MakeTrade("BTCUSDT", kDay + 86399999, 11, 3),
+                            MakeTrade("BTCUSDT", kDay + 86400000, 14)};
+    std::vector<STrade> eth{MakeTrade("ETH/USDT", kDay + 5000, 7), MakeTrade("ETH/USDT", kDay + 6000, 8)};
+    eth[1].first_trade_id = eth[1].last_trade_id = 0;  // no ids
+    {
+        CTickStore store(dir.string(), 16);
+        STradeBlock block;
+        for (size_t i = 0; i < btc.size(); ++i) {
+            block.Append(btc[i]);
+            if (i < eth.size()) {
+                block.Append(eth[i]);
+            }
+        }
+        store.Append(block);
+        EXPECT_EQ(store.Written(), 5u);
+        EXPECT_EQ(store.Dropped(), 0u);
+    }
+    EXPECT_TRUE(fs::exists(dir / "BTCUSDT" / "20231114.ticks"));
+    EXPECT_TRUE(fs::exists(dir / "BTCUSDT" / "20231115.ticks"));
+    EXPECT_TRUE(fs::exists(dir / "ETH_USDT" / "20231114.ticks"));
+
+    const auto scanned = ScanAll(dir, "BTCUSDT");
+    ASSERT_EQ(scanned.size(), btc.size());
+    for (size_t i = 0; i < btc.size(); ++i) {
+        EXPECT_EQ(scanned[i].symbol, btc[i].symbol);
+        EXPECT_DOUBLE_EQ(scanned[i].price, btc[i].price);
+        EXPECT_DOUBLE_EQ(scanned[i].quantity, btc[i].quantity);
+        EXPECT_EQ(scanned[i].timestamp, btc[i].timestamp);
+        EXPECT_EQ(scanned[i].buyer_initiated, btc[i].buyer_initiated);
+        EXPECT_EQ(scanned[i].first_trade_id, btc[i].first_trade_id);
+        EXPECT_EQ(scanned[i].last_trade_id, btc[i].last_trade_id);
+    }
+    const auto eth_scanned = ScanAll(dir, "ETH/USDT");
+    ASSERT_EQ(eth_scanned.size(), 2u);
+    EXPECT_EQ(eth_scanned[0].first_trade_id, 7u);
+    EXPECT_EQ(eth_scanned[1].last_trade_id, 0u);
+    EXPECT_EQ(eth_scanned[1].TradeCount(), 1u);
+    EXPECT_TRUE(ScanAll(dir, "SOLUSDT").empty());
+}
+
+TEST(TickStoreTest, TimeIndexBoundsRangeScans) {
+    const auto dir = MakeTempDir("cqg_ticks_index");
+    // One trade every 10 s for two hours, with nothing between minute 30 and 40.
+    std::vector<uint64_t> stamps;
+    {
+        CTickStore store(dir.string(), 1 << 10);
+        uint64_t id = 1;
+        for (uint64_t ts = kDay; ts < kDay + 2 * 3600000; ts += 10000) {
+            if (ts >= kDay + 30 * 60000 && ts < kDay + 40 * 60000) {
+                continue;
+            }
+            ASSERT_TRUE(store.Append(MakeTrade("BTCUSDT", ts, id++)));
+            stamps.push_back(ts);
+        }
+    }
+    auto expected = [&](uint64_t from_ms, uint64_t to_ms) {
+        size_t n = 0;
+        for (const auto ts : stamps) {
+            n += ts >= from_ms && ts < to_ms;
+        }
+        return n;
+    };
+    const std::pair<uint64_t, uint64_t> ranges[] = {
+        {kDay, kDay + 2 * 3600000},
+        {kDay + 65000, kDay + 185000},
+        {kDay + 31 * 60000, kDay + 35 * 60000},  // inside the gap
+        {kDay + 29 * 60000 + 5000, kDay + 41 * 60000 + 1},
+        {kDay + 3 * 3600000, kDay + 4 * 3600000},  // after the last trade
+    };
+    for (const auto& range : ranges) {
+        EXPECT_EQ(ScanAll(dir, "BTCUSDT", range.first, range.second).size(), expected(range.first, range.second))
+            << range.first - kDay << ".." << range.second - kDay;
+    }
+
+    // The index narrows a scan to the minutes it touches.
+    CTickFileReader reader;
+    ASSERT_TRUE(reader.Open((dir / "BTCUSDT" / "20231114.ticks").string()));
+    EXPECT_EQ(reader.Count(), stamps.size());
+    EXPECT_EQ(reader.Symbol(), "BTCUSDT");
+    uint64_t first = 0;
+    uint64_t last = 0;
+    reader.Bounds(kDay + 65000, kDay + 185000, first, last);
+    EXPECT_EQ(first, 6u);   // 60 s
+    EXPECT_EQ(last, 24u);   // 240 s
+    reader.Bounds(kDay + 31 * 60000, kDay + 35 * 60000, first, last);
+    EXPECT_EQ(first, last);
+}
+
+TEST(TickStoreTest, GrowsAndResumesAcrossRestarts) {
+    const auto dir = MakeTempDir("cqg_ticks_resume");
+    {
+        CTickStore store(dir.string(), 4);
+        for (uint64_t i = 1; i <= 10; ++i) {
+            ASSERT_TRUE(store.Append(MakeTrade("BTCUSDT", kDay + i * 1000, i)));
+        }
+    }
+    {
+        CTickStore store(dir.string(), 4);
+        for (uint64_t i = 11; i <= 15; ++i) {
+            ASSERT_TRUE(store.Append(MakeTrade("BTCUSDT", kDay + i * 1000, i)));
+        }
+    }
+    const auto scanned = ScanAll(dir, "BTCUSDT");
+    ASSERT_EQ(scanned.size(), 15u);
+    for (uint64_t i = 0; i < 15; ++i) {
+        EXPECT_EQ(scanned[i].last_trade_id, i + 1);
+    }
+    EXPECT_EQ(ScanAll(dir, "BTCUSDT", kDay + 12000, kDay + 14000).size(), 2u);
+}
+
+TEST(TickStoreTest, LeavesForeignFilesAlone) {
+    const auto dir = MakeTempDir("cqg_ticks_foreign");
+    fs::create_directories(dir / "BTCUSDT");
+    const auto path = dir / "BTCUSDT" / "20231114.ticks";
+    { std::ofstream(path) << "not a tick file"; }
+
+    CTickStore store(dir.string(), 4);
+    EXPECT_FALSE(store.Append(MakeTrade("BTCUSDT", kDay + 1000, 1)));
+    EXPECT_FALSE(store.Append(MakeTrade("BTCUSDT", kDay + 2000, 2)));
+    EXPECT_TRUE(store.Append(MakeTrade("ETHUSDT", kDay + 2000, 3)));
+    EXPECT_EQ(store.Dropped(), 2u);
+    EXPECT_EQ(fs::file_size(path), 15u);
+    EXPECT_TRUE(ScanAll(dir, "BTCUSDT").empty());
+}
@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+#include "trace.hpp"
+#include "trade_queue.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+namespace {
+// Tracing is process-wide; each test turns it off again.
+struct STracingOn {
+    STracingOn(uint32_t sample_every, size_t ring_events) { ConfigureTracing(sample_every, ring_events); }
+    ~STracingOn() { ConfigureTracing(0, 65536); }
+};
+
+nlohmann::json DumpTrace() {
+    const std::string path = "test_trace.json";
+    EXPECT_GE(WriteTrace(path), 0);
+    std::ifstream in(path);
+    nlohmann::json trace = nlohmann::json::parse(in);
+    std::remove(path.c_str());
+    return trace;
+}
+
+size_t CountEvents(const nlohmann::json& trace, const std::string& name, const std::string& phase) {
+    size_t count = 0;
+    for (const auto& event : trace["traceEvents"]) {
+        count += event["name"] == name && event["ph"] == phase ? 1 : 0;
+    }
+    return count;
+}
+}
+
+TEST(TraceTest, SamplesOneTradeInN) {
+    EXPECT_FALSE(TraceEnabled());
+    STracingOn on(4, 1024);
+    EXPECT_TRUE(TraceEnabled());
+    std::thread producer([] {
+        uint64_t samples[2] = {};
+        int taken = 0;
+        for (int i = 1; i <= 8; ++i) {
+            if (const uint64_t sample = TraceSampleTrade()) {
+                EXPECT_EQ(i % 4, 0);
+                samples[taken++] = sample;
+            }
+        }
+        EXPECT_EQ(taken, 2);
+        EXPECT_EQ(TraceThreadSamples(), 2u);
+        EXPECT_EQ(TraceLastSample(), samples[1]);
+        EXPECT_GT(samples[1], samples[0]);
+    });
+    producer.join();
+}
+
+TEST(TraceTest, WritesChromeTraceEvents) {
+    STracingOn on(1, 1024);
+    std::thread worker([] {
+        SetTraceThreadName("trace-test");
+        const uint64_t now = TraceNowNs();
+        TraceSpan("test-span", now, now + 1500, 7);
+        TraceTradeSpan("test-wait", now - 3000, now, 7);
+    });
+    worker.join();
+
+    const nlohmann::json trace = DumpTrace();
+    ASSERT_TRUE(trace.contains("traceEvents"));
+    bool named = false;
+    for (const auto& event : trace["traceEvents"]) {
+        named = named || (event["ph"] == "M" && event["args"]["name"] == "trace-test");
+        if (event["name"] == "test-span") {
+            EXPECT_EQ(event["ph"], "X");
+            EXPECT_DOUBLE_EQ(event["dur"].get<double>(), 1.5);
+            EXPECT_EQ(event["args"]["sample"], 7);
+        }
+        if (event["name"] == "test-wait") {
+            EXPECT_EQ(event["id"], 7);
+        }
+    }
+    EXPECT_TRUE(named);
+    EXPECT_EQ(CountEvents(trace, "test-span", "X"), 1u);
+    EXPECT_EQ(CountEvents(trace, "test-wait", "b"), 1u);
+    EXPECT_EQ(CountEvents(trace, "test-wait", "e"), 1u);
+}
+
+TEST(TraceTest, RingKeepsTheLatestSpans) {
+    STracingOn on(1, 64);
+    std::thread worker([] {
+        for (uint64_t i = 0; i < 200; ++i) {
+            TraceSpan("test-ring", i * 1000, i * 1000 + 10);
+        }
+    });
+    worker.join();
+
+    const nlohmann::json trace = DumpTrace();
+    EXPECT_EQ(CountEvents(trace, "test-ring", "X"), 64u);
+    double first_us = 1e18;
+    for (const auto& event : trace["traceEvents"]) {
+        if (event["name"] == "test-ring") {
+            first_us = std::min(first_us, event["ts"].get<double>());
+        }
+    }
+    EXPECT_DOUBLE_EQ(first_us, 136.0);  // spans 136..199 survive
+}
+
+TEST(TraceTest, QueueTimesSampledTrades) {
+    STracingOn on(2, 1024);
+    CTradeQueue queue;
+    std::thread producer([&queue] {
+        for (int i = 0; i < 5; ++i) {
+            queue.Push(STrade{"BTCUSDT", 100.0, 1.0, 123456, true});
+        }
+    });
+    producer.join();
+
+    STradeBlock block;
+    ASSERT_TRUE(queue.PopBatch(block, 3));
+    const uint64_t first_sample = block.trace_sample;
+    EXPECT_NE(first_sample, 0u);  // the 2nd trade
+    ASSERT_TRUE(queue.PopBatch(block, 3));
+    EXPECT_EQ(block.trace_sample, first_sample + 1);  // the 4th
+}
+
+TEST(TraceTest, DroppedTradesTakeNoSample) {
+    STracingOn on(1, 1024);
+    CTradeQueue queue(1, EOverflowPolicy::DropNewest);
+    std::thread producer([&queue] {
+        queue.Push(STrade{"BTCUSDT", 100.0, 1.0, 123456, true});
+        queue.Push(STrade{"BTCUSDT", 100.0, 1.0, 123457, true});  // dropped
+        EXPECT_EQ(TraceThreadSamples(), 1u);
+    });
+    producer.join();
+    EXPECT_EQ(queue.Stats().dropped, 1u);
+}
+
+TEST(TraceTest, BatcherSamplesHeldTrades) {
+    STracingOn on(1, 1024);
+    CTradeQueue queue;
+    uint64_t held_sample = 0;
+    std::thread producer([&queue, &held_sample] {
+        for (uint64_t i = 1; i <= 10; ++i) {
+            queue.Push(STrade{"BTCUSDT", 100.0, 1.0, i, true});  // a backlog, so the batcher holds trades
+        }
+        CTradeBatcher batcher(queue, 64, std::chrono::seconds(10));
+        batcher.Add(STrade{"BTCUSDT", 100.0, 1.0, 11, true});
+        ASSERT_GT(batcher.Target(), 1u);
+        const uint64_t samples = TraceThreadSamples();
+        batcher.Add(STrade{"BTCUSDT", 100.0, 1.0, 12, true});
+        EXPECT_TRUE(batcher.Pending());
+        EXPECT_EQ(TraceThreadSamples(), samples + 1);  // sampled while its frame is parsed
+        held_sample = TraceLastSample();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        batcher.Flush();
+        EXPECT_EQ(TraceThreadSamples(), samples + 1);  // not sampled again by the push
+    });
+    producer.join();
+
+    STradeBlock block;
+    ASSERT_TRUE(queue.PopBatch(block, 64));
+    EXPECT_EQ(block.Size(), 12u);
+    EXPECT_EQ(block.trace_sample, held_sample);
+
+    const nlohmann::json trace = DumpTrace();
+    double begin_us = -1.0;
+    double end_us = -1.0;
+    for (const auto& event : trace["traceEvents"]) {
+        if (event["name"] == "queue" && event.contains("id") && event["id"] == held_sample) {
+            (event["ph"] == "b" ? begin_us : end_us) = event["ts"].get<double>();
+        }
+    }
+    ASSERT_GE(begin_us, 0.0);
+    EXPECT_GE(end_us - begin_us, 5000.0);  // the queue span starts when the batcher took the trade
+}
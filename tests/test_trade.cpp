@@ -26,4 +26,16 @@ TEST(TradeTest, FromJson) {
     EXPECT_TRUE(t.buyer_initiated);
     std::string bad_json = R"({"s":"","p":"100.0","q":"1.0","T":123456,"m":true})";
     EXPECT_THROW(STrade::FromJson(bad_json), std::runtime_error);
-}
\ No newline at end of file
+}
+TEST(TradeTest, FromJsonAggTrade) {
+    std::string json = R"({"stream":"btcusdt@aggTrade","data":{"e":"aggTrade","E":123457,"s":"BTCUSDT","a":26129,"p":"100.5","q":"3.0","f":100,"l":104,"T":123456,"m":false,"M":true}})";
+    STrade t = STrade::FromJson(json);
+    EXPECT_DOUBLE_EQ(t.price, 100.5);
+    EXPECT_EQ(t.first_trade_id, 100u);
+    EXPECT_EQ(t.last_trade_id, 104u);
+    EXPECT_EQ(t.TradeCount(), 5u);
+
+    STrade raw = STrade::FromJson(std::string(R"({"s":"BTCUSDT","t":42,"p":"100.0","q":"1.0","T":123456,"m":true})"));
+    EXPECT_EQ(raw.first_trade_id, 42u);
+    EXPECT_EQ(raw.TradeCount(), 1u);
+}
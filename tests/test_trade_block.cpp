@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include "aggregator.hpp"
+#include "trade_block.hpp"
+
+#include <random>
+
+namespace {
+std::vector<STrade> MakeTrades(size_t count) {
+    std::mt19937_64 rng(3);
+    std::uniform_real_distribution<double> qty(0.001, 2.0);
+    std::uniform_int_distribution<int> step(-5, 5);
+    const char* symbols[] = {"BTCUSDT", "ETHUSDT", "SOLUSDT"};
+    double prices[] = {65000.0, 3200.0, 150.0};
+    std::vector<STrade> trades;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t s = rng() % 3;
+        prices[s] += step(rng) * 0.01;
+        STrade t{symbols[s], prices[s], qty(rng), 1000 + i * 7, (rng() & 1) != 0};
+        if (i % 5 == 0) {
+            t.first_trade_id = 100 + i;
+            t.last_trade_id = 100 + i + rng() % 4;
+        }
+        trades.push_back(t);
+    }
+    return trades;
+}
+}
+
+TEST(TradeBlockTest, AppendInternsSymbolsAndRejectsInvalid) {
+    STradeBlock block;
+    EXPECT_TRUE(block.Append({"BTCUSDT", 100.0, 1.0, 1000, true}));
+    EXPECT_TRUE(block.Append({"ETHUSDT", 10.0, 2.0, 1001, false}));
+    EXPECT_TRUE(block.Append({"BTCUSDT", 101.0, 1.0, 1002, false}));
+    EXPECT_FALSE(block.Append({"BTCUSDT", -1.0, 1.0, 1003, false}));
+    ASSERT_EQ(block.Size(), 3u);
+    EXPECT_EQ(block.symbols.size(), 2u);
+    EXPECT_EQ(block.symbol_index[2], block.symbol_index[0]);
+    const STrade back = block.At(1);
+    EXPECT_EQ(back.symbol, "ETHUSDT");
+    EXPECT_DOUBLE_EQ(back.quantity, 2.0);
+
+    block.Clear();
+    EXPECT_TRUE(block.Empty());
+    EXPECT_EQ(block.symbols.size(), 2u);
+}
+
+TEST(TradeBlockTest, ReductionsAgreeWithScalarLoop) {
+    STradeBlock block;
+    for (const auto& t : MakeTrades(1003)) {  // not a multiple of the lane count
+        block.Append(t);
+    }
+    STradeReduction expected;
+    for (size_t i = 0; i < block.Size(); ++i) {
+        expected.trades_count += block.trade_count[i];
+        expected.buyer_initiated_count += block.buyer_initiated[i] ? block.trade_count[i] : 0;
+        expected.total_quantity += block.quantity[i];
+        expected.total_volume += block.price[i] * block.quantity[i];
+        expected.min_price = std::min(expected.min_price, block.price[i]);
+        expected.max_price = std::max(expected.max_price, block.price[i]);
+    }
+    for (size_t n : {size_t{0}, size_t{3}, block.Size()}) {
+        const auto portable = ReduceTradesPortable(block.price.data(), block.quantity.data(), block.trade_count.data(),
+                                                   block.buyer_initiated.data(), n);
+        const auto dispatched = ReduceTrades(block.price.data(), block.quantity.data(), block.trade_count.data(),
+                                             block.buyer_initiated.data(), n);
+        for (const auto& r : {portable, dispatched}) {
+            if (n == block.Size()) {
+                EXPECT_EQ(r.trades_count, expected.trades_count);
+                EXPECT_EQ(r.buyer_initiated_count, expected.buyer_initiated_count);
+                EXPECT_NEAR(r.total_quantity, expected.total_quantity, 1e-9);
+                EXPECT_NEAR(r.total_volume, expected.total_volume, 1e-9 * expected.total_volume);
+                EXPECT_EQ(r.min_price, expected.min_price);
+                EXPECT_EQ(r.max_price, expected.max_price);
+            }
+        }
+        EXPECT_EQ(portable.trades_count, dispatched.trades_count);
+        EXPECT_EQ(portable.min_price, dispatched.min_price);
+    }
+    std::cout << "AVX2 reduction: " << (ReduceTradesUsesAvx2() ? "yes" : "no") << "\n";
+}
+
+TEST(TradeBlockTest, AddBatchMatchesAddTrade) {
+    SAppConfig cfg;
+    cfg.agg.period_ms = 1000;
+    CTradeAggregator one_by_one(cfg);
+    CTradeAggregator batched(cfg);
+    const auto trades = MakeTrades(2000);  // spans several windows
+    STradeBlock block;
+    for (size_t i = 0; i < trades.size(); ++i) {
+        one_by_one.AddTrade(trades[i]);
+        block.Append(trades[i]);
+        if (block.Size() == 300 || i + 1 == trades.size()) {
+            batched.AddBatch(block);
+            block.Clear();
+        }
+    }
+    const auto expected = one_by_one.FlushStatistics();
+    const auto actual = batched.FlushStatistics();
+    ASSERT_EQ(actual.size(), expected.size());
+    for (const auto& window : expected) {
+        const auto& got = actual.at(window.first);
+        ASSERT_EQ(got.size(), window.second.size());
+        for (const auto& entry : window.second) {
+            const auto& e = entry.second;
+            const auto& a = got.at(entry.first);
+            EXPECT_EQ(a.trades_count, e.trades_count);
+            EXPECT_EQ(a.buy_count, e.buy_count);
+            EXPECT_EQ(a.sell_count, e.sell_count);
+            EXPECT_NEAR(a.total_quantity, e.total_quantity, 1e-9);
+            EXPECT_NEAR(a.total_volume, e.total_volume, 1e-9 * e.total_volume);
+            EXPECT_EQ(a.min_price, e.min_price);
+            EXPECT_EQ(a.max_price, e.max_price);
+        }
+    }
+}
+
+TEST(TradeBlockTest, AddBatchFeedsMetrics) {
+    SAppConfig cfg;
+    CBasicTradeAggregator<CFullMetrics> agg(cfg);
+    STradeBlock block;
+    for (double price : {100.0, 110.0, 120.0}) {
+        block.Append({"BTCUSDT", price, 1.0, 1000, false});
+    }
+    agg.AddBatch(block);
+    const auto windows = agg.FlushStatistics();
+    const auto& stats = windows.at(1000).at("BTCUSDT");
+    EXPECT_DOUBLE_EQ(SPriceQuantileMetric<50>::Value(stats.metrics.Get<SPriceQuantileMetric<50>>()), 110.0);
+}
+
+TEST(TradeBlockTest, InternKeepsIndicesAcrossTableGrowth) {
+    STradeBlock block;
+    for (int round = 0; round < 2; ++round) {
+        for (int s = 0; s < 100; ++s) {
+            ASSERT_TRUE(block.Append({"SYM" + std::to_string(s), 1.0, 1.0, 1000, false}));
+        }
+    }
+    ASSERT_EQ(block.symbols.size(), 100u);
+    for (size_t i = 0; i < block.Size(); ++i) {
+        EXPECT_EQ(block.symbols[block.symbol_index[i]], "SYM" + std::to_string(i % 100));
+    }
+}
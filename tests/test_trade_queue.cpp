@@ -61,3 +61,240 @@ TEST(TradeQueueTest, MultiThread) {
     producer.join();
     ASSERT_EQ(count, N);
 }
+
+TEST(TradeQueueTest, TryPop) {
+    CTradeQueue queue;
+    STrade out;
+    EXPECT_FALSE(queue.TryPop(out));
+    queue.Push({"BTCUSDT", 100.0, 1.0, 123456, true});
+    queue.Stop();
+    EXPECT_TRUE(queue.IsStopped());
+    ASSERT_TRUE(queue.TryPop(out));
+    EXPECT_EQ(out.timestamp, 123456u);
+    EXPECT_FALSE(queue.TryPop(out));
+}
+
+TEST(TradeQueueTest, DropNewestWhenFull) {
+    CTradeQueue queue(2, EOverflowPolicy::DropNewest);
+    for (uint64_t i = 1; i <= 5; ++i) {
+        queue.Push({"BTCUSDT", 100.0, 1.0, i, true});
+    }
+    const auto stats = queue.Stats();
+    EXPECT_EQ(stats.size, 2u);
+    EXPECT_EQ(stats.high_water_mark, 2u);
+    EXPECT_EQ(stats.dropped, 3u);
+    STrade out;
+    ASSERT_TRUE(queue.TryPop(out));
+    EXPECT_EQ(out.timestamp, 1u);
+}
+
+TEST(TradeQueueTest, BlockWaitsForSpaceThenTimesOut) {
+    CTradeQueue queue(1, EOverflowPolicy::Block, std::chrono::milliseconds(20));
+    queue.Push({"BTCUSDT", 100.0, 1.0, 1, true});
+    // Nobody pops: the push gives up after the timeout and counts a drop.
+    queue.Push({"BTCUSDT", 100.0, 1.0, 2, true});
+    EXPECT_EQ(queue.Stats().dropped, 1u);
+
+    CTradeQueue slow(1, EOverflowPolicy::Block, std::chrono::seconds(5));
+    slow.Push({"BTCUSDT", 100.0, 1.0, 1, true});
+    std::thread consumer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        STrade out;
+        slow.Pop(out);
+    });
+    slow.Push({"BTCUSDT", 100.0, 1.0, 2, true});
+    consumer.join();
+    const auto stats = slow.Stats();
+    EXPECT_EQ(stats.blocked, 1u);
+    EXPECT_EQ(stats.dropped, 0u);
+    STrade out;
+    ASSERT_TRUE(slow.TryPop(out));
+    EXPECT_EQ(out.timestamp, 2u);
+}
+
+TEST(TradeQueueTest, CoalesceKeepsExactStatistics) {
+    CTradeQueue queue(1, EOverflowPolicy::Coalesce, std::chrono::milliseconds(100), 1000);
+    queue.Push({"BTCUSDT", 100.0, 1.0, 1000, true});
+    queue.Push({"BTCUSDT", 110.0, 2.0, 1100, false});
+    queue.Push({"BTCUSDT", 90.0, 1.0, 1900, true});
+    queue.Push({"BTCUSDT", 95.0, 1.0, 2100, false});  // next window
+    queue.Push({"ETHUSDT", 10.0, 3.0, 1500, false});
+
+    EXPECT_EQ(queue.Stats().coalesced, 4u);
+    std::vector<SCoalescedTrades> partials;
+    ASSERT_TRUE(queue.TakeCoalesced(partials));
+    ASSERT_EQ(partials.size(), 3u);
+    const auto& btc = partials[0];
+    EXPECT_EQ(btc.symbol, "BTCUSDT");
+    EXPECT_EQ(btc.window_start, 1000u);
+    EXPECT_EQ(btc.trades_count, 2u);
+    EXPECT_DOUBLE_EQ(btc.total_quantity, 3.0);
+    EXPECT_DOUBLE_EQ(btc.total_volume, 310.0);
+    EXPECT_DOUBLE_EQ(btc.min_price, 90.0);
+    EXPECT_DOUBLE_EQ(btc.max_price, 110.0);
+    EXPECT_EQ(btc.buy_count, 1u);
+    EXPECT_EQ(btc.sell_count, 1u);
+    EXPECT_EQ(partials[1].window_start, 2000u);
+    EXPECT_EQ(partials[2].symbol, "ETHUSDT");
+
+    partials.clear();
+    EXPECT_FALSE(queue.TakeCoalesced(partials));
+}
+
+TEST(TradeQueueTest, ParseOverflowPolicy) {
+    EOverflowPolicy policy = EOverflowPolicy::Block;
+    EXPECT_TRUE(ParseOverflowPolicy("coalesce", policy));
+    EXPECT_EQ(policy, EOverflowPolicy::Coalesce);
+    EXPECT_TRUE(ParseOverflowPolicy("drop_newest", policy));
+    EXPECT_EQ(policy, EOverflowPolicy::DropNewest);
+    EXPECT_FALSE(ParseOverflowPolicy("drop_oldest", policy));
+}
+
+TEST(TradeQueueTest, PopBatchTakesWhatIsQueued) {
+    CTradeQueue queue;
+    for (uint64_t i = 0; i < 5; ++i) {
+        queue.Push({"BTCUSDT", 100.0 + static_cast<double>(i), 1.0, 1000 + i, false});
+    }
+    queue.Push({"", 1.0, 1.0, 1000, false});  // invalid: not appended
+    STradeBlock block;
+    ASSERT_TRUE(queue.PopBatch(block, 3));
+    EXPECT_EQ(block.Size(), 3u);
+    EXPECT_DOUBLE_EQ(block.price[2], 102.0);
+    ASSERT_TRUE(queue.TryPopBatch(block, 100));
+    EXPECT_EQ(block.Size(), 2u);
+    EXPECT_EQ(block.timestamp[0], 1003u);
+    EXPECT_FALSE(queue.TryPopBatch(block, 100));
+    EXPECT_TRUE(block.Empty());
+
+    queue.Stop();
+    EXPECT_FALSE(queue.PopBatch(block, 100));
+}
+
+TEST(TradeQueueTest, PushBatchAppliesTheOverflowPolicy) {
+    CTradeQueue queue(3, EOverflowPolicy::DropNewest);
+    std::vector<STrade> trades;
+    for (uint64_t i = 1; i <= 5; ++i) {
+        trades.push_back({"BTCUSDT", 100.0, 1.0, i, true});
+    }
+    queue.PushBatch(trades);
+    EXPECT_TRUE(trades.empty());
+    auto stats = queue.Stats();
+    EXPECT_EQ(stats.size, 3u);
+    EXPECT_EQ(stats.dropped, 2u);
+    EXPECT_EQ(stats.pushed[BatchBucket(3)], 1u);
+
+    STradeBlock block;
+    ASSERT_TRUE(queue.PopBatch(block, 100));
+    EXPECT_EQ(block.timestamp[2], 3u);
+    stats = queue.Stats();
+    EXPECT_EQ(stats.popped[BatchBucket(3)], 1u);
+    EXPECT_EQ(stats.wakeups, 0u);  // the trades were there already
+}
+
+TEST(TradeQueueTest, BatchFillingTheQueueWakesTheConsumer) {
+    // A blocked batch must not wait for a consumer that was never told.
+    CTradeQueue queue(2, EOverflowPolicy::Block, std::chrono::seconds(5));
+    size_t popped = 0;
+    std::thread consumer([&]() {
+        STradeBlock block;
+        while (popped < 6 && queue.PopBatch(block, 1)) {
+            popped += block.Size();
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));  // let the consumer sleep
+    std::vector<STrade> trades;
+    for (uint64_t i = 1; i <= 6; ++i) {
+        trades.push_back({"BTCUSDT", 100.0, 1.0, i, true});
+    }
+    const auto started = std::chrono::steady_clock::now();
+    queue.PushBatch(trades);
+    queue.Stop();  // the consumer still drains what is queued
+    consumer.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(2));
+    EXPECT_EQ(popped, 6u);
+    const auto stats = queue.Stats();
+    EXPECT_EQ(stats.dropped, 0u);
+    EXPECT_GE(stats.wakeups, 1u);
+}
+
+TEST(TradeQueueTest, BlockedBatchSharesOneTimeout) {
+    // Nobody pops: the whole batch waits one block_timeout, not one per trade.
+    CTradeQueue queue(4, EOverflowPolicy::Block, std::chrono::milliseconds(50));
+    std::vector<STrade> trades;
+    for (uint64_t i = 1; i <= 4; ++i) {
+        trades.push_back({"BTCUSDT", 100.0, 1.0, i, true});
+    }
+    queue.PushBatch(trades);
+    for (uint64_t i = 1; i <= 64; ++i) {
+        trades.push_back({"BTCUSDT", 100.0, 1.0, 4 + i, true});
+    }
+    const auto started = std::chrono::steady_clock::now();
+    queue.PushBatch(trades);
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+    EXPECT_GE(elapsed, std::chrono::milliseconds(50));
+    EXPECT_LT(elapsed, std::chrono::milliseconds(150));
+    const auto stats = queue.Stats();
+    EXPECT_EQ(stats.size, 4u);
+    EXPECT_EQ(stats.dropped, 64u);
+}
+
+TEST(TradeQueueTest, BatcherFollowsTheQueueDepth) {
+    CTradeQueue queue;
+    CTradeBatcher batcher(queue, 8, std::chrono::seconds(10));
+    // Nothing queued: the trade is pushed right away.
+    batcher.Add({"BTCUSDT", 100.0, 1.0, 1, true});
+    EXPECT_FALSE(batcher.Pending());
+    EXPECT_EQ(batcher.Target(), 1u);
+    batcher.Add({"BTCUSDT", 100.0, 1.0, 2, true});
+    EXPECT_FALSE(batcher.Pending());
+    EXPECT_EQ(batcher.Target(), 2u);
+
+    // Nobody pops: the batch grows with the backlog, up to max_batch.
+    batcher.Add({"BTCUSDT", 100.0, 1.0, 3, true});
+    EXPECT_TRUE(batcher.Pending());
+    EXPECT_EQ(queue.Depth(), 2u);
+    batcher.Flush();
+    EXPECT_EQ(queue.Depth(), 3u);
+    for (uint64_t i = 0; i < 40; ++i) {
+        batcher.Add({"BTCUSDT", 100.0, 1.0, 4 + i, true});
+    }
+    EXPECT_EQ(batcher.Target(), 8u);
+    batcher.Flush();
+    EXPECT_EQ(queue.Depth(), 43u);
+
+    // The reader catches up: back to one trade at a time.
+    STradeBlock block;
+    ASSERT_TRUE(queue.PopBatch(block, 100));
+    batcher.Add({"BTCUSDT", 100.0, 1.0, 100, true});
+    EXPECT_TRUE(batcher.Pending());  // the target adapts on the next push
+    batcher.Flush();
+    ASSERT_TRUE(queue.PopBatch(block, 100));
+    batcher.Add({"BTCUSDT", 100.0, 1.0, 101, true});
+    EXPECT_FALSE(batcher.Pending());
+    EXPECT_EQ(batcher.Target(), 1u);
+
+    // Batches of 3, 6 and 7 (the flush), then three full ones.
+    const auto stats = queue.Stats();
+    EXPECT_EQ(stats.pushed[0], 5u);
+    EXPECT_EQ(stats.pushed[BatchBucket(3)], 1u);
+    EXPECT_EQ(stats.pushed[BatchBucket(6)], 2u);
+    EXPECT_EQ(stats.pushed[BatchBucket(8)], 3u);
+    EXPECT_EQ(FormatBatchHistogram(BatchHistogram{}), "-");
+    EXPECT_EQ(FormatBatchHistogram(BatchHistogram{2, 0, 5}), "1:2 4:5");
+}
+
+TEST(TradeQueueTest, BatcherPushesOnTheDeadline) {
+    CTradeQueue queue;
+    for (uint64_t i = 1; i <= 10; ++i) {
+        queue.Push({"BTCUSDT", 100.0, 1.0, i, true});  // a backlog, so the batcher holds trades
+    }
+    CTradeBatcher batcher(queue, 64, std::chrono::microseconds(1000));
+    batcher.Add({"BTCUSDT", 100.0, 1.0, 10, true});
+    EXPECT_EQ(batcher.Target(), 11u);
+    batcher.Add({"BTCUSDT", 100.0, 1.0, 11, true});
+    EXPECT_TRUE(batcher.Pending());
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    batcher.Add({"BTCUSDT", 100.0, 1.0, 12, true});
+    EXPECT_FALSE(batcher.Pending());
+    EXPECT_EQ(queue.Depth(), 13u);
+}
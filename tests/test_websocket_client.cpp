@@ -27,17 +27,31 @@ public:
         client->ScheduleReconnect(reason, ec);
     }
     static void call_on_read(CWebSocketClient* client, boost::beast::error_code ec, std::size_t bytes) {
-        client->OnRead(ec, bytes);
+        client->OnRead(client->m_conn, ec, bytes);
+    }
+    // Delivers one frame on the active connection, or on the standby.
+    static void deliver(CWebSocketClient* client, const std::string& data, bool on_standby = false) {
+        const auto conn = on_standby ? client->m_standby : client->m_conn;
+        auto& buffer = conn->buffer;
+        buffer.commit(boost::asio::buffer_copy(buffer.prepare(data.size()), boost::asio::buffer(data)));
+        client->OnRead(conn, {}, data.size());
     }
     static void call_on_reconnect_timer(CWebSocketClient* client, boost::beast::error_code ec = {}) {
         client->OnReconnectTimer(ec);
     }
     static void prepare_buffer(CWebSocketClient* client, const std::string& data) {
-        client->m_buffer.commit(boost::asio::buffer_copy(client->m_buffer.prepare(data.size()), boost::asio::buffer(data)));
+        auto& buffer = client->m_conn->buffer;
+        buffer.commit(boost::asio::buffer_copy(buffer.prepare(data.size()), boost::asio::buffer(data)));
     }
     static void init_ws(CWebSocketClient* client, net::io_context& ioc, ssl::context& ctx) {
-        client->m_ws.emplace(ioc, ctx);
+        client->m_conn = std::make_shared<CWebSocketClient::SConnection>(ioc, ctx);
+    }
+    // A replacement connection that is still being set up.
+    static void init_standby(CWebSocketClient* client, net::io_context& ioc, ssl::context& ctx) {
+        client->m_standby = std::make_shared<CWebSocketClient::SConnection>(ioc, ctx);
     }
+    static const void* active(CWebSocketClient* client) { return client->m_conn.get(); }
+    static const void* standby(CWebSocketClient* client) { return client->m_standby.get(); }
 };
 
 TEST(WebSocketClientTest, ConstructStartStop) {
@@ -158,3 +172,87 @@ TEST(WebSocketClientTest, FullCycleInternetOnOffOn) {
     EXPECT_CALL(*mock_tq, Push).Times(1);
     WebSocketClientTestHelper::call_on_read(client.get(), {}, json.size());
 }
+
+TEST(WebSocketClientTest, TrafficStatsCountReadMessages) {
+    boost::asio::io_context ioc;
+    ssl::context ctx{ssl::context::tlsv12_client};
+    auto mock_tq = std::make_shared<MockTradeQueue>();
+    SAppConfig cfg;
+    auto client = std::make_shared<CWebSocketClient>(ioc, mock_tq, cfg);
+    WebSocketClientTestHelper::init_ws(client.get(), ioc, ctx);
+    std::string json = R"({"s":"BTCUSDT","p":"100.0","q":"1.0","T":123456,"m":true})";
+    EXPECT_CALL(*mock_tq, Push).Times(2);
+    for (int i = 0; i < 2; ++i) {
+        WebSocketClientTestHelper::prepare_buffer(client.get(), json);
+        WebSocketClientTestHelper::call_on_read(client.get(), {}, json.size());
+    }
+    WebSocketClientTestHelper::call_on_read(client.get(), boost::beast::error_code{boost::beast::error::timeout}, 0);
+
+    const SWsTrafficStats stats = client->TrafficStats();
+    EXPECT_EQ(stats.messages, 2u);
+    EXPECT_EQ(stats.payload_bytes, 2 * json.size());
+    EXPECT_EQ(stats.wire_bytes, 0u);  // nothing came through TLS
+    EXPECT_FALSE(stats.deflate_negotiated);
+}
+
+TEST(WebSocketClientTest, DuplicateTradeIdsAreDropped) {
+    boost::asio::io_context ioc;
+    ssl::context ctx{ssl::context::tlsv12_client};
+    auto mock_tq = std::make_shared<MockTradeQueue>();
+    SAppConfig cfg;
+    auto client = std::make_shared<CWebSocketClient>(ioc, mock_tq, cfg);
+    WebSocketClientTestHelper::init_ws(client.get(), ioc, ctx);
+    WebSocketClientTestHelper::init_standby(client.get(), ioc, ctx);
+    auto trade = [](const char* symbol, int id) {
+        return std::string(R"({"s":")") + symbol + R"(","t":)" + std::to_string(id) +
+               R"(,"p":"100.0","q":"1.0","T":123456,"m":true})";
+    };
+    // As during a rotation overlap: the new connection joins at trade 10
+    // while the old one has only delivered up to 7.
+    EXPECT_CALL(*mock_tq, Push).Times(5);
+    WebSocketClientTestHelper::deliver(client.get(), trade("BTCUSDT", 7));
+    WebSocketClientTestHelper::deliver(client.get(), trade("BTCUSDT", 10), true);
+    WebSocketClientTestHelper::deliver(client.get(), trade("BTCUSDT", 8));   // not seen by the new one
+    WebSocketClientTestHelper::deliver(client.get(), trade("BTCUSDT", 10));  // duplicate
+    WebSocketClientTestHelper::deliver(client.get(), trade("ETHUSDT", 10));
+    WebSocketClientTestHelper::deliver(client.get(), trade("BTCUSDT", 11), true);
+    WebSocketClientTestHelper::deliver(client.get(), trade("BTCUSDT", 11));  // duplicate
+    EXPECT_EQ(client->ReconnectStats().duplicates_dropped, 2u);
+}
+
+TEST(WebSocketClientTest, ActiveLossHandsOverToStandby) {
+    boost::asio::io_context ioc;
+    ssl::context ctx{ssl::context::tlsv12_client};
+    auto tq = std::make_shared<CTradeQueue>();
+    SAppConfig cfg;
+    auto client = std::make_shared<CWebSocketClient>(ioc, tq, cfg);
+    WebSocketClientTestHelper::init_ws(client.get(), ioc, ctx);
+    WebSocketClientTestHelper::init_standby(client.get(), ioc, ctx);
+    const void* standby = WebSocketClientTestHelper::standby(client.get());
+
+    // The server closed the active connection while its replacement was connecting.
+    WebSocketClientTestHelper::call_on_read(client.get(), boost::beast::websocket::error::closed, 0);
+    EXPECT_FALSE(client->is_reconnect_scheduled());
+    EXPECT_EQ(WebSocketClientTestHelper::active(client.get()), standby);
+    EXPECT_EQ(WebSocketClientTestHelper::standby(client.get()), nullptr);
+
+    // Without a replacement the usual reconnect follows.
+    WebSocketClientTestHelper::call_on_read(client.get(), boost::beast::websocket::error::closed, 0);
+    EXPECT_TRUE(client->is_reconnect_scheduled());
+}
+
+TEST(WebSocketClientTest, OkxFramesReachTheQueue) {
+    boost::asio::io_context ioc;
+    ssl::context ctx{ssl::context::tlsv12_client};
+    auto mock_tq = std::make_shared<MockTradeQueue>();
+    SAppConfig cfg;
+    cfg.ws.venue = "okx";
+    auto client = std::make_shared<CWebSocketClient>(ioc, mock_tq, cfg);
+    WebSocketClientTestHelper::init_ws(client.get(), ioc, ctx);
+    EXPECT_CALL(*mock_tq, Push).Times(2);
+    WebSocketClientTestHelper::deliver(client.get(), R"({"event":"subscribe","arg":{"channel":"trades","instId":"BTC-USDT"}})");
+    WebSocketClientTestHelper::deliver(client.get(), R"({"arg":{"channel":"trades","instId":"BTC-USDT"},"data":[)"
+        R"({"instId":"BTC-USDT","tradeId":"7","px":"100.0","sz":"1.0","side":"buy","ts":"123456","count":"1"},)"
+        R"({"instId":"BTC-USDT","tradeId":"8","px":"100.1","sz":"2.0","side":"sell","ts":"123457","count":"1"}]})");
+    WebSocketClientTestHelper::deliver(client.get(), "pong");
+}
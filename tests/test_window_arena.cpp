@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include "aggregator.hpp"
+#include "window_arena.hpp"
+
+TEST(WindowArenaTest, PoolRecyclesBlocks) {
+    auto pool = std::make_shared<CArenaPool>(64 * 1024, false, 2);
+    void* a = pool->Acquire();
+    void* b = pool->Acquire();
+    void* c = pool->Acquire();
+    EXPECT_EQ(pool->AllocatedBlocks(), 3u);
+    pool->Release(a);
+    pool->Release(b);
+    pool->Release(c);  // over the free-list cap: returned to the heap
+    EXPECT_EQ(pool->FreeBlocks(), 2u);
+    EXPECT_EQ(pool->AllocatedBlocks(), 2u);
+
+    void* again = pool->Acquire();
+    EXPECT_TRUE(again == a || again == b);
+    pool->Release(again);
+    EXPECT_EQ(pool->AllocatedBlocks(), 2u);
+}
+
+TEST(WindowArenaTest, HugepagePoolCarvesSlabs) {
+    auto pool = std::make_shared<CArenaPool>(256 * 1024, true);
+    void* block = pool->Acquire();
+    ASSERT_NE(block, nullptr);
+    EXPECT_EQ(pool->AllocatedBlocks(), CArenaPool::kSlabBytes / (256 * 1024));
+    static_cast<char*>(block)[256 * 1024 - 1] = 1;
+    pool->Release(block);
+    EXPECT_EQ(pool->FreeBlocks(), pool->AllocatedBlocks());
+}
+
+TEST(WindowArenaTest, WindowReturnsBlockWhenDestroyed) {
+    auto pool = std::make_shared<CArenaPool>(16 * 1024, false);
+    {
+        CTradeAggregator::WindowStats window(std::make_unique<CWindowArena>(pool));
+        window["BTCUSDT"].trades_count = 2;
+        window["ETHUSDT"].trades_count = 1;
+        window["BTCUSDT"].trades_count += 1;
+        EXPECT_EQ(pool->FreeBlocks(), 0u);
+
+        // Moving keeps the nodes in the original arena.
+        CTradeAggregator::WindowStats moved(std::move(window));
+        ASSERT_EQ(moved.size(), 2u);
+        EXPECT_EQ(moved.at("BTCUSDT").trades_count, 3u);
+        EXPECT_NE(moved.find("ETHUSDT"), moved.end());
+        EXPECT_EQ(moved.find("XRPUSDT"), moved.end());
+    }
+    EXPECT_EQ(pool->FreeBlocks(), 1u);
+    EXPECT_EQ(pool->AllocatedBlocks(), 1u);
+}
+
+TEST(WindowArenaTest, AggregatorStatisticsSurviveFlush) {
+    SAppConfig cfg;
+    cfg.agg.arena_kb = 16;
+    CTradeAggregator agg(cfg);
+    for (uint64_t ts = 1000; ts < 11000; ts += 100) {
+        agg.AddTrade({"BTCUSDT", 100.0, 1.0, ts, false});
+        agg.AddTrade({"A_SYMBOL_LONGER_THAN_SSO", 1.0, 1.0, ts, true});
+    }
+    auto windows = agg.FlushStatistics();
+    ASSERT_EQ(windows.size(), 10u);
+    for (const auto& window : windows) {
+        EXPECT_EQ(window.second.at("BTCUSDT").trades_count, 10u);
+        EXPECT_EQ(window.second.at("A_SYMBOL_LONGER_THAN_SSO").sell_count, 10u);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <boost/asio/ssl.hpp>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include <memory>
+
+// Self-signed P-256 certificate for CN=localhost, valid for a week, for the
+// loopback TLS servers of the load generator and the benchmarks.
+inline bool UseSelfSignedCertificate(boost::asio::ssl::context& ctx) {
+    std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(EVP_EC_gen("P-256"), &EVP_PKEY_free);
+    std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), &X509_free);
+    if (!key || !cert) {
+        return false;
+    }
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert.get()), 7 * 24 * 3600);
+    X509_set_pubkey(cert.get(), key.get());
+    X509_NAME* name = X509_get_subject_name(cert.get());
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert.get(), name);
+    return X509_sign(cert.get(), key.get(), EVP_sha256()) > 0 &&
+           SSL_CTX_use_certificate(ctx.native_handle(), cert.get()) == 1 &&
+           SSL_CTX_use_PrivateKey(ctx.native_handle(), key.get()) == 1;
+}
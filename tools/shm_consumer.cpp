@@ -0,0 +1,76 @@
+// Sample consumer of the shared-memory publisher (shm.enabled=true).
+// Usage: cqg_shm_consumer [/shm_name] [--trades] [--from-start]
+#include "shm_reader.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+volatile std::sig_atomic_t g_stop = 0;
+}
+
+int main(int argc, char** argv) {
+    std::string name = "/cqg_aggregates";
+    bool show_trades = false;
+    bool from_start = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--trades") {
+            show_trades = true;
+        } else if (arg == "--from-start") {
+            from_start = true;
+        } else {
+            name = arg;
+        }
+    }
+    std::signal(SIGINT, [](int) { g_stop = 1; });
+    std::signal(SIGTERM, [](int) { g_stop = 1; });
+
+    CShmReader reader;
+    while (!reader.Open(name)) {
+        if (g_stop) {
+            return 0;
+        }
+        std::cerr << "Waiting for " << name << "..." << std::endl;
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    if (!from_start) {
+        reader.Windows().SeekToLatest();
+        reader.Trades().SeekToLatest();
+    }
+
+    SShmWindowRecord window{};
+    SShmTradeRecord trade{};
+    while (!g_stop) {
+        bool idle = true;
+        while (reader.Windows().Next(window)) {
+            idle = false;
+            std::cout << "window=" << window.window_start_ms
+                      << " symbol=" << window.symbol
+                      << " trades=" << window.trades_count
+                      << " volume=" << std::fixed << std::setprecision(5) << window.total_volume
+                      << " min=" << std::setprecision(2) << window.min_price
+                      << " max=" << std::setprecision(2) << window.max_price
+                      << "\n";
+        }
+        while (show_trades && reader.Trades().Next(trade)) {
+            idle = false;
+            std::cout << "trade symbol=" << trade.symbol
+                      << " price=" << std::setprecision(2) << trade.price
+                      << " qty=" << std::setprecision(5) << trade.quantity
+                      << " ts=" << trade.timestamp << "\n";
+        }
+        if (idle) {
+            std::cout.flush();
+            // A latency-sensitive consumer would spin here instead of sleeping.
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    std::cout << "lost windows=" << reader.Windows().Lost()
+              << " lost trades=" << reader.Trades().Lost() << std::endl;
+    return 0;
+}
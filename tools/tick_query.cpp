@@ -0,0 +1,122 @@
+// Time-range queries over the tick store (ticks.enabled=true).
+// Usage: cqg_tick_query --symbol=BTCUSDT[,ETHUSDT...] [--dir=ticks] [--from=ms] [--to=ms]
+//                       [--print] [--aggregate=period_ms]
+// Without --print or --aggregate the range is only scanned, which reports
+// how fast the files can be read. --aggregate replays the trades through the
+// aggregator and prints the windows in the writer's format, with the metric
+// set of the CQG_METRICS build, to backfill a metric over recorded days.
+#include "aggregator.hpp"
+#include "tick_file.hpp"
+#include "tick_store.hpp"
+#include "trade_block.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr size_t kReplayBatchTrades = 4096;
+
+std::vector<std::string> SplitSymbols(const std::string& list) {
+    std::vector<std::string> symbols;
+    std::stringstream ss(list);
+    std::string symbol;
+    while (std::getline(ss, symbol, ',')) {
+        if (!symbol.empty()) {
+            symbols.push_back(symbol);
+        }
+    }
+    return symbols;
+}
+}
+
+int main(int argc, char** argv) {
+    std::string dir = "ticks";
+    std::vector<std::string> symbols;
+    uint64_t from_ms = 0;
+    uint64_t to_ms = std::numeric_limits<uint64_t>::max();
+    bool print = false;
+    uint64_t aggregate_ms = 0;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--dir=", 0) == 0) {
+            dir = arg.substr(6);
+        } else if (arg.rfind("--symbol=", 0) == 0) {
+            symbols = SplitSymbols(arg.substr(9));
+        } else if (arg.rfind("--from=", 0) == 0) {
+            from_ms = std::stoull(arg.substr(7));
+        } else if (arg.rfind("--to=", 0) == 0) {
+            to_ms = std::stoull(arg.substr(5));
+        } else if (arg == "--print") {
+            print = true;
+        } else if (arg.rfind("--aggregate=", 0) == 0) {
+            aggregate_ms = std::stoull(arg.substr(12));
+        } else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            return 2;
+        }
+    }
+    if (symbols.empty()) {
+        std::cerr << "Usage: cqg_tick_query --symbol=SYM[,SYM...] [--dir=ticks] [--from=ms] [--to=ms] "
+                     "[--print] [--aggregate=period_ms]\n";
+        return 2;
+    }
+
+    std::unique_ptr<CTradeAggregator> aggregator;
+    STradeBlock block;
+    if (aggregate_ms > 0) {
+        SAppConfig cfg;
+        cfg.agg.period_ms = aggregate_ms;
+        cfg.output.write_delay_ms = 0;
+        aggregator = std::make_unique<CTradeAggregator>(cfg);
+        block.Reserve(kReplayBatchTrades);
+    }
+
+    uint64_t records = 0;
+    double checksum = 0.0;
+    const auto started = std::chrono::steady_clock::now();
+    for (const auto& symbol : symbols) {
+        records += ScanTicks(dir, symbol, from_ms, to_ms, [&](const STickRecord& record) {
+            checksum += record.price * record.quantity;
+            if (print) {
+                std::cout << "ts=" << record.timestamp << " symbol=" << symbol
+                          << " price=" << std::setprecision(10) << record.price
+                          << " qty=" << record.quantity
+                          << " side=" << (record.buyer_initiated ? "sell" : "buy")
+                          << " id=" << record.last_trade_id
+                          << " count=" << record.trade_count << "\n";
+            }
+            if (aggregator) {
+                block.Append(TickToTrade(symbol, record));
+                if (block.Size() == kReplayBatchTrades) {
+                    aggregator->AddBatch(block);
+                    block.Clear();
+                }
+            }
+        });
+    }
+    if (aggregator && !block.Empty()) {
+        aggregator->AddBatch(block);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (aggregator) {
+        // Recorded windows are all in the past, so one flush returns every one of them.
+        for (const auto& window_pair : aggregator->FlushStatistics()) {
+            CTradeAggregator::WriteWindow(std::cout, window_pair.first, window_pair.second);
+        }
+    }
+
+    const double bytes = static_cast<double>(records) * sizeof(STickRecord);
+    std::cerr << "records=" << records
+              << " bytes=" << static_cast<uint64_t>(bytes)
+              << " seconds=" << std::fixed << std::setprecision(6) << seconds
+              << " GB/s=" << std::setprecision(2) << (seconds > 0 ? bytes / seconds / 1e9 : 0.0)
+              << " notional=" << std::setprecision(2) << checksum << "\n";
+    return 0;
+}
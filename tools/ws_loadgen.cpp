@@ -0,0 +1,573 @@
+// Local TLS WebSocket server that feeds the service synthetic Binance trade
+// frames, for end-to-end throughput tests:
+//
+//   cqg_ws_loadgen [--port=N] [--symbols=N] [--rate=N] [--burst=N] [--seconds=N]
+//                  [--disconnect-every=N] [--max-age=N] [--stream=trade|aggTrade]
+//                  [--venue=binance|okx]
+//                  [--shm=/name] [--deflate[=window_bits]] [--deflate-no-context-takeover]
+//
+// Point the service at it with --ws-host=127.0.0.1 --ws-port=N (the client does
+// not verify the peer, so the self-signed certificate generated at startup is
+// accepted). Frames go out in bursts of --burst back to back, spaced so the
+// average is --rate frames/s (0 = as fast as the socket takes them); a slow
+// consumer shows up as TCP backpressure, i.e. a lower achieved rate.
+// --disconnect-every drops the TCP connection every N seconds without a close
+// handshake and waits for the service to reconnect. --max-age closes each
+// connection with a close frame once it is N seconds old, like Binance's 24h
+// limit. Clients may hold several connections at once; every frame goes to
+// all of them, so a client rotating make-before-break sees each id twice
+// during the overlap.
+//
+// --venue=okx sends OKX "trades" channel frames instead (the service with
+// ws.venue okx); the subscribe message the client sends is not read.
+//
+// --deflate accepts permessage-deflate when the client offers it (ws.deflate
+// in the service config), with the server window limited to window_bits
+// (9..15, default 15); the summary then shows wire bytes next to payload bytes.
+//
+// Each frame carries a sequence number as its trade id. With --shm the
+// generator also reads the service's shared-memory trade feed (shm.enabled
+// and shm.publish_trades) and matches ids to send times, which gives the
+// end-to-end latency (socket write -> shm record) and the frames that never
+// came out (dropped by the queue, rejected, or lost while disconnected).
+#include "self_signed_cert.hpp"
+#include "shm_reader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
+#include <openssl/bio.h>
+#include <openssl/ssl.h>
+#include <sys/socket.h>
+#include <zlib.h>
+
+namespace net = boost::asio;
+namespace ssl = net::ssl;
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+using tcp = net::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+volatile std::sig_atomic_t g_stop = 0;
+
+struct SOptions {
+    uint16_t port = 9443;
+    size_t symbols = 8;
+    uint64_t rate = 50000;  // frames/s, 0 = unpaced
+    uint64_t burst = 1;
+    uint64_t seconds = 30;
+    uint64_t disconnect_every_sec = 0;
+    uint64_t max_age_sec = 0;
+    bool agg_trade = false;
+    bool okx = false;  // OKX "trades" channel frames instead of Binance ones
+    std::string shm_name;
+    bool deflate = false;
+    int deflate_window_bits = 15;
+    bool deflate_no_context_takeover = false;
+};
+
+// Send times by sequence number; ids older than the ring are not matched.
+constexpr uint64_t kSendTimeSlots = 1u << 24;
+
+int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+uint64_t NowMs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+class CFrameSource {
+public:
+    explicit CFrameSource(const SOptions& options) : m_agg_trade(options.agg_trade), m_okx(options.okx), m_rng(42) {
+        for (size_t s = 0; s < options.symbols; ++s) {
+            m_symbols.push_back("LGEN" + std::to_string(s) + "USDT");
+            m_prices.push_back(100.0 + static_cast<double>(s) * 10.0);
+        }
+    }
+
+    // Combined-stream frame for trade id `seq`.
+    const std::string& Next(uint64_t seq) {
+        const size_t s = m_rng() % m_symbols.size();
+        m_prices[s] = std::max(0.01, m_prices[s] + static_cast<double>(static_cast<int>(m_rng() % 7) - 3) * 0.01);
+        const uint64_t ms = NowMs();
+        char price[32];
+        char quantity[32];
+        std::snprintf(price, sizeof(price), "%.2f", m_prices[s]);
+        std::snprintf(quantity, sizeof(quantity), "%.5f", 0.001 + static_cast<double>(m_rng() % 100000) * 1e-5);
+        const char* maker = (m_rng() & 1) != 0 ? "true" : "false";
+        std::string lower = m_symbols[s];
+        std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+        const std::string seq_text = std::to_string(seq);
+        m_frame.clear();
+        if (m_okx) {
+            // Symbols become instrument ids like LGEN0-USDT.
+            const std::string inst_id = m_symbols[s].substr(0, m_symbols[s].size() - 4) + "-USDT";
+            m_frame += "{\"arg\":{\"channel\":\"trades\",\"instId\":\"" + inst_id + "\"},\"data\":[{\"instId\":\"" +
+                       inst_id + "\",\"tradeId\":\"" + seq_text + "\",\"px\":\"" + price + "\",\"sz\":\"" + quantity +
+                       "\",\"side\":\"" + (maker[0] == 't' ? "sell" : "buy") + "\",\"ts\":\"" + std::to_string(ms) +
+                       "\",\"count\":\"1\"}]}";
+        } else if (m_agg_trade) {
+            // One exchange trade per record, so ids stay one per frame.
+            m_frame += "{\"stream\":\"" + lower + "@aggTrade\",\"data\":{\"e\":\"aggTrade\",\"E\":" + std::to_string(ms) +
+                       ",\"s\":\"" + m_symbols[s] + "\",\"a\":" + seq_text + ",\"p\":\"" + price + "\",\"q\":\"" +
+                       quantity + "\",\"f\":" + seq_text + ",\"l\":" + seq_text + ",\"T\":" + std::to_string(ms) +
+                       ",\"m\":" + maker + "}}";
+        } else {
+            m_frame += "{\"stream\":\"" + lower + "@trade\",\"data\":{\"e\":\"trade\",\"E\":" + std::to_string(ms) +
+                       ",\"s\":\"" + m_symbols[s] + "\",\"t\":" + seq_text + ",\"p\":\"" + price + "\",\"q\":\"" +
+                       quantity + "\",\"T\":" + std::to_string(ms) + ",\"m\":" + maker + "}}";
+        }
+        return m_frame;
+    }
+
+private:
+    const bool m_agg_trade;
+    const bool m_okx;
+    std::mt19937_64 m_rng;
+    std::vector<std::string> m_symbols;
+    std::vector<double> m_prices;
+    std::string m_frame;
+};
+
+// Compresses frames for permessage-deflate itself: Beast 1.74 ends every
+// message with a full flush, which resets the dictionary, so small frames
+// barely compress. Servers like Binance keep the context between messages
+// (sync flush), which is what this does unless no_context_takeover was agreed.
+class CFrameDeflater {
+public:
+    CFrameDeflater(int window_bits, bool no_context_takeover) : m_no_context_takeover(no_context_takeover) {
+        // Negative window bits: raw deflate, no zlib header.
+        m_ok = deflateInit2(&m_zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -window_bits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~CFrameDeflater() { deflateEnd(&m_zs); }
+    CFrameDeflater(const CFrameDeflater&) = delete;
+    CFrameDeflater& operator=(const CFrameDeflater&) = delete;
+
+    bool Ok() const { return m_ok; }
+
+    // A complete unmasked server text frame with RSV1 set.
+    const std::string& Frame(const std::string& payload) {
+        m_deflated.resize(deflateBound(&m_zs, payload.size()) + 16);
+        m_zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(payload.data()));
+        m_zs.avail_in = static_cast<uInt>(payload.size());
+        m_zs.next_out = reinterpret_cast<Bytef*>(&m_deflated[0]);
+        m_zs.avail_out = static_cast<uInt>(m_deflated.size());
+        deflate(&m_zs, Z_SYNC_FLUSH);
+        // RFC 7692: the trailing 00 00 ff ff of the sync flush is not sent.
+        const size_t n = m_deflated.size() - m_zs.avail_out - 4;
+        if (m_no_context_takeover) {
+            deflateReset(&m_zs);
+        }
+        m_frame.clear();
+        m_frame.push_back(static_cast<char>(0xC1));  // FIN | RSV1 | text
+        if (n < 126) {
+            m_frame.push_back(static_cast<char>(n));
+        } else if (n <= 0xFFFF) {
+            m_frame.push_back(static_cast<char>(126));
+            m_frame.push_back(static_cast<char>(n >> 8));
+            m_frame.push_back(static_cast<char>(n & 0xFF));
+        } else {
+            m_frame.push_back(static_cast<char>(127));
+            for (int shift = 56; shift >= 0; shift -= 8) {
+                m_frame.push_back(static_cast<char>((static_cast<uint64_t>(n) >> shift) & 0xFF));
+            }
+        }
+        m_frame.append(m_deflated, 0, n);
+        return m_frame;
+    }
+
+private:
+    z_stream m_zs{};
+    bool m_ok = false;
+    const bool m_no_context_takeover;
+    std::string m_deflated;
+    std::string m_frame;
+};
+
+struct SSenderStats {
+    uint64_t sent = 0;
+    uint64_t bytes = 0;       // frame payloads
+    uint64_t wire_bytes = 0;  // TLS records written
+    uint64_t compressed_connections = 0;
+    uint64_t connections = 0;
+    uint64_t forced_disconnects = 0;
+    uint64_t aged_out = 0;
+    double seconds = 0.0;  // time with at least one client connected
+};
+
+// An accepted client, streamed to by the sender once the acceptor hands it over.
+struct SPeer {
+    SPeer(tcp::socket socket, ssl::context& ctx) : ws(std::move(socket), ctx) {}
+    websocket::stream<beast::ssl_stream<tcp::socket>> ws;
+    std::unique_ptr<CFrameDeflater> deflater;
+    Clock::time_point connected;
+};
+
+// Handshakes clients on its own thread, so that a client can open a second
+// connection while the first one is streaming.
+void RunAcceptor(const SOptions& options, tcp::acceptor& acceptor, ssl::context& ctx, std::mutex& mutex,
+                 std::vector<std::unique_ptr<SPeer>>& incoming) {
+    while (!g_stop) {
+        tcp::socket socket(acceptor.get_executor());
+        beast::error_code ec;
+        acceptor.accept(socket, ec);
+        if (ec) {
+            return;  // closed at the end of the run
+        }
+        auto peer = std::make_unique<SPeer>(std::move(socket), ctx);
+        auto& ws = peer->ws;
+        if (options.deflate) {
+            websocket::permessage_deflate pmd;
+            pmd.server_enable = true;
+            pmd.server_max_window_bits = options.deflate_window_bits;
+            pmd.server_no_context_takeover = options.deflate_no_context_takeover;
+            ws.set_option(pmd);
+        }
+        // The decorator sees the response after the extensions are negotiated.
+        std::string extensions;
+        ws.set_option(websocket::stream_base::decorator([&extensions](websocket::response_type& res) {
+            extensions = std::string(res[beast::http::field::sec_websocket_extensions]);
+        }));
+        ws.next_layer().handshake(ssl::stream_base::server, ec);
+        if (!ec) {
+            ws.accept(ec);
+        }
+        if (ec) {
+            std::fprintf(stderr, "handshake failed: %s\n", ec.message().c_str());
+            continue;
+        }
+        ws.text(true);
+        if (extensions.find("permessage-deflate") != std::string::npos) {
+            // The client may have asked for a smaller window or for no context takeover.
+            int window_bits = options.deflate_window_bits;
+            const auto bits_at = extensions.find("server_max_window_bits=");
+            if (bits_at != std::string::npos) {
+                window_bits = std::min(window_bits, std::atoi(extensions.c_str() + bits_at + 23));
+            }
+            peer->deflater = std::make_unique<CFrameDeflater>(
+                window_bits, extensions.find("server_no_context_takeover") != std::string::npos);
+            if (!peer->deflater->Ok()) {
+                std::fprintf(stderr, "deflateInit2 failed\n");
+                g_stop = 1;
+                return;
+            }
+        }
+        peer->connected = Clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        incoming.push_back(std::move(peer));
+    }
+}
+
+// Streams every frame to every connected client, as the exchange does, until
+// the run is over. Trade ids start at 1 and are never reused; frames are
+// only generated while at least one client is connected.
+void RunSender(const SOptions& options, std::vector<std::atomic<int64_t>>& send_ns, SSenderStats& stats) {
+    net::io_context ioc;
+    ssl::context ctx(ssl::context::tlsv12_server);
+    if (!UseSelfSignedCertificate(ctx)) {
+        std::fprintf(stderr, "failed to create a self-signed certificate\n");
+        g_stop = 1;
+        return;
+    }
+    tcp::acceptor acceptor(ioc, {net::ip::make_address("127.0.0.1"), options.port});
+    std::printf("listening on wss://127.0.0.1:%u\n", options.port);
+    std::fflush(stdout);
+
+    std::mutex incoming_mutex;
+    std::vector<std::unique_ptr<SPeer>> incoming;
+    std::thread acceptor_thread([&]() { RunAcceptor(options, acceptor, ctx, incoming_mutex, incoming); });
+
+    std::vector<std::unique_ptr<SPeer>> peers;
+    auto drop = [&stats](SPeer& peer, bool graceful, websocket::close_code code) {
+        beast::error_code ec;
+        if (graceful) {
+            // The close handshake completes once the client has read everything
+            // still buffered, so those frames are not counted as drops.
+            peer.ws.close(code, ec);
+        }
+        // Otherwise no close frame: the client sees a dropped connection, as on a network fault.
+        stats.wire_bytes += BIO_number_written(SSL_get_wbio(peer.ws.next_layer().native_handle()));
+        beast::get_lowest_layer(peer.ws).close(ec);
+    };
+
+    CFrameSource source(options);
+    uint64_t seq = 0;
+    const double burst_interval_sec =
+        options.rate == 0 ? 0.0 : static_cast<double>(options.burst) / static_cast<double>(options.rate);
+    Clock::time_point run_end = Clock::time_point::max();
+    Clock::time_point next_burst{};
+    Clock::time_point streaming_since{};
+    while (!g_stop) {
+        {
+            std::lock_guard<std::mutex> lock(incoming_mutex);
+            for (auto& peer : incoming) {
+                if (stats.connections++ == 0) {
+                    run_end = Clock::now() + std::chrono::seconds(options.seconds);
+                }
+                stats.compressed_connections += peer->deflater ? 1 : 0;
+                std::printf("connection %llu%s\n", static_cast<unsigned long long>(stats.connections),
+                            peer->deflater ? " (permessage-deflate)" : "");
+                std::fflush(stdout);
+                peers.push_back(std::move(peer));
+            }
+            incoming.clear();
+        }
+        auto now = Clock::now();
+        if (now >= run_end) {
+            break;
+        }
+        for (auto it = peers.begin(); it != peers.end();) {
+            const auto age = now - (*it)->connected;
+            if (options.disconnect_every_sec > 0 && age >= std::chrono::seconds(options.disconnect_every_sec)) {
+                ++stats.forced_disconnects;
+                drop(**it, false, websocket::close_code::none);
+                it = peers.erase(it);
+            } else if (options.max_age_sec > 0 && age >= std::chrono::seconds(options.max_age_sec)) {
+                ++stats.aged_out;
+                drop(**it, true, websocket::close_code::going_away);
+                it = peers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (peers.empty()) {
+            if (streaming_since != Clock::time_point{}) {
+                stats.seconds += std::chrono::duration<double>(now - streaming_since).count();
+                streaming_since = {};
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if (streaming_since == Clock::time_point{}) {
+            streaming_since = now;
+            next_burst = now;
+        }
+        if (burst_interval_sec > 0.0) {
+            if (now < next_burst) {
+                std::this_thread::sleep_until(std::min({next_burst, run_end, now + std::chrono::milliseconds(10)}));
+                continue;
+            }
+            next_burst += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(burst_interval_sec));
+        }
+        for (uint64_t i = 0; i < options.burst && !peers.empty(); ++i) {
+            const std::string& frame = source.Next(++seq);
+            send_ns[seq % kSendTimeSlots].store(NowNs(), std::memory_order_relaxed);
+            for (auto it = peers.begin(); it != peers.end();) {
+                beast::error_code ec;
+                auto& peer = **it;
+                if (peer.deflater) {
+                    // Whole frames straight to the TLS stream; Beast's framing state is untouched.
+                    net::write(peer.ws.next_layer(), net::buffer(peer.deflater->Frame(frame)), ec);
+                } else {
+                    peer.ws.write(net::buffer(frame), ec);
+                }
+                if (ec) {
+                    std::fprintf(stderr, "write failed: %s\n", ec.message().c_str());
+                    drop(peer, false, websocket::close_code::none);
+                    it = peers.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            ++stats.sent;
+            stats.bytes += frame.size();
+        }
+    }
+    if (streaming_since != Clock::time_point{}) {
+        stats.seconds += std::chrono::duration<double>(Clock::now() - streaming_since).count();
+    }
+    for (auto& peer : peers) {
+        drop(*peer, true, websocket::close_code::normal);
+    }
+    // Wakes the blocking accept.
+    ::shutdown(acceptor.native_handle(), SHUT_RDWR);
+    acceptor_thread.join();
+}
+
+struct SReceiverStats {
+    uint64_t matched = 0;
+    uint64_t duplicates = 0;  // ids published more than once
+    uint64_t lost_in_ring = 0;
+    int64_t first_ns = 0;
+    int64_t last_ns = 0;
+    std::vector<uint32_t> latency_us;
+};
+
+void RunReceiver(const std::string& name, uint64_t run_start_ms, const std::vector<std::atomic<int64_t>>& send_ns,
+                 const std::atomic<bool>& done, SReceiverStats& stats) {
+    CShmReader reader;
+    while (!reader.Open(name)) {
+        if (g_stop || done.load()) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    // Read from the start of the ring: the service may publish the first
+    // frames before the segment is found. Records of earlier runs are
+    // older than run_start_ms and skipped.
+    stats.latency_us.reserve(1u << 22);
+    std::vector<bool> seen;
+    SShmTradeRecord record{};
+    // After the sender is done, wait until the feed has been quiet for a second.
+    int64_t quiet_since = NowNs();
+    while (!g_stop && !(done.load() && NowNs() - quiet_since > 1000000000)) {
+        bool idle = true;
+        while (reader.Trades().Next(record)) {
+            idle = false;
+            if (record.last_trade_id == 0 || record.timestamp < run_start_ms ||
+                std::strncmp(record.symbol, "LGEN", 4) != 0) {
+                continue;
+            }
+            if (record.last_trade_id >= seen.size()) {
+                seen.resize(std::max<size_t>(record.last_trade_id + 1, seen.size() * 2));
+            }
+            if (seen[record.last_trade_id]) {
+                ++stats.duplicates;
+                continue;
+            }
+            seen[record.last_trade_id] = true;
+            const int64_t now = NowNs();
+            const int64_t sent = send_ns[record.last_trade_id % kSendTimeSlots].load(std::memory_order_relaxed);
+            ++stats.matched;
+            stats.first_ns = stats.first_ns == 0 ? now : stats.first_ns;
+            stats.last_ns = now;
+            stats.latency_us.push_back(static_cast<uint32_t>(std::max<int64_t>(0, now - sent) / 1000));
+        }
+        if (idle) {
+            std::this_thread::yield();
+        } else {
+            quiet_since = NowNs();
+        }
+    }
+    stats.lost_in_ring = reader.Trades().Lost();
+}
+
+bool ParseArgs(int argc, char** argv, SOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--port=", 0) == 0) {
+            options.port = static_cast<uint16_t>(std::stoul(arg.substr(7)));
+        } else if (arg.rfind("--symbols=", 0) == 0) {
+            options.symbols = std::max<size_t>(1, std::stoull(arg.substr(10)));
+        } else if (arg.rfind("--rate=", 0) == 0) {
+            options.rate = std::stoull(arg.substr(7));
+        } else if (arg.rfind("--burst=", 0) == 0) {
+            options.burst = std::max<uint64_t>(1, std::stoull(arg.substr(8)));
+        } else if (arg.rfind("--seconds=", 0) == 0) {
+            options.seconds = std::max<uint64_t>(1, std::stoull(arg.substr(10)));
+        } else if (arg.rfind("--disconnect-every=", 0) == 0) {
+            options.disconnect_every_sec = std::stoull(arg.substr(19));
+        } else if (arg.rfind("--max-age=", 0) == 0) {
+            options.max_age_sec = std::stoull(arg.substr(10));
+        } else if (arg == "--stream=trade" || arg == "--stream=aggTrade") {
+            options.agg_trade = arg == "--stream=aggTrade";
+        } else if (arg == "--venue=binance" || arg == "--venue=okx") {
+            options.okx = arg == "--venue=okx";
+        } else if (arg.rfind("--shm=", 0) == 0) {
+            options.shm_name = arg.substr(6);
+        } else if (arg == "--deflate") {
+            options.deflate = true;
+        } else if (arg.rfind("--deflate=", 0) == 0) {
+            options.deflate = true;
+            options.deflate_window_bits = std::stoi(arg.substr(10));
+            if (options.deflate_window_bits < 9 || options.deflate_window_bits > 15) {
+                return false;
+            }
+        } else if (arg == "--deflate-no-context-takeover") {
+            options.deflate_no_context_takeover = true;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+int main(int argc, char** argv) {
+    SOptions options;
+    if (!ParseArgs(argc, argv, options)) {
+        std::fprintf(stderr,
+                     "usage: %s [--port=N] [--symbols=N] [--rate=N] [--burst=N] [--seconds=N]\n"
+                     "          [--disconnect-every=N] [--max-age=N] [--stream=trade|aggTrade]\n"
+                     "          [--venue=binance|okx]\n"
+                     "          [--shm=/name] [--deflate[=9..15]] [--deflate-no-context-takeover]\n",
+                     argv[0]);
+        return 1;
+    }
+    std::signal(SIGINT, [](int) { g_stop = 1; });
+    std::signal(SIGTERM, [](int) { g_stop = 1; });
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::atomic<int64_t>> send_ns(kSendTimeSlots);
+    std::atomic<bool> receiver_done{false};
+    SReceiverStats received;
+    std::thread receiver;
+    if (!options.shm_name.empty()) {
+        const uint64_t run_start_ms = NowMs();
+        receiver = std::thread([&, run_start_ms]() {
+            RunReceiver(options.shm_name, run_start_ms, send_ns, receiver_done, received);
+        });
+    }
+
+    SSenderStats sent;
+    try {
+        RunSender(options, send_ns, sent);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "loadgen: %s\n", e.what());
+    }
+    if (receiver.joinable()) {
+        receiver_done.store(true);
+        receiver.join();
+    }
+
+    const double seconds = std::max(sent.seconds, 1e-9);
+    std::printf("sent %llu frames in %.2f s connected: %.0f frames/s, %.2f MB/s (%llu connections, %llu forced disconnects, %llu aged out)\n",
+                static_cast<unsigned long long>(sent.sent), sent.seconds, static_cast<double>(sent.sent) / seconds,
+                static_cast<double>(sent.bytes) / seconds / 1e6, static_cast<unsigned long long>(sent.connections),
+                static_cast<unsigned long long>(sent.forced_disconnects),
+                static_cast<unsigned long long>(sent.aged_out));
+    if (sent.wire_bytes > 0) {
+        std::printf("wire %.2f MB/s, payload/wire %.2f (%llu of %llu connections compressed)\n",
+                    static_cast<double>(sent.wire_bytes) / seconds / 1e6,
+                    static_cast<double>(sent.bytes) / static_cast<double>(sent.wire_bytes),
+                    static_cast<unsigned long long>(sent.compressed_connections),
+                    static_cast<unsigned long long>(sent.connections));
+    }
+    if (!options.shm_name.empty()) {
+        const uint64_t missing = sent.sent > received.matched ? sent.sent - received.matched : 0;
+        const double receive_seconds = std::max(1e-9, static_cast<double>(received.last_ns - received.first_ns) / 1e9);
+        std::printf("received %llu via %s: %.0f frames/s sustained, drop rate %.4f%% (%llu missing, %llu duplicates, %llu lapped in the shm ring)\n",
+                    static_cast<unsigned long long>(received.matched), options.shm_name.c_str(),
+                    static_cast<double>(received.matched) / receive_seconds,
+                    sent.sent == 0 ? 0.0 : 100.0 * static_cast<double>(missing) / static_cast<double>(sent.sent),
+                    static_cast<unsigned long long>(missing), static_cast<unsigned long long>(received.duplicates),
+                    static_cast<unsigned long long>(received.lost_in_ring));
+        auto& lat = received.latency_us;
+        if (!lat.empty()) {
+            std::sort(lat.begin(), lat.end());
+            auto pct = [&](double p) { return lat[std::min(lat.size() - 1, static_cast<size_t>(p * lat.size()))]; };
+            std::printf("end-to-end latency: p50 %u us  p99 %u us  p99.9 %u us  max %u us\n", pct(0.5), pct(0.99),
+                        pct(0.999), lat.back());
+        }
+    }
+    return 0;
+}